@@ -0,0 +1,16 @@
+# This module defines
+# liburing_LIBRARY, the name of the library to link against
+# liburing_FOUND, if false, the io_uring persistent log backend is disabled
+# liburing_INCLUDE_DIR, where to find liburing.h
+
+find_path(liburing_INCLUDE_DIR NAMES liburing.h)
+find_library(liburing_LIBRARY NAMES uring)
+
+include(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(liburing
+                                  REQUIRED_VARS liburing_LIBRARY liburing_INCLUDE_DIR)
+
+if(liburing_FOUND)
+    set(liburing_INCLUDE_DIRS ${liburing_INCLUDE_DIR})
+    set(liburing_LIBRARIES ${liburing_LIBRARY})
+endif()
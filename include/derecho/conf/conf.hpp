@@ -37,15 +37,30 @@ private:
 #define CONF_DERECHO_EXTERNAL_PORT "DERECHO/external_port"
 #define CONF_DERECHO_HEARTBEAT_MS "DERECHO/heartbeat_ms"
 #define CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS "DERECHO/p2p_loop_busy_wait_before_sleep_ms"
+#define CONF_DERECHO_P2P_RECEIVE_THREADS "DERECHO/p2p_receive_threads"
+#define CONF_DERECHO_P2P_REQUEST_WORKERS "DERECHO/p2p_request_workers"
+#define CONF_DERECHO_P2P_PROBE_BATCH_SIZE "DERECHO/p2p_probe_batch_size"
 #define CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS "DERECHO/sst_poll_cq_timeout_ms"
+#define CONF_DERECHO_SST_PREDICATE_SPIN_US "DERECHO/sst_predicate_spin_us"
+#define CONF_DERECHO_SST_PREDICATE_YIELD_US "DERECHO/sst_predicate_yield_us"
+#define CONF_DERECHO_SST_PREDICATE_BLOCK_US "DERECHO/sst_predicate_block_us"
 #define CONF_DERECHO_RESTART_TIMEOUT_MS "DERECHO/restart_timeout_ms"
+#define CONF_DERECHO_RESTART_INTAKE_THREADS "DERECHO/restart_intake_threads"
 #define CONF_DERECHO_ENABLE_BACKUP_RESTART_LEADERS "DERECHO/enable_backup_restart_leaders"
 #define CONF_DERECHO_DISABLE_PARTITIONING_SAFETY "DERECHO/disable_partitioning_safety"
 #define CONF_DERECHO_MAX_NODE_ID "DERECHO/max_node_id"
+#define CONF_DERECHO_NUM_PERSISTENCE_THREADS "DERECHO/num_persistence_threads"
+#define CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE "DERECHO/state_transfer_chunk_size"
+#define CONF_DERECHO_STATE_TRANSFER_CHECKSUMS "DERECHO/state_transfer_checksums"
+#define CONF_DERECHO_STATE_TRANSFER_SOCKET_BUFFER_SIZE "DERECHO/state_transfer_socket_buffer_size"
+#define CONF_DERECHO_MESSAGE_BUFFER_ARENA_SIZE "DERECHO/message_buffer_arena_size"
+#define CONF_DERECHO_MESSAGE_BUFFER_HUGE_PAGES "DERECHO/message_buffer_huge_pages"
+#define CONF_DERECHO_RPC_DELIVERY_BATCH_SIZE "DERECHO/rpc_delivery_batch_size"
 
 #define CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE "DERECHO/max_p2p_request_payload_size"
 #define CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE "DERECHO/max_p2p_reply_payload_size"
 #define CONF_DERECHO_P2P_WINDOW_SIZE "DERECHO/p2p_window_size"
+#define CONF_DERECHO_P2P_SEND_QUEUE_SIZE "DERECHO/p2p_send_queue_size"
 
 #define CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE "SUBGROUP/DEFAULT/max_payload_size"
 #define CONF_SUBGROUP_DEFAULT_MAX_REPLY_PAYLOAD_SIZE "SUBGROUP/DEFAULT/max_reply_payload_size"
@@ -63,6 +78,10 @@ private:
 #define CONF_PERS_RESET "PERS/reset"
 #define CONF_PERS_MAX_LOG_ENTRY "PERS/max_log_entry"
 #define CONF_PERS_MAX_DATA_SIZE "PERS/max_data_size"
+#define CONF_PERS_LOG_SEGMENT_ENTRIES "PERS/log_segment_entries"
+#define CONF_PERS_DATA_SEGMENT_SIZE "PERS/data_segment_size"
+#define CONF_PERS_SNAPSHOT_INTERVAL "PERS/snapshot_interval"
+#define CONF_PERS_LOG_BACKEND "PERS/log_backend"
 #define CONF_PERS_PRIVATE_KEY_FILE "PERS/private_key_file"
 #define CONF_LOGGER_DEFAULT_LOG_NAME "LOGGER/default_log_name"
 #define CONF_LOGGER_DEFAULT_LOG_LEVEL "LOGGER/default_log_level"
@@ -89,14 +108,29 @@ private:
             {CONF_DERECHO_EXTERNAL_PORT, "32645"},
             {CONF_SUBGROUP_DEFAULT_RDMC_SEND_ALGORITHM, "binomial_send"},
             {CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS, "250"},
+            {CONF_DERECHO_P2P_RECEIVE_THREADS, "1"},
+            {CONF_DERECHO_P2P_REQUEST_WORKERS, "1"},
+            {CONF_DERECHO_P2P_PROBE_BATCH_SIZE, "4"},
             {CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS, "2000"},
+            {CONF_DERECHO_SST_PREDICATE_SPIN_US, "1000"},
+            {CONF_DERECHO_SST_PREDICATE_YIELD_US, "1000"},
+            {CONF_DERECHO_SST_PREDICATE_BLOCK_US, "1000"},
             {CONF_DERECHO_RESTART_TIMEOUT_MS, "2000"},
+            {CONF_DERECHO_RESTART_INTAKE_THREADS, "8"},
             {CONF_DERECHO_DISABLE_PARTITIONING_SAFETY, "true"},
             {CONF_DERECHO_ENABLE_BACKUP_RESTART_LEADERS, "false"},
             {CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE, "10240"},
             {CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE, "10240"},
             {CONF_DERECHO_P2P_WINDOW_SIZE, "16"},
+            {CONF_DERECHO_P2P_SEND_QUEUE_SIZE, "1024"},
             {CONF_DERECHO_MAX_NODE_ID, "1024"},
+            {CONF_DERECHO_NUM_PERSISTENCE_THREADS, "4"},
+            {CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE, "1048576"},
+            {CONF_DERECHO_STATE_TRANSFER_CHECKSUMS, "false"},
+            {CONF_DERECHO_STATE_TRANSFER_SOCKET_BUFFER_SIZE, "0"},
+            {CONF_DERECHO_MESSAGE_BUFFER_ARENA_SIZE, "67108864"},
+            {CONF_DERECHO_MESSAGE_BUFFER_HUGE_PAGES, "none"},
+            {CONF_DERECHO_RPC_DELIVERY_BATCH_SIZE, "1"},
             // [SUBGROUP/<subgroupname>]
             {CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE, "10240"},
             {CONF_SUBGROUP_DEFAULT_MAX_REPLY_PAYLOAD_SIZE, "10240"},
@@ -115,6 +149,10 @@ private:
             {CONF_PERS_RESET, "false"},
             {CONF_PERS_MAX_LOG_ENTRY, "1048576"},       // 1M log entries.
             {CONF_PERS_MAX_DATA_SIZE, "549755813888"},  // 512G total data size.
+            {CONF_PERS_LOG_SEGMENT_ENTRIES, "65536"},   // 4MB log segments.
+            {CONF_PERS_DATA_SEGMENT_SIZE, "67108864"},  // 64MB data segments.
+            {CONF_PERS_SNAPSHOT_INTERVAL, "0"},         // no snapshot.
+            {CONF_PERS_LOG_BACKEND, "file"},
             {CONF_PERS_PRIVATE_KEY_FILE, "private_key.pem"},
             // [LOGGER]
             {CONF_LOGGER_DEFAULT_LOG_NAME, "derecho_debug"},
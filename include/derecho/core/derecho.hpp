@@ -9,5 +9,6 @@
 #include "subgroup_functions.hpp"
 #include "subgroup_info.hpp"
 #include "notification.hpp"
+#include "notification_stream.hpp"
 #include "bytes_object.hpp"
 #include "derecho/mutils-serialization/SerializationSupport.hpp"
@@ -9,10 +9,21 @@
 #include <mutex>
 
 namespace tcp {
+/**
+ * Sets the send and receive buffers of a socket to buffer_size bytes, unless
+ * buffer_size is 0, which keeps the kernel's default sizes. A failure only
+ * prints a warning, since the socket still works with the default sizes.
+ * @param sock The socket
+ * @param buffer_size The size of both buffers, in bytes
+ */
+void set_socket_buffer_sizes(socket& sock, int buffer_size);
+
 class tcp_connections {
     std::mutex sockets_mutex;
 
     node_id_t my_id;
+    /** The send and receive buffer size of every socket, or 0 for the kernel's defaults */
+    int socket_buffer_size;
     std::unique_ptr<connection_listener> conn_listener;
     std::map<node_id_t, socket> sockets;
     bool add_connection(const node_id_t other_id,
@@ -26,9 +37,12 @@ public:
      * to all of the initial set of addresses.
      * @param my_id The ID of this node
      * @param ip_addrs_and_ports The map of IP address-port pairs to connect to, indexed by node ID
+     * @param socket_buffer_size The send and receive buffer size of every
+     * socket, or 0 to keep the kernel's default sizes
      */
     tcp_connections(node_id_t my_id,
-                    const std::map<node_id_t, std::pair<ip_addr_t, uint16_t>> ip_addrs_and_ports);
+                    const std::map<node_id_t, std::pair<ip_addr_t, uint16_t>> ip_addrs_and_ports,
+                    int socket_buffer_size = 0);
     void destroy();
     /**
      * Writes size bytes from a buffer to the node with ID node_id, using the
@@ -133,5 +147,15 @@ public:
      * @return A LockedReference to the TCP socket connected to that node.
      */
     derecho::LockedReference<std::unique_lock<std::mutex>, socket> get_socket(node_id_t node_id);
+
+    /**
+     * Gets a locked reference to all of the TCP sockets, indexed by node ID.
+     * Like get_socket, no other tcp_connections methods can be called while
+     * the caller holds the locked reference, but the caller can use the
+     * sockets connected to several nodes at once, e.g. from one thread per
+     * node. The caller must not add or remove entries in the map.
+     * @return A LockedReference to the map from node ID to TCP socket.
+     */
+    derecho::LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, socket>> get_all_sockets();
 };
 }  // namespace tcp
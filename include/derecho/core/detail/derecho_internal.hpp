@@ -17,6 +17,7 @@
 #include <string>
 #include <sys/types.h>
 #include <utility>
+#include <vector>
 
 namespace persistent {
 class PersistentRegistry;
@@ -63,6 +64,28 @@ using verified_callback_t = std::function<void(subgroup_id_t, persistent::versio
  */
 using rpc_handler_t = std::function<void(subgroup_id_t, node_id_t, persistent::version_t, uint64_t, uint8_t*, uint32_t)>;
 
+/**
+ * An RPC message that MulticastGroup delivers as part of a batch, with the
+ * arguments it would otherwise have passed to an rpc_handler_t.
+ */
+struct DeliveredRPCMessage {
+    node_id_t sender_id;
+    persistent::version_t version;
+    /** The message's timestamp, in microseconds */
+    uint64_t timestamp_us;
+    /** The RPC message, after the multicast header */
+    uint8_t* buf;
+    uint32_t size;
+};
+
+/**
+ * The type of the function used by MulticastGroup to hand a run of
+ * consecutive RPC messages in one subgroup to RPCManager. The function must
+ * deliver them in order, and create each message's version as soon as that
+ * message has been handled.
+ */
+using rpc_batch_handler_t = std::function<void(subgroup_id_t, const std::vector<DeliveredRPCMessage>&)>;
+
 /**
  * Bundles together a set of callback functions for message delivery events.
  * These will be invoked by MulticastGroup or ViewManager to hand control back
@@ -108,10 +108,55 @@ auto ExternalClientCaller<T, ExternalGroupType>::p2p_send(node_id_t dest_node, A
                 }
             },
             std::forward<Args>(args)...);
+    std::lock_guard<std::mutex> lock(group_client.p2p_send_mutex);
     group_client.send_p2p_message(dest_node, subgroup_id, message_seq_num, return_pair.pending);
     return std::move(*return_pair.results);
 }
 
+template <typename T, typename ExternalGroupType>
+template <rpc::FunctionTag tag, typename... Args>
+auto ExternalClientCaller<T, ExternalGroupType>::p2p_send_async(node_id_t dest_node, Args&&... args) {
+    using results_t = std::decay_t<decltype(*wrapped_this->template send<rpc::to_internal_tag<true>(tag)>(
+                                                    std::declval<std::function<uint8_t*(std::size_t)>>(),
+                                                    std::forward<Args>(args)...)
+                                                    .results)>;
+    add_p2p_connection(dest_node);
+
+    std::lock_guard<std::mutex> lock(group_client.p2p_send_mutex);
+    auto& send_queue = group_client.p2p_send_queues[dest_node];
+    // Fail fast, before serializing anything, if the message could not even be queued
+    if(send_queue.size() >= group_client.p2p_send_queue_size) {
+        return std::optional<results_t>{};
+    }
+    std::optional<sst::P2PBufferHandle> buffer_handle;
+    std::unique_ptr<uint8_t[]> queued_buf;
+    std::size_t queued_size = 0;
+    auto return_pair = wrapped_this->template send<rpc::to_internal_tag<true>(tag)>(
+            [&](size_t size) -> uint8_t* {
+                const std::size_t max_p2p_request_payload_size = getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE);
+                if(size > max_p2p_request_payload_size) {
+                    throw derecho_exception("The size of serialized args exceeds the maximum message size (CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE).");
+                }
+                // Messages already queued for dest_node must go out before this one
+                if(send_queue.empty()) {
+                    buffer_handle = group_client.try_get_sendbuffer_ptr(dest_node, sst::MESSAGE_TYPE::P2P_REQUEST);
+                }
+                if(buffer_handle) {
+                    return buffer_handle->buf_ptr;
+                }
+                queued_buf = std::make_unique<uint8_t[]>(size);
+                queued_size = size;
+                return queued_buf.get();
+            },
+            std::forward<Args>(args)...);
+    if(buffer_handle) {
+        group_client.send_p2p_message(dest_node, subgroup_id, buffer_handle->seq_num, return_pair.pending);
+    } else {
+        send_queue.push({subgroup_id, std::move(queued_buf), queued_size, return_pair.pending});
+    }
+    return std::optional<results_t>{std::move(*return_pair.results)};
+}
+
 template <typename... ReplicatedTypes>
 void ExternalGroupClient<ReplicatedTypes...>::initialize_p2p_connections() {
     uint64_t view_max_rpc_reply_payload_size = 0;
@@ -148,7 +193,8 @@ template <typename... ReplicatedTypes>
 ExternalGroupClient<ReplicatedTypes...>::ExternalGroupClient()
         : my_id(getConfUInt32(CONF_DERECHO_LOCAL_ID)),
           receivers(new std::decay_t<decltype(*receivers)>()),
-          busy_wait_before_sleep_ms(getConfUInt64(CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS)) {
+          busy_wait_before_sleep_ms(getConfUInt64(CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS)),
+          p2p_send_queue_size(std::max(getConfUInt32(CONF_DERECHO_P2P_SEND_QUEUE_SIZE), 1u)) {
 #ifdef USE_VERBS_API
     sst::verbs_initialize({},
                           std::map<node_id_t, std::pair<ip_addr_t, uint16_t>>{{my_id, {getConfString(CONF_DERECHO_LOCAL_IP), getConfUInt16(CONF_DERECHO_EXTERNAL_PORT)}}},
@@ -181,7 +227,8 @@ ExternalGroupClient<ReplicatedTypes...>::ExternalGroupClient(
 #else
           factories(make_kind_map<NoArgFactory>(factories...)),
 #endif
-          busy_wait_before_sleep_ms(getConfUInt64(CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS)) {
+          busy_wait_before_sleep_ms(getConfUInt64(CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS)),
+          p2p_send_queue_size(std::max(getConfUInt32(CONF_DERECHO_P2P_SEND_QUEUE_SIZE), 1u)) {
     for(auto dc : deserialization_contexts) {
         rdv.push_back(dc);
     }
@@ -209,6 +256,12 @@ ExternalGroupClient<ReplicatedTypes...>::~ExternalGroupClient() {
     if(rpc_listener_thread.joinable()) {
         rpc_listener_thread.join();
     }
+    std::lock_guard<std::mutex> lock(p2p_send_mutex);
+    for(auto& send_queue_pair : p2p_send_queues) {
+        fail_queued_p2p_sends(send_queue_pair.first);
+    }
+    // No reply will free up a request buffer anymore
+    p2p_send_window_cv.notify_all();
 }
 
 template <typename... ReplicatedTypes>
@@ -260,8 +313,16 @@ bool ExternalGroupClient<ReplicatedTypes...>::get_view(const node_id_t nid) {
 
 template <typename... ReplicatedTypes>
 void ExternalGroupClient<ReplicatedTypes...>::clean_up() {
+    std::lock_guard<std::mutex> lock(p2p_send_mutex);
     p2p_connections->filter_to(curr_view->members);
     sst::filter_external_to(curr_view->members);
+    for(auto& send_queue_pair : p2p_send_queues) {
+        if(curr_view->rank_of(send_queue_pair.first) == -1) {
+            fail_queued_p2p_sends(send_queue_pair.first);
+        }
+    }
+    // Threads waiting for a request buffer to a removed node must wake up and fail
+    p2p_send_window_cv.notify_all();
 
     for(auto& fulfilled_pending_results_pair : fulfilled_pending_results) {
         const subgroup_id_t subgroup_id = fulfilled_pending_results_pair.first;
@@ -335,17 +396,70 @@ ExternalClientCaller<SubgroupType, ExternalGroupClient<ReplicatedTypes...>>& Ext
 template <typename... ReplicatedTypes>
 sst::P2PBufferHandle ExternalGroupClient<ReplicatedTypes...>::get_sendbuffer_ptr(uint32_t dest_id, sst::MESSAGE_TYPE type) {
     std::optional<sst::P2PBufferHandle> buffer;
-    do {
-        try {
-            buffer = p2p_connections->get_sendbuffer_ptr(dest_id, type);
-        } catch(std::out_of_range& map_error) {
-            throw node_removed_from_group_exception(dest_id);
+    std::unique_lock<std::mutex> lock(p2p_send_mutex);
+    p2p_send_window_cv.wait(lock, [&]() {
+        if(thread_shutdown) {
+            throw derecho_exception("ExternalGroupClient is shutting down.");
         }
-
-    } while(!buffer);
+        if(type == sst::MESSAGE_TYPE::P2P_REQUEST && !p2p_send_queues[dest_id].empty()) {
+            return false;
+        }
+        buffer = try_get_sendbuffer_ptr(dest_id, type);
+        return buffer.has_value();
+    });
     return *buffer;
 }
 
+template <typename... ReplicatedTypes>
+std::optional<sst::P2PBufferHandle> ExternalGroupClient<ReplicatedTypes...>::try_get_sendbuffer_ptr(uint32_t dest_id, sst::MESSAGE_TYPE type) {
+    try {
+        return p2p_connections->get_sendbuffer_ptr(dest_id, type);
+    } catch(std::out_of_range& map_error) {
+        throw node_removed_from_group_exception(dest_id);
+    }
+}
+
+template <typename... ReplicatedTypes>
+void ExternalGroupClient<ReplicatedTypes...>::drain_p2p_send_queues() {
+    std::lock_guard<std::mutex> lock(p2p_send_mutex);
+    for(auto& send_queue_pair : p2p_send_queues) {
+        const node_id_t dest_id = send_queue_pair.first;
+        auto& send_queue = send_queue_pair.second;
+        while(!send_queue.empty()) {
+            std::optional<sst::P2PBufferHandle> buffer;
+            try {
+                buffer = try_get_sendbuffer_ptr(dest_id, sst::MESSAGE_TYPE::P2P_REQUEST);
+            } catch(node_removed_from_group_exception&) {
+                fail_queued_p2p_sends(dest_id);
+                break;
+            }
+            if(!buffer) {
+                break;
+            }
+            queued_p2p_send& request = send_queue.front();
+            std::memcpy(buffer->buf_ptr, request.msg_buf.get(), request.msg_size);
+            send_p2p_message(dest_id, request.dest_subgroup_id, buffer->seq_num, request.pending_results_handle);
+            send_queue.pop();
+        }
+    }
+    p2p_send_window_cv.notify_all();
+}
+
+template <typename... ReplicatedTypes>
+void ExternalGroupClient<ReplicatedTypes...>::fail_queued_p2p_sends(node_id_t dest_id) {
+    auto& send_queue = p2p_send_queues[dest_id];
+    while(!send_queue.empty()) {
+        std::shared_ptr<AbstractPendingResults> pending_results = send_queue.front().pending_results_handle.lock();
+        if(pending_results) {
+            pending_results->fulfill_map({dest_id});
+            pending_results->set_exception_for_removed_node(dest_id);
+            // No reply will ever arrive to free the invocation ID
+            pending_results->delete_self_ptr();
+        }
+        send_queue.pop();
+    }
+}
+
 template <typename... ReplicatedTypes>
 void ExternalGroupClient<ReplicatedTypes...>::send_p2p_message(node_id_t dest_id, subgroup_id_t dest_subgroup_id, uint64_t sequence_num, std::weak_ptr<rpc::AbstractPendingResults> pending_results_handle) {
     try {
@@ -496,6 +610,10 @@ void ExternalGroupClient<ReplicatedTypes...>::p2p_receive_loop() {
                 p2p_message_handler(message_handle.sender_id, message_handle.buf);
                 p2p_connections->increment_incoming_seq_num(message_handle.sender_id, message_handle.type);
             }
+            // Each reply (including a null reply) frees up a buffer in a request window
+            if(message_handle.type == sst::MESSAGE_TYPE::P2P_REPLY) {
+                drain_p2p_send_queues();
+            }
 
             // update last time
             clock_gettime(CLOCK_REALTIME, &last_time);
@@ -9,6 +9,7 @@
 #include "derecho/utils/logger.hpp"
 #include "derecho_internal.hpp"
 #include "make_kind_map.hpp"
+#include "state_transfer.hpp"
 
 #include <spdlog/async.h>
 #include <spdlog/sinks/rotating_file_sink.h>
@@ -256,6 +257,10 @@ Group<ReplicatedTypes...>::Group(const UserMessageCallbacks& callbacks,
             // Verification callback
             [this](subgroup_id_t subgroup, persistent::version_t version) {
                 rpc_manager.notify_verification_finished(subgroup, version);
+            },
+            // Batched RPC message handler
+            [this](subgroup_id_t subgroup, const std::vector<DeliveredRPCMessage>& messages) {
+                rpc_manager.rpc_batch_handler(subgroup, messages, objects_by_subgroup_id.at(subgroup));
             }};
     view_manager.initialize_multicast_groups(callbacks, internal_callbacks);
     rpc_manager.create_connections();
@@ -492,33 +497,69 @@ ShardIterator<SubgroupType> Group<ReplicatedTypes...>::get_shard_iterator(uint32
 
 template <typename... ReplicatedTypes>
 void Group<ReplicatedTypes...>::receive_objects(const std::set<std::pair<subgroup_id_t, node_id_t>>& subgroups_and_leaders) {
-    // This will receive one object from each shard leader in ascending order of subgroup ID
+    // Each sender sends its objects in ascending order of subgroup ID over its own socket, so the objects
+    // from different senders can be received concurrently.
+    std::map<node_id_t, std::vector<subgroup_id_t>> subgroups_by_sender;
     for(const auto& subgroup_and_leader : subgroups_and_leaders) {
-        LockedReference<std::unique_lock<std::mutex>, tcp::socket> leader_socket
-                = view_manager.get_transfer_socket(subgroup_and_leader.second);
-        ReplicatedObject* subgroup_object = objects_by_subgroup_id.at(subgroup_and_leader.first);
-        try {
-            if(subgroup_object->is_persistent()) {
-                persistent::version_t log_tail_length = subgroup_object->get_minimum_latest_persisted_version();
-                dbg_default_debug("Sending log tail length of {} for subgroup {} to node {}.",
-                                  log_tail_length, subgroup_and_leader.first, subgroup_and_leader.second);
-                leader_socket.get().write(log_tail_length);
+        subgroups_by_sender[subgroup_and_leader.second].push_back(subgroup_and_leader.first);
+    }
+    if(subgroups_by_sender.empty()) {
+        dbg_default_debug("Done receiving all Replicated Objects from subgroup leaders (there were none to receive)");
+        return;
+    }
+    LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, tcp::socket>> sockets
+            = view_manager.get_transfer_sockets();
+    auto receive_from_sender = [this, &sockets](node_id_t sender, const std::vector<subgroup_id_t>& subgroup_ids) {
+        tcp::socket& sender_socket = sockets.get().at(sender);
+        for(subgroup_id_t subgroup_id : subgroup_ids) {
+            ReplicatedObject* subgroup_object = objects_by_subgroup_id.at(subgroup_id);
+            try {
+                if(subgroup_object->is_persistent()) {
+                    persistent::version_t log_tail_length = subgroup_object->get_minimum_latest_persisted_version();
+                    dbg_default_debug("Sending log tail length of {} for subgroup {} to node {}.",
+                                      log_tail_length, subgroup_id, sender);
+                    sender_socket.write(log_tail_length);
+                }
+                dbg_default_debug("Receiving Replicated Object state for subgroup {} from node {}",
+                                  subgroup_id, sender);
+                // The whole object, log tails included, is buffered before it is deserialized
+                StateTransferBuffer buffer;
+                buffer.receive(sender_socket);
+                dbg_default_trace("Deserializing Replicated Object from buffer of size {}", buffer.size());
+                subgroup_object->receive_object(buffer.data());
+            } catch(tcp::socket_error& e) {
+                // Convert socket exceptions to a more readable error message, since this will cause a crash
+                throw derecho_exception("Fatal error: Node " + std::to_string(sender) + " failed during state transfer!");
+            }
+        }
+    };
+    if(subgroups_by_sender.size() == 1) {
+        receive_from_sender(subgroups_by_sender.begin()->first, subgroups_by_sender.begin()->second);
+    } else {
+        std::vector<std::thread> receiver_threads;
+        std::vector<std::exception_ptr> errors(subgroups_by_sender.size());
+        for(const auto& sender_and_subgroups : subgroups_by_sender) {
+            std::size_t thread_index = receiver_threads.size();
+            receiver_threads.emplace_back([&, thread_index]() {
+                pthread_setname_np(pthread_self(), "state_xfer");
+                try {
+                    receive_from_sender(sender_and_subgroups.first, sender_and_subgroups.second);
+                } catch(...) {
+                    errors[thread_index] = std::current_exception();
+                }
+            });
+        }
+        for(auto& thread : receiver_threads) {
+            thread.join();
+        }
+        for(const auto& error : errors) {
+            if(error) {
+                std::rethrow_exception(error);
             }
-            dbg_default_debug("Receiving Replicated Object state for subgroup {} from node {}",
-                              subgroup_and_leader.first, subgroup_and_leader.second);
-            std::size_t buffer_size;
-            leader_socket.get().read(buffer_size);
-            std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(buffer_size);
-            leader_socket.get().read(buffer.get(), buffer_size);
-            dbg_default_trace("Deserializing Replicated Object from buffer of size {}", buffer_size);
-            subgroup_object->receive_object(buffer.get());
-        } catch(tcp::socket_error& e) {
-            // Convert socket exceptions to a more readable error message, since this will cause a crash
-            throw derecho_exception("Fatal error: Node " + std::to_string(subgroup_and_leader.second) + " failed during state transfer!");
         }
     }
 
-    dbg_default_debug("Done receiving all Replicated Objects from subgroup leaders {}", subgroups_and_leaders.empty() ? "(there were none to receive)" : "");
+    dbg_default_debug("Done receiving all Replicated Objects from {} senders", subgroups_by_sender.size());
 }
 
 template <typename... ReplicatedTypes>
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "derecho/rdmc/rdmc.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace derecho {
+
+/**
+ * Represents a block of memory used to store a message. The block is a slice
+ * of a larger RDMA memory region (usually an arena owned by a
+ * MessageBufferPool, or else a region owned by the application), so RDMC
+ * operations on it must use the buffer's offset within that region.
+ * This is a move-only type, since the block can only be owned by one message.
+ */
+struct MessageBuffer {
+    /** The start of the block of memory */
+    uint8_t* buffer = nullptr;
+    /** The size of the block in bytes, which is the size of its pool's size class */
+    std::size_t size = 0;
+    /** The offset of the block from the start of mr's buffer */
+    std::size_t offset = 0;
+    /** The registered memory region that contains the block */
+    std::shared_ptr<rdma::memory_region> mr;
+    /** If the block belongs to the application rather than to a pool, the
+     * function to call when it is no longer in use; empty otherwise */
+    std::function<void()> release_callback;
+
+    MessageBuffer() {}
+    MessageBuffer(const MessageBuffer&) = delete;
+    MessageBuffer(MessageBuffer&& other)
+            : buffer(std::exchange(other.buffer, nullptr)),
+              size(std::exchange(other.size, 0)),
+              offset(std::exchange(other.offset, 0)),
+              mr(std::move(other.mr)),
+              release_callback(std::move(other.release_callback)) {}
+    MessageBuffer& operator=(const MessageBuffer&) = delete;
+    MessageBuffer& operator=(MessageBuffer&& other) {
+        buffer = std::exchange(other.buffer, nullptr);
+        size = std::exchange(other.size, 0);
+        offset = std::exchange(other.offset, 0);
+        mr = std::move(other.mr);
+        release_callback = std::move(other.release_callback);
+        return *this;
+    }
+};
+
+/**
+ * A pool of registered message buffers shared by all the subgroups of a
+ * MulticastGroup (and handed on to the next MulticastGroup at a view change).
+ * Buffers come in power-of-two size classes, and a request is served from the
+ * smallest class that fits it, so small messages don't tie up buffers of the
+ * subgroup's maximum message size. Buffers are carved lazily out of large
+ * arenas, each of which is registered with RDMA once, optionally backed by
+ * 2MB or 1GB huge pages. Memory given back to the pool is kept for reuse and
+ * only freed when the pool and every buffer taken from it are destroyed.
+ * All methods are thread-safe.
+ */
+class MessageBufferPool {
+public:
+    /** The kinds of pages an arena can be backed by. */
+    enum class PageSize {
+        DEFAULT,
+        HUGE_2MB,
+        HUGE_1GB
+    };
+
+    /** The size of the smallest size class. */
+    static constexpr std::size_t min_class_size = 4096;
+
+private:
+    /**
+     * A block of memory mapped with mmap and registered as one memory region.
+     * Buffers refer to it through an aliased shared_ptr to its memory region,
+     * so it is unmapped only after the last of them is gone.
+     */
+    struct Arena {
+        uint8_t* base;
+        std::size_t length;
+        std::unique_ptr<rdma::memory_region> mr;
+        Arena(uint8_t* base, std::size_t length);
+        ~Arena();
+    };
+
+    const std::size_t arena_size;
+    const PageSize page_size;
+    std::mutex pool_mtx;
+    /** Free buffers, indexed by size class. Protected by pool_mtx. */
+    std::map<std::size_t, std::vector<MessageBuffer>> free_buffers;
+    /** The arena new buffers are currently carved from. Protected by pool_mtx. */
+    std::shared_ptr<Arena> current_arena;
+    /** The number of bytes of current_arena already carved into buffers. */
+    std::size_t current_arena_used = 0;
+    /** The total size of all the arenas allocated so far. */
+    std::size_t total_arena_bytes = 0;
+
+    /** @return The size class that a request for size bytes is served from */
+    static std::size_t size_class_of(std::size_t size);
+    /** Maps and registers a new arena of at least min_length bytes. */
+    std::shared_ptr<Arena> allocate_arena(std::size_t min_length);
+    /** Carves a new buffer of the given size class out of an arena. */
+    MessageBuffer carve_buffer(std::size_t class_size);
+
+public:
+    /**
+     * @param arena_size The size of the arenas buffers are carved from; a
+     * buffer larger than this gets an arena of its own
+     * @param page_size The kind of pages to back the arenas with
+     */
+    MessageBufferPool(std::size_t arena_size, PageSize page_size);
+
+    /**
+     * Parses the value of the message_buffer_huge_pages config option.
+     * @throws derecho_exception if the value is not "none", "2MB" or "1GB"
+     */
+    static PageSize parse_page_size(const std::string& value);
+
+    /**
+     * Takes a buffer of at least size bytes out of the pool, growing the pool
+     * if no free buffer of the right size class is left.
+     */
+    MessageBuffer acquire(std::size_t size);
+
+    /** Gives a buffer taken from this pool back to it. */
+    void release(MessageBuffer&& buffer);
+
+    /** @return The total number of bytes of registered memory the pool has allocated */
+    std::size_t get_total_arena_bytes();
+};
+
+}  // namespace derecho
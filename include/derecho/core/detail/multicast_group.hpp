@@ -11,10 +11,12 @@
 #include "derecho/sst/sst.hpp"
 #include "derecho_internal.hpp"
 #include "derecho_sst.hpp"
+#include "message_buffer_pool.hpp"
 #include "persistence_manager.hpp"
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <condition_variable>
 #include <functional>
@@ -26,6 +28,8 @@
 #include <ostream>
 #include <queue>
 #include <set>
+#include <sstream>
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -72,8 +76,32 @@ struct DerechoParams : public mutils::ByteRepresentable {
     unsigned int heartbeat_ms;
     /** The algorithm to use for RDMC (binomial, chain, sequential, or tree). */
     rdmc::send_algorithm rdmc_send_algorithm;
+    /**
+     * Message sizes, in increasing order, at or below which RDMC messages are
+     * sent with the corresponding entry of rdmc_threshold_algorithms instead
+     * of rdmc_send_algorithm. Empty unless the profile sets
+     * rdmc_algorithm_thresholds.
+     */
+    std::vector<uint64_t> rdmc_size_thresholds;
+    /** The RDMC algorithm to use for each entry of rdmc_size_thresholds. */
+    std::vector<rdmc::send_algorithm> rdmc_threshold_algorithms;
+    /**
+     * The number of RDMC messages each sender can have in flight at once.
+     * Each sender gets this many RDMC groups per algorithm and sends
+     * consecutive messages on different groups, so the first blocks of a
+     * message can move through the shard while the last blocks of the
+     * previous one are still being relayed.
+     */
+    uint32_t rdmc_pipeline_depth = 1;
     /** The TCP port to use when transferring state to new members. */
     uint32_t state_transfer_port;
+    /**
+     * Whether SST Multicast messages are packed contiguously in a ring of
+     * bytes, with a length word before each one, instead of each taking a
+     * slot of sst_max_msg_size bytes. Only the bytes of the messages are then
+     * written to the other members.
+     */
+    bool packed_smc;
 
     static uint64_t compute_max_msg_size(
             const uint64_t max_payload_size,
@@ -102,6 +130,44 @@ struct DerechoParams : public mutils::ByteRepresentable {
         }
     }
 
+    /**
+     * Parses the value of the rdmc_algorithm_thresholds profile option, a
+     * comma-separated list of size:algorithm entries such as
+     * "16384:sequential_send,1048576:binomial_send", into rdmc_size_thresholds
+     * and rdmc_threshold_algorithms, sorted by size.
+     */
+    void set_rdmc_algorithm_thresholds(const std::string& thresholds_string) {
+        std::map<uint64_t, rdmc::send_algorithm> thresholds;
+        std::istringstream entries(thresholds_string);
+        std::string entry;
+        while(std::getline(entries, entry, ',')) {
+            const std::size_t colon = entry.find(':');
+            if(colon == std::string::npos) {
+                throw "wrong value for RDMC algorithm thresholds: " + thresholds_string + ". Check your config file.";
+            }
+            thresholds[std::stoull(entry.substr(0, colon))] = send_algorithm_from_string(entry.substr(colon + 1));
+        }
+        rdmc_size_thresholds.clear();
+        rdmc_threshold_algorithms.clear();
+        for(const auto& threshold : thresholds) {
+            rdmc_size_thresholds.emplace_back(threshold.first);
+            rdmc_threshold_algorithms.emplace_back(threshold.second);
+        }
+    }
+
+    /**
+     * @return The RDMC algorithm to use for a message of msg_size bytes
+     * (including the header)
+     */
+    rdmc::send_algorithm rdmc_algorithm_for(uint64_t msg_size) const {
+        for(std::size_t i = 0; i < rdmc_size_thresholds.size(); ++i) {
+            if(msg_size <= rdmc_size_thresholds[i]) {
+                return rdmc_threshold_algorithms[i];
+            }
+        }
+        return rdmc_send_algorithm;
+    }
+
     DerechoParams(uint64_t max_payload_size,
                   uint64_t max_reply_payload_size,
                   uint64_t max_smc_payload_size,
@@ -109,19 +175,40 @@ struct DerechoParams : public mutils::ByteRepresentable {
                   unsigned int window_size,
                   unsigned int heartbeat_ms,
                   rdmc::send_algorithm rdmc_send_algorithm,
-                  uint32_t state_transfer_port)
+                  uint32_t state_transfer_port,
+                  bool packed_smc = false)
             : max_reply_msg_size(max_reply_payload_size + sizeof(header)),
               sst_max_msg_size(max_smc_payload_size + sizeof(header)),
               block_size(block_size),
               window_size(window_size),
               heartbeat_ms(heartbeat_ms),
               rdmc_send_algorithm(rdmc_send_algorithm),
-              state_transfer_port(state_transfer_port) {
+              state_transfer_port(state_transfer_port),
+              packed_smc(packed_smc) {
         //if this is initialized above, DerechoParams turns abstract. idk why.
         max_msg_size = compute_max_msg_size(max_payload_size, block_size,
                                             max_payload_size > max_smc_payload_size);
     }
 
+    DerechoParams(uint64_t max_payload_size,
+                  uint64_t max_reply_payload_size,
+                  uint64_t max_smc_payload_size,
+                  uint64_t block_size,
+                  unsigned int window_size,
+                  unsigned int heartbeat_ms,
+                  rdmc::send_algorithm rdmc_send_algorithm,
+                  std::vector<uint64_t> rdmc_size_thresholds,
+                  std::vector<rdmc::send_algorithm> rdmc_threshold_algorithms,
+                  uint32_t rdmc_pipeline_depth,
+                  uint32_t state_transfer_port,
+                  bool packed_smc)
+            : DerechoParams(max_payload_size, max_reply_payload_size, max_smc_payload_size, block_size,
+                            window_size, heartbeat_ms, rdmc_send_algorithm, state_transfer_port, packed_smc) {
+        this->rdmc_size_thresholds = std::move(rdmc_size_thresholds);
+        this->rdmc_threshold_algorithms = std::move(rdmc_threshold_algorithms);
+        this->rdmc_pipeline_depth = rdmc_pipeline_depth;
+    }
+
     DerechoParams() {}
 
     /**
@@ -151,8 +238,10 @@ struct DerechoParams : public mutils::ByteRepresentable {
         uint32_t timeout_ms = getConfUInt32(CONF_DERECHO_HEARTBEAT_MS);
         const std::string& algorithm = getConfString(prefix + Conf::subgroupProfileFields[5]);
         uint32_t state_transfer_port = getConfUInt32(CONF_DERECHO_STATE_TRANSFER_PORT);
+        // Optional, unlike the fields in subgroupProfileFields
+        bool packed_smc = hasCustomizedConfKey(prefix + "packed_smc") && getConfBoolean(prefix + "packed_smc");
 
-        return DerechoParams{
+        DerechoParams params{
                 max_payload_size,
                 max_reply_payload_size,
                 max_smc_payload_size,
@@ -161,35 +250,21 @@ struct DerechoParams : public mutils::ByteRepresentable {
                 timeout_ms,
                 DerechoParams::send_algorithm_from_string(algorithm),
                 state_transfer_port,
+                packed_smc,
         };
+        if(hasCustomizedConfKey(prefix + "rdmc_algorithm_thresholds")) {
+            params.set_rdmc_algorithm_thresholds(getConfString(prefix + "rdmc_algorithm_thresholds"));
+        }
+        if(hasCustomizedConfKey(prefix + "rdmc_pipeline_depth")) {
+            params.rdmc_pipeline_depth = std::clamp(getConfUInt32(prefix + "rdmc_pipeline_depth"), 1u, window_size);
+        }
+        return params;
     }
 
     DEFAULT_SERIALIZATION_SUPPORT(DerechoParams, max_msg_size, max_reply_msg_size,
                                   sst_max_msg_size, block_size, window_size,
-                                  heartbeat_ms, rdmc_send_algorithm, state_transfer_port);
-};
-
-/**
- * Represents a block of memory used to store a message. This object contains
- * both the array of bytes in which the message is stored and the corresponding
- * RDMA memory region (which has registered that array of bytes as its buffer).
- * This is a move-only type, since memory regions can't be copied.
- */
-struct MessageBuffer {
-    std::unique_ptr<uint8_t[]> buffer;
-    std::shared_ptr<rdma::memory_region> mr;
-
-    MessageBuffer() {}
-    MessageBuffer(size_t size) {
-        if(size != 0) {
-            buffer = std::unique_ptr<uint8_t[]>(new uint8_t[size]);
-            mr = std::make_shared<rdma::memory_region>(buffer.get(), size);
-        }
-    }
-    MessageBuffer(const MessageBuffer&) = delete;
-    MessageBuffer(MessageBuffer&&) = default;
-    MessageBuffer& operator=(const MessageBuffer&) = delete;
-    MessageBuffer& operator=(MessageBuffer&&) = default;
+                                  heartbeat_ms, rdmc_send_algorithm, rdmc_size_thresholds,
+                                  rdmc_threshold_algorithms, rdmc_pipeline_depth, state_transfer_port, packed_smc);
 };
 
 /**
@@ -276,6 +351,12 @@ struct MulticastGroupCallbacks {
      * verification callback in UserMessageCallbacks).
      */
     verified_callback_t global_verified_callback;
+    /**
+     * A function to be called with a run of consecutive multicast RPC
+     * messages, used instead of rpc_callback and post_next_version_callback
+     * for those messages when the rpc_delivery_batch_size option is above 1.
+     */
+    rpc_batch_handler_t rpc_batch_callback;
 };
 
 /** Implements the low-level mechanics of tracking multicasts in a Derecho group,
@@ -304,16 +385,55 @@ private:
     const std::map<subgroup_id_t, SubgroupSettings> subgroup_settings_map;
     /** Used for synchronizing receives by RDMC and SST */
     std::vector<std::list<int32_t>> received_intervals;
-    /** Maps subgroup IDs for which this node is a sender to the RDMC group it should use to send.
+    /** Maps subgroup IDs for which this node is a sender to the RDMC groups it should use to send,
+     * rdmc_pipeline_depth of them for each RDMC algorithm in the subgroup's profile.
      * Constructed incrementally in create_rdmc_sst_groups(), so it can't be const.  */
-    std::map<subgroup_id_t, uint32_t> subgroup_to_rdmc_group;
-    /** Offset to add to member ranks to form RDMC group numbers. */
+    std::map<subgroup_id_t, std::map<rdmc::send_algorithm, std::vector<uint32_t>>> subgroup_to_rdmc_group;
+    /**
+     * The parts of a subgroup's settings that the sender thread reads each
+     * time it checks whether the subgroup's next RDMC message can be sent,
+     * flattened so that the check needs no map lookups or copies.
+     */
+    struct SenderState {
+        /** False if this node is not a member of the subgroup */
+        bool is_member = false;
+        /** This node's sender rank within its shard, or -1 if it is not a sender */
+        int sender_rank = -1;
+        uint32_t num_senders = 0;
+        uint32_t num_received_offset = 0;
+        bool ordered = false;
+        int32_t window_size = 0;
+        /** The SST rows of the members of this node's shard */
+        std::vector<uint32_t> shard_sst_indices;
+        /** The RDMC groups this node sends on, used in turn, or empty if the shard has no other members */
+        std::vector<uint32_t> rdmc_groups;
+        /** (size, groups) pairs in increasing order of size: a message of at most
+         * size bytes is sent on the first such groups instead of rdmc_groups */
+        std::vector<std::pair<uint64_t, std::vector<uint32_t>>> rdmc_groups_by_size;
+        /** The number of RDMC messages this node can have in flight at once */
+        int32_t rdmc_pipeline_depth = 1;
+        /** The receive handler called in place of an RDMC send if the shard has no other members */
+        const std::function<void(uint8_t*, size_t)>* singleton_receive_handler = nullptr;
+    };
+    /** SenderStates indexed by subgroup ID, built once the RDMC groups are
+     * created and immutable afterwards. */
+    std::vector<SenderState> sender_states;
+    /** The number to give the next RDMC group this group creates. */
     uint16_t rdmc_group_num_offset;
+    /** The numbers of the RDMC groups this group created, which wedge() destroys. */
+    std::vector<uint16_t> rdmc_group_nums;
     /** false if RDMC groups haven't been created successfully */
     bool rdmc_sst_groups_created = false;
-    /** Stores message buffers not currently in use. Protected by
-     * msg_state_mtx */
-    std::map<uint32_t, std::vector<MessageBuffer>> free_message_buffers;
+    /** The pool RDMC message buffers are taken from, shared by all the
+     * subgroups and handed on to the next MulticastGroup at a view change. */
+    std::shared_ptr<MessageBufferPool> message_buffer_pool;
+    /** The number of message buffers each subgroup can still take from the
+     * pool, which bounds each subgroup to window_size buffers per shard
+     * member. It is negative when a view change carried over more messages
+     * than the new window allows, in which case the subgroup sends nothing
+     * over RDMC until enough of them are delivered. Protected by the
+     * subgroup's msg_state_mtx */
+    std::map<uint32_t, int64_t> free_message_buffers;
 
     /** Index to be used the next time get_sendbuffer_ptr is called.
      * When next_message is not none, then next_message.index = future_message_index-1 */
@@ -325,18 +445,19 @@ private:
     /** For each subgroup, indicates whether an SST Multicast send is currently in progress
      * (i.e. a thread is inside the send() method). This prevents multiple application threads
      * from calling send() simultaneously and causing a race condition. */
-    std::map<uint32_t, bool> smc_send_in_progress;
+    std::vector<char> smc_send_in_progress;
     std::vector<uint32_t> committed_sst_index;
     std::vector<uint32_t> num_nulls_queued;
     std::vector<int32_t> first_null_index;
     /** Messages that are ready to be sent, but must wait until the current send finishes. */
     std::vector<std::queue<RDMCMessage>> pending_sends;
-    /** Vector of messages that are currently being sent out using RDMC, or boost::none otherwise. */
-    /** one per subgroup */
-    std::vector<std::optional<RDMCMessage>> current_sends;
+    /** Messages that are currently being sent out using RDMC, by subgroup and then by the
+     * RDMC group they are sent on (or 0 for shards without RDMC groups). */
+    std::vector<std::map<uint32_t, RDMCMessage>> current_sends;
 
-    /** Messages that are currently being received. */
-    std::map<std::pair<subgroup_id_t, node_id_t>, RDMCMessage> current_receives;
+    /** Messages that are currently being received, by subgroup and then by the
+     * RDMC group they are received on (each sender has one per RDMC algorithm). */
+    std::map<subgroup_id_t, std::map<uint32_t, RDMCMessage>> current_receives;
     /** Receiver lambdas for shards that have only one member. */
     std::map<subgroup_id_t, std::function<void(uint8_t*, size_t)>> singleton_shard_receive_handlers;
 
@@ -382,8 +503,50 @@ private:
      */
     std::vector<std::unique_ptr<std::atomic<persistent::version_t>>> delivered_version;
 
-    std::recursive_mutex msg_state_mtx;
-    std::condition_variable_any sender_cv;
+    /** The maximum number of RPC messages handed to rpc_batch_callback at
+     * once; 1 if messages are delivered one at a time. */
+    uint32_t rpc_delivery_batch_size;
+    /** For each subgroup, the RPC messages that are ready to be delivered but
+     * have not been passed to rpc_batch_callback yet. Protected by the
+     * subgroup's msg_state_mtx, and always empty when it is released. */
+    std::vector<std::vector<DeliveredRPCMessage>> rpc_delivery_batches;
+    /** For each subgroup, the buffers of the RDMC messages in its
+     * rpc_delivery_batch, which can be reused once the batch is delivered. */
+    std::vector<std::vector<MessageBuffer>> rpc_delivery_batch_buffers;
+
+    /**
+     * Guards each subgroup's message state (its entries in the containers
+     * above), indexed by subgroup number, so that subgroups send and deliver
+     * independently of each other. Every subgroup has its entry in each of
+     * the maps above from construction on, so that no thread ever changes
+     * the structure of a map that another subgroup's thread is reading.
+     *
+     * Threads hold at most one of these at a time, with two exceptions: a
+     * delivery upcall on the SST predicate thread can send into another
+     * subgroup, and a new group takes all of the old group's locks in index
+     * order. Delivery upcalls may only be called with one of these held on
+     * the predicate thread. The RDMC completion thread and the sender thread
+     * release it before their UNORDERED delivery upcalls, so no two threads
+     * can each wait for the subgroup lock the other one holds.
+     */
+    std::vector<std::recursive_mutex> msg_state_mtx;
+    /**
+     * Held by the thread that sequences and delivers messages of an
+     * UNORDERED subgroup, indexed by subgroup number. The RDMC completion
+     * thread keeps it across the delivery upcalls for which it releases
+     * msg_state_mtx, so the predicate thread can't sequence the same
+     * messages in the meantime. Always acquired before msg_state_mtx, and
+     * never by a thread that holds another subgroup's lock.
+     */
+    std::vector<std::mutex> unordered_delivery_mtx;
+    /** Guards sender_cv. Never held while acquiring a msg_state_mtx. */
+    std::mutex sender_mtx;
+    std::condition_variable sender_cv;
+    /** Counts the calls to wake_sender, so the sender thread can tell
+     * whether it missed one while it was checking the subgroups. */
+    std::atomic<uint64_t> sender_wakeups{0};
+    /** True while the sender thread is (about to be) waiting on sender_cv */
+    std::atomic<bool> sender_sleeping{false};
 
     /** The time, in milliseconds, that a sender can wait to send a message before it is considered failed. */
     unsigned int sender_timeout;
@@ -408,7 +571,10 @@ private:
     std::list<pred_handle> persistence_pred_handles;
     std::list<pred_handle> sender_pred_handles;
 
-    std::vector<bool> last_transfer_medium;
+    /** For each subgroup, whether the message being built by send() goes
+     * through RDMC. Not a vector<bool>, so that subgroups can set their
+     * entries concurrently. */
+    std::vector<char> last_transfer_medium;
 
     /** A reference to the PersistenceManager that lives in Group, used to
      * alert it when a new version needs to be persisted. */
@@ -418,11 +584,29 @@ private:
      * implements the sender thread. */
     void send_loop();
 
+    /** Tells the sender thread that a subgroup may have a message ready to
+     * send. Lock-free unless the sender thread is asleep. */
+    void wake_sender();
+
+    /** Takes a buffer of at least size bytes from the pool for a subgroup,
+     * using up one of its free_message_buffers. Receives and null sends take
+     * a buffer even if free_message_buffers is not positive. Must be called
+     * with the subgroup's msg_state_mtx held. */
+    MessageBuffer take_message_buffer(subgroup_id_t subgroup_num, std::size_t size);
+
+    /** Gives a subgroup's message buffer back to the pool. Must be called
+     * with the subgroup's msg_state_mtx held. */
+    void return_message_buffer(subgroup_id_t subgroup_num, MessageBuffer&& buffer);
+
     /** Checks for failures when a sender reaches its timeout. This function
      * implements the timeout thread. */
     void check_failures_loop();
 
     bool create_rdmc_sst_groups();
+    /** Creates the per-subgroup entries of the message state maps. */
+    void initialize_subgroup_state();
+    /** Fills in sender_states from subgroup_settings_map and the RDMC groups. */
+    void initialize_sender_states();
     void initialize_sst_row();
     void register_predicates();
 
@@ -474,6 +658,26 @@ private:
     bool version_message(SSTMessage& msg, const subgroup_id_t& subgroup_num,
                          const persistent::version_t& version, const uint64_t& msg_timestamp);
 
+    /**
+     * If RPC delivery batching is on and the message is an RPC message, adds
+     * it to the subgroup's delivery batch, which takes the place of both
+     * deliver_message and version_message; the caller must keep the
+     * message's bytes valid until the batch is delivered. A message that is
+     * not an RPC message causes the batch to be delivered first, so messages
+     * are still delivered in order.
+     * @param seq_num The message's sequence number in the subgroup
+     * @return true if the message was added to the batch, false if the caller
+     * should deliver it with deliver_message and version_message
+     */
+    bool batch_rpc_message(subgroup_id_t subgroup_num, int32_t seq_num, node_id_t sender_id,
+                           uint8_t* buf, long long unsigned int msg_size,
+                           persistent::version_t version, uint64_t msg_timestamp);
+
+    /** Delivers the subgroup's delivery batch, if it is not empty, and
+     * reclaims its message buffers. Must be called with the subgroup's
+     * msg_state_mtx held. */
+    void deliver_rpc_batch(subgroup_id_t subgroup_num);
+
     uint32_t get_num_senders(const std::vector<int>& shard_senders) {
         uint32_t num = 0;
         for(const auto i : shard_senders) {
@@ -519,7 +723,8 @@ private:
     void get_buffer_and_send_auto_null(subgroup_id_t subgroup_num);
     /* Get a pointer into the current buffer, to write data into it before sending
      * Now this is a private function, called by send internally */
-    uint8_t* get_sendbuffer_ptr(subgroup_id_t subgroup_num, long long unsigned int payload_size, bool cooked_send);
+    uint8_t* get_sendbuffer_ptr(subgroup_id_t subgroup_num, long long unsigned int payload_size, bool cooked_send,
+                                MessageBuffer* caller_buffer = nullptr);
 
 public:
     /**
@@ -570,6 +775,28 @@ public:
     bool send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
               const std::function<void(uint8_t* buf)>& msg_generator, bool cooked_send);
 
+    /**
+     * Sends a message whose body the caller has already placed in a memory
+     * region registered for RDMA, so that RDMC can send it without copying
+     * it into one of the group's own buffers. The first sizeof(header) bytes
+     * at offset are reserved for the message header, and the payload_size
+     * bytes of payload follow them. msg_generator is called with a pointer to
+     * the payload in the caller's region to fill in whatever isn't ready yet
+     * (e.g. RPC headers). Messages small enough for SMC are copied into the
+     * SST instead.
+     * @param buffer_released Called once the region is no longer needed by
+     * the message (after local delivery and persistence, or right away if the
+     * message was copied into the SST). It runs on a Derecho thread holding
+     * the subgroup's lock, so it should be quick and must not send messages.
+     * @return false if the message could not be sent in the current view, in
+     * which case buffer_released is not called.
+     * @throws derecho_exception if the message doesn't fit in the region
+     */
+    bool send_registered(subgroup_id_t subgroup_num, std::shared_ptr<rdma::memory_region> mr,
+                         std::size_t offset, long long unsigned int payload_size,
+                         const std::function<void(uint8_t* buf)>& msg_generator,
+                         std::function<void()> buffer_released, bool cooked_send);
+
     /** Compute the global real-time stability frontier in nano seconds.
      */
     const uint64_t compute_global_stability_frontier(subgroup_id_t subgroup_num) const;
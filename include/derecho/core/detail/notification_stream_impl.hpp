@@ -0,0 +1,254 @@
+#include "../notification_stream.hpp"
+
+#include "derecho/conf/conf.hpp"
+#include "derecho/core/derecho_exception.hpp"
+#include "derecho/utils/logger.hpp"
+
+#include <vector>
+
+namespace derecho {
+
+template <typename T>
+NotificationStream<T>::NotificationStream(ExternalClientCallback<T>& client_callback,
+                                          const NotificationStreamOptions& options)
+        : client_callback(client_callback),
+          options(options),
+          max_message_size(getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE)
+                           - rpc::RemoteInvocableOf<T>::serialized_args_offset()),
+          flush_thread(&NotificationStream<T>::flush_loop, this) {}
+
+template <typename T>
+NotificationStream<T>::~NotificationStream() {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        thread_shutdown = true;
+    }
+    flush_cv.notify_all();
+    if(flush_thread.joinable()) {
+        flush_thread.join();
+    }
+}
+
+template <typename T>
+void NotificationStream<T>::subscribe(node_id_t client_id) {
+    std::lock_guard<std::mutex> lock(queues_mutex);
+    subscribers.insert(client_id);
+}
+
+template <typename T>
+void NotificationStream<T>::unsubscribe(node_id_t client_id) {
+    std::lock_guard<std::mutex> lock(queues_mutex);
+    subscribers.erase(client_id);
+    client_queues.erase(client_id);
+}
+
+template <typename T>
+void NotificationStream<T>::check_size(const NotificationMessage& message) const {
+    if(message.bytes_size() > max_message_size) {
+        throw buffer_overflow_exception("The size of a notification exceeds the maximum P2P message size.");
+    }
+}
+
+template <typename T>
+void NotificationStream<T>::post(node_id_t client_id, const NotificationMessage& message, std::optional<uint64_t> key) {
+    check_size(message);
+    auto shared_message = std::make_shared<const NotificationMessage>(message);
+    std::lock_guard<std::mutex> lock(queues_mutex);
+    enqueue(client_id, shared_message, key, std::chrono::steady_clock::now());
+}
+
+template <typename T>
+void NotificationStream<T>::publish(const NotificationMessage& message, std::optional<uint64_t> key) {
+    check_size(message);
+    auto shared_message = std::make_shared<const NotificationMessage>(message);
+    const auto post_time = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(queues_mutex);
+    for(node_id_t client_id : subscribers) {
+        enqueue(client_id, shared_message, key, post_time);
+    }
+}
+
+template <typename T>
+void NotificationStream<T>::enqueue(node_id_t client_id, const std::shared_ptr<const NotificationMessage>& message,
+                                    const std::optional<uint64_t>& key, std::chrono::steady_clock::time_point post_time) {
+    ClientQueue& queue = client_queues[client_id];
+    if(key && options.coalesce_by_key) {
+        auto existing = queue.pending_by_key.find(*key);
+        if(existing != queue.pending_by_key.end()) {
+            // Only the latest notification for a key survives, and it is sent in the order it was posted
+            queue.pending.erase(existing->second);
+            queue.pending_by_key.erase(existing);
+            num_coalesced++;
+        }
+    }
+    if(queue.pending.size() >= options.max_queued_per_client) {
+        drop_oldest(queue);
+    }
+    queue.pending.push_back(QueuedNotification{message, key, post_time});
+    if(key && options.coalesce_by_key) {
+        queue.pending_by_key[*key] = std::prev(queue.pending.end());
+    }
+}
+
+template <typename T>
+void NotificationStream<T>::drop_oldest(ClientQueue& queue) {
+    const QueuedNotification& oldest = queue.pending.front();
+    if(oldest.key) {
+        auto oldest_key_entry = queue.pending_by_key.find(*oldest.key);
+        if(oldest_key_entry != queue.pending_by_key.end() && oldest_key_entry->second == queue.pending.begin()) {
+            queue.pending_by_key.erase(oldest_key_entry);
+        }
+    }
+    queue.pending.pop_front();
+    num_dropped_queue_full++;
+}
+
+template <typename T>
+void NotificationStream<T>::requeue(node_id_t client_id, std::list<QueuedNotification>& unsent) {
+    std::lock_guard<std::mutex> lock(queues_mutex);
+    ClientQueue& queue = client_queues[client_id];
+    // The unsent notifications are older than anything posted since they were taken, so they go first
+    const auto insert_pos = queue.pending.begin();
+    for(QueuedNotification& notification : unsent) {
+        if(notification.key && options.coalesce_by_key) {
+            if(queue.pending_by_key.find(*notification.key) != queue.pending_by_key.end()) {
+                // A newer notification with the same key was posted in the meantime
+                num_coalesced++;
+                continue;
+            }
+            queue.pending_by_key[*notification.key] = queue.pending.insert(insert_pos, std::move(notification));
+        } else {
+            queue.pending.insert(insert_pos, std::move(notification));
+        }
+    }
+    while(queue.pending.size() > options.max_queued_per_client) {
+        drop_oldest(queue);
+    }
+}
+
+template <typename T>
+void NotificationStream<T>::flush_loop() {
+    pthread_setname_np(pthread_self(), "notif_stream");
+    std::unique_lock<std::mutex> lock(flush_mutex);
+    while(!thread_shutdown) {
+        flush_cv.wait_for(lock, options.flush_interval, [this]() { return thread_shutdown; });
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+template <typename T>
+void NotificationStream<T>::flush() {
+    // Take the queued notifications, so that posting can continue while they are sent
+    std::map<node_id_t, std::list<QueuedNotification>> to_send;
+    {
+        std::lock_guard<std::mutex> lock(queues_mutex);
+        for(auto queue_iter = client_queues.begin(); queue_iter != client_queues.end();) {
+            if(!queue_iter->second.pending.empty()) {
+                to_send[queue_iter->first].swap(queue_iter->second.pending);
+                queue_iter->second.pending_by_key.clear();
+            }
+            // The queue of a client that isn't subscribed only exists while post() has notifications for it
+            if(subscribers.find(queue_iter->first) == subscribers.end()) {
+                queue_iter = client_queues.erase(queue_iter);
+            } else {
+                ++queue_iter;
+            }
+        }
+    }
+    // A batch is sent as a NotificationMessage whose body holds the serialized notifications
+    const std::size_t batch_header_size = sizeof(NotificationMessage::message_type) + sizeof(NotificationMessage::size);
+    const auto now = std::chrono::steady_clock::now();
+    for(auto& client_and_notifications : to_send) {
+        const node_id_t client_id = client_and_notifications.first;
+        std::list<QueuedNotification>& notifications = client_and_notifications.second;
+        if(!client_callback.has_external_client(client_id)) {
+            num_dropped_disconnected += notifications.size();
+            continue;
+        }
+        // Pack as many notifications into each P2P message as will fit. The notifications
+        // before notification_iter are the ones in the current batch.
+        std::vector<std::shared_ptr<const NotificationMessage>> batch;
+        std::size_t batch_size = batch_header_size;
+        SendResult result = SendResult::SENT;
+        auto notification_iter = notifications.begin();
+        while(notification_iter != notifications.end()) {
+            if(options.max_staleness.count() > 0 && now - notification_iter->post_time > options.max_staleness) {
+                num_dropped_stale++;
+                notification_iter = notifications.erase(notification_iter);
+                continue;
+            }
+            const std::size_t message_size = notification_iter->message->bytes_size();
+            if(!batch.empty() && batch_size + message_size > max_message_size) {
+                result = send_batch(client_id, batch);
+                if(result != SendResult::SENT) {
+                    break;
+                }
+                notifications.erase(notifications.begin(), notification_iter);
+                batch.clear();
+                batch_size = batch_header_size;
+            }
+            batch.emplace_back(notification_iter->message);
+            batch_size += message_size;
+            ++notification_iter;
+        }
+        if(result == SendResult::SENT && !batch.empty()) {
+            result = send_batch(client_id, batch);
+            if(result == SendResult::SENT) {
+                notifications.clear();
+            }
+        }
+        if(result == SendResult::WINDOW_FULL) {
+            // Don't wait for this client; try the rest of its notifications again next time
+            requeue(client_id, notifications);
+        } else if(result == SendResult::FAILED) {
+            num_dropped_disconnected += notifications.size();
+        }
+    }
+}
+
+template <typename T>
+typename NotificationStream<T>::SendResult NotificationStream<T>::send_batch(
+        node_id_t client_id, const std::vector<std::shared_ptr<const NotificationMessage>>& batch) {
+    try {
+        bool sent;
+        if(batch.size() == 1) {
+            sent = client_callback.template try_p2p_send<RPC_NAME(notify)>(client_id, *batch.front()).has_value();
+        } else {
+            std::size_t body_size = 0;
+            for(const auto& message : batch) {
+                body_size += message->bytes_size();
+            }
+            NotificationMessage batch_message(NotificationMessage::batch_message_type, body_size);
+            std::size_t offset = 0;
+            for(const auto& message : batch) {
+                offset += message->to_bytes(batch_message.body + offset);
+            }
+            sent = client_callback.template try_p2p_send<RPC_NAME(notify)>(client_id, batch_message).has_value();
+        }
+        if(!sent) {
+            return SendResult::WINDOW_FULL;
+        }
+    } catch(derecho_exception& ex) {
+        dbg_default_warn("Failed to send {} notifications to client {}: {}", batch.size(), client_id, ex.what());
+        return SendResult::FAILED;
+    }
+    num_sent += batch.size();
+    num_batches_sent++;
+    return SendResult::SENT;
+}
+
+template <typename T>
+NotificationStreamStats NotificationStream<T>::get_stats() const {
+    NotificationStreamStats stats;
+    stats.sent = num_sent;
+    stats.batches_sent = num_batches_sent;
+    stats.coalesced = num_coalesced;
+    stats.dropped_queue_full = num_dropped_queue_full;
+    stats.dropped_stale = num_dropped_stale;
+    stats.dropped_disconnected = num_dropped_disconnected;
+    return stats;
+}
+
+}  // namespace derecho
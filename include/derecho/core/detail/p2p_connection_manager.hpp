@@ -14,6 +14,7 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <set>
 #include <thread>
 #include <vector>
 
@@ -30,6 +31,8 @@ struct P2PParams {
     uint64_t max_rpc_reply_size;
     bool is_external;
     failure_upcall_t failure_upcall;
+    /** The number of shards probe_all() divides the connections into, one per probing thread */
+    uint32_t num_probe_shards = 1;
 };
 
 struct MessagePointer {
@@ -60,6 +63,35 @@ class P2PConnectionManager {
      * updates from write conflicts.
      */
     char* active_p2p_connections;
+    /**
+     * The node IDs that currently have a connection, so that scanning the
+     * connections costs as much as the number of connections rather than the
+     * range of node IDs. Guarded by connections_mutex.
+     */
+    std::set<node_id_t> active_node_ids;
+    /**
+     * Incremented whenever active_node_ids actually changes (not when it is
+     * given IDs it already has), so that probing threads refresh their copies.
+     */
+    std::atomic<uint64_t> active_node_ids_version{0};
+
+    /** The state of the round-robin probe over one shard of the connections. */
+    struct ProbeCursor {
+        /** This shard's node IDs from active_node_ids, as of version */
+        std::vector<node_id_t> node_ids;
+        uint64_t version = 0;
+        /** The position in node_ids of the connection to probe first */
+        std::size_t position = 0;
+        /** The number of consecutive messages taken from the connection at position */
+        uint32_t served = 0;
+    };
+    /** One cursor per shard; each is only used by the thread probing that shard. */
+    std::vector<ProbeCursor> probe_cursors;
+    /**
+     * The number of consecutive messages probe_all() takes from a connection
+     * that keeps having messages before it moves on to the next connection.
+     */
+    const uint32_t probe_batch_size;
 
     uint64_t p2p_buf_size;
     std::atomic<bool> thread_shutdown{false};
@@ -69,6 +101,9 @@ class P2PConnectionManager {
     failure_upcall_t failure_upcall;
     std::mutex connections_mutex;
 
+    /** @return A copy of active_node_ids */
+    std::vector<node_id_t> get_active_node_ids();
+
 public:
     P2PConnectionManager(const P2PParams params);
     ~P2PConnectionManager();
@@ -94,13 +129,23 @@ public:
      */
     void increment_incoming_seq_num(node_id_t node_id, MESSAGE_TYPE type);
     /**
-     * Checks all the P2P connection buffers for new messages. If any
-     * connection has a new message, this returns a MessagePointer object
-     * describing the message: the sender's ID, a pointer into the message
-     * buffer, and the type of message in the buffer.
+     * Checks the P2P connection buffers for new messages. If any connection
+     * has a new message, this returns a MessagePointer object describing the
+     * message: the sender's ID, a pointer into the message buffer, and the
+     * type of message in the buffer.
+     *
+     * The connections are divided into P2PParams::num_probe_shards shards,
+     * each probed by a single thread. Within a shard, connections are probed
+     * round-robin: each call starts where the previous one stopped, and a
+     * connection that keeps having messages is left after at most
+     * DERECHO/p2p_probe_batch_size consecutive messages, so that no peer is
+     * starved by lower-numbered ones. When connections are added or removed,
+     * the round-robin resumes from the node it would have probed next.
+     * @param shard The shard to probe: only the connections to node IDs equal
+     * to shard modulo the number of shards are checked
      * @return A MessagePointer struct, or std::nullopt if no connection has a new message.
      */
-    std::optional<MessagePointer> probe_all();
+    std::optional<MessagePointer> probe_all(uint32_t shard = 0);
     /**
      * Returns a P2PBufferHandle for the next available message buffer
      * for the specified message type in the specified node's P2P connection
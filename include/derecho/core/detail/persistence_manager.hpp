@@ -13,11 +13,15 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <errno.h>
 #include <list>
-#include <queue>
-#include <semaphore.h>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 namespace derecho {
 
@@ -39,38 +43,69 @@ public:
         subgroup_id_t subgroup_id;
         persistent::version_t version;
     };
+    /**
+     * Counters describing the request queue of one subgroup, which can be used
+     * to tune the number of persistence threads.
+     */
+    struct SubgroupQueueStats {
+        /** The number of requests currently waiting in the queue */
+        uint64_t queue_depth = 0;
+        /** The total number of persistence requests posted */
+        uint64_t persist_requests = 0;
+        /** The number of persist() calls the posted persistence requests were coalesced into */
+        uint64_t persist_batches = 0;
+        /** The largest number of persistence requests coalesced into one persist() call */
+        uint64_t max_persist_batch_size = 0;
+        /** The total number of verification requests posted */
+        uint64_t verify_requests = 0;
+        /** The number of verifications the posted verification requests were coalesced into */
+        uint64_t verify_batches = 0;
+    };
 
 private:
-    /** Thread handle */
-    std::thread persist_thread;
+    /** The pending requests of one subgroup */
+    struct SubgroupQueue {
+        std::vector<ThreadRequest> requests;
+        SubgroupQueueStats stats;
+    };
     /**
-     * A flag to signal the persistent thread to shutdown; set to true when the
-     * group is destroyed.
+     * A persistence thread and the queues of the subgroups assigned to it. Each
+     * subgroup is always handled by the same thread, so requests of a subgroup
+     * are handled in order while different subgroups make progress in parallel.
      */
-    std::atomic<bool> thread_shutdown;
+    struct PersistenceWorker {
+        /** Thread handle */
+        std::thread thread;
+        /** Guards ready_subgroups and subgroup_queues */
+        std::mutex queue_mutex;
+        /** Signaled when a subgroup becomes ready, or on shutdown */
+        std::condition_variable queue_cv;
+        /** Subgroups with queued requests, in the order they became non-empty */
+        std::deque<subgroup_id_t> ready_subgroups;
+        /** Request queues of the subgroups assigned to this thread, indexed by subgroup ID */
+        std::map<subgroup_id_t, SubgroupQueue> subgroup_queues;
+        /**
+         * This thread's Verifier for other replicas' signatures, or null if
+         * signatures are disabled. A Verifier holds a single digest context,
+         * so it can't be shared between threads.
+         */
+        std::unique_ptr<openssl::Verifier> signature_verifier;
+    };
     /**
-     * A semaphore that counts the number of persistence requests available for
-     * the persistence thread to handle
+     * The persistence threads. Subgroup s is assigned to workers[s % workers.size()].
      */
-    sem_t persistence_request_sem;
+    std::vector<std::unique_ptr<PersistenceWorker>> workers;
     /**
-     * Queue of requests for the persistence thread, which is shared with other
-     * threads (e.g. the predicates thread) so they can make requests
+     * A flag to signal the persistent threads to shutdown; set to true when the
+     * group is destroyed.
      */
-    std::queue<ThreadRequest> persistence_request_queue;
-    /** A test-and-set lock guarding the persistence request queue */
-    std::atomic_flag prq_lock = ATOMIC_FLAG_INIT;
+    std::atomic<bool> thread_shutdown;
     /**
      * The latest version that has been persisted successfully in each subgroup
      * (indexed by subgroup number). Updated each time a persistence request completes.
+     * Each entry is only accessed by the thread the subgroup is assigned to.
      */
     std::vector<persistent::version_t> last_persisted_version;
-    /**
-     * The Verifier to use for verifying other replicas' signatures over
-     * persistent log entries, if signatures are enabled. This will be null if
-     * signatures are disabled.
-     */
-    std::unique_ptr<openssl::Verifier> signature_verifier;
     /** The size of a signature (which is a constant), or 0 if signatures are disabled. */
     std::size_t signature_size;
     /**
@@ -87,10 +122,15 @@ private:
      * also needs a reference to PersistenceManager.
      */
     ViewManager* view_manager;
+    /** The main loop of a persistence thread */
+    void worker_loop(PersistenceWorker& worker);
+    /** Puts a request in the queue of its subgroup and wakes up the subgroup's thread */
+    void enqueue_request(const ThreadRequest& request);
     /** Helper function that handles a single persistence request */
     void handle_persist_request(subgroup_id_t subgroup_id, persistent::version_t version);
-    /** Helper function that handles a single verification request */
-    void handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version);
+    /** Helper function that handles a single verification request, using the calling thread's Verifier */
+    void handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version,
+                               openssl::Verifier& signature_verifier);
 
 public:
     /**
@@ -106,23 +146,21 @@ public:
             bool any_signed_objects,
             const persistence_callback_t& user_persistence_callback);
 
-    /**
-     * Custom destructor needed to clean up the semaphore
-     */
     virtual ~PersistenceManager();
 
     /** Initializes the ViewManager pointer. Must be called before start(). */
     void set_view_manager(ViewManager& view_manager);
 
     /** Adds another function to the list of persistence callbacks, which are
-     * called when a version finishes persisting locally. */
+     * called when a version finishes persisting locally. Callbacks for different
+     * subgroups may be called concurrently from different persistence threads. */
     void add_persistence_callback(const persistence_callback_t& callback);
 
     //This method is probably unnecessary since ViewManager should have other ways of determining the signature size.
     /** @return the size of a signature on an update in this group. */
     std::size_t get_signature_size() const;
 
-    /** Start the persistent thread. */
+    /** Start the persistent threads. */
     void start();
 
     /** post a persistence request */
@@ -139,12 +177,17 @@ public:
      */
     void post_verify_request(const subgroup_id_t& subgroup_id, const persistent::version_t& version);
 
+    /**
+     * @return the counters of the persistence request queue of a subgroup
+     */
+    SubgroupQueueStats get_queue_stats(subgroup_id_t subgroup_id);
+
     /** make a version */
     void make_version(const subgroup_id_t& subgroup_id,
                       const persistent::version_t& version, const HLC& mhlc);
 
-    /** shutdown the thread
-     * @wait - wait till the thread finished or not.
+    /** shutdown the threads
+     * @wait - wait till the threads finished or not.
      */
     void shutdown(bool wait);
 };
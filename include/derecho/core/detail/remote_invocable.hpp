@@ -70,6 +70,13 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
         return *this;
     }
 
+    /* like get_invoker, but selects the RemoteInvoker by its tag alone, for
+     * callers that have no argument values to resolve the overload with */
+    inline RemoteInvoker& get_invoker_by_tag(
+            std::integral_constant<FunctionTag, Tag> const* const) {
+        return *this;
+    }
+
     using barray = uint8_t*;
     using cbarray = const uint8_t*;
 
@@ -143,6 +150,29 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
                            std::weak_ptr<PendingResults<Ret>>(pending_results)};
     }
 
+    /**
+     * Like send, but for an RPC message whose arguments the caller has already
+     * serialized into place, so they are not copied. Writes this call's
+     * invocation ID right before the serialized arguments.
+     * @param invocation_id_buf The location for the invocation ID; the
+     * serialized arguments must start right after it
+     * @param args_size The size of the serialized arguments in bytes
+     */
+    send_return send_serialized(uint8_t* invocation_id_buf, std::size_t args_size) {
+        std::shared_ptr<PendingResults<Ret>> pending_results = std::make_shared<PendingResults<Ret>>();
+        std::unique_ptr<QueryResults<Ret>> query_results = pending_results->get_future();
+        std::shared_ptr<PendingResults<Ret>>* results_heap_ptr = nullptr;
+        if constexpr(!std::is_void_v<Ret>) {
+            results_heap_ptr = new std::shared_ptr<PendingResults<Ret>>(pending_results);
+        }
+        pending_results->set_self_ptr(results_heap_ptr);
+        std::size_t size = mutils::to_bytes(results_heap_ptr, invocation_id_buf) + args_size;
+
+        dbg_default_trace("Ready to send a pre-serialized RPC call message with invocation ID {}", fmt::ptr(results_heap_ptr));
+        return send_return{size, invocation_id_buf, std::move(query_results),
+                           std::weak_ptr<PendingResults<Ret>>(pending_results)};
+    }
+
     /**
      * Specialization of receive_response for non-void functions. Stores the
      * response in the results object, or stores the exception if there was an
@@ -572,6 +602,7 @@ struct RemoteInvocablePairs<wrapped<id, FunType>>
               RemoteInvocable<id, FunType>(class_id, instance_id, receivers, function_ptr) {}
 
     using RemoteInvoker<id, FunType>::get_invoker;
+    using RemoteInvoker<id, FunType>::get_invoker_by_tag;
     using RemoteInvocable<id, FunType>::get_handler;
 };
 
@@ -602,8 +633,10 @@ struct RemoteInvocablePairs<wrapped<id, FunType>, rest...>
 
     //Ensure the inherited functions from RemoteInvoker and RemoteInvokable are visible
     using RemoteInvoker<id, FunType>::get_invoker;
+    using RemoteInvoker<id, FunType>::get_invoker_by_tag;
     using RemoteInvocable<id, FunType>::get_handler;
     using RemoteInvocablePairs<rest...>::get_invoker;
+    using RemoteInvocablePairs<rest...>::get_invoker_by_tag;
     using RemoteInvocablePairs<rest...>::get_handler;
 };
 
@@ -626,6 +659,7 @@ struct RemoteInvokers<wrapped<Tag, FunType>> : public RemoteInvoker<Tag, FunType
             : RemoteInvoker<Tag, FunType>(class_id, instance_id, receivers) {}
 
     using RemoteInvoker<Tag, FunType>::get_invoker;
+    using RemoteInvoker<Tag, FunType>::get_invoker_by_tag;
 };
 
 /**
@@ -648,7 +682,9 @@ struct RemoteInvokers<wrapped<Tag, FunType>, RestWrapped...>
               RemoteInvokers<RestWrapped...>(class_id, instance_id, receivers) {}
 
     using RemoteInvoker<Tag, FunType>::get_invoker;
+    using RemoteInvoker<Tag, FunType>::get_invoker_by_tag;
     using RemoteInvokers<RestWrapped...>::get_invoker;
+    using RemoteInvokers<RestWrapped...>::get_invoker_by_tag;
 };
 
 /**
@@ -683,6 +719,15 @@ public:
         return function_call_size + remote_invocation_utilities::header_space();
     }
 
+    /**
+     * @return The number of bytes an ordered_send message for this class has
+     * before its serialized arguments: the RPC header and the invocation ID.
+     */
+    static std::size_t serialized_args_offset() {
+        long int invocation_id = 0;
+        return remote_invocation_utilities::header_space() + mutils::bytes_size(invocation_id);
+    }
+
     template <FunctionTag Tag, typename... Args>
     auto* getReturnType(Args&&... args) {
         constexpr std::integral_constant<FunctionTag, Tag>* choice{nullptr};
@@ -743,6 +788,33 @@ public:
                            sent_return.pending};
     }
 
+    /**
+     * Like send, but for a message whose arguments the caller has already
+     * serialized, starting serialized_args_offset() bytes into buf. Only the
+     * RPC header and invocation ID are written into buf.
+     * @param buf The start of the message
+     * @param args_size The size of the serialized arguments in bytes
+     * @return A struct containing the futures ("results") and promises
+     * ("pending") for the results, as returned by send
+     */
+    template <FunctionTag Tag>
+    auto send_serialized(uint8_t* buf, std::size_t args_size) {
+        using namespace remote_invocation_utilities;
+
+        constexpr std::integral_constant<FunctionTag, Tag>* choice{nullptr};
+        auto& invoker = this->get_invoker_by_tag(choice);
+        auto sent_return = invoker.send_serialized(buf + header_space(), args_size);
+        populate_header(buf, sent_return.size, invoker.invoke_opcode, nid, 0);
+
+        using Ret = typename decltype(sent_return.results)::element_type::type;
+        struct send_return {
+            std::unique_ptr<QueryResults<Ret>> results;
+            std::weak_ptr<PendingResults<Ret>> pending;
+        };
+        return send_return{std::move(sent_return.results),
+                           sent_return.pending};
+    }
+
     using specialized_to = IdentifyingClass;
     RemoteInvocableClass& for_class(IdentifyingClass*) {
         return *this;
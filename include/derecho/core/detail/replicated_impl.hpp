@@ -1,12 +1,15 @@
 #pragma once
 
 #include "../replicated.hpp"
+#include "state_transfer.hpp"
 #include "view_manager.hpp"
 
 #include "derecho/mutils-serialization/SerializationSupport.hpp"
 
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <utility>
 
 namespace derecho {
@@ -165,6 +168,40 @@ auto Replicated<T>::ordered_send(Args&&... args) {
     }
 }
 
+template <typename T>
+template <rpc::FunctionTag tag>
+auto Replicated<T>::ordered_send_serialized(std::shared_ptr<rdma::memory_region> mr, std::size_t offset,
+                                            std::size_t args_size, std::function<void()> buffer_released) {
+    if(is_valid()) {
+        const std::size_t payload_size = rpc::RemoteInvocableOf<T>::serialized_args_offset() + args_size;
+        using SendReturn = decltype(wrapped_this->template send_serialized<rpc::to_internal_tag<false>(tag)>(nullptr, 0));
+        std::optional<SendReturn> send_return;
+        auto header_writer = [&](uint8_t* buffer) {
+            send_return.emplace(wrapped_this->template send_serialized<rpc::to_internal_tag<false>(tag)>(
+                    buffer, args_size));
+        };
+
+        std::shared_lock<std::shared_timed_mutex> view_read_lock(group_rpc_manager.view_manager.view_mutex);
+        if(payload_size > group_rpc_manager.view_manager.get_max_payload_sizes().at(subgroup_id)) {
+            throw buffer_overflow_exception("The size of an ordered_send message exceeds the maximum message size.");
+        }
+        group_rpc_manager.view_manager.view_change_cv.wait(view_read_lock, [&]() {
+            return group_rpc_manager.view_manager.curr_view
+                    ->multicast_group->send_registered(subgroup_id, mr, offset, payload_size,
+                                                       header_writer, buffer_released, true);
+        });
+        group_rpc_manager.register_rpc_results(subgroup_id, send_return->pending);
+        return std::move(*send_return->results);
+    } else {
+        throw empty_reference_exception{"Attempted to use an empty Replicated<T>"};
+    }
+}
+
+template <typename T>
+std::size_t Replicated<T>::serialized_send_prefix_size() {
+    return sizeof(header) + rpc::RemoteInvocableOf<T>::serialized_args_offset();
+}
+
 template <typename T>
 void Replicated<T>::send(unsigned long long int payload_size,
                          const std::function<void(uint8_t* buf)>& msg_generator) {
@@ -178,13 +215,28 @@ std::size_t Replicated<T>::object_size() const {
 
 template <typename T>
 void Replicated<T>::send_object(tcp::socket& receiver_socket) const {
-    auto bind_socket_write = [&receiver_socket](const uint8_t* bytes, std::size_t size) {
-        receiver_socket.write(bytes, size);
+    StateTransferWriter writer(receiver_socket);
+    auto bind_writer = [&writer](const uint8_t* bytes, std::size_t size) {
+        writer.write(bytes, size);
     };
-    dbg_default_trace("send_object sending object size {} to {}", object_size(), receiver_socket.get_remote_ip());
-    mutils::post_object(bind_socket_write, object_size());
     dbg_default_trace("send_object starting send to {}", receiver_socket.get_remote_ip());
-    send_object_raw(receiver_socket);
+    if(!writer.has_checksums()) {
+        // Send the data of large log entries straight from the log's files
+        persistent::PersistLog::setFileRangePoster(
+                [&writer](int fd, off_t offset, std::size_t size) {
+                    writer.write_file(fd, offset, size);
+                },
+                StateTransferWriter::min_file_range_size);
+    }
+    try {
+        mutils::post_object(bind_writer, **user_object_ptr);
+    } catch(...) {
+        persistent::PersistLog::resetFileRangePoster();
+        throw;
+    }
+    persistent::PersistLog::resetFileRangePoster();
+    std::size_t sent_size = writer.finish();
+    dbg_default_trace("send_object sent an object of size {} to {}", sent_size, receiver_socket.get_remote_ip());
 }
 
 template <typename T>
@@ -285,6 +337,18 @@ void Replicated<T>::post_next_version(persistent::version_t version, uint64_t ts
     current_timestamp_us = ts_us;
 }
 
+template <typename T>
+void Replicated<T>::deliver_versions(const std::vector<DeliveredRPCMessage>& messages,
+                                     const std::function<void(const DeliveredRPCMessage&)>& deliver) {
+    persistent_registry->makeVersions(messages.size(), [&](std::size_t i) {
+        const DeliveredRPCMessage& message = messages[i];
+        current_version = message.version;
+        current_timestamp_us = message.timestamp_us;
+        deliver(message);
+        return std::make_pair(message.version, message.timestamp_us);
+    });
+}
+
 template <typename T>
 std::tuple<persistent::version_t, uint64_t> Replicated<T>::get_current_version() {
     return std::tie(current_version, current_timestamp_us);
@@ -417,6 +481,40 @@ auto ExternalClientCallback<T>::p2p_send(node_id_t dest_node, Args&&... args) {
     }
 }
 
+template <typename T>
+template <rpc::FunctionTag tag, typename... Args>
+auto ExternalClientCallback<T>::try_p2p_send(node_id_t dest_node, Args&&... args) {
+    using results_t = std::decay_t<decltype(*wrapped_this->template send<rpc::to_internal_tag<true>(tag)>(
+                                                    std::declval<std::function<uint8_t*(std::size_t)>>(),
+                                                    std::forward<Args>(args)...)
+                                                    .results)>;
+    static_assert(std::is_same_v<results_t, rpc::QueryResults<void>>,
+                  "try_p2p_send can only invoke RPC functions that return void");
+    assert(dest_node != node_id);
+    std::optional<sst::P2PBufferHandle> buffer_handle;
+    std::unique_ptr<uint8_t[]> unsent_buf;
+    auto return_pair = wrapped_this->template send<rpc::to_internal_tag<true>(tag)>(
+            [&](size_t size) -> uint8_t* {
+                const std::size_t max_payload_size = getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE);
+                if(size > max_payload_size) {
+                    throw buffer_overflow_exception("The size of a P2P message exceeds the maximum P2P message size.");
+                }
+                buffer_handle = group_rpc_manager.try_get_sendbuffer_ptr(dest_node, sst::MESSAGE_TYPE::P2P_REQUEST);
+                if(buffer_handle) {
+                    return buffer_handle->buf_ptr;
+                }
+                // The window is full, so serialize into a buffer that will be discarded
+                unsent_buf = std::make_unique<uint8_t[]>(size);
+                return unsent_buf.get();
+            },
+            std::forward<Args>(args)...);
+    if(!buffer_handle) {
+        return std::optional<results_t>{};
+    }
+    group_rpc_manager.send_p2p_message(dest_node, subgroup_id, buffer_handle->seq_num, return_pair.pending);
+    return std::optional<results_t>{std::move(*return_pair.results)};
+}
+
 template <typename T>
 template <rpc::FunctionTag tag, typename... Args>
 auto ShardIterator<T>::p2p_send(Args&&... args) {
@@ -29,6 +29,13 @@ public:
                             const uint8_t* signature) = 0;
     virtual void truncate(persistent::version_t latest_version) = 0;
     virtual void post_next_version(persistent::version_t version, uint64_t msg_ts) = 0;
+    /**
+     * Delivers a run of ordered updates: for each message in turn, posts its
+     * version, calls deliver on it and makes its version, as
+     * post_next_version() and make_version() would.
+     */
+    virtual void deliver_versions(const std::vector<DeliveredRPCMessage>& messages,
+                                  const std::function<void(const DeliveredRPCMessage&)>& deliver) = 0;
 };
 
 }  // namespace derecho
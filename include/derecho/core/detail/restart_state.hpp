@@ -10,6 +10,7 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -132,13 +133,42 @@ private:
     const node_id_t my_id;
 
     /**
-     * Helper method for await_quorum that processes the logged View and
-     * RaggedTrims from a single rejoining node. This may update curr_view or
-     * logged_ragged_trim if the joiner has newer information.
-     * @param joiner_id The ID of the rejoining node
+     * Guards all the state above while await_quorum's intake threads are
+     * receiving rejoining nodes, so that their logs are merged one at a time.
+     */
+    std::mutex intake_mutex;
+    /** The result of the most recent quorum check by an intake thread; guarded by intake_mutex. */
+    bool ready_to_restart = false;
+
+    /** The logged View and RaggedTrims received from a single rejoining node. */
+    struct JoinerLogs {
+        std::unique_ptr<View> view;
+        std::vector<std::unique_ptr<RaggedTrim>> ragged_trims;
+    };
+
+    /**
+     * Helper method for await_quorum that carries out the restart handshake
+     * with a single rejoining node: it receives the node's logs and ports
+     * without holding intake_mutex, then merges them and checks for a quorum
+     * while holding it. Nodes that fail during the handshake are ignored.
      * @param client_socket The TCP socket connected to the rejoining node
      */
-    void receive_joiner_logs(const node_id_t& joiner_id, tcp::socket& client_socket);
+    void intake_joiner(tcp::socket client_socket);
+
+    /**
+     * Receives the logged View and RaggedTrims from a single rejoining node.
+     * @param client_socket The TCP socket connected to the rejoining node
+     */
+    static JoinerLogs receive_joiner_logs(tcp::socket& client_socket);
+
+    /**
+     * Processes the logged View and RaggedTrims from a single rejoining node.
+     * This may update curr_view or logged_ragged_trim if the joiner has newer
+     * information. Must be called with intake_mutex held.
+     * @param joiner_id The ID of the rejoining node
+     * @param joiner_logs The logs received from the rejoining node
+     */
+    void merge_joiner_logs(const node_id_t& joiner_id, JoinerLogs joiner_logs);
 
     /**
      * Recomputes the restart view based on the current set of nodes that have
@@ -164,7 +194,9 @@ public:
      * Waits for nodes to rejoin at this node, updating the last known View and
      * RaggedTrim (and corresponding longest-log information) as each node connects,
      * until there is a quorum of nodes from the last known View and a new View
-     * can be installed that is adequately provisioned.
+     * can be installed that is adequately provisioned. Rejoining nodes are
+     * handed off to DERECHO/restart_intake_threads threads as they connect, so
+     * their handshakes proceed concurrently.
      * @param server_socket The TCP socket to listen for rejoining nodes on
      */
     void await_quorum(tcp::connection_listener& server_socket);
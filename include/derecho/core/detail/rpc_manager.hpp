@@ -16,11 +16,13 @@
 #include "remote_invocable.hpp"
 #include "rpc_utils.hpp"
 
+#include <algorithm>
 #include <exception>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 namespace derecho {
@@ -34,6 +36,7 @@ template <typename T>
 class ExternalClientCallback;
 
 class ViewManager;
+class ReplicatedObject;
 
 /**
  * The Deserialization Interface to be implemented by user applications.
@@ -167,15 +170,24 @@ class RPCManager {
     bool thread_start = false;
     /** Mutex for thread_start_cv. */
     std::mutex thread_start_mutex;
-    /** Notified when the P2P listening thread should start. */
+    /** Notified when the P2P listening threads should start. */
     std::condition_variable thread_start_cv;
     std::atomic<bool> thread_shutdown{false};
-    /** The thread that listens for incoming P2P RPC calls; implemented by p2p_receive_loop() */
-    std::thread rpc_listener_thread;
     /** The maximum busy wait time in millisecond before sleep */
     const uint64_t busy_wait_before_sleep_ms;
-    /** The thread that processes P2P requests in FIFO order; implemented by p2p_request_worker() */
-    std::thread request_worker_thread;
+    /**
+     * The number of threads listening for incoming P2P messages. Each one
+     * probes the connections to the node IDs equal to its index modulo this
+     * number.
+     */
+    const uint32_t num_receive_threads;
+    /** The number of request worker threads started by each listening thread. */
+    const uint32_t num_request_workers;
+    /**
+     * The threads that listen for incoming P2P RPC calls, one per shard of the
+     * P2P connections; implemented by p2p_receive_loop()
+     */
+    std::vector<std::thread> rpc_listener_threads;
     /** A simple struct representing a P2P request message.
      *  Encapsulates the parameters to a p2p_message_handler call. */
     struct p2p_req {
@@ -188,20 +200,36 @@ class RPCManager {
                 : sender_id(_sender_id),
                   msg_buf(_msg_buf) {}
     };
-    /** P2P requests that need to be handled by the worker thread. */
-    std::queue<p2p_req> p2p_request_queue;
-    std::mutex request_queue_mutex;
-    /** Notified when the request worker thread has work to do. */
-    std::condition_variable request_queue_cv;
+    /** The P2P requests that need to be handled by one request worker thread. */
+    struct p2p_request_queue {
+        std::queue<p2p_req> requests;
+        std::mutex mutex;
+        /** Notified when the request worker thread has work to do. */
+        std::condition_variable cv;
+    };
+    /**
+     * One request queue per request worker thread, indexed by receive thread
+     * and then by worker. Requests from a node always go to the same queue
+     * (see get_request_queue()), so they are handled in FIFO order.
+     */
+    std::vector<std::unique_ptr<p2p_request_queue>> p2p_request_queues;
 
     /** The caller id of the latest rpc */
     static thread_local node_id_t rpc_caller_id;
 
-    /** Listens for P2P RPC calls over the RDMA P2P connections and handles them. */
-    void p2p_receive_loop();
+    /**
+     * Listens for P2P RPC calls over one shard of the RDMA P2P connections and
+     * handles them.
+     * @param thread_index The index of the receive thread, which is also the
+     * index of the shard of connections it probes
+     */
+    void p2p_receive_loop(uint32_t thread_index);
+
+    /** Handles the non-cascading P2P Send requests in a request queue in FIFO order. */
+    void p2p_request_worker(p2p_request_queue& request_queue);
 
-    /** Handles non-cascading P2P Send requests in FIFO order. */
-    void p2p_request_worker();
+    /** @return The request queue that handles the P2P requests from a node. */
+    p2p_request_queue& get_request_queue(node_id_t sender_id);
 
     /**
      * Handler to be called by p2p_receive_loop each time it receives a
@@ -248,17 +276,33 @@ class RPCManager {
     std::exception_ptr parse_and_receive(uint8_t* buf, std::size_t size,
                                          const std::function<uint8_t*(int)>& out_alloc);
 
+    /**
+     * Delivers one ordered RPC message and sends or self-delivers its reply;
+     * the body of rpc_message_handler(), which must be called in the RPC
+     * handler context.
+     */
+    void receive_rpc_message(subgroup_id_t subgroup_id, node_id_t sender_id,
+                             persistent::version_t version, uint64_t timestamp,
+                             uint8_t* msg_buf, uint32_t buffer_size);
+
 public:
     RPCManager(ViewManager& group_view_manager,
                const std::vector<DeserializationContext*>& deserialization_context)
             : nid(getConfUInt32(CONF_DERECHO_LOCAL_ID)),
               receivers(new std::decay_t<decltype(*receivers)>()),
               view_manager(group_view_manager),
-              busy_wait_before_sleep_ms(getConfUInt64(CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS)) {
+              busy_wait_before_sleep_ms(getConfUInt64(CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS)),
+              num_receive_threads(std::max(getConfUInt32(CONF_DERECHO_P2P_RECEIVE_THREADS), 1u)),
+              num_request_workers(std::max(getConfUInt32(CONF_DERECHO_P2P_REQUEST_WORKERS), 1u)) {
         for(const auto& deserialization_context_ptr : deserialization_context) {
             rdv.push_back(deserialization_context_ptr);
         }
-        rpc_listener_thread = std::thread(&RPCManager::p2p_receive_loop, this);
+        for(uint32_t i = 0; i < num_receive_threads * num_request_workers; ++i) {
+            p2p_request_queues.emplace_back(std::make_unique<p2p_request_queue>());
+        }
+        for(uint32_t i = 0; i < num_receive_threads; ++i) {
+            rpc_listener_threads.emplace_back(&RPCManager::p2p_receive_loop, this, i);
+        }
     }
 
     ~RPCManager();
@@ -341,6 +385,23 @@ public:
                              uint64_t timestamp,
                              uint8_t* msg_buf, uint32_t buffer_size);
 
+    /**
+     * Handler to be called by MulticastGroup with a run of consecutive
+     * "cooked send" RPC messages, when RPC delivery batching is enabled.
+     * Delivers each message as rpc_message_handler() would, through the
+     * object's deliver_versions(), which posts each message's version before
+     * it is handled and makes the version right after, so each message still
+     * gets its own version of the object's state, with a single call into
+     * the object and its registry for the whole run.
+     * @param subgroup_id The internal subgroup number of the subgroup the
+     * messages were received in
+     * @param messages The messages, in delivery order
+     * @param object The replicated object of the subgroup
+     */
+    void rpc_batch_handler(subgroup_id_t subgroup_id,
+                           const std::vector<DeliveredRPCMessage>& messages,
+                           ReplicatedObject* object);
+
     /**
      * Callback to be called by PersistenceManager when it has finished
      * persisting a version. This will deliver "local persistence done" events
@@ -397,6 +458,15 @@ public:
      */
     sst::P2PBufferHandle get_sendbuffer_ptr(uint32_t dest_id, sst::MESSAGE_TYPE type);
 
+    /**
+     * Like get_sendbuffer_ptr, but returns immediately instead of waiting if
+     * the sending window to dest_id is full.
+     * @param dest_id The ID of the node that the P2P message will be sent to
+     * @param type The type of P2P message that will be sent
+     * @return A buffer, or std::nullopt if none was available
+     */
+    std::optional<sst::P2PBufferHandle> try_get_sendbuffer_ptr(uint32_t dest_id, sst::MESSAGE_TYPE type);
+
     /**
      * Sends the P2P message buffer with the specified sequence number over an RDMA
      * connection to the specified node, and registers the "promise object" pointed
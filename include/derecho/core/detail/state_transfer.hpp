@@ -0,0 +1,150 @@
+#pragma once
+
+#include "derecho/tcp/tcp.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/types.h>
+
+namespace derecho {
+
+/**
+ * The header preceding each chunk of a serialized object sent during state
+ * transfer. An object is sent as a sequence of contiguous chunks of at most
+ * CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE bytes, in order, followed by a header
+ * with size 0 whose offset is the total size of the object. The header is
+ * sent as raw bytes, so its layout has no implicit padding.
+ */
+struct StateTransferChunkHeader {
+    /** The offset of this chunk within the serialized object */
+    uint64_t offset;
+    /** The number of bytes in this chunk; 0 marks the end of the object */
+    uint32_t size;
+    /** The CRC-32C of the chunk, if has_checksum is nonzero */
+    uint32_t checksum;
+    /** 1 if checksum is set, 0 otherwise */
+    uint8_t has_checksum;
+    /** Unused; always sent as zeroes */
+    uint8_t reserved[7];
+};
+static_assert(sizeof(StateTransferChunkHeader) == 24, "StateTransferChunkHeader must not have implicit padding");
+
+/**
+ * Computes the CRC-32C (Castagnoli) checksum of a byte buffer.
+ * @param buffer The bytes to checksum
+ * @param size The number of bytes in the buffer
+ * @return The checksum
+ */
+uint32_t crc32c(const uint8_t* buffer, std::size_t size);
+
+/**
+ * Sends a serialized object over a state-transfer socket as a stream of
+ * bounded-size chunks. It can be used as the consumer of mutils::post_object,
+ * so the object is serialized straight into the chunk buffer and the sender
+ * never needs to compute the object's size in advance.
+ */
+class StateTransferWriter {
+    tcp::socket& socket;
+    const std::size_t chunk_size;
+    const bool use_checksums;
+    std::unique_ptr<uint8_t[]> chunk;
+    /** Number of bytes in the current chunk */
+    std::size_t chunk_used;
+    /** Offset of the current chunk within the object */
+    uint64_t offset;
+
+    /** Sends the chunk in buffer, which starts at the current offset. */
+    void send_chunk(const uint8_t* buffer, std::size_t size);
+
+public:
+    /**
+     * The size of the smallest file range worth sending with write_file().
+     * Each range costs a chunk header and two system calls, so smaller ones
+     * are cheaper to copy into the current chunk.
+     */
+    static constexpr std::size_t min_file_range_size = 65536;
+
+    /**
+     * Constructs a writer that sends chunks over the given socket, with the
+     * chunk size and checksum setting read from the configuration.
+     */
+    StateTransferWriter(tcp::socket& socket);
+
+    /**
+     * Appends bytes to the object, sending each chunk as soon as it is full.
+     */
+    void write(const uint8_t* bytes, std::size_t size);
+
+    /**
+     * Appends a range of a file to the object, sending it from the file with
+     * sendfile so its bytes are never copied into user space. The range is
+     * sent as chunks of its own, after the partially filled chunk, and it
+     * can't carry checksums, so it must only be used without them.
+     * @param fd The file
+     * @param file_offset The offset of the range in the file
+     * @param size The length of the range, in bytes
+     */
+    void write_file(int fd, off_t file_offset, std::size_t size);
+
+    /** @return True if the chunks carry checksums, which write_file() can't compute */
+    bool has_checksums() const { return use_checksums; }
+
+    /**
+     * Sends the last, partially filled chunk and the end-of-object marker.
+     * @return The total size of the object that was sent
+     */
+    std::size_t finish();
+};
+
+/**
+ * Receives an object sent by a StateTransferWriter into a contiguous buffer.
+ * The buffer is anonymous memory that grows (with mremap, which does not copy
+ * the received bytes) as chunks arrive, so the receiver does not need to know
+ * the size of the object in advance. Each chunk's checksum is verified as soon
+ * as the chunk arrives.
+ *
+ * Chunking does not bound the receiver's memory: the buffer holds the whole
+ * serialized object, including the log tails of its Persistent fields, until
+ * it is deserialized, because the object is deserialized from one contiguous
+ * buffer. Only the sender's memory is bounded by the chunk size.
+ */
+class StateTransferBuffer {
+    uint8_t* buffer;
+    std::size_t capacity;
+    /** The number of bytes received so far, which is where the next chunk must start */
+    std::size_t received_size;
+    std::size_t object_size;
+
+    /** Grows the buffer so that it can hold at least new_capacity bytes. */
+    void reserve(std::size_t new_capacity);
+
+public:
+    StateTransferBuffer();
+    StateTransferBuffer(const StateTransferBuffer&) = delete;
+    StateTransferBuffer& operator=(const StateTransferBuffer&) = delete;
+    ~StateTransferBuffer();
+
+    /**
+     * Reads chunks from the socket until the end-of-object marker arrives.
+     * @throw derecho_exception if a chunk's checksum does not match, a chunk
+     * does not start where the previous one ended, or the end marker's size
+     * does not match the bytes received; or a subclass of tcp::socket_error
+     * if the socket fails.
+     */
+    void receive(tcp::socket& socket);
+
+    /**
+     * Reads one chunk, or the end-of-object marker, from the socket and
+     * stores it at its offset in the buffer.
+     * @return False if the end-of-object marker was read, true otherwise.
+     */
+    bool receive_chunk(tcp::socket& socket);
+
+    /** @return A pointer to the received object */
+    uint8_t* data() { return buffer; }
+    /** @return The size of the received object, once it has been received */
+    std::size_t size() const { return object_size; }
+};
+
+}  // namespace derecho
@@ -258,8 +258,9 @@ private:
 
     /**
      * A 2-dimensional vector, indexed by (subgroup ID -> shard number),
-     * containing the ID of the node in each shard that was its leader
-     * in the prior view, or -1 if that shard had no state in the prior view.
+     * containing the ID of the node in each shard that sends the shard's
+     * state to new members (see choose_state_transfer_senders), or -1 if that
+     * shard had no state in the prior view.
      * Only used for state transfer during initial startup and total restart,
      * may be empty otherwise.
      */
@@ -382,11 +383,12 @@ private:
 
     /** Helper method for completing view changes; determines whether this node
      * needs to send Replicated Object state to each node that just joined, and then
-     * sends the state if necessary. */
-    void send_objects_to_new_members(const vector_int64_2d& old_shard_leaders);
+     * sends the state if necessary. The state is sent to several joiners at once,
+     * using one thread per joiner. */
+    void send_objects_to_new_members(const vector_int64_2d& state_transfer_senders);
 
-    /** Sends a single subgroup's replicated object to a new member after a view change. */
-    void send_subgroup_object(subgroup_id_t subgroup_id, node_id_t new_node_id);
+    /** Sends a single subgroup's replicated object to a new member over its state-transfer socket. */
+    void send_subgroup_object(subgroup_id_t subgroup_id, tcp::socket& joiner_socket);
 
     /** Sends a joining node the new view that has been constructed to include it.*/
     void send_view(const View& new_view, tcp::socket& client_socket);
@@ -646,6 +648,19 @@ private:
      * transfer), the "node ID" for that shard will be -1.
      */
     static vector_int64_2d old_shard_leaders_by_new_ids(const View& curr_view, const View& next_view);
+    /**
+     * Chooses the node that sends each shard's state to the shard's new
+     * members, in a vector indexed the same way as old_shard_leaders. Instead
+     * of always using the old shard leader, the sender is picked among the
+     * members that were in the shard in the old view and stay in it, rotating
+     * by view ID, subgroup ID and shard number, so that the transfers of a view
+     * change are spread over several nodes. Nodes that receive state in this
+     * view change are never picked, since two nodes that each wait to send an
+     * object to the other would deadlock; the old shard leader is kept if there
+     * is no other choice.
+     */
+    static vector_int64_2d choose_state_transfer_senders(const View& next_view,
+                                                         const vector_int64_2d& old_shard_leaders);
 
     /**
      * A little convenience method that receives a 2-dimensional vector using
@@ -809,9 +824,9 @@ public:
     bool is_starting_leader() const;
 
     /**
-     * @return The list of shard leaders in the previous view that this node
-     * received along with curr_view when it joined the group. Needed by Group
-     * to complete state transfer.
+     * @return The list of nodes to receive each shard's state from, which this
+     * node received along with curr_view when it joined the group. Needed by
+     * Group to complete state transfer.
      */
     const vector_int64_2d& get_old_shard_leaders() const { return prior_view_shard_leaders; }
 
@@ -823,6 +838,12 @@ public:
      */
     LockedReference<std::unique_lock<std::mutex>, tcp::socket> get_transfer_socket(node_id_t member_id);
 
+    /**
+     * Gets a locked reference to all of the state-transfer TCP sockets, indexed
+     * by node ID, so that Group can receive state from several nodes at once.
+     */
+    LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, tcp::socket>> get_transfer_sockets();
+
     /** Causes this node to cleanly leave the group by setting itself to "failed." */
     void leave();
 
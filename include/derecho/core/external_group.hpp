@@ -7,12 +7,16 @@
 #include "notification.hpp"
 #include "view.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <exception>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <thread>
 #include <unordered_map>
@@ -96,6 +100,19 @@ public:
      */
     template <rpc::FunctionTag tag, typename... Args>
     auto p2p_send(node_id_t dest_node, Args&&... args);
+    /**
+     * Like p2p_send, but never waits for a P2P request buffer. If the request
+     * window to dest_node is full, the message is serialized into a bounded
+     * client-side queue (DERECHO/p2p_send_queue_size entries per node) and sent
+     * by the P2P listener thread as replies from dest_node free up the window.
+     * @param dest_node The ID of the node that the P2P message should be sent to
+     * @param args The arguments to the RPC function being invoked
+     * @return An std::optional containing the rpc::QueryResults<Ret> for the
+     * call, or std::nullopt if the queue for dest_node was also full and the
+     * message was not sent
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    auto p2p_send_async(node_id_t dest_node, Args&&... args);
 };
 
 /**
@@ -152,8 +169,53 @@ private:
 
     /** ======================== copy/paste from rpc_manager ======================== **/
     const uint64_t busy_wait_before_sleep_ms;
+    /**
+     * Waits until a buffer of the given type is free in the P2P connection to
+     * dest_id, without spinning: the P2P listener thread wakes waiters whenever
+     * a reply frees up a request buffer. Requests queued by p2p_send_async for
+     * dest_id are sent first. Throws node_removed_from_group_exception if
+     * dest_id leaves the group while waiting, and derecho_exception if the
+     * client shuts down.
+     */
     sst::P2PBufferHandle get_sendbuffer_ptr(uint32_t dest_id, sst::MESSAGE_TYPE type);
+    /**
+     * @return The next free buffer of the given type in the P2P connection to
+     * dest_id, or std::nullopt if the connection's send window is full.
+     */
+    std::optional<sst::P2PBufferHandle> try_get_sendbuffer_ptr(uint32_t dest_id, sst::MESSAGE_TYPE type);
+    /** Must be called with p2p_send_mutex held. */
     void send_p2p_message(node_id_t dest_id, subgroup_id_t dest_subgroup_id, uint64_t sequence_num, std::weak_ptr<AbstractPendingResults> pending_results_handle);
+    /** A P2P request that was serialized while its destination's request window was full. */
+    struct queued_p2p_send {
+        subgroup_id_t dest_subgroup_id;
+        std::unique_ptr<uint8_t[]> msg_buf;
+        std::size_t msg_size;
+        std::weak_ptr<AbstractPendingResults> pending_results_handle;
+    };
+    /** The largest number of requests p2p_send_async queues for a single node. */
+    const uint32_t p2p_send_queue_size;
+    /** Requests waiting for a free buffer in the request window, by destination node. */
+    std::map<node_id_t, std::queue<queued_p2p_send>> p2p_send_queues;
+    /** Guards p2p_send_queues and fulfilled_pending_results. */
+    std::mutex p2p_send_mutex;
+    /**
+     * Notified by the P2P listener thread whenever a reply may have freed up a
+     * request buffer, and by clean_up() and the destructor, after which a
+     * waiting thread may have to give up.
+     */
+    std::condition_variable p2p_send_window_cv;
+    /**
+     * Sends as many queued requests as the request windows now have room for,
+     * then wakes any thread waiting in get_sendbuffer_ptr. Called by the P2P
+     * listener thread after it receives a reply.
+     */
+    void drain_p2p_send_queues();
+    /**
+     * Gives up on the requests queued for a node that is no longer reachable,
+     * reporting node_removed_from_group_exception for each of them. Must be
+     * called with p2p_send_mutex held.
+     */
+    void fail_queued_p2p_sends(node_id_t dest_id);
     std::atomic<bool> thread_shutdown{false};
     std::thread rpc_listener_thread;
     /** p2p send and queries are queued in fifo worker */
@@ -242,9 +242,14 @@ private:
     /**
      * Updates the state of the replicated objects that correspond to subgroups
      * identified in the provided map, by receiving serialized state from the
-     * shard leader whose ID is paired with that subgroup ID.
-     * @param subgroups_and_leaders Pairs of (subgroup ID, leader's node ID) for
-     * subgroups that need to have their state initialized from the leader.
+     * shard member whose ID is paired with that subgroup ID. Objects from
+     * different members are received concurrently, one thread per member.
+     * Each object, including the log tails of its Persistent fields, is
+     * buffered in full before it is deserialized, so the memory this needs
+     * grows with the size of the largest object and is not bounded by the
+     * state transfer chunk size.
+     * @param subgroups_and_leaders Pairs of (subgroup ID, sender's node ID) for
+     * subgroups that need to have their state initialized from the sender.
      */
     void receive_objects(const std::set<std::pair<subgroup_id_t, node_id_t>>& subgroups_and_leaders);
 
@@ -4,6 +4,7 @@
 #include "derecho/mutils-serialization/SerializationSupport.hpp"
 #include "register_rpc_functions.hpp"
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -11,6 +12,12 @@
 namespace derecho {
 
 struct NotificationMessage : mutils::ByteRepresentable {
+    /**
+     * The message type of a batch of notifications sent by a NotificationStream,
+     * whose body contains several serialized NotificationMessages. This type is
+     * reserved and must not be used by applications.
+     */
+    static constexpr uint64_t batch_message_type = UINT64_MAX;
     /**
      * A number identifying the type of notification message, which can be
      * defined and interpreted by the notification-supporting class in any
@@ -87,6 +94,14 @@ struct NotificationMessage : mutils::ByteRepresentable {
     static mutils::context_ptr<const NotificationMessage> from_bytes_noalloc_const(
             mutils::DeserializationManager* ctx,
             const uint8_t* const buffer);
+
+    /**
+     * Calls a function on each of the notifications contained in a batch
+     * message (one whose type is batch_message_type), in order. The
+     * notifications refer to this message's body and are only valid for the
+     * duration of the call.
+     */
+    void for_each_in_batch(const std::function<void(const NotificationMessage&)>& func) const;
 };
 
 using notification_handler_t = std::function<void(const NotificationMessage&)>;
@@ -103,7 +118,11 @@ public:
     virtual void notify(const NotificationMessage& msg) const {
         dbg_default_trace("notification message of type {} received.", msg.message_type);
         if (handler) {
-            (*handler)(msg);
+            if(msg.message_type == NotificationMessage::batch_message_type) {
+                msg.for_each_in_batch(*handler);
+            } else {
+                (*handler)(msg);
+            }
         }
     }
 
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "derecho_type_definitions.hpp"
+#include "notification.hpp"
+#include "replicated.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+namespace derecho {
+
+/**
+ * Settings for a NotificationStream.
+ */
+struct NotificationStreamOptions {
+    /** How long notifications are collected before they are sent to their clients. */
+    std::chrono::microseconds flush_interval{1000};
+    /**
+     * The largest number of notifications that can wait for a single client.
+     * When a client's queue is full, its oldest notification is dropped.
+     */
+    std::size_t max_queued_per_client = 1024;
+    /**
+     * If true, a notification posted with a key replaces any notification with
+     * the same key that is still waiting for the same client, so that only the
+     * latest notification for a key is sent.
+     */
+    bool coalesce_by_key = true;
+    /**
+     * Bounded-staleness mode: if nonzero, notifications that have been waiting
+     * for longer than this when they are flushed are dropped instead of sent.
+     */
+    std::chrono::microseconds max_staleness{0};
+};
+
+/**
+ * Counters describing what a NotificationStream did with the notifications
+ * posted to it.
+ */
+struct NotificationStreamStats {
+    /** Notifications sent to a client */
+    uint64_t sent = 0;
+    /** P2P messages used to send them */
+    uint64_t batches_sent = 0;
+    /** Notifications replaced by a newer notification with the same key */
+    uint64_t coalesced = 0;
+    /** Notifications dropped because their client's queue was full */
+    uint64_t dropped_queue_full = 0;
+    /** Notifications dropped because they exceeded the staleness bound */
+    uint64_t dropped_stale = 0;
+    /** Notifications dropped because their client was no longer connected */
+    uint64_t dropped_disconnected = 0;
+};
+
+/**
+ * Sends notifications from a subgroup to its external clients in batches.
+ * Notifications are queued per client and sent by a background thread once
+ * per flush interval, packing all of a client's pending notifications into as
+ * few P2P messages as the P2P request size allows. Each batch is delivered to
+ * the client's notification handler one notification at a time, in the order
+ * they were posted, by NotificationSupport::notify. A client whose P2P request
+ * window is full does not hold up the others: its unsent notifications stay
+ * queued until the next flush.
+ *
+ * @tparam T The subgroup type, which must derive from NotificationSupport and
+ * register notify as a P2P-callable function
+ */
+template <typename T>
+class NotificationStream {
+    static_assert(std::is_base_of_v<NotificationSupport, T>,
+                  "NotificationStream can only be used with subgroup types that derive from NotificationSupport");
+
+private:
+    struct QueuedNotification {
+        std::shared_ptr<const NotificationMessage> message;
+        std::optional<uint64_t> key;
+        std::chrono::steady_clock::time_point post_time;
+    };
+    struct ClientQueue {
+        std::list<QueuedNotification> pending;
+        /** The position in pending of the notification with each key, for coalescing */
+        std::unordered_map<uint64_t, typename std::list<QueuedNotification>::iterator> pending_by_key;
+    };
+
+    ExternalClientCallback<T>& client_callback;
+    const NotificationStreamOptions options;
+    /** The largest serialized notification, or batch of notifications, that fits in a P2P request */
+    const std::size_t max_message_size;
+
+    /** Guards client_queues and subscribers */
+    std::mutex queues_mutex;
+    /** The queues of the subscribers, and of other clients while they have notifications from post() */
+    std::map<node_id_t, ClientQueue> client_queues;
+    std::set<node_id_t> subscribers;
+
+    std::atomic<uint64_t> num_sent{0};
+    std::atomic<uint64_t> num_batches_sent{0};
+    std::atomic<uint64_t> num_coalesced{0};
+    std::atomic<uint64_t> num_dropped_queue_full{0};
+    std::atomic<uint64_t> num_dropped_stale{0};
+    std::atomic<uint64_t> num_dropped_disconnected{0};
+
+    std::mutex flush_mutex;
+    std::condition_variable flush_cv;
+    bool thread_shutdown = false;
+    std::thread flush_thread;
+
+    /** Adds a notification to a client's queue. Must be called with queues_mutex held. */
+    void enqueue(node_id_t client_id, const std::shared_ptr<const NotificationMessage>& message,
+                 const std::optional<uint64_t>& key, std::chrono::steady_clock::time_point post_time);
+    /** Drops the oldest notification in a full queue. Must be called with queues_mutex held. */
+    void drop_oldest(ClientQueue& queue);
+    /**
+     * Puts notifications that could not be sent yet back at the front of a
+     * client's queue, ahead of any posted since they were taken.
+     */
+    void requeue(node_id_t client_id, std::list<QueuedNotification>& unsent);
+    /** Throws buffer_overflow_exception if a notification could never be sent. */
+    void check_size(const NotificationMessage& message) const;
+    void flush_loop();
+    /** Sends everything that is currently queued. */
+    void flush();
+    enum class SendResult {
+        SENT,
+        /** The client's P2P request window was full */
+        WINDOW_FULL,
+        /** The client could not be reached */
+        FAILED
+    };
+    /**
+     * Sends one P2P message to a client holding the given notifications,
+     * without waiting if the client's P2P request window is full.
+     */
+    SendResult send_batch(node_id_t client_id, const std::vector<std::shared_ptr<const NotificationMessage>>& batch);
+
+public:
+    /**
+     * Creates a notification stream that sends to the external clients of a
+     * subgroup, and starts its flushing thread.
+     * @param client_callback The handle for sending to the subgroup's external
+     * clients, from Group::get_client_callback
+     * @param options The batching, coalescing and staleness settings
+     */
+    NotificationStream(ExternalClientCallback<T>& client_callback,
+                       const NotificationStreamOptions& options = NotificationStreamOptions{});
+    NotificationStream(const NotificationStream&) = delete;
+    /** Sends any notifications still queued, then stops the flushing thread. */
+    virtual ~NotificationStream();
+
+    /** Adds a client to the set of clients that receive publish()ed notifications. */
+    void subscribe(node_id_t client_id);
+    /** Removes a client from the subscribers, discarding its queued notifications. */
+    void unsubscribe(node_id_t client_id);
+
+    /**
+     * Queues a notification for a single client.
+     * @param client_id The external client to notify
+     * @param message The notification
+     * @param key If set, the key the notification is coalesced by
+     * @throw buffer_overflow_exception if the message is too large to fit in a P2P request
+     */
+    void post(node_id_t client_id, const NotificationMessage& message, std::optional<uint64_t> key = std::nullopt);
+
+    /**
+     * Queues a notification for every subscribed client. The clients' queues
+     * share a single copy of the message.
+     * @param message The notification
+     * @param key If set, the key the notification is coalesced by
+     * @throw buffer_overflow_exception if the message is too large to fit in a P2P request
+     */
+    void publish(const NotificationMessage& message, std::optional<uint64_t> key = std::nullopt);
+
+    /** @return A snapshot of this stream's counters */
+    NotificationStreamStats get_stats() const;
+};
+
+}  // namespace derecho
+
+#include "detail/notification_stream_impl.hpp"
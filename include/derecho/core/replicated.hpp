@@ -18,6 +18,7 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <tuple>
 #include <type_traits>
 
@@ -272,6 +273,33 @@ public:
     template <rpc::FunctionTag tag, typename... Args>
     auto ordered_send(Args&&... args);
 
+    /**
+     * Like ordered_send, but for arguments the caller has already serialized
+     * into a memory region registered for RDMA, so that large arguments are
+     * sent straight from that region instead of being copied into a multicast
+     * buffer. The serialized arguments must start serialized_send_prefix_size()
+     * bytes after offset in the region; Derecho writes its headers into those
+     * first bytes. The region must not be modified until buffer_released is
+     * called.
+     * @param mr The registered memory region holding the arguments
+     * @param offset The offset of the message (including the prefix) in mr
+     * @param args_size The size of the serialized arguments in bytes
+     * @param buffer_released Called once Derecho no longer needs the region.
+     * It runs on a Derecho thread that holds internal locks, so it should be
+     * quick and must not send messages.
+     * @return An instance of rpc::QueryResults<Ret>, where Ret is the return type
+     * of the RPC function being invoked.
+     */
+    template <rpc::FunctionTag tag>
+    auto ordered_send_serialized(std::shared_ptr<rdma::memory_region> mr, std::size_t offset,
+                                 std::size_t args_size, std::function<void()> buffer_released);
+
+    /**
+     * @return The number of bytes that must be left free in front of the
+     * arguments passed to ordered_send_serialized.
+     */
+    static std::size_t serialized_send_prefix_size();
+
     /**
      * Submits a call to send a "raw" (byte array) message in a multicast to
      * this object's subgroup; the message will be generated by invoking msg_generator
@@ -287,9 +315,10 @@ public:
 
     /**
      * Serializes and sends the state of the "wrapped" object (of type T) for
-     * this Replicated<T> over the given socket. (This includes sending the
-     * object's size before its data, so the receiver knows the size of buffer
-     * to allocate).
+     * this Replicated<T> over the given socket, as a stream of bounded-size
+     * chunks that can be received with a StateTransferBuffer. The chunks
+     * bound the memory used by the sender only; the receiver buffers the
+     * whole object before it calls receive_object().
      * @param receiver_socket
      */
     void send_object(tcp::socket& receiver_socket) const;
@@ -421,6 +450,17 @@ public:
      */
     virtual void post_next_version(persistent::version_t version, uint64_t ts_us);
 
+    /**
+     * Delivers a run of ordered updates. For each message in turn, posts its
+     * version, calls deliver on it, and makes its version of the Persistent
+     * fields, so every message still gets its own version. The Persistent
+     * fields are looked up once for the whole run.
+     * @param messages The messages, in delivery order
+     * @param deliver The function that handles one message
+     */
+    virtual void deliver_versions(const std::vector<DeliveredRPCMessage>& messages,
+                                  const std::function<void(const DeliveredRPCMessage&)>& deliver);
+
     /**
      * Get the current version, set by the most recent ordered_send update.
      * During the execution of an ordered_send RPC method, this represents the
@@ -549,6 +589,19 @@ public:
     template <rpc::FunctionTag tag, typename... Args>
     auto p2p_send(node_id_t dest_node, Args&&... args);
 
+    /**
+     * Like p2p_send, but never waits for the P2P request window to the client
+     * to have room: if the window is full, the message is not sent. Since the
+     * message is dropped without a reply, this can only invoke RPC functions
+     * that return void.
+     * @param dest_node The ID of the node that the P2P message should be sent to
+     * @param args The arguments to the RPC function being invoked
+     * @return An instance of rpc::QueryResults<void>, or std::nullopt if the
+     * request window to dest_node was full
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    auto try_p2p_send(node_id_t dest_node, Args&&... args);
+
     bool is_valid() const { return true; }
 };
 
@@ -2,6 +2,7 @@
 #include "SerializationMacros.hpp"
 #include "context_ptr.hpp"
 #include <cstring>
+#include <limits>
 #include <mutils/macro_utils.hpp>
 #include <mutils/mutils.hpp>
 #include <mutils/tuple_extras.hpp>
@@ -192,6 +193,28 @@ struct DeserializationManager {
     }
 };
 
+/**
+ * True for the types whose serialized form is exactly their in-memory
+ * representation, so that a contiguous range of them (e.g. the elements of a
+ * std::vector) can be serialized and deserialized with a single memcpy. This
+ * holds for PODs, and for pairs of such types that have no padding between
+ * their members.
+ */
+template <typename T>
+struct is_memcpy_serializable : std::is_pod<T> {};
+
+/**
+ * The type of the element count that prefixes a serialized std::vector. It
+ * stays an int, so that logs persisted and messages sent by older builds can
+ * still be read; a vector can't have more elements than an int can count.
+ */
+using vector_size_t = int;
+
+template <typename T, typename U>
+struct is_memcpy_serializable<std::pair<T, U>>
+        : std::integral_constant<bool, is_memcpy_serializable<T>::value && is_memcpy_serializable<U>::value
+                                               && sizeof(std::pair<T, U>) == sizeof(T) + sizeof(U)> {};
+
 /**
  * Just calls sizeof(T)
  */
@@ -232,15 +255,15 @@ template <typename T>
 std::size_t bytes_size(const std::vector<T>& v) {
     whenmutilsdebug(
             static const auto typenonce_size = bytes_size(
-                    type_name<std::vector<T>>());) if(std::is_pod<T>::value) return v
+                    type_name<std::vector<T>>());) if constexpr(is_memcpy_serializable<T>::value) return v
                             .size()
-                    * bytes_size(v.back())
-            + sizeof(int) whenmutilsdebug(+typenonce_size);
+                    * sizeof(T)
+            + sizeof(vector_size_t) whenmutilsdebug(+typenonce_size);
     else {
-        int accum = 0;
+        std::size_t accum = 0;
         for(auto& e : v)
             accum += bytes_size(e);
-        return accum + sizeof(int) whenmutilsdebug(+typenonce_size);
+        return accum + sizeof(vector_size_t) whenmutilsdebug(+typenonce_size);
     }
 }
 
@@ -470,6 +493,78 @@ struct marshalled : public ByteRepresentable {
     from_bytes_noalloc(DeserializationManager const* const, uint8_t* v);
 };
 
+/**
+ * A read-only view of a serialized std::vector<T> whose elements are
+ * memcpy-serializable. It has the same serialized form as std::vector<T>, so
+ * an RPC function can take a const vector_view<T>& where its callers pass a
+ * std::vector<T>, but deserializing it with from_bytes_noalloc copies nothing:
+ * the view points directly into the buffer it was deserialized from, and is
+ * not valid past the end of life of that buffer. The elements are only as
+ * aligned as the buffer's address plus sizeof(vector_size_t) bytes.
+ */
+template <typename T>
+class vector_view : public ByteRepresentable {
+    static_assert(is_memcpy_serializable<T>::value,
+                  "vector_view can only view elements that are serialized with memcpy");
+    T const* elements;
+    std::size_t count;
+
+    static vector_view view_of(uint8_t const* buffer) {
+        vector_size_t size;
+        std::memcpy(&size, buffer, sizeof(size));
+        return vector_view{(T const*)(buffer + sizeof(size)), static_cast<std::size_t>(size)};
+    }
+
+public:
+    vector_view(T const* elements, std::size_t count) : elements(elements), count(count) {}
+    vector_view(const std::vector<T>& vec) : elements(vec.data()), count(vec.size()) {}
+
+    T const* data() const { return elements; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T const* begin() const { return elements; }
+    T const* end() const { return elements + count; }
+    const T& operator[](std::size_t i) const { return elements[i]; }
+    /** Copies the viewed elements into a new std::vector. */
+    std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+
+    std::size_t to_bytes(uint8_t* buffer) const {
+        assert(count <= static_cast<std::size_t>(std::numeric_limits<vector_size_t>::max()));
+        const vector_size_t size = count;
+        std::memcpy(buffer, &size, sizeof(size));
+        if(count > 0) {
+            std::memcpy(buffer + sizeof(size), elements, count * sizeof(T));
+        }
+        return bytes_size();
+    }
+
+    std::size_t bytes_size() const { return sizeof(vector_size_t) + count * sizeof(T); }
+
+    void post_object(const std::function<void(uint8_t const* const, std::size_t)>& consumer) const {
+        const vector_size_t size = count;
+        consumer((uint8_t*)&size, sizeof(size));
+        if(count > 0) {
+            consumer((uint8_t const*)elements, count * sizeof(T));
+        }
+    }
+
+#ifdef MUTILS_DEBUG
+    void ensure_registered(DeserializationManager&) {}
+#endif
+
+    static std::unique_ptr<vector_view> from_bytes(DeserializationManager*, uint8_t const* buffer) {
+        return std::make_unique<vector_view>(view_of(buffer));
+    }
+
+    static context_ptr<vector_view> from_bytes_noalloc(DeserializationManager*, uint8_t const* buffer) {
+        return context_ptr<vector_view>{new vector_view(view_of(buffer))};
+    }
+
+    static context_ptr<const vector_view> from_bytes_noalloc_const(DeserializationManager*, uint8_t const* buffer) {
+        return context_ptr<const vector_view>{new vector_view(view_of(buffer))};
+    }
+};
+
 /**
  * Serialization is also implemented for the following STL types:
  * vector
@@ -745,11 +840,13 @@ void post_object(const std::function<void(uint8_t const* const, std::size_t)>& c
 template <typename T>
 void post_object(const std::function<void(uint8_t const* const, std::size_t)>& consumer,
                  const std::vector<T>& vec) {
-    whenmutilsdebug(post_object(f, type_name<std::vector<T>>());) int size = vec.size();
+    assert(vec.size() <= static_cast<std::size_t>(std::numeric_limits<vector_size_t>::max()));
+    whenmutilsdebug(post_object(f, type_name<std::vector<T>>());) vector_size_t size = vec.size();
     consumer((uint8_t*)&size, sizeof(size));
-    if(std::is_pod<T>::value) {
-        std::size_t size = vec.size() * bytes_size(vec.back());
-        consumer((uint8_t*)vec.data(), size);
+    if constexpr(is_memcpy_serializable<T>::value) {
+        if(size > 0) {
+            consumer((uint8_t*)vec.data(), size * sizeof(T));
+        }
     } else {
         for(const auto& e : vec) {
             post_object(consumer, e);
@@ -827,10 +924,18 @@ std::size_t to_bytes(const T& t, uint8_t* buffer) {
 
 template <typename T>
 std::size_t to_bytes(const std::vector<T>& vec, uint8_t* buffer) {
-    int vector_size = vec.size();
+    assert(vec.size() <= static_cast<std::size_t>(std::numeric_limits<vector_size_t>::max()));
+    vector_size_t vector_size = vec.size();
     std::size_t bsize = to_bytes(vector_size, buffer);
-    for (const auto& e: vec) {
-        bsize += to_bytes(e,buffer+bsize);
+    if constexpr(is_memcpy_serializable<T>::value) {
+        if(vector_size > 0) {
+            std::memcpy(buffer + bsize, vec.data(), vector_size * sizeof(T));
+            bsize += vector_size * sizeof(T);
+        }
+    } else {
+        for (const auto& e: vec) {
+            bsize += to_bytes(e,buffer+bsize);
+        }
     }
     return bsize;
 }
@@ -1156,21 +1261,25 @@ from_bytes(DeserializationManager* ctx, uint8_t const* buffer) {
     using member = typename T::value_type;
     if constexpr(std::is_same<bool, member>::value) {
         return boolvec_from_bytes<T>(ctx, buffer);
-    } else if constexpr(std::is_pod<member>::value && !std::is_same<bool, member>::value) {
-        member const* const start = (member*)(buffer + sizeof(int));
-        const int size = ((int*)buffer)[0];
-        return std::unique_ptr<T>{new T{start, start + size}};
+    } else if constexpr(is_memcpy_serializable<member>::value) {
+        vector_size_t size;
+        std::memcpy(&size, buffer, sizeof(size));
+        member const* const start = (member const*)(buffer + sizeof(size));
+        return std::unique_ptr<T>{new T(start, start + size)};
     } else {
-        int size = ((int*)buffer)[0];
-        auto* buffer2 = buffer + sizeof(int);
+        vector_size_t size;
+        std::memcpy(&size, buffer, sizeof(size));
+        auto* buffer2 = buffer + sizeof(size);
         std::size_t accumulated_offset = 0;
-        std::unique_ptr<T> accum{new T()};
-        for(int i = 0; i < size; ++i) {
+        // T could be const std::vector, but we don't want to create a const vector here
+        auto accum = std::make_unique<std::remove_cv_t<T>>();
+        accum->reserve(size);
+        for(vector_size_t i = 0; i < size; ++i) {
             std::unique_ptr<member> item = from_bytes<member>(ctx, buffer2 + accumulated_offset);
             accumulated_offset += bytes_size(*item);
             accum->push_back(*item);
         }
-        return accum;
+        return std::unique_ptr<T>{accum.release()};
     }
 }
 
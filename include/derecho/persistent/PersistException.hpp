@@ -46,6 +46,8 @@ namespace persistent {
 #define PERSIST_EXP_INV_OBJNAME PERSIST_EXP(33, 0)
 #define PERSIST_EXP_REMOVE_FILE(x) PERSIST_EXP(34, (x))
 #define PERSIST_EXP_SHA256_HASH(x) PERSIST_EXP(35, (x))
+#define PERSIST_EXP_IO_URING(x) PERSIST_EXP(36, (x))
+#define PERSIST_EXP_OLD_LOG_FORMAT(x) PERSIST_EXP(37, (x))
 }
 
 #endif  //PERSISTENT_EXCEPTION_HPP
@@ -10,6 +10,7 @@
 #include "derecho/utils/logger.hpp"
 #include "detail/FilePersistLog.hpp"
 #include "detail/PersistLog.hpp"
+#include "detail/UringPersistLog.hpp"
 
 #include <functional>
 #include <inttypes.h>
@@ -103,6 +104,18 @@ public:
     /** Make a new version capturing the current state of the object. */
     void makeVersion(version_t ver, const HLC& mhlc);
 
+    /**
+     * Make a version for each of a run of updates, applying each update just
+     * before its version is made. Equivalent to calling apply_update and then
+     * makeVersion() for each update in turn, but walks the registry once for
+     * the whole run.
+     * @param num_updates The number of updates in the run
+     * @param apply_update Applies the update at an index in the run, and
+     * returns its version and its timestamp in microseconds
+     */
+    void makeVersions(std::size_t num_updates,
+                      const std::function<std::pair<version_t, uint64_t>(std::size_t)>& apply_update);
+
     /**
      * Returns the minumum of the latest version across all Persistent fields.
      * This is effectively the "current version" of the object, since all the
@@ -316,7 +329,10 @@ protected:
 // persisted for each update in the form of a byte array called the DELTA. Each
 // time Persistent<T> tries to make a version, it collects the DELTA from T and
 // writes it to the log. Upon reloading data from persistent storage, the DELTAs in
-// the log entries are applied in order. TODO: use checkpointing to accelerate it!
+// the log entries are applied in order. If PERS/snapshot_interval is set, a full
+// serialized copy of T is saved every 'snapshot_interval' log entries, and a
+// historical state is rebuilt from the nearest snapshot at or before it, applying
+// only the DELTAs after the snapshot.
 //
 // There are three methods included in this interface:
 // - 'finalizeCurrentDelta'     This method is called when Persistent<T> wants to
@@ -548,8 +564,9 @@ public:
      * (const ObjectType&). Please note that due to zero copy design, this object may not be accessible anymore after
      * it returns.
      *
-     * A note for ObjectType implementing IDeltaSupport<> interface: a history state will be reconstructed from the very
-     * first log entry, making it extremely inefficient. @TODO: use cached checkpoint to accelerate it.
+     * A note for ObjectType implementing IDeltaSupport<> interface: a history state will be reconstructed from the
+     * nearest snapshot at or before idx, or from the very first log entry if there is no such snapshot. Please set
+     * PERS/snapshot_interval to enable snapshots.
      *
      * @param idx   index
      * @param fun   the user function to process a const ObjectType& object
@@ -980,6 +997,16 @@ public:
      */
     virtual void version(version_t ver);
 
+    /**
+     * startPersist(version_t)
+     *
+     * Start persisting log entries up to the specified version, without
+     * waiting for them to be persisted.
+     *
+     * @param latest_version The version to persist up to
+     */
+    virtual void startPersist(version_t latest_version);
+
     /**
      * persist(version_t)
      *
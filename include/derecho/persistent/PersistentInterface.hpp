@@ -70,6 +70,12 @@ public:
      * @param verifier The Verifier to update
      */
     virtual void updateVerifier(version_t version, openssl::Verifier& verifier) = 0;
+    /**
+     * Starts persisting versions up to the provided version without waiting
+     * for them; a following call to persist() waits for them.
+     * @param version The highest version number to persist
+     */
+    virtual void startPersist(version_t version) = 0;
     /**
      * Persists versions to persistent storage, up to the provided version.
      * @param version The highest version number to persist
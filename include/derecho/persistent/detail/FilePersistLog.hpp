@@ -4,8 +4,12 @@
 #include "PersistLog.hpp"
 #include "util.hpp"
 #include <derecho/utils/logger.hpp>
+#include <map>
 #include <pthread.h>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace persistent {
 
@@ -13,11 +17,18 @@ namespace persistent {
 #define LOG_FILE_SUFFIX "log"
 #define DATA_FILE_SUFFIX "data"
 #define SWAP_FILE_SUFFIX "swp"
+#define SNAPSHOT_FILE_SUFFIX "snap"
 //Every log entry will be padded out to this size, which must be page-aligned
 #define MAX_LOG_ENTRY_SIZE (64)
 //Similarly, the size of a meta header must be page-aligned
 #define META_HEADER_SIZE (256)
 
+// snapshot file header format: the serialized object follows the header.
+struct SnapshotHeader {
+    int64_t ver;    // version of the log entry the snapshot corresponds to
+    uint64_t size;  // length of the serialized object
+};
+
 // meta header format
 union MetaHeader {
     struct {
@@ -52,15 +63,25 @@ union LogEntry {
     uint8_t bytes[MAX_LOG_ENTRY_SIZE];
 };
 
-// TODO: make this hard-wired number configurable.
-// Currently, we allow 1M(2^20-1) log entries and
-// 512GB data size. The max log entry and max size are
-// both from the configuration file:
+// The log entries and the data live in two ring buffers in the virtual memory. The initial capacity of the rings is
+// from the configuration file:
 // CONF_PERS_MAX_LOG_ENTRY - "PERS/max_log_entry"
 // CONF_PERS_MAX_DATA_SIZE - "PERS/max_data_size"
+// A ring that fills up is moved to a reservation twice as large, so the capacity of each log grows on demand with no
+// upper bound. The rings only reserve address space: nothing but the mapped segments takes memory.
+// The rings are backed by fixed-size segment files, which are created when the tail of the log reaches them and
+// deleted when the log is trimmed past them. So only the live part of the log takes disk space. The segment sizes are
+// from the configuration file:
+// CONF_PERS_LOG_SEGMENT_ENTRIES - "PERS/log_segment_entries"
+// CONF_PERS_DATA_SEGMENT_SIZE - "PERS/data_segment_size"
+// Segment N of the log (or data) is mapped to slot (N % number of slots) of the ring. Each ring has one more slot than
+// its capacity needs, so that the partially used segments at both ends of the log never share a slot.
 #define MAX_LOG_ENTRY (this->m_iMaxLogEntry)
 #define MAX_LOG_SIZE (sizeof(LogEntry) * MAX_LOG_ENTRY)
 #define MAX_DATA_SIZE (this->m_iMaxDataSize)
+#define LOG_SEGMENT_ENTRIES (this->m_iLogSegmentEntries)
+#define LOG_SEGMENT_SIZE (sizeof(LogEntry) * LOG_SEGMENT_ENTRIES)
+#define DATA_SEGMENT_SIZE (this->m_iDataSegmentSize)
 #define META_SIZE (sizeof(MetaHeader))
 
 // helpers:
@@ -69,7 +90,7 @@ union LogEntry {
 
 #define NUM_USED_SLOTS (m_currMetaHeader.fields.tail - m_currMetaHeader.fields.head)
 // #define NUM_USED_SLOTS_PERS   (m_persMetaHeader.tail - m_persMetaHeader.head)
-#define NUM_FREE_SLOTS (MAX_LOG_ENTRY - 1 - NUM_USED_SLOTS)
+#define NUM_FREE_SLOTS ((int64_t)(MAX_LOG_ENTRY - LOG_SEGMENT_ENTRIES) - NUM_USED_SLOTS)
 // #define NUM_FREE_SLOTS_PERS   (MAX_LOG_ENTRY - 1 - NUM_USERD_SLOTS_PERS)
 
 #define LOG_ENTRY_AT(idx) (LOG_ENTRY_ARRAY + (int)((idx) % MAX_LOG_ENTRY))
@@ -85,7 +106,7 @@ union LogEntry {
 #define NEXT_DATA_PERS ((NEXT_LOG_ENTRY > NEXT_LOG_ENTRY_PERS) ? LOG_ENTRY_DATA(NEXT_LOG_ENTRY_PERS) : NULL)
 
 #define NUM_USED_BYTES ((NUM_USED_SLOTS == 0) ? 0 : (LOG_ENTRY_AT(CURR_LOG_IDX)->fields.ofst + LOG_ENTRY_AT(CURR_LOG_IDX)->fields.sdlen - LOG_ENTRY_AT(m_currMetaHeader.fields.head)->fields.ofst))
-#define NUM_FREE_BYTES (MAX_DATA_SIZE - NUM_USED_BYTES)
+#define NUM_FREE_BYTES (MAX_DATA_SIZE - DATA_SEGMENT_SIZE - NUM_USED_BYTES)
 
 #define PAGE_SIZE (getpagesize())
 #define ALIGN_TO_PAGE(x) ((void*)(((uint64_t)(x)) - ((uint64_t)(x)) % PAGE_SIZE))
@@ -105,24 +126,43 @@ protected:
     const std::string m_sDataPath;
     // full meta file name
     const std::string m_sMetaFile;
-    // full log file name
+    // full log file name, the prefix of the log segment files
     const std::string m_sLogFile;
-    // full data file name
+    // full data file name, the prefix of the data segment files
     const std::string m_sDataFile;
-    // max number of log entry
-    const uint64_t m_iMaxLogEntry;
-    // max data size
-    const uint64_t m_iMaxDataSize;
-
-    // the log file descriptor
-    int m_iLogFileDesc;
-    // the data file descriptor
-    int m_iDataFileDesc;
+    // number of log entries in a log segment
+    const uint64_t m_iLogSegmentEntries;
+    // size of a data segment
+    const uint64_t m_iDataSegmentSize;
+    // number of log entries in the log ring, which grows with the log, protected by m_rwlock
+    uint64_t m_iMaxLogEntry;
+    // size of the data ring, which grows with the log, protected by m_rwlock
+    uint64_t m_iMaxDataSize;
+    // number of log entries between two snapshots, 0 for no snapshot.
+    const uint64_t m_iSnapshotInterval;
+    // snapshots: version --> log index, protected by m_rwlock
+    std::map<version_t, int64_t> m_snapshots;
+    // snapshots still in their swap files, waiting for persist() to sync and rename them, protected by m_rwlock
+    std::set<version_t> m_unsyncedSnapshots;
+
+    // mapped log segments: segment number --> file descriptor, protected by m_rwlock
+    std::map<int64_t, int> m_logSegments;
+    // mapped data segments: segment number --> file descriptor, protected by m_rwlock
+    std::map<int64_t, int> m_dataSegments;
 
     // memory mapped Log RingBuffer
     void* m_pLog;
     // memory mapped Data RingBuffer
     void* m_pData;
+    // a ring buffer replaced by a larger one
+    struct RetiredRing {
+        void* ring;
+        uint64_t ring_size;
+    };
+    // The rings replaced by larger ones. Readers may still use pointers to the entries in them, so they stay mapped
+    // until the log is destroyed; the segments are cleared from them as the log is trimmed. Protected by m_rwlock.
+    std::vector<RetiredRing> m_retiredLogRings;
+    std::vector<RetiredRing> m_retiredDataRings;
     // read/write lock
     pthread_rwlock_t m_rwlock;
     // persistent lock
@@ -175,6 +215,26 @@ protected:
     // FPL_PERS_LOCK is acquired.
     virtual void persistMetaHeaderAtomically(MetaHeader*);
 
+    /**
+     * Get the range of the log segments and the data segments holding the log entries in [head, tail).
+     * Note: no lock protected, use FPL_RDLOCK
+     * @PARAM head the first log index
+     * @PARAM tail the log index after the last one
+     * @PARAM log_first,log_last the first and the last log segment; log_first > log_last if there is none.
+     * @PARAM data_first,data_last the first and the last data segment; data_first > data_last if there is none.
+     */
+    void getSegmentRange(int64_t head, int64_t tail,
+                         int64_t& log_first, int64_t& log_last,
+                         int64_t& data_first, int64_t& data_last);
+
+    /**
+     * Fsync the snapshots written by addSnapshot() since the last call and rename them from their swap files to
+     * their final names. persist() calls this, so that the delivery thread taking a snapshot does not wait for
+     * the disk.
+     * Note: lock protected, don't hold FPL_RDLOCK/FPL_WRLOCK
+     */
+    void syncSnapshots();
+
 public:
     //Constructor
     FilePersistLog(const std::string& name, const std::string& dataPath, bool enableSignatures);
@@ -205,6 +265,10 @@ public:
                               bool preLocked = false) override;
     virtual void processEntryAtVersion(version_t ver, const std::function<void(const void*, std::size_t)>& func) override;
     virtual void addSignature(version_t ver, const uint8_t* signature, version_t previous_signed_version) override;
+    virtual void addSnapshot(version_t ver, const void* pdata, uint64_t size) override;
+    virtual bool isSnapshotDue() override;
+    virtual int64_t getSnapshotIndex(int64_t idx) override;
+    virtual bool processSnapshotAtIndex(int64_t idx, const std::function<void(const void*, std::size_t)>& func) override;
     virtual bool getSignature(version_t ver, uint8_t* signature, version_t& previous_signed_version) override;
     virtual bool getSignatureByIndex(int64_t index, uint8_t* signature, version_t& prev_ver) override;
     virtual void trimByIndex(int64_t eno) override;
@@ -236,6 +300,7 @@ public:
         idx = binarySearch<TKey>(keyGetter, key, m_currMetaHeader.fields.head, m_currMetaHeader.fields.tail);
         if(idx != INVALID_INDEX) {
             m_currMetaHeader.fields.head = (idx + 1);
+            removeTrimmedSnapshots();
             FPL_PERS_LOCK;
             try {
                 // What version number should be supplied to persist in this case?
@@ -245,15 +310,13 @@ public:
                 // it.
                 version_t ver = LOG_ENTRY_AT(CURR_LOG_IDX)->fields.ver;
                 persist(ver, true);
+                releaseSegments();
             } catch(uint64_t e) {
                 FPL_UNLOCK;
                 FPL_PERS_UNLOCK;
                 throw e;
             }
             FPL_PERS_UNLOCK;
-            //TODO:remove delete entries from the index. This is tricky because
-            // HLC order and idex order does not agree with each other.
-            // throw PERSIST_EXP_UNIMPLEMENTED;
         } else {
             FPL_UNLOCK;
             return;
@@ -272,11 +335,142 @@ private:
     /** verify the existence of the meta file */
     bool checkOrCreateMetaFile();
 
-    /** verify the existence of the log file */
-    bool checkOrCreateLogFile();
+    /**
+     * An HLC as an (rtc, logic) pair, which orders like HLC. The binary searches over HLCs use it as their key, since
+     * constructing an HLC initializes a spinlock and destroying it destroys the spinlock.
+     */
+    using HLCKey = std::pair<uint64_t, uint64_t>;
+
+    /**
+     * Set the HLC of a new log entry at the tail. getHLCIndex() binary searches the HLCs in the log, so they must grow
+     * with the log index, but the versions of a subgroup are timestamped by their senders, whose clocks disagree. An
+     * entry timestamped no later than the previous one gets the previous timestamp with the logical component advanced.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void setLogEntryHLC(LogEntry* ple, uint64_t hlc_r, uint64_t hlc_l);
+
+    /**
+     * Apply the rule of setLogEntryHLC() to the loaded log, whose HLCs may be out of order if it was written by an
+     * older build. The repair goes to the mapped segments without a flush, which is safe because redoing it after a
+     * crash gives the same HLCs.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void repairLogEntryHLCs();
+
+    /** get the file name of a log or data segment */
+    std::string getSegmentFileName(const std::string& prefix, int64_t seg) const;
+
+    /**
+     * Map a segment file to its slots in a ring buffer.
+     * Note: no lock protected, use FPL_WRLOCK
+     * @PARAM prefix m_sLogFile or m_sDataFile
+     * @PARAM segments m_logSegments or m_dataSegments
+     * @PARAM ring m_pLog or m_pData
+     * @PARAM ring_size size of the ring buffer
+     * @PARAM seg_size size of a segment
+     * @PARAM seg the segment number
+     * @PARAM create whether to create the segment file if it does not exist.
+     */
+    void mapSegment(const std::string& prefix, std::map<int64_t, int>& segments,
+                    void* ring, uint64_t ring_size, uint64_t seg_size, int64_t seg, bool create);
+
+    /**
+     * Unmap a segment from a ring buffer and from the rings it replaced, and delete its file.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void unmapSegment(const std::string& prefix, std::map<int64_t, int>& segments,
+                      void* ring, uint64_t ring_size, uint64_t seg_size, int64_t seg,
+                      const std::vector<RetiredRing>& retired);
+
+    /**
+     * Reserve the address space of a ring buffer of ring_size bytes, which is mapped twice.
+     * @RETURN the address of the ring
+     */
+    void* reserveRing(uint64_t ring_size);
+
+    /**
+     * Move a ring buffer to a new reservation of at least min_size bytes, doubling its size, and map its segments
+     * there. The old ring is added to 'retired'. Does nothing if the ring is large enough.
+     * Note: no lock protected, use FPL_WRLOCK
+     * @PARAM segments m_logSegments or m_dataSegments
+     * @PARAM ring m_pLog or m_pData, updated to the new ring
+     * @PARAM ring_size the current size of the ring, a multiple of seg_size
+     * @PARAM seg_size size of a segment
+     * @PARAM min_size the size the ring needs
+     * @PARAM retired m_retiredLogRings or m_retiredDataRings
+     * @RETURN the new size of the ring
+     */
+    uint64_t growRing(std::map<int64_t, int>& segments, void*& ring, uint64_t ring_size, uint64_t seg_size,
+                      uint64_t min_size, std::vector<RetiredRing>& retired);
+
+    /**
+     * Grow the rings, if needed, to make room for a new log entry with 'size' bytes of data at the tail.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void ensureCapacity(uint64_t size);
+
+    /**
+     * Whether the log and data files of the format before segments, <name>.log and <name>.data, exist.
+     */
+    bool hasOldLogFormat() const;
+
+    /**
+     * Copy the live part of a log in the format before segments into segment files, then delete the old files. The
+     * old log and data rings are single files, sized by the configuration they were written with. The meta header
+     * format did not change. A crash during the migration leaves the old files, so the migration starts over.
+     * Note: no lock protected, use FPL_WRLOCK and FPL_PERS_LOCK
+     */
+    void migrateOldLogFormat();
+
+    /**
+     * Make sure the segments for a new log entry at the tail, whose data is at [ofst, ofst + len), are mapped.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void ensureSegments(uint64_t ofst, uint64_t len);
+
+    /**
+     * Unmap and delete the segments outside of the current log. This must happen after the meta header of the
+     * current log is persisted, so that a crash never leaves a persisted log pointing at a deleted segment.
+     * Note: no lock protected, use FPL_WRLOCK and FPL_PERS_LOCK
+     */
+    void releaseSegments();
+
+    /**
+     * Delete the segment files of this log outside of the mapped segments, for example those left behind by a crash.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void removeStaleSegmentFiles();
+
+    /** get the snapshot file name for a version */
+    std::string getSnapshotFileName(version_t ver) const;
+
+    /**
+     * get the file currently holding the snapshot of a version, which is its swap file until syncSnapshots()
+     * renames it.
+     * Note: no lock protected, use FPL_RDLOCK
+     */
+    std::string getSnapshotPath(version_t ver) const;
 
-    /** verify the existence of the data file */
-    bool checkOrCreateDataFile();
+    /**
+     * Scan the data path for the snapshots of this log and index them. Snapshots
+     * not matching a log entry, for example those taken beyond the persisted
+     * part of the log before a crash, are removed.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void loadSnapshots();
+
+    /**
+     * Remove the snapshots whose log entries have been trimmed.
+     * Note: no lock protected, use FPL_WRLOCK
+     */
+    void removeTrimmedSnapshots();
+
+    /**
+     * Remove the snapshots strictly newer than a version.
+     * Note: no lock protected, use FPL_WRLOCK
+     * @PARAM ver the latest version whose snapshot is kept.
+     */
+    void removeSnapshotsAfter(version_t ver);
 
     /**
      * Get the minimum index greater than a given version
@@ -308,6 +502,14 @@ private:
      * @RETURN the number of bytes posted.
      */
     size_t postLogEntry(const std::function<void(uint8_t const* const, std::size_t)>& f, const LogEntry* ple);
+    /**
+     * send a range of the data segments with file_range_poster, one piece per
+     * segment file. Each segment's file descriptor is duplicated under
+     * FPL_RDLOCK, so a concurrent trim can't close it while it is being sent.
+     * @PARAM ofst - the offset of the range in the data
+     * @PARAM len - the length of the range
+     */
+    void postDataFromSegments(uint64_t ofst, uint64_t len);
     /**
      * merge the log entry to current state.
      * Note: no lock protected, use FPL_WRLOCK
@@ -363,7 +565,6 @@ private:
     }
 
     /* Validate the log before we append. It will throw exception if
-     * - there is no space
      * - the version is not monotonic
      * @param size: size of the data to be append in this log entry
      * @param ver: version of the new log entry
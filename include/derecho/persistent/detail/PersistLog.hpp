@@ -11,9 +11,9 @@
 #include <functional>
 #include <inttypes.h>
 #include <map>
-#include <set>
 #include <stdio.h>
 #include <string>
+#include <sys/types.h>
 
 namespace persistent {
 
@@ -27,30 +27,13 @@ enum StorageType {
 constexpr version_t INVALID_VERSION = -1L;
 constexpr int64_t INVALID_INDEX = INT64_MAX;
 
-// index entry for the hlc index
-struct hlc_index_entry {
-    HLC hlc;
-    int64_t log_idx;
-    //default constructor
-    hlc_index_entry() : log_idx(-1) {
-    }
-    // constructor with hlc and index.
-    hlc_index_entry(const HLC& _hlc, const int64_t& _log_idx) : hlc(_hlc), log_idx(_log_idx) {
-    }
-    // constructor with time stamp and index.
-    hlc_index_entry(const uint64_t& r, const uint64_t& l, const int64_t& _log_idx) : hlc(r, l), log_idx(_log_idx) {
-    }
-    //copy constructor
-    hlc_index_entry(const struct hlc_index_entry& _entry) : hlc(_entry.hlc), log_idx(_entry.log_idx) {
-    }
-};
-// comparator for the hlc index
-struct hlc_index_entry_comp {
-    bool operator()(const struct hlc_index_entry& e1,
-                    const struct hlc_index_entry& e2) const {
-        return e1.hlc < e2.hlc;
-    }
-};
+/**
+ * A function that sends a range of a file in place of posting its bytes.
+ * @param fd The file, which stays open until the function returns
+ * @param offset The offset of the range in the file
+ * @param size The length of the range, in bytes
+ */
+using FileRangePoster = std::function<void(int fd, off_t offset, std::size_t size)>;
 
 /**
  * Persistent log interface.
@@ -66,11 +49,6 @@ public:
      * on the configured private key. It is 0 if signatures are disabled.
      */
     const uint32_t signature_size;
-    // HLCIndex
-    std::set<hlc_index_entry, hlc_index_entry_comp> hidx;
-#ifndef NDEBUG
-    void dump_hidx();
-#endif  //NDEBUG
     /**
      * Constructor.
      * Remark: A subclass's constructor should check the persistent storage to
@@ -120,7 +98,8 @@ public:
      */
     virtual int64_t getVersionIndex(version_t ver, bool exact = false) = 0;
 
-    // Get the Index corresponding to an HLC timestamp
+    // Get the Index corresponding to an HLC timestamp, that is, the latest log entry whose HLC is equal to or
+    // earlier than hlc. The HLCs of a log grow with the log index.
     virtual int64_t getHLCIndex(const HLC& hlc) = 0;
 
     // Get the version corresponding to an HLC timestamp
@@ -146,6 +125,8 @@ public:
     // @param ver - version requested
     // @param exact - ask for the exact version
     // @return the pointer to the data, nullptr if exact is true and no corresponding version are found.
+    //         The pointer stays valid until the entry is trimmed; use processEntryAtVersion() to read an entry that
+    //         may be trimmed concurrently.
     virtual const void* getEntry(version_t ver, bool exact = false) = 0;
 
     // Get the latest version - deprecated.
@@ -156,11 +137,20 @@ public:
     /**
      * process the entry at exactly version @ver
      * if such a version does not exist, nothing will happen.
+     * The entry is not trimmed while func runs, so func must not trim the log.
      * @param ver - the specified version
      * @param func - the function to run on the entry
      */
     virtual void processEntryAtVersion(version_t ver, const std::function<void(const void*, std::size_t)>& func) = 0;
 
+    /**
+     * Start persisting the log till specified version without waiting for it.
+     * A following persist() call waits for it. Backends that can't persist
+     * asynchronously do nothing here and do all the work in persist().
+     * @param version - the version to persist up to
+     */
+    virtual void startPersist(version_t version) {}
+
     /**
      * Persist the log till specified version
      * @return - the version till which has been persisted.
@@ -211,6 +201,42 @@ public:
      * invalid or signatures are disabled.
      */
     virtual bool getSignatureByIndex(int64_t index, uint8_t* signature, version_t& prev_ver) = 0;
+    /**
+     * Store a full serialized snapshot of the object next to the log entry at
+     * version ver. Reads of a delta-based object can start from a snapshot
+     * instead of replaying the log from the earliest entry. The snapshot can
+     * be read right away, but it is only made durable by the next persist(),
+     * so the caller does not wait for the disk.
+     * @param ver - version of an existing log entry the snapshot corresponds to
+     * @param pdata - serialized object state at version ver
+     * @param size - length of the serialized state
+     */
+    virtual void addSnapshot(version_t ver, const void* pdata, uint64_t size) = 0;
+
+    /**
+     * Check if enough log entries have been appended since the latest snapshot
+     * that a new snapshot should be taken, according to PERS/snapshot_interval.
+     * @return true if the caller should add a snapshot for the latest version.
+     */
+    virtual bool isSnapshotDue() = 0;
+
+    /**
+     * Get the index of the latest log entry, equal or earlier than idx, that
+     * has a snapshot.
+     * @param idx - log index
+     * @return the index of the snapshotted log entry, or INVALID_INDEX if
+     * there is no snapshot at or before idx.
+     */
+    virtual int64_t getSnapshotIndex(int64_t idx) = 0;
+
+    /**
+     * Process the snapshot at exactly log index idx.
+     * @param idx - the log index returned by getSnapshotIndex()
+     * @param func - the function to run on the serialized snapshot
+     * @return true if the snapshot is found and processed, otherwise false.
+     */
+    virtual bool processSnapshotAtIndex(int64_t idx, const std::function<void(const void*, std::size_t)>& func) = 0;
+
     /**
      * Trim the log till entry number eno, inclusively.
      * For exmaple, there is a log: [7,8,9,4,5,6]. After trim(3), it becomes [5,6]
@@ -255,6 +281,25 @@ public:
                              version_t ver)
             = 0;
 
+    /**
+     * Set a function that post_object() will send the data of log entries with,
+     * straight from the files holding them, instead of posting their bytes to
+     * its serialization function. It is stored in a thread-local variable, so
+     * it only applies to post_object() calls on this thread, and only to the
+     * data of entries of at least min_size bytes. The file ranges are sent in
+     * the order their bytes would have been posted. Logs that do not keep
+     * their entries in files post the bytes as usual.
+     * @param poster The function that sends a file range
+     * @param min_size The size of the smallest entry data to send with poster
+     */
+    static void setFileRangePoster(const FileRangePoster& poster, std::size_t min_size);
+
+    /**
+     * Clear the function set by setFileRangePoster(), so that post_object()
+     * on this thread posts all of the bytes to its serialization function.
+     */
+    static void resetFileRangePoster() noexcept(true);
+
     /**
      * Check/Merge the LogTail to the existing log.
      * @PARAM dsm - deserialization manager
@@ -267,6 +312,12 @@ public:
      * @param ver - all log entry strictly after ver will be truncated.
      */
     virtual void truncate(version_t ver) = 0;
+
+protected:
+    // The function set by setFileRangePoster(), if any
+    static thread_local FileRangePoster file_range_poster;
+    // The size of the smallest entry data to send with file_range_poster
+    static thread_local std::size_t file_range_min_size;
 };
 }  // namespace persistent
 
@@ -81,7 +81,7 @@ inline void Persistent<ObjectType, storageType>::initialize_log(const char* obje
     switch(storageType) {
         // file system
         case ST_FILE:
-            this->m_pLog = std::make_unique<FilePersistLog>(object_name, enable_signatures);
+            this->m_pLog = createFilePersistLog(object_name, getPersFilePath(), enable_signatures);
             if(this->m_pLog == nullptr) {
                 throw PERSIST_EXP_NEW_FAILED_UNKNOWN;
             }
@@ -277,10 +277,21 @@ std::unique_ptr<ObjectType> Persistent<ObjectType, storageType>::getByIndex(
         int64_t idx,
         mutils::DeserializationManager* dm) const {
     if constexpr(std::is_base_of<IDeltaSupport<ObjectType>, ObjectType>::value) {
-        // ObjectType* ot = new ObjectType{};
-        std::unique_ptr<ObjectType> p = ObjectType::create(dm);
-        // TODO: accelerate this by checkpointing
-        for(int64_t i = this->m_pLog->getEarliestIndex(); i <= idx; i++) {
+        std::unique_ptr<ObjectType> p;
+        int64_t i = this->m_pLog->getEarliestIndex();
+        // start from the nearest snapshot at or before idx, if there is one.
+        const int64_t snapshot_idx = this->m_pLog->getSnapshotIndex(idx);
+        if(snapshot_idx != INVALID_INDEX) {
+            this->m_pLog->processSnapshotAtIndex(snapshot_idx, [&p, dm](const void* data, std::size_t) {
+                p = mutils::from_bytes<ObjectType>(dm, reinterpret_cast<const uint8_t*>(data));
+            });
+        }
+        if(p) {
+            i = snapshot_idx + 1;
+        } else {
+            p = ObjectType::create(dm);
+        }
+        for(; i <= idx; i++) {
             const uint8_t* entry_data = (const uint8_t*)this->m_pLog->getEntryByIndex(i);
             p->applyDelta(entry_data);
         }
@@ -528,12 +539,21 @@ template <typename ObjectType,
 void Persistent<ObjectType, storageType>::set(ObjectType& v, version_t ver, const HLC& mhlc) {
     dbg_default_trace("append to log with ver({}),hlc({},{})", ver, mhlc.m_rtc_us, mhlc.m_logic);
     if constexpr(std::is_base_of<IDeltaSupport<ObjectType>, ObjectType>::value) {
+        bool appended = false;
         v.finalizeCurrentDelta([&](uint8_t const* const buf, size_t len) {
             // will not create a log for versions without data change.
             if (len > 0) {
                 this->m_pLog->append((const void* const)buf, len, ver, mhlc);
+                appended = true;
             }
         });
+        // save a full snapshot periodically so that history reads do not replay the whole log.
+        if(appended && this->m_pLog->isSnapshotDue()) {
+            auto size = mutils::bytes_size(v);
+            std::unique_ptr<uint8_t[]> buf = std::make_unique<uint8_t[]>(size);
+            mutils::to_bytes(v, buf.get());
+            this->m_pLog->addSnapshot(ver, buf.get(), size);
+        }
     } else {
         // ObjectType does not support Delta, logging the whole current state.
         auto size = mutils::bytes_size(v);
@@ -629,6 +649,12 @@ void Persistent<ObjectType, storageType>::updateVerifier(version_t ver, openssl:
     });
 }
 
+template <typename ObjectType,
+          StorageType storageType>
+void Persistent<ObjectType, storageType>::startPersist(version_t ver) {
+    this->m_pLog->startPersist(ver);
+}
+
 template <typename ObjectType,
           StorageType storageType>
 version_t Persistent<ObjectType, storageType>::persist(version_t ver) {
@@ -0,0 +1,135 @@
+#ifndef URING_PERSIST_LOG_HPP
+#define URING_PERSIST_LOG_HPP
+
+#include "FilePersistLog.hpp"
+
+#include <memory>
+#include <string>
+
+#ifdef HAS_LIBURING
+#include <condition_variable>
+#include <liburing.h>
+#include <map>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace persistent {
+
+#define PERS_LOG_BACKEND_FILE "file"
+#define PERS_LOG_BACKEND_IO_URING "io_uring"
+
+/**
+ * Create the file system-based log for a Persistent<T> with storage type ST_FILE. The implementation is chosen by
+ * CONF_PERS_LOG_BACKEND: "file" gives a FilePersistLog, "io_uring" gives a UringPersistLog if the library was built
+ * with liburing, and falls back to FilePersistLog with a warning otherwise. Both backends use the same on-disk format.
+ * @param name the object name
+ * @param dataPath the directory holding the log files
+ * @param enableSignatures whether the log reserves space for signatures
+ */
+std::unique_ptr<PersistLog> createFilePersistLog(const std::string& name,
+                                                 const std::string& dataPath,
+                                                 bool enableSignatures);
+
+#ifdef HAS_LIBURING
+
+// Maximum number of persist() calls whose flushes can be in flight on one log at the same time.
+#define URING_MAX_INFLIGHT_FLUSHES (8)
+// Submission queue entries reserved per flush: a range sync per log and data segment touched, usually one or two
+// each. A flush touching more segments is submitted in several batches.
+#define URING_SQES_PER_FLUSH (4)
+
+/**
+ * UringPersistLog keeps the mmapped data, log and meta files of FilePersistLog, but replaces the synchronous
+ * msync(MS_SYNC) in persist() with asynchronous flushes submitted to an io_uring:
+ *
+ * 1) the dirty ranges of the log and data segments are synced with IORING_OP_FSYNC range syncs, which run
+ *    concurrently, also with the syncs of other flushes;
+ * 2) once a flush and all flushes before it have completed, the meta header of the latest of them is written to
+ *    the swap file, synced, and renamed over the meta file, as FilePersistLog does.
+ *
+ * startPersist() submits a flush without waiting for it, so the flushes of several versions, or of the several
+ * Persistent<T> fields of an object, can be in flight before persist() waits for the latest one. Completed flushes
+ * are retired in submission order, so the persisted meta header never goes backwards.
+ */
+class UringPersistLog : public FilePersistLog {
+protected:
+    // an in-flight flush
+    struct InflightFlush {
+        // the meta header to persist once this flush is retired
+        MetaHeader header;
+        // number of submitted operations that have not completed yet
+        uint32_t pending;
+        // the first error reported by an operation of this flush, 0 if none.
+        int error;
+    };
+    // a dirty range of a segment file
+    struct SegmentRange {
+        int fd;
+        uint64_t offset;
+        uint64_t length;
+    };
+    // the io_uring, its submission and completion queues are protected by m_uringMutex
+    struct io_uring m_ring;
+    // protects m_ring, m_inflight, m_flushErrors, m_submittedMetaHeader, m_nextTicket, m_retiredTicket, m_bReaping,
+    // and writes to m_persMetaHeader.
+    std::mutex m_uringMutex;
+    // signaled whenever flushes are retired or the reaper steps down
+    std::condition_variable m_uringCv;
+    // ticket --> in-flight flush, in submission order
+    std::map<uint64_t, InflightFlush> m_inflight;
+    // ticket --> error of retired flushes that failed, picked up by the waiting persist() call
+    std::map<uint64_t, int> m_flushErrors;
+    // the meta header of the latest submitted flush
+    MetaHeader m_submittedMetaHeader;
+    // ticket of the next flush
+    uint64_t m_nextTicket;
+    // all flushes with a ticket smaller than this one have been retired
+    uint64_t m_retiredTicket;
+    // true if a thread is waiting on the completion queue
+    bool m_bReaping;
+
+    // Persist the meta header after the in-flight flushes are retired; we assume FPL_PERS_LOCK is acquired.
+    virtual void persistMetaHeaderAtomically(MetaHeader*) override;
+    // Write the meta header to the swap file, sync it, and rename it over the meta file; we assume m_uringMutex is
+    // acquired. Return 0 on success, the errno of the failed call otherwise.
+    int writeMetaHeader(const MetaHeader& header);
+    // Submit a flush of everything appended since the last submitted flush, if anything; we assume FPL_PERS_LOCK
+    // and FPL_RDLOCK are acquired. FPL_RDLOCK is released on return.
+    void submitFlush(std::unique_lock<std::mutex>& lck);
+
+    // Append the ranges of the segment files covering [start, end) of the log or the data to 'ranges'.
+    // We assume FPL_RDLOCK is acquired.
+    void getSegmentRanges(const std::map<int64_t, int>& segments, uint64_t seg_size,
+                          uint64_t start, uint64_t end, std::vector<SegmentRange>& ranges);
+    // Get a submission queue entry, submitting the queued ones if the queue is full; we assume m_uringMutex is
+    // acquired.
+    struct io_uring_sqe* getSqe();
+    // Consume the available completions and retire the finished flushes in order; we assume m_uringMutex is
+    // acquired.
+    void processCompletions();
+    // Fail the in-flight flushes after a failed one, and start the next flush from the persisted meta header; we
+    // assume m_uringMutex is acquired.
+    void failFlushes(int error);
+    // Wait until every flush with a ticket smaller than or equal to 'ticket' is retired.
+    void waitForFlushes(std::unique_lock<std::mutex>& lck, uint64_t ticket);
+
+public:
+    //Constructor
+    UringPersistLog(const std::string& name, const std::string& dataPath, bool enableSignatures);
+    UringPersistLog(const std::string& name, bool enableSignatures) : UringPersistLog(name, getPersFilePath(), enableSignatures){};
+    //Destructor
+    virtual ~UringPersistLog() noexcept(true);
+
+    //Derived from FilePersistLog
+    virtual version_t getLastPersistedVersion() override;
+    virtual void startPersist(version_t ver) override;
+    virtual version_t persist(version_t ver,
+                              bool preLocked = false) override;
+};
+
+#endif  // HAS_LIBURING
+
+}  // namespace persistent
+
+#endif  // URING_PERSIST_LOG_HPP
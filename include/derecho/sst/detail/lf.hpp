@@ -11,6 +11,7 @@
 #include "derecho/core/detail/connection_manager.hpp"
 #include "derecho/utils/logger.hpp"
 
+#include <cstddef>
 #include <iostream>
 #include <map>
 #include <rdma/fabric.h>
@@ -328,10 +329,13 @@ void filter_external_to(const std::vector<node_id_t>& live_nodes_list);
 void lf_initialize(const std::map<uint32_t, std::pair<ip_addr_t, uint16_t>>& internal_ip_addrs_and_ports,
                    const std::map<uint32_t, std::pair<ip_addr_t, uint16_t>>& external_ip_addrs_and_ports,
                    uint32_t node_id);
-/** Polls for completion of a single posted remote write. 
- * @return a pair: <completion_entry_index,<remote_id,result(1/0)>>
+/** The largest number of completion entries the polling thread reads from the completion queue at once. */
+constexpr std::size_t max_completions_per_poll = 64;
+/** Polls for completion of posted remote writes, reading up to max_completions of them at once.
+ * @return the number of completions written to the array, each a pair: <completion_entry_index,<remote_id,result(1/0)>>
  */
-std::pair<uint32_t, std::pair<int32_t, int32_t>> lf_poll_completion();
+std::size_t lf_poll_completions(std::pair<uint32_t, std::pair<int32_t, int32_t>>* completions,
+                                std::size_t max_completions);
 /** Shutdown the polling thread. */
 void shutdown_polling_thread();
 /** Destroys the global libfabric resources. */
@@ -1,39 +1,87 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
-#include <optional>
-#include <list>
-#include <map>
+#include <cstdint>
 #include <mutex>
-#include <thread>
+#include <optional>
+#include <utility>
 #include <vector>
 
 namespace sst {
 namespace util {
+/**
+ * Routes the completion entries read by the polling thread to the threads
+ * waiting for them. Each waiting thread owns a completion slot, whose index
+ * it puts in the ce_idx field of the sender contexts of the requests it posts;
+ * the polling thread appends each completion to the slot named by its
+ * context, and the owner takes it from there, both without locking.
+ */
 class PollingData {
-    // static std::vector<std::list<std::pair<int32_t, int32_t>>> completion_entries;
-    // static std::map<std::thread::id, uint32_t> tid_to_index;
-    // static std::vector<bool> if_waiting;
-    // static std::condition_variable poll_cv;
-    // static std::mutex poll_mutex;
-    // static bool check_waiting();
-
-    std::vector<std::list<std::pair<int32_t, int32_t>>> completion_entries;
-    std::map<std::thread::id, uint32_t> tid_to_index;
-    std::vector<bool> if_waiting;
+public:
+    /** The largest number of threads that can own a completion slot at once. */
+    static constexpr uint32_t max_waiting_threads = 4096;
+    /** The largest number of completions that can be queued for one thread. */
+    static constexpr uint32_t slot_capacity = 1024;
+
+private:
+    /**
+     * A single-producer, single-consumer ring of completion entries. Only the
+     * polling thread adds entries, and only the owning thread removes them.
+     */
+    struct CompletionSlot {
+        std::array<std::pair<int32_t, int32_t>, slot_capacity> entries;
+        /** The number of entries ever removed, written by the owning thread */
+        alignas(64) std::atomic<uint64_t> head{0};
+        /** The number of entries ever added, written by the polling thread */
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::atomic<bool> waiting{false};
+    };
+
+    /** Slots by index; a slot is allocated the first time its index is handed
+     * out and reused by later threads once its owner exits. */
+    std::array<std::atomic<CompletionSlot*>, max_waiting_threads> slots{};
+    /** Protects num_slots and free_indices. */
+    std::mutex slot_allocation_mutex;
+    uint32_t num_slots = 0;
+    /** Indices of slots whose owning threads have exited. */
+    std::vector<uint32_t> free_indices;
+
+    /** The number of slots whose owners are waiting for completions. */
+    std::atomic<uint32_t> num_waiting{0};
+    std::atomic<bool> poller_sleeping{false};
     std::condition_variable poll_cv;
     std::mutex poll_mutex;
-    bool check_waiting();
+
+    uint32_t allocate_index();
+    void release_index(uint32_t index);
+    friend struct SlotOwner;
+
 public:
+    ~PollingData();
+
+    /**
+     * Queues a completion entry for the thread that owns the slot with the
+     * given index. Must only be called by the polling thread.
+     */
     void insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce);
 
-    std::optional<std::pair<int32_t, int32_t>> get_completion_entry(const std::thread::id id);
+    /**
+     * Takes the oldest completion entry queued for the slot with the given
+     * index, if there is one. Must only be called by the slot's owner.
+     */
+    std::optional<std::pair<int32_t, int32_t>> get_completion_entry(uint32_t index);
 
-    uint32_t get_index(const std::thread::id id);
+    /**
+     * @return The index of the calling thread's completion slot, which is
+     * assigned on the thread's first call and given up when the thread exits.
+     */
+    uint32_t get_index();
 
-    void set_waiting(const std::thread::id id);
+    void set_waiting(uint32_t index);
 
-    void reset_waiting(const std::thread::id id);
+    void reset_waiting(uint32_t index);
 
     void wait_for_requests();
 };
@@ -9,6 +9,7 @@
 #include "../sst.hpp"
 
 #include "../predicates.hpp"
+#include "derecho/utils/time.h"
 #include "poll_utils.hpp"
 
 #include <chrono>
@@ -30,6 +31,11 @@ namespace sst {
 template <typename DerivedSST>
 SST<DerivedSST>::~SST() {
     thread_shutdown = true;
+    {
+        // Taking the lock ensures the predicate thread is either waiting or has not checked thread_shutdown yet
+        std::lock_guard<std::mutex> lock(wakeup_mutex);
+    }
+    wakeup_cv.notify_all();
     for(auto& thread : background_threads) {
         if(thread.joinable()) thread.join();
     }
@@ -57,6 +63,11 @@ void SST<DerivedSST>::start_predicate_evaluation() {
  * trigger functions for each predicate that fires. In addition, it
  * continuously evaluates named functions one by one, and updates the local
  * row's observed values of those functions.
+ *
+ * When no trigger fires, the thread keeps evaluating predicates in a busy loop
+ * for predicate_spin_ns, then yields the CPU between passes for
+ * predicate_yield_ns, and then blocks for up to predicate_block_ns between
+ * passes until notify_predicate_thread() wakes it up.
  */
 template <typename DerivedSST>
 void SST<DerivedSST>::detect() {
@@ -65,8 +76,9 @@ void SST<DerivedSST>::detect() {
         std::unique_lock<std::mutex> lock(thread_start_mutex);
         thread_start_cv.wait(lock, [this]() { return thread_start; });
     }
-    struct timespec last_time, cur_time;
-    clock_gettime(CLOCK_REALTIME, &last_time);
+    uint64_t last_trigger_time = get_time();
+    // The time the thread resumed evaluation after blocking, or 0 if a trigger has fired since then
+    uint64_t wake_time = 0;
 
     while(!thread_shutdown) {
         bool predicate_fired = false;
@@ -75,11 +87,11 @@ void SST<DerivedSST>::detect() {
 
         // one time predicates need to be evaluated only until they become true
         for(auto& pred : predicates.one_time_predicates) {
-            if(pred != nullptr && (pred->first(*derived_this) == true)) {
+            if(pred != nullptr && (pred->evaluate(*derived_this) == true)) {
                 predicate_fired = true;
                 // Copy the trigger pointer locally, so it can continue running without
                 // segfaulting even if this predicate gets deleted when we unlock predicates_lock
-                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
+                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->trigger);
                 predicates_lock.unlock();
                 (*trigger)(*derived_this);
                 predicates_lock.lock();
@@ -90,9 +102,9 @@ void SST<DerivedSST>::detect() {
 
         // recurrent predicates are evaluated each time they are found to be true
         for(auto& pred : predicates.recurrent_predicates) {
-            if(pred != nullptr && (pred->first(*derived_this) == true)) {
+            if(pred != nullptr && (pred->evaluate(*derived_this) == true)) {
                 predicate_fired = true;
-                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
+                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->trigger);
                 predicates_lock.unlock();
                 (*trigger)(*derived_this);
                 predicates_lock.lock();
@@ -106,11 +118,11 @@ void SST<DerivedSST>::detect() {
         while(pred_it != predicates.transition_predicates.end()) {
             if(*pred_it != nullptr) {
                 //*pred_state_it is the previous state of the predicate at *pred_it
-                bool curr_pred_state = (*pred_it)->first(*derived_this);
+                bool curr_pred_state = (*pred_it)->evaluate(*derived_this);
                 if(curr_pred_state == true && *pred_state_it == false) {
                     predicate_fired = true;
                     std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(
-                            (*pred_it)->second);
+                            (*pred_it)->trigger);
                     predicates_lock.unlock();
                     (*trigger)(*derived_this);
                     predicates_lock.lock();
@@ -123,17 +135,46 @@ void SST<DerivedSST>::detect() {
         }
 
         if(predicate_fired) {
-            // update last time
-            clock_gettime(CLOCK_REALTIME, &last_time);
+            last_trigger_time = get_time();
+            if(wake_time != 0) {
+                wake_to_trigger_latency.record(last_trigger_time - wake_time);
+                wake_time = 0;
+            }
+            if(predicate_thread_blocked) {
+                // The thread announced it would block, but found work on its last pass
+                std::lock_guard<std::mutex> wakeup_lock(wakeup_mutex);
+                predicate_thread_blocked = false;
+                wakeup_pending = false;
+            }
         } else {
-            clock_gettime(CLOCK_REALTIME, &cur_time);
-            // check if the system has been inactive for enough time to induce sleep
-            double time_elapsed_in_ms = (cur_time.tv_sec - last_time.tv_sec) * 1e3
-                                        + (cur_time.tv_nsec - last_time.tv_nsec) / 1e6;
-            if(time_elapsed_in_ms > 1) {
+            // check if the system has been inactive for enough time to back off
+            const uint64_t idle_time = get_time() - last_trigger_time;
+            if(idle_time < predicate_spin_ns) {
+                continue;
+            } else if(idle_time < predicate_spin_ns + predicate_yield_ns) {
+                predicates_lock.unlock();
+                std::this_thread::yield();
+                predicates_lock.lock();
+            } else if(!predicate_thread_blocked) {
+                // Announce that the thread is about to block, then evaluate the predicates once more:
+                // a put() that does not see the announcement changed the row before that last pass.
+                predicate_thread_blocked = true;
+                // Pairs with the fence in notify_predicate_thread(): without it, the row reads of the
+                // last pass could be reordered before the store, and both sides could miss each other
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            } else {
                 predicates_lock.unlock();
-                using namespace std::chrono_literals;
-                std::this_thread::sleep_for(1ms);
+                {
+                    std::unique_lock<std::mutex> wakeup_lock(wakeup_mutex);
+                    wakeup_cv.wait_for(wakeup_lock, std::chrono::nanoseconds(predicate_block_ns),
+                                       [this]() { return wakeup_pending || thread_shutdown; });
+                    wake_time = get_time();
+                    if(wakeup_pending) {
+                        notify_to_wake_latency.record(wake_time - last_notify_time);
+                        wakeup_pending = false;
+                    }
+                    predicate_thread_blocked = false;
+                }
                 predicates_lock.lock();
             }
         }
@@ -141,6 +182,24 @@ void SST<DerivedSST>::detect() {
     }
 }
 
+template <typename DerivedSST>
+void SST<DerivedSST>::notify_predicate_thread() {
+    // Orders the caller's row update before the load of predicate_thread_blocked. Pairs with the
+    // fence after the predicate thread sets predicate_thread_blocked and before its last pass.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!predicate_thread_blocked) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeup_mutex);
+        if(!wakeup_pending) {
+            wakeup_pending = true;
+            last_notify_time = get_time();
+        }
+    }
+    wakeup_cv.notify_one();
+}
+
 template <typename DerivedSST>
 void SST<DerivedSST>::put(const std::vector<uint32_t> receiver_ranks, size_t offset, size_t size) {
     assert(offset + size <= rowLen);
@@ -152,7 +211,7 @@ void SST<DerivedSST>::put(const std::vector<uint32_t> receiver_ranks, size_t off
         // perform a remote RDMA write on the owner of the row
         res_vec[index]->post_remote_write(offset, size);
     }
-    return;
+    notify_predicate_thread();
 }
 
 template <typename DerivedSST>
@@ -161,11 +220,10 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
     unsigned int num_writes_posted = 0;
     std::vector<bool> posted_write_to(num_members, false);
 
-    const auto tid = std::this_thread::get_id();
     // get id first
-    uint32_t ce_idx = util::polling_data.get_index(tid);
+    uint32_t ce_idx = util::polling_data.get_index();
 
-    util::polling_data.set_waiting(tid);
+    util::polling_data.set_waiting(ce_idx);
 #ifdef USE_VERBS_API
     verbs_sender_ctxt sctxt[receiver_ranks.size()];
 #else
@@ -203,7 +261,7 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
 
         while(true) {
             // check if polling result is available
-            ce = util::polling_data.get_completion_entry(tid);
+            ce = util::polling_data.get_completion_entry(ce_idx);
             if(ce) {
                 break;
             }
@@ -237,7 +295,8 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
         }
     }
 
-    util::polling_data.reset_waiting(tid);
+    util::polling_data.reset_waiting(ce_idx);
+    notify_predicate_thread();
 
     for(auto index : failed_node_indexes) {
         freeze(index);
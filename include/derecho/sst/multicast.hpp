@@ -4,8 +4,10 @@
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
+#include <deque>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <thread>
@@ -49,8 +51,66 @@ class multicast_group {
     // maximum size that the SST can send
     const uint64_t max_msg_size;
 
+    // whether messages are packed contiguously in a byte ring instead of fixed-size slots
+    const bool packed;
+    // size of each sender's ring, in the packed layout
+    const uint64_t ring_size;
+    // marks the end of the used part of the ring: the next record starts at offset 0
+    static constexpr uint64_t wrap_marker = std::numeric_limits<uint64_t>::max();
+
+    // a message in the packed ring: a length word followed by the message, padded to 8 bytes
+    struct packed_record {
+        // where the bytes to push start: the wrap marker if the record wrapped around, otherwise start
+        uint64_t push_start;
+        uint64_t start;
+        uint64_t end;
+    };
+    // the records of the messages from finished_multicasts_num + 1 to queued_num, in order
+    std::deque<packed_record> packed_records;
+    // where the next record will be written in the ring
+    uint64_t write_offset = 0;
+    // where the next record of each sender will be read, in the senders' rings
+    std::vector<uint64_t> read_offsets;
+
     std::thread timeout_thread;
 
+    static uint64_t padded_record_size(uint64_t msg_size) {
+        return (sizeof(uint64_t) + msg_size + alignTo - 1) & ~(uint64_t)(alignTo - 1);
+    }
+
+    /**
+     * Reserves room for a record of record_size bytes in the ring, after the
+     * record of the last queued message, writing a wrap marker if the record
+     * has to go back to the start of the ring.
+     * @return False if the ring does not have enough free room.
+     */
+    bool allocate_packed_record(uint64_t record_size) {
+        volatile uint8_t* ring = &sst->slots[my_row][slots_offset];
+        const uint64_t tail = packed_records.empty() ? write_offset : packed_records.front().push_start;
+        packed_record record;
+        if(packed_records.empty() || write_offset > tail) {
+            // the free room is [write_offset, ring_size) and [0, tail)
+            if(write_offset + record_size <= ring_size) {
+                record = {write_offset, write_offset, write_offset + record_size};
+            } else if(record_size <= tail || (packed_records.empty() && record_size <= ring_size)) {
+                if(write_offset + sizeof(uint64_t) <= ring_size) {
+                    (uint64_t&)ring[write_offset] = wrap_marker;
+                }
+                record = {write_offset, 0, record_size};
+            } else {
+                return false;
+            }
+        } else if(write_offset + record_size <= tail) {
+            // the free room is [write_offset, tail)
+            record = {write_offset, write_offset, write_offset + record_size};
+        } else {
+            return false;
+        }
+        packed_records.push_back(record);
+        write_offset = record.end;
+        return true;
+    }
+
     void initialize() {
         for(auto i : row_indices) {
             for(uint j = num_received_offset; j < num_received_offset + num_senders; ++j) {
@@ -67,7 +127,8 @@ public:
                     std::vector<int> is_sender = {},
                     uint32_t num_received_offset = 0,
                     uint32_t slots_offset = 0,
-                    int32_t index_offset = 0)
+                    int32_t index_offset = 0,
+                    bool packed = false)
             : my_row(sst->get_local_index()),
               sst(sst),
               row_indices(row_indices),
@@ -83,7 +144,9 @@ public:
               slots_offset(slots_offset),
               num_members(row_indices.size()),
               window_size(window_size),
-              max_msg_size(max_msg_size + sizeof(uint64_t)) {
+              max_msg_size(max_msg_size + sizeof(uint64_t)),
+              packed(packed),
+              ring_size(packed_ring_size(window_size, max_msg_size)) {
         // find my_member_index
         for(uint i = 0; i < num_members; ++i) {
             if(row_indices[i] == my_row) {
@@ -104,15 +167,34 @@ public:
         if(!this->is_sender[my_member_index]) {
             my_sender_index = -1;
         }
+        read_offsets.resize(num_senders, 0);
         initialize();
     }
 
+    /**
+     * The size of each sender's region of the slots field when messages are
+     * packed in a ring. It holds a full window of maximum-size messages plus
+     * the room wasted at the end of the ring when a record wraps around, so
+     * the window of messages bounds the ring's usage just like with slots.
+     * @param window_size The number of messages in the window
+     * @param max_msg_size The maximum size of a message
+     */
+    static uint64_t packed_ring_size(uint32_t window_size, uint64_t max_msg_size) {
+        return (window_size + 1) * padded_record_size(max_msg_size);
+    }
+
     volatile uint8_t* get_buffer(uint64_t msg_size) {
         assert(my_sender_index >= 0);
         std::lock_guard<std::mutex> lock(msg_send_mutex);
         assert(msg_size <= max_msg_size);
         while(true) {
-            if(queued_num - finished_multicasts_num < window_size) {
+            if(packed && queued_num - finished_multicasts_num < window_size
+               && allocate_packed_record(padded_record_size(msg_size))) {
+                queued_num++;
+                volatile uint8_t* record = &sst->slots[my_row][slots_offset + packed_records.back().start];
+                (uint64_t&)record[0] = msg_size;
+                return record + sizeof(uint64_t);
+            } else if(!packed && queued_num - finished_multicasts_num < window_size) {
                 queued_num++;
                 uint32_t slot = queued_num % window_size;
                 // set size appropriately
@@ -126,9 +208,12 @@ public:
                 }
                 if(finished_multicasts_num == min_multicast_num) {
                     return nullptr;
-                } else {
-                    finished_multicasts_num = min_multicast_num;
                 }
+                // every member received these messages, so their records can be overwritten
+                for(; packed && finished_multicasts_num < min_multicast_num; ++finished_multicasts_num) {
+                    packed_records.pop_front();
+                }
+                finished_multicasts_num = min_multicast_num;
             }
         }
     }
@@ -148,6 +233,10 @@ public:
             sst->put(sst->index, index_offset);
             return;
         }
+        if(packed) {
+            send_packed(committed_index, ready_to_be_sent);
+            return;
+        }
 
         uint32_t first_slot = (committed_index - ready_to_be_sent + 1) % window_size;
         uint64_t size_to_push;
@@ -172,15 +261,77 @@ public:
              first_null_index, header_size);
     }
 
+    /**
+     * Pushes the records of the messages from committed_index -
+     * ready_to_be_sent + 1 to committed_index, then the index. Only the bytes
+     * of the records are pushed, rather than whole slots.
+     */
+    void send_packed(uint32_t committed_index, uint32_t ready_to_be_sent) {
+        // byte ranges of the ring to push, merged when contiguous
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;
+        auto add_range = [&ranges](uint64_t start, uint64_t end) {
+            if(!ranges.empty() && ranges.back().second == start) {
+                ranges.back().second = end;
+            } else {
+                ranges.emplace_back(start, end);
+            }
+        };
+        {
+            // get_buffer may be adding or releasing records
+            std::lock_guard<std::mutex> lock(msg_send_mutex);
+            // In a shard of one member, the messages may have been received and released already
+            const long long int first_message = std::max((long long int)committed_index - ready_to_be_sent + 1,
+                                                         finished_multicasts_num + 1);
+            for(long long int message = first_message; message <= committed_index; ++message) {
+                const packed_record& record = packed_records[message - finished_multicasts_num - 1];
+                if(record.push_start != record.start && record.push_start + sizeof(uint64_t) <= ring_size) {
+                    add_range(record.push_start, record.push_start + sizeof(uint64_t));
+                }
+                add_range(record.start, record.end);
+            }
+        }
+        const uint64_t ring_offset = (uint8_t*)std::addressof(sst->slots[0][slots_offset]) - sst->getBaseAddress();
+        for(const auto& range : ranges) {
+            sst->put(ring_offset + range.first, range.second - range.first);
+        }
+        sst->put(sst->index, index_offset);
+    }
+
+    /**
+     * Reads the next message of a sender from its ring, in the packed layout.
+     * Messages must be read in order, after the sender's index shows they
+     * were sent.
+     * @param sender_row The SST row of the sender
+     * @param sender_index The rank of the sender among the senders
+     * @param msg_size Set to the size of the message
+     * @return A pointer to the message in the SST
+     */
+    volatile uint8_t* get_packed_message(uint32_t sender_row, uint32_t sender_index, uint64_t& msg_size) {
+        uint64_t& offset = read_offsets[sender_index];
+        volatile uint8_t* ring = &sst->slots[sender_row][slots_offset];
+        if(offset + sizeof(uint64_t) > ring_size || (uint64_t&)ring[offset] == wrap_marker) {
+            offset = 0;
+        }
+        msg_size = (uint64_t&)ring[offset];
+        volatile uint8_t* msg = ring + offset + sizeof(uint64_t);
+        offset += padded_record_size(msg_size);
+        return msg;
+    }
+
     void debug_print() {
         using std::cout;
         using std::endl;
-        cout << "Printing slots::size" << endl;
-        for(auto i : row_indices) {
-            for(uint j = 0; j < window_size; ++j) {
-                cout << (uint64_t&)sst->slots[i][slots_offset + (max_msg_size * (j + 1)) - sizeof(uint64_t)] << " ";
+        if(packed) {
+            cout << "Packed ring: write offset " << write_offset << ", "
+                 << packed_records.size() << " records in use" << endl;
+        } else {
+            cout << "Printing slots::size" << endl;
+            for(auto i : row_indices) {
+                for(uint j = 0; j < window_size; ++j) {
+                    cout << (uint64_t&)sst->slots[i][slots_offset + (max_msg_size * (j + 1)) - sizeof(uint64_t)] << " ";
+                }
+                cout << endl;
             }
-            cout << endl;
         }
         cout << "Printing num_received_sst" << endl;
         for(auto i : row_indices) {
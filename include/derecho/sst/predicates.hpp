@@ -1,11 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <utility>
-
+#include <vector>
 
 namespace sst {
 
@@ -24,11 +27,94 @@ enum class PredicateType {
     TRANSITION
 };
 
+/**
+ * A range of SST memory that a predicate reads, usually one row's element (or
+ * elements) of an SST field; see SSTField::input() and SSTFieldVector::input().
+ */
+struct PredicateInput {
+    const volatile uint8_t* address;
+    std::size_t size;
+};
+
+/**
+ * A registered predicate and its trigger, along with the SST memory the
+ * predicate declared it reads, if any.
+ */
 template <class DerivedSST>
-class Predicates {
+class PredicateEntry {
+public:
     using pred = std::function<bool(const DerivedSST&)>;
     using trig = std::function<void(DerivedSST&)>;
-    using pred_list = std::list<std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>>;
+
+    pred predicate;
+    std::shared_ptr<trig> trigger;
+
+private:
+    std::vector<PredicateInput> inputs;
+    /** A copy of the inputs as they were at the last evaluation */
+    std::vector<uint8_t> input_snapshot;
+    bool last_result;
+
+    /**
+     * Compares the inputs with their snapshot, and copies them to the snapshot
+     * if they differ.
+     * @return True if the inputs have not changed since the last call.
+     */
+    bool inputs_unchanged() {
+        if(!input_snapshot.empty()) {
+            const uint8_t* snapshot = input_snapshot.data();
+            bool unchanged = true;
+            for(const PredicateInput& input : inputs) {
+                if(std::memcmp(snapshot, const_cast<const uint8_t*>(input.address), input.size) != 0) {
+                    unchanged = false;
+                    break;
+                }
+                snapshot += input.size;
+            }
+            if(unchanged) {
+                return true;
+            }
+        }
+        input_snapshot.clear();
+        for(const PredicateInput& input : inputs) {
+            const uint8_t* bytes = const_cast<const uint8_t*>(input.address);
+            input_snapshot.insert(input_snapshot.end(), bytes, bytes + input.size);
+        }
+        return false;
+    }
+
+public:
+    PredicateEntry(pred predicate, trig trigger, std::vector<PredicateInput> inputs)
+            : predicate(std::move(predicate)),
+              trigger(std::make_shared<trig>(std::move(trigger))),
+              inputs(std::move(inputs)),
+              last_result(false) {}
+
+    /**
+     * Evaluates the predicate. A predicate that declared its inputs and was
+     * false at its last evaluation is not called again until its inputs change,
+     * so it must not become true because of anything else than its inputs and
+     * its own trigger.
+     */
+    bool evaluate(const DerivedSST& sst) {
+        if(inputs.empty()) {
+            return predicate(sst);
+        }
+        // The snapshot is refreshed before the predicate runs, so that a change
+        // made while it runs is seen at the next evaluation.
+        if(inputs_unchanged() && !last_result) {
+            return false;
+        }
+        last_result = predicate(sst);
+        return last_result;
+    }
+};
+
+template <class DerivedSST>
+class Predicates {
+    using pred = typename PredicateEntry<DerivedSST>::pred;
+    using trig = typename PredicateEntry<DerivedSST>::trig;
+    using pred_list = std::list<std::unique_ptr<PredicateEntry<DerivedSST>>>;
     /** Predicate list for one-time predicates. */
     pred_list one_time_predicates;
     /** Predicate list for recurrent predicates */
@@ -75,6 +161,16 @@ public:
     pred_handle insert(pred predicate, trig trigger,
                        PredicateType type = PredicateType::ONE_TIME);
 
+    /**
+     * Inserts a (predicate, trigger) pair whose predicate reads only the given
+     * SST memory, apart from local state that only its own trigger changes.
+     * While the predicate is false, it is re-evaluated only when that memory
+     * changes, which saves the cost of calling it on every pass of the
+     * predicate thread.
+     */
+    pred_handle insert(pred predicate, trig trigger, PredicateType type,
+                       std::vector<PredicateInput> inputs);
+
     /** Inserts a predicate with a list of triggers (which will be run in
      * sequence) to the appropriate predicate list. */
     pred_handle insert(pred predicate, const std::list<trig>& triggers,
@@ -105,18 +201,23 @@ public:
  */
 template <class DerivedSST>
 auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type) -> pred_handle {
+    return insert(std::move(predicate), std::move(trigger), type, {});
+}
+
+template <class DerivedSST>
+auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type,
+                                    std::vector<PredicateInput> inputs) -> pred_handle {
     std::lock_guard<std::mutex> lock(predicate_mutex);
+    auto entry = std::make_unique<PredicateEntry<DerivedSST>>(std::move(predicate), std::move(trigger),
+                                                              std::move(inputs));
     if(type == PredicateType::ONE_TIME) {
-        one_time_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
+        one_time_predicates.push_back(std::move(entry));
         return pred_handle(--one_time_predicates.end(), type);
     } else if(type == PredicateType::RECURRENT) {
-        recurrent_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
+        recurrent_predicates.push_back(std::move(entry));
         return pred_handle(--recurrent_predicates.end(), type);
     } else {
-        transition_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
+        transition_predicates.push_back(std::move(entry));
         transition_predicate_states.push_back(false);
         return pred_handle(--transition_predicates.end(), type);
     }
@@ -135,7 +236,7 @@ void Predicates<DerivedSST>::remove(pred_handle& handle) {
 template <class DerivedSST>
 void Predicates<DerivedSST>::clear() {
     std::lock_guard<std::mutex> lock(predicate_mutex);
-    using ptr_to_pred = std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>;
+    using ptr_to_pred = std::unique_ptr<PredicateEntry<DerivedSST>>;
     std::for_each(one_time_predicates.begin(), one_time_predicates.end(),
                   [](ptr_to_pred& ptr) { ptr.reset(); });
     std::for_each(recurrent_predicates.begin(), recurrent_predicates.end(),
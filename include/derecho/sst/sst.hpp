@@ -1,6 +1,7 @@
 #pragma once
 
 #include "derecho/conf/conf.hpp"
+#include "derecho/utils/latency_histogram.hpp"
 #include "predicates.hpp"
 
 #ifdef USE_VERBS_API
@@ -85,6 +86,11 @@ public:
 
     // Setter
     void operator()(const size_t row_idx, T const v) { *(T*)(base + row_idx * rowLen) = v; }
+
+    /** The memory of this field in a row, for declaring the inputs of a predicate. */
+    PredicateInput input(const size_t row_idx) const {
+        return {base + row_idx * rowLen, sizeof(T)};
+    }
 };
 
 /**
@@ -115,6 +121,14 @@ public:
     /** Just like std::vector::size(), returns the number of elements in this vector. */
     size_t size() const { return length; }
 
+    /**
+     * The memory of count consecutive elements of this vector in a row,
+     * starting at index first, for declaring the inputs of a predicate.
+     */
+    PredicateInput input(const size_t row_idx, const size_t first, const size_t count = 1) const {
+        return {base + row_idx * rowLen + first * sizeof(T), count * sizeof(T)};
+    }
+
     void __attribute__((noinline)) debug_print(size_t row_num) {
         volatile T* arr = (*this)[row_num];
         for(size_t j = 0; j < length; ++j) {
@@ -126,6 +140,14 @@ public:
 
 typedef std::function<void(uint32_t)> failure_upcall_t;
 
+/** Latency statistics of the predicate evaluation thread's wakeups. */
+struct PredicateWakeupStats {
+    /** From a notification by put() to the blocked thread resuming evaluation */
+    derecho::LatencyHistogram::Snapshot notify_to_wake;
+    /** From the thread resuming evaluation after blocking to the first trigger that fires */
+    derecho::LatencyHistogram::Snapshot wake_to_trigger;
+};
+
 /** Constructor parameter pack for SST. */
 struct SSTParams {
     const std::vector<uint32_t>& members;
@@ -231,6 +253,30 @@ private:
     /** Notified when the predicate evaluation thread should start. */
     std::condition_variable thread_start_cv;
 
+    /** How long, in nanoseconds, the predicate thread keeps evaluating
+     * predicates in a busy loop after the last trigger fired. */
+    const uint64_t predicate_spin_ns;
+    /** How long, in nanoseconds, the predicate thread then keeps evaluating
+     * predicates while yielding the CPU between passes. */
+    const uint64_t predicate_yield_ns;
+    /** After that, the longest time, in nanoseconds, that the predicate thread
+     * blocks between passes; a local put() wakes it up earlier. */
+    const uint64_t predicate_block_ns;
+    /** True while the predicate thread is about to block or is blocked on wakeup_cv. */
+    std::atomic<bool> predicate_thread_blocked;
+    /** Mutex for wakeup_cv, wakeup_pending and last_notify_time. */
+    std::mutex wakeup_mutex;
+    /** Notified to wake up the blocked predicate thread. */
+    std::condition_variable wakeup_cv;
+    /** Set by notify_predicate_thread(), cleared when the predicate thread wakes up. */
+    bool wakeup_pending;
+    /** The time of the latest notification, in nanoseconds. */
+    uint64_t last_notify_time;
+    /** Latency of the wakeups of the blocked predicate thread by notify_predicate_thread(). */
+    derecho::LatencyHistogram notify_to_wake_latency;
+    /** Latency from the predicate thread waking up after blocking to the first trigger that fires. */
+    derecho::LatencyHistogram wake_to_trigger_latency;
+
 public:
     SST(DerivedSST* derived_class_pointer, const SSTParams& params)
             : derived_this(derived_class_pointer),
@@ -243,7 +289,13 @@ public:
               row_is_frozen(num_members),
               failure_upcall(params.failure_upcall),
               res_vec(num_members),
-              thread_start(params.start_predicate_thread) {
+              thread_start(params.start_predicate_thread),
+              predicate_spin_ns(derecho::getConfUInt64(CONF_DERECHO_SST_PREDICATE_SPIN_US) * 1000),
+              predicate_yield_ns(derecho::getConfUInt64(CONF_DERECHO_SST_PREDICATE_YIELD_US) * 1000),
+              predicate_block_ns(derecho::getConfUInt64(CONF_DERECHO_SST_PREDICATE_BLOCK_US) * 1000),
+              predicate_thread_blocked(false),
+              wakeup_pending(false),
+              last_notify_time(0) {
         //Figure out my SST index
         my_index = (uint)-1;
         for(uint32_t i = 0; i < num_members; ++i) {
@@ -309,6 +361,19 @@ public:
     /** Starts the predicate evaluation loop. */
     void start_predicate_evaluation();
 
+    /**
+     * Wakes up the predicate evaluation thread if it is blocked, so that it
+     * evaluates the predicates right away. This is called by put() after the
+     * local row changes; changes made by remote writes do not generate any
+     * local event, so they are only noticed when the thread polls.
+     */
+    void notify_predicate_thread();
+
+    /** Returns the latency histograms of the predicate thread's wakeups. */
+    PredicateWakeupStats get_predicate_wakeup_stats() const {
+        return {notify_to_wake_latency.snapshot(), wake_to_trigger_latency.snapshot()};
+    }
+
     /** Does a TCP sync with each member of the SST. */
     void sync_with_members() const;
 
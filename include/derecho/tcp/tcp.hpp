@@ -5,6 +5,8 @@
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 namespace tcp {
 
@@ -165,6 +167,50 @@ public:
      */
     void write(const uint8_t* buffer, size_t size);
 
+    /**
+     * Reads from the socket into a list of buffers, filling each one completely
+     * before moving on to the next, using as few system calls as possible.
+     * @param iov An array of iovecs describing the buffers to read into
+     * @param iovcnt The number of entries in iov
+     * @throw a subclass of socket_error if there was an error before all the
+     * buffers could be filled, with the same meanings as for read().
+     */
+    void readv(const struct iovec* iov, int iovcnt);
+
+    /**
+     * Writes the contents of a list of buffers to the socket, in order, using
+     * as few system calls as possible.
+     * @param iov An array of iovecs describing the buffers to send
+     * @param iovcnt The number of entries in iov
+     * @throw a subclass of socket_error if there was an error before all the
+     * bytes could be written, with the same meanings as for write().
+     */
+    void writev(const struct iovec* iov, int iovcnt);
+
+    /**
+     * Sends size bytes of a file, starting at the given offset, without copying
+     * them through a user-space buffer. SIGPIPE is blocked in the calling
+     * thread while sending, so a peer that closes the connection is reported
+     * with an exception, as in write(), rather than a signal.
+     * @param file_fd A file descriptor open for reading, which must support
+     * mmap-like operations (i.e. a regular file)
+     * @param offset The offset in the file of the first byte to send
+     * @param size The number of bytes to send
+     * @throw a subclass of socket_error if there was an error before all size
+     * bytes could be sent, or if the file ended first.
+     */
+    void sendfile(int file_fd, off_t offset, size_t size);
+
+    /**
+     * Sets the sizes of the kernel's send and receive buffers for this socket.
+     * Large buffers let bulk transfers keep more data in flight. The kernel may
+     * adjust the sizes within its configured limits.
+     * @param send_buffer_size The size of the send buffer in bytes
+     * @param receive_buffer_size The size of the receive buffer in bytes
+     * @throw socket_io_error if the sizes could not be set
+     */
+    void set_buffer_sizes(int send_buffer_size, int receive_buffer_size);
+
     /**
      * Convenience method for sending a single POD object (e.g. an int) over
      * the socket.
@@ -0,0 +1,88 @@
+/**
+ * @file latency_histogram.hpp
+ *
+ * A histogram of latencies with power-of-two buckets, cheap enough to record
+ * on the critical path.
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace derecho {
+
+/**
+ * A histogram of latencies in nanoseconds. Bucket i counts the latencies in
+ * [2^(i-1), 2^i) ns, and bucket 0 counts latencies of 0 ns. Recording is
+ * lock-free and meant to be done by a single thread; other threads can take a
+ * snapshot at any time, which may be slightly inconsistent while records are
+ * being added.
+ */
+class LatencyHistogram {
+public:
+    static constexpr std::size_t num_buckets = 65;
+
+    /** A copy of the histogram at some point in time. */
+    struct Snapshot {
+        std::array<uint64_t, num_buckets> buckets{};
+        uint64_t count = 0;
+        uint64_t total_ns = 0;
+        uint64_t max_ns = 0;
+
+        /** @return The mean latency in nanoseconds, or 0 if nothing was recorded */
+        double mean_ns() const {
+            return count == 0 ? 0.0 : static_cast<double>(total_ns) / count;
+        }
+
+        /**
+         * @param fraction A fraction in [0, 1], e.g. 0.99 for the 99th percentile
+         * @return An upper bound of the latency at the given percentile, in
+         * nanoseconds: the upper end of the bucket it falls in.
+         */
+        uint64_t percentile_ns(double fraction) const {
+            const uint64_t rank = static_cast<uint64_t>(fraction * count);
+            uint64_t seen = 0;
+            for(std::size_t i = 0; i < num_buckets; i++) {
+                seen += buckets[i];
+                if(seen > rank) {
+                    return i == 0 ? 0 : (i >= 64 ? max_ns : (uint64_t{1} << i) - 1);
+                }
+            }
+            return max_ns;
+        }
+    };
+
+private:
+    std::array<std::atomic<uint64_t>, num_buckets> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+
+public:
+    /** Records one latency, in nanoseconds. */
+    void record(uint64_t latency_ns) {
+        const std::size_t bucket = latency_ns == 0 ? 0 : 64 - __builtin_clzll(latency_ns);
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+        if(latency_ns > max_ns.load(std::memory_order_relaxed)) {
+            max_ns.store(latency_ns, std::memory_order_relaxed);
+        }
+    }
+
+    /** @return A copy of the current state of the histogram */
+    Snapshot snapshot() const {
+        Snapshot result;
+        for(std::size_t i = 0; i < num_buckets; i++) {
+            result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        }
+        result.count = count.load(std::memory_order_relaxed);
+        result.total_ns = total_ns.load(std::memory_order_relaxed);
+        result.max_ns = max_ns.load(std::memory_order_relaxed);
+        return result;
+    }
+};
+
+}  // namespace derecho
@@ -73,9 +73,8 @@ int main() {
     resources *res = new resources(r_index, read_buf, write_buf, ROWSIZE, ROWSIZE, node_rank < r_index);
 #endif
 
-    const auto tid = std::this_thread::get_id();
     // get id first
-    uint32_t id = util::polling_data.get_index(tid);
+    uint32_t id = util::polling_data.get_index();
 
     // remotely write data from the write_buf
 #ifdef USE_VERBS_API
@@ -89,7 +88,7 @@ int main() {
     // poll for completion
     while(true)
     {
-      auto ce =  util::polling_data.get_completion_entry(tid);
+      auto ce =  util::polling_data.get_completion_entry(id);
       if (ce) break;
     }
     sync(r_index);
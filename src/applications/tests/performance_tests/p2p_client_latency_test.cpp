@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/core/derecho.hpp>
+
+#include "log_results.hpp"
+
+using derecho::ExternalClientCaller;
+using std::cout;
+using std::endl;
+
+class TestObject : public mutils::ByteRepresentable {
+    int state;
+
+public:
+    TestObject() : state(0) {}
+    TestObject(int init_state) : state(init_state) {}
+
+    int read_state() const {
+        return state;
+    }
+
+    DEFAULT_SERIALIZATION_SUPPORT(TestObject, state);
+    REGISTER_RPC_FUNCTIONS(TestObject, P2P_TARGETS(read_state));
+};
+
+struct exp_result {
+    node_id_t client_id;
+    node_id_t target_id;
+    uint32_t num_queries;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double p999_us;
+    double max_us;
+
+    void print(std::ofstream& fout) {
+        fout << client_id << " " << target_id << " " << num_queries << " "
+             << mean_us << " " << p50_us << " " << p99_us << " "
+             << p999_us << " " << max_us << endl;
+    }
+};
+
+/**
+ * Measures the latency of P2P queries sent by many external clients at once,
+ * to show whether the members serve all the clients fairly. Start num_nodes
+ * members, then any number of external clients (e.g. 100 or more processes,
+ * each with its own local_id); each client sends num_queries queries, one at
+ * a time, to the member of rank (local_id % num_nodes) and reports its own
+ * latency distribution. Comparing the tail latencies of the clients shows
+ * whether some of them are starved.
+ * Command line arguments: [derecho-config-list --] is_external num_nodes num_queries
+ */
+int main(int argc, char* argv[]) {
+    if(argc < 4 || (argc > 4 && strcmp("--", argv[argc - 4]))) {
+        cout << "Invalid command line arguments." << endl;
+        cout << "USAGE: " << argv[0] << " [ derecho-config-list -- ] is_external (0 - member, 1 - external client) num_nodes num_queries" << endl;
+        return -1;
+    }
+    derecho::Conf::initialize(argc, argv);
+    const bool is_external = std::stoi(argv[argc - 3]) != 0;
+    const uint32_t num_nodes = std::stoi(argv[argc - 2]);
+    const uint32_t num_queries = std::stoi(argv[argc - 1]);
+
+    if(!is_external) {
+        derecho::SubgroupInfo subgroup_info{derecho::DefaultSubgroupAllocator(
+                {{std::type_index(typeid(TestObject)),
+                  derecho::one_subgroup_policy(derecho::fixed_even_shards(1, num_nodes))}})};
+        auto object_factory = [](persistent::PersistentRegistry*, derecho::subgroup_id_t) {
+            return std::make_unique<TestObject>();
+        };
+        derecho::Group<TestObject> group({}, subgroup_info, {}, std::vector<derecho::view_upcall_t>{}, object_factory);
+        cout << "Finished constructing/joining Group" << endl;
+        cout << "Press enter when all the clients are finished." << endl;
+        std::cin.get();
+        group.leave(true);
+        return 0;
+    }
+
+    derecho::ExternalGroupClient<TestObject> group;
+    cout << "Finished constructing ExternalGroupClient" << endl;
+    const node_id_t my_id = derecho::getConfUInt32(CONF_DERECHO_LOCAL_ID);
+    std::vector<node_id_t> shard_members = group.get_shard_members(0, 0);
+    const node_id_t target = shard_members[my_id % shard_members.size()];
+    ExternalClientCaller<TestObject, decltype(group)>& handle = group.get_subgroup_caller<TestObject>();
+
+    std::vector<uint64_t> latencies_ns(num_queries);
+    for(uint32_t i = 0; i < num_queries; ++i) {
+        auto begin_time = std::chrono::steady_clock::now();
+        handle.p2p_send<RPC_NAME(read_state)>(target).get().get(target);
+        auto end_time = std::chrono::steady_clock::now();
+        latencies_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - begin_time).count();
+    }
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    auto percentile_us = [&latencies_ns](double fraction) {
+        const std::size_t rank = std::min(static_cast<std::size_t>(fraction * latencies_ns.size()),
+                                          latencies_ns.size() - 1);
+        return latencies_ns[rank] / 1000.0;
+    };
+    double total_ns = 0;
+    for(uint64_t latency : latencies_ns) {
+        total_ns += latency;
+    }
+    exp_result result{my_id, target, num_queries,
+                      total_ns / num_queries / 1000.0,
+                      percentile_us(0.5), percentile_us(0.99), percentile_us(0.999),
+                      latencies_ns.back() / 1000.0};
+    cout << "Client " << my_id << " -> node " << target << ": mean " << result.mean_us
+         << " us, p50 " << result.p50_us << " us, p99 " << result.p99_us
+         << " us, p99.9 " << result.p999_us << " us, max " << result.max_us << " us" << endl;
+    log_results(result, "data_p2p_client_latency_test");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "aggregate_bandwidth.hpp"
+#include "log_results.hpp"
+#include <derecho/core/derecho.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <time.h>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+using namespace derecho;
+
+struct exp_result {
+    uint32_t num_nodes;
+    uint32_t num_subgroups;
+    long long unsigned int msg_size;
+    uint32_t num_messages;
+    double ns_per_message;
+
+    void print(std::ofstream& fout) {
+        fout << num_nodes << " "
+             << num_subgroups << " "
+             << msg_size << " "
+             << num_messages << " "
+             << ns_per_message << endl;
+    }
+};
+
+/**
+ * Measures the cost per message of the multicast send path as the number of
+ * subgroups grows. Every node is a member of num_subgroups identical raw
+ * subgroups, but messages are only sent in subgroup 0, so the extra subgroups
+ * add nothing but the work the sender thread does to check them. Messages are
+ * one byte larger than the SST multicast limit, so they always go through RDMC
+ * and the sender thread. Run it with increasing num_subgroups and compare the
+ * nanoseconds per message that the leader logs.
+ */
+int main(int argc, char* argv[]) {
+    if(argc < 4 || (argc > 4 && strcmp("--", argv[argc - 4]))) {
+        cout << "Invalid command line arguments." << endl;
+        cout << "Usage:" << argv[0]
+             << "[ derecho-config-list -- ] num_nodes, num_subgroups, num_messages"
+             << endl;
+        return 1;
+    }
+    pthread_setname_np(pthread_self(), "main");
+
+    const uint num_nodes = std::stoi(argv[argc - 3]);
+    const uint num_subgroups = std::stoi(argv[argc - 2]);
+    const uint num_messages = std::stoi(argv[argc - 1]);
+
+    Conf::initialize(argc, argv);
+
+    volatile bool done = false;
+    auto stability_callback = [&num_messages,
+                               &done,
+                               &num_nodes,
+                               num_delivered = 0u](uint32_t subgroup, uint32_t sender_id,
+                                                   long long int index,
+                                                   std::optional<std::pair<uint8_t*, long long int>> data,
+                                                   persistent::version_t ver) mutable {
+        ++num_delivered;
+        if(num_delivered == num_messages * num_nodes) {
+            done = true;
+        }
+    };
+
+    auto membership_function = [num_subgroups, num_nodes](
+                                       const std::vector<std::type_index>& subgroup_type_order,
+                                       const std::unique_ptr<View>& prev_view, View& curr_view) {
+        subgroup_shard_layout_t subgroup_vector(num_subgroups);
+        auto num_members = curr_view.members.size();
+        if(num_members < num_nodes) {
+            throw subgroup_provisioning_exception();
+        }
+        for(uint i = 0; i < num_subgroups; ++i) {
+            subgroup_vector[i].emplace_back(curr_view.make_subview(curr_view.members));
+        }
+        curr_view.next_unassigned_rank = curr_view.members.size();
+        derecho::subgroup_allocation_map_t subgroup_allocation;
+        subgroup_allocation.emplace(std::type_index(typeid(RawObject)), std::move(subgroup_vector));
+        return subgroup_allocation;
+    };
+
+    SubgroupInfo raw_groups(membership_function);
+
+    Group<RawObject> group(UserMessageCallbacks{stability_callback},
+                           raw_groups, {}, std::vector<view_upcall_t>{},
+                           &raw_object_factory);
+
+    cout << "Finished constructing/joining Group" << endl;
+    auto members_order = group.get_members();
+    uint32_t node_rank = group.get_my_rank();
+
+    const long long unsigned int msg_size = getConfUInt64(CONF_SUBGROUP_DEFAULT_MAX_SMC_PAYLOAD_SIZE) + 1;
+    if(msg_size > getConfUInt64(CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE)) {
+        cout << "max_payload_size must be larger than max_smc_payload_size for this test" << endl;
+        return 1;
+    }
+    Replicated<RawObject>& raw_subgroup = group.get_subgroup<RawObject>(0);
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_REALTIME, &start_time);
+    for(uint i = 0; i < num_messages; ++i) {
+        raw_subgroup.send(msg_size, [](uint8_t* buf) {});
+    }
+    while(!done) {
+    }
+    struct timespec end_time;
+    clock_gettime(CLOCK_REALTIME, &end_time);
+    long long int nanoseconds_elapsed = (end_time.tv_sec - start_time.tv_sec) * (long long int)1e9 + (end_time.tv_nsec - start_time.tv_nsec);
+    double ns_per_message = static_cast<double>(nanoseconds_elapsed) / (num_messages * num_nodes);
+    double avg_ns_per_message = aggregate_bandwidth(members_order, members_order[node_rank], ns_per_message);
+    if(node_rank == 0) {
+        log_results(exp_result{num_nodes, num_subgroups, msg_size, num_messages, avg_ns_per_message},
+                    "data_send_path_scaling_test");
+    }
+
+    group.barrier_sync();
+    group.leave();
+}
@@ -0,0 +1,147 @@
+#include "aggregate_bandwidth.hpp"
+#include "bytes_object.hpp"
+#include "log_results.hpp"
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/core/derecho.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using std::endl;
+using test::Bytes;
+using namespace std::chrono;
+
+class TestObject {
+public:
+    void bytes_fun(const Bytes& bytes) {
+    }
+
+    REGISTER_RPC_FUNCTIONS(TestObject, ORDERED_TARGETS(bytes_fun));
+};
+
+struct exp_result {
+    int num_nodes;
+    bool zero_copy;
+    long long unsigned int msg_size;
+    unsigned int window_size;
+    uint32_t count;
+    double avg_msec;
+    double avg_gbps;
+
+    void print(std::ofstream& fout) {
+        fout << num_nodes << " " << zero_copy << " "
+             << msg_size << " " << window_size << " "
+             << count << " "
+             << avg_msec << " " << avg_gbps << endl;
+    }
+};
+
+/**
+ * Compares the bandwidth of ordered_send, which serializes its argument into
+ * a multicast buffer, with ordered_send_serialized, which sends an argument
+ * that was serialized once into registered memory owned by the sender. Every
+ * node sends count messages of the largest size that fits in max_payload_size;
+ * in zero-copy mode each node cycles through window_size registered regions,
+ * waiting for a region to be released before it reuses it.
+ * Command line arguments: [derecho-config-list --] num_nodes count zero_copy (0 or 1)
+ */
+int main(int argc, char* argv[]) {
+    if(argc < 4 || (argc > 4 && strcmp("--", argv[argc - 4]))) {
+        std::cout << "Invalid command line arguments." << std::endl;
+        std::cout << "USAGE: " << argv[0] << " [ derecho-config-list -- ] num_nodes count zero_copy (0 or 1)" << std::endl;
+        return -1;
+    }
+    derecho::Conf::initialize(argc, argv);
+    pthread_setname_np(pthread_self(), "zero_copy_bw");
+
+    const int num_nodes = std::stoi(argv[argc - 3]);
+    const uint32_t count = std::stoi(argv[argc - 2]);
+    const bool zero_copy = std::stoi(argv[argc - 1]) != 0;
+    const uint32_t window_size = derecho::getConfUInt32(CONF_SUBGROUP_DEFAULT_WINDOW_SIZE);
+
+    // The serialized Bytes object includes its size field, and the RPC message
+    // starts with an invocation ID and the RPC header
+    const std::size_t rpc_header_size = sizeof(std::size_t) + sizeof(std::size_t)
+                                        + derecho::remote_invocation_utilities::header_space();
+    const uint64_t msg_size = derecho::getConfUInt64(CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE) - rpc_header_size;
+    const uint64_t total_num_messages = static_cast<uint64_t>(count) * num_nodes;
+
+    volatile bool done = false;
+    steady_clock::time_point send_complete_time;
+    auto stability_callback = [&done, &send_complete_time, total_num_messages, num_delivered = 0u](
+                                      uint32_t, uint32_t, long long int,
+                                      std::optional<std::pair<uint8_t*, long long int>>,
+                                      persistent::version_t) mutable {
+        ++num_delivered;
+        if(num_delivered == total_num_messages) {
+            send_complete_time = steady_clock::now();
+            done = true;
+        }
+    };
+
+    derecho::SubgroupInfo subgroup_info{derecho::DefaultSubgroupAllocator(
+            {{std::type_index(typeid(TestObject)),
+              derecho::one_subgroup_policy(derecho::fixed_even_shards(1, num_nodes))}})};
+    auto factory = [](persistent::PersistentRegistry*, derecho::subgroup_id_t) { return std::make_unique<TestObject>(); };
+    derecho::Group<TestObject> group(derecho::UserMessageCallbacks{stability_callback}, subgroup_info, {},
+                                     std::vector<derecho::view_upcall_t>{}, factory);
+    std::cout << "Finished constructing/joining Group" << std::endl;
+    derecho::Replicated<TestObject>& handle = group.get_subgroup<TestObject>();
+
+    std::vector<uint8_t> payload(msg_size, 'x');
+    Bytes bytes(payload.data(), msg_size);
+
+    // For zero-copy sends: one registered region per window slot, each holding
+    // the serialized argument after the space Derecho needs for its headers
+    const std::size_t prefix_size = derecho::Replicated<TestObject>::serialized_send_prefix_size();
+    const std::size_t args_size = mutils::bytes_size(bytes);
+    std::vector<std::shared_ptr<rdma::memory_region>> regions;
+    std::unique_ptr<std::atomic<bool>[]> region_in_use(new std::atomic<bool>[window_size]);
+    if(zero_copy) {
+        for(uint32_t i = 0; i < window_size; i++) {
+            regions.emplace_back(std::make_shared<rdma::memory_region>(prefix_size + args_size));
+            mutils::to_bytes(bytes, regions.back()->buffer + prefix_size);
+            region_in_use[i] = false;
+        }
+    }
+
+    steady_clock::time_point begin_time = steady_clock::now();
+    for(uint32_t i = 0; i < count; i++) {
+        if(zero_copy) {
+            const uint32_t slot = i % window_size;
+            while(region_in_use[slot]) {
+            }
+            region_in_use[slot] = true;
+            handle.ordered_send_serialized<RPC_NAME(bytes_fun)>(
+                    regions[slot], 0, args_size,
+                    [&region_in_use, slot]() { region_in_use[slot] = false; });
+        } else {
+            handle.ordered_send<RPC_NAME(bytes_fun)>(bytes);
+        }
+    }
+    while(!done) {
+    }
+
+    int64_t nsec = duration_cast<nanoseconds>(send_complete_time - begin_time).count();
+    double thp_gbps = (static_cast<double>(total_num_messages) * msg_size) / nsec;
+    double msec = static_cast<double>(nsec) / 1000000;
+    std::cout << "timespan: " << msec << " ms, throughput: " << thp_gbps << " GB/s" << std::endl;
+
+    std::pair<double, double> bw_laten(thp_gbps, msec);
+    auto members_order = group.get_members();
+    const uint32_t node_rank = group.get_my_rank();
+    bw_laten = aggregate_bandwidth(members_order, members_order[node_rank], bw_laten);
+    if(node_rank == 0) {
+        log_results(exp_result{num_nodes, zero_copy, msg_size, window_size, count,
+                               bw_laten.second, bw_laten.first},
+                    "data_zero_copy_bw_test");
+    }
+
+    group.barrier_sync();
+    group.leave();
+}
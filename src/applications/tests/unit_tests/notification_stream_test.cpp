@@ -0,0 +1,301 @@
+/**
+ * @file notification_stream_test.cpp
+ *
+ * This program tests NotificationStream. Every process first checks that
+ * NotificationMessage::for_each_in_batch unpacks a batch message. Then the
+ * group member with the lowest ID publishes a burst of keyed updates through
+ * one stream, which must coalesce them by key and pack them into fewer P2P
+ * messages than notifications, and posts unkeyed notifications through a
+ * stream with a tiny staleness bound, which must drop them as stale. Finally
+ * it posts a notification telling the external client how many notifications
+ * were sent, and the client checks that it received exactly those, one at a
+ * time, with the latest update for every key arriving last.
+ */
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/core/derecho.hpp>
+#include <derecho/mutils-serialization/SerializationSupport.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using derecho::ExternalClientCaller;
+using derecho::NotificationMessage;
+using derecho::NotificationStream;
+using derecho::NotificationStreamOptions;
+using derecho::NotificationStreamStats;
+using std::cout;
+using std::endl;
+
+class NotifyingObject : public derecho::NotificationSupport,
+                        public mutils::ByteRepresentable {
+    // An unused field, since the serialization macros need at least one
+    uint64_t unused;
+
+public:
+    NotifyingObject(uint64_t unused = 0) : unused(unused) {}
+
+    void notify(const NotificationMessage& msg) const {
+        derecho::NotificationSupport::notify(msg);
+    }
+
+    REGISTER_RPC_FUNCTIONS(NotifyingObject, P2P_TARGETS(notify));
+    DEFAULT_SERIALIZATION_SUPPORT(NotifyingObject, unused);
+};
+
+// Notification types
+constexpr uint64_t UPDATE = 1;
+constexpr uint64_t STALE = 2;
+constexpr uint64_t DONE = 3;
+
+constexpr uint64_t num_updates = 1000;
+constexpr uint64_t num_keys = 10;
+constexpr uint64_t num_stale = 100;
+
+NotificationMessage make_notification(uint64_t type, uint64_t value) {
+    return NotificationMessage(type, reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+uint64_t get_value(const NotificationMessage& message) {
+    uint64_t value;
+    std::memcpy(&value, message.body, sizeof(value));
+    return value;
+}
+
+/**
+ * Checks that for_each_in_batch visits every notification packed into a batch
+ * message, in order, and returns the number of errors.
+ */
+int test_for_each_in_batch() {
+    std::vector<NotificationMessage> messages;
+    for(uint64_t i = 0; i < 5; ++i) {
+        // Vary the sizes so the notifications don't start at regular offsets
+        NotificationMessage message(UPDATE + i, i * 7);
+        for(std::size_t j = 0; j < message.size; ++j) {
+            message.body[j] = static_cast<uint8_t>('a' + (i + j) % 26);
+        }
+        messages.emplace_back(std::move(message));
+    }
+    std::size_t body_size = 0;
+    for(const auto& message : messages) {
+        body_size += message.bytes_size();
+    }
+    NotificationMessage batch(NotificationMessage::batch_message_type, body_size);
+    std::size_t offset = 0;
+    for(const auto& message : messages) {
+        offset += message.to_bytes(batch.body + offset);
+    }
+
+    int errors = 0;
+    std::size_t index = 0;
+    batch.for_each_in_batch([&](const NotificationMessage& message) {
+        if(index >= messages.size()) {
+            cout << "for_each_in_batch visited more notifications than were in the batch" << endl;
+            errors++;
+        } else if(message.message_type != messages[index].message_type || message.size != messages[index].size
+                  || std::memcmp(message.body, messages[index].body, message.size) != 0) {
+            cout << "for_each_in_batch notification " << index << " does not match the one packed" << endl;
+            errors++;
+        }
+        index++;
+    });
+    if(index != messages.size()) {
+        cout << "for_each_in_batch visited " << index << " notifications, expected " << messages.size() << endl;
+        errors++;
+    }
+    return errors;
+}
+
+/**
+ * Waits until a stream's counters satisfy a condition.
+ * @return false if they didn't within a few seconds
+ */
+bool wait_for_stats(NotificationStream<NotifyingObject>& stream,
+                    const std::function<bool(const NotificationStreamStats&)>& condition) {
+    for(int tries = 0; tries < 100; ++tries) {
+        if(condition(stream.get_stats())) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return false;
+}
+
+int run_member(uint32_t external_node_id, int num_nodes) {
+    derecho::SubgroupInfo subgroup_info{derecho::DefaultSubgroupAllocator(
+            {{std::type_index(typeid(NotifyingObject)),
+              derecho::one_subgroup_policy(derecho::fixed_even_shards(1, num_nodes))}})};
+    auto object_factory = [](persistent::PersistentRegistry*, derecho::subgroup_id_t) { return std::make_unique<NotifyingObject>(); };
+
+    derecho::Group<NotifyingObject> group({}, subgroup_info, {}, std::vector<derecho::view_upcall_t>{}, object_factory);
+    cout << "Finished constructing/joining Group" << endl;
+
+    int errors = 0;
+    const node_id_t my_id = derecho::getConfUInt64(CONF_DERECHO_LOCAL_ID);
+    if(my_id == group.get_members()[0]) {
+        derecho::ExternalClientCallback<NotifyingObject>& callback = group.get_client_callback<NotifyingObject>(0);
+        cout << "Waiting for the external node to connect" << endl;
+        while(!callback.has_external_client(external_node_id)) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+
+        NotificationStreamOptions options;
+        options.flush_interval = std::chrono::milliseconds(100);
+        NotificationStream<NotifyingObject> stream(callback, options);
+        stream.subscribe(external_node_id);
+        for(uint64_t i = 0; i < num_updates; ++i) {
+            stream.publish(make_notification(UPDATE, i), i % num_keys);
+        }
+        if(!wait_for_stats(stream, [](const NotificationStreamStats& stats) {
+               return stats.sent + stats.coalesced == num_updates;
+           })) {
+            cout << "Timed out waiting for the updates to be sent" << endl;
+            errors++;
+        }
+        NotificationStreamStats stats = stream.get_stats();
+        cout << "Updates: sent " << stats.sent << " in " << stats.batches_sent << " batches, coalesced "
+             << stats.coalesced << endl;
+        if(stats.coalesced == 0) {
+            cout << "Expected updates to the same key to be coalesced" << endl;
+            errors++;
+        }
+        if(stats.batches_sent >= stats.sent) {
+            cout << "Expected several updates to be packed into each batch" << endl;
+            errors++;
+        }
+        if(stats.dropped_queue_full + stats.dropped_stale + stats.dropped_disconnected != 0) {
+            cout << "Expected no updates to be dropped" << endl;
+            errors++;
+        }
+        const uint64_t updates_sent = stats.sent;
+
+        NotificationStreamOptions stale_options;
+        stale_options.flush_interval = std::chrono::milliseconds(100);
+        stale_options.max_staleness = std::chrono::microseconds(1);
+        NotificationStream<NotifyingObject> stale_stream(callback, stale_options);
+        for(uint64_t i = 0; i < num_stale; ++i) {
+            stale_stream.post(external_node_id, make_notification(STALE, i));
+        }
+        if(!wait_for_stats(stale_stream, [](const NotificationStreamStats& stats) {
+               return stats.sent + stats.dropped_stale == num_stale;
+           })) {
+            cout << "Timed out waiting for the stale notifications to be flushed" << endl;
+            errors++;
+        }
+        stats = stale_stream.get_stats();
+        cout << "Stale notifications: sent " << stats.sent << ", dropped " << stats.dropped_stale << endl;
+        if(stats.dropped_stale == 0) {
+            cout << "Expected notifications older than the staleness bound to be dropped" << endl;
+            errors++;
+        }
+
+        // Tell the client how many notifications to expect
+        stream.post(external_node_id, make_notification(DONE, updates_sent + stats.sent));
+        if(!wait_for_stats(stream, [updates_sent](const NotificationStreamStats& stats) {
+               return stats.sent == updates_sent + 1;
+           })) {
+            cout << "Timed out waiting for the final notification to be sent" << endl;
+            errors++;
+        }
+    }
+    cout << "Press enter when the external client is done." << endl;
+    std::cin.get();
+    group.leave(true);
+    return errors;
+}
+
+int run_client() {
+    auto dummy_object_factory = []() { return std::make_unique<NotifyingObject>(); };
+    derecho::ExternalGroupClient<NotifyingObject> group(dummy_object_factory);
+    cout << "Finished constructing ExternalGroupClient" << endl;
+
+    std::mutex received_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    uint64_t expected_count = 0;
+    uint64_t received_count = 0;
+    std::map<uint64_t, uint64_t> latest_update_by_key;
+    int errors = 0;
+
+    ExternalClientCaller<NotifyingObject, decltype(group)>& caller = group.get_subgroup_caller<NotifyingObject>();
+    caller.add_p2p_connection(group.get_members()[0]);
+    caller.register_notification_handler([&](const NotificationMessage& message) {
+        std::lock_guard<std::mutex> lock(received_mutex);
+        if(message.message_type == DONE) {
+            expected_count = get_value(message);
+            done = true;
+            done_cv.notify_all();
+            return;
+        }
+        received_count++;
+        if(message.message_type == UPDATE) {
+            const uint64_t value = get_value(message);
+            auto latest = latest_update_by_key.find(value % num_keys);
+            // Coalescing must not reorder the updates to a key
+            if(latest != latest_update_by_key.end() && latest->second >= value) {
+                cout << "Update " << value << " arrived after update " << latest->second << endl;
+                errors++;
+            }
+            latest_update_by_key[value % num_keys] = value;
+        } else if(message.message_type != STALE) {
+            // This includes batch messages, which should have been unpacked
+            cout << "Received a notification of unexpected type " << message.message_type << endl;
+            errors++;
+        }
+    });
+
+    cout << "Awaiting notifications." << endl;
+    std::unique_lock<std::mutex> lock(received_mutex);
+    if(!done_cv.wait_for(lock, std::chrono::seconds(60), [&]() { return done; })) {
+        cout << "Timed out waiting for the final notification" << endl;
+        return errors + 1;
+    }
+    if(received_count != expected_count) {
+        cout << "Received " << received_count << " notifications, expected " << expected_count << endl;
+        errors++;
+    }
+    // The latest update for every key is never coalesced away
+    for(uint64_t key = 0; key < num_keys; ++key) {
+        const uint64_t final_value = num_updates - num_keys + key;
+        if(latest_update_by_key[key] != final_value) {
+            cout << "The latest update received for key " << key << " is " << latest_update_by_key[key]
+                 << ", expected " << final_value << endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    const int num_args = 2;
+    if(argc < (num_args + 1) || (argc > (num_args + 1) && strcmp("--", argv[argc - (num_args + 1)]) != 0)) {
+        cout << "Invalid command line arguments." << endl;
+        cout << "USAGE:" << argv[0] << "[ derecho-config-list -- ] external_node_id num_nodes" << endl;
+        return -1;
+    }
+    derecho::Conf::initialize(argc, argv);
+    const uint32_t external_node_id = std::stoi(argv[argc - num_args]);
+    const int num_nodes = std::stoi(argv[argc - num_args + 1]);
+    const node_id_t my_id = derecho::getConfUInt64(CONF_DERECHO_LOCAL_ID);
+
+    int errors = test_for_each_in_batch();
+    if(external_node_id != my_id) {
+        errors += run_member(external_node_id, num_nodes);
+    } else {
+        errors += run_client();
+    }
+
+    if(errors > 0) {
+        cout << "FAILED with " << errors << " errors" << endl;
+        return 1;
+    }
+    cout << "PASSED" << endl;
+    return 0;
+}
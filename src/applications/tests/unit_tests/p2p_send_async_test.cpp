@@ -0,0 +1,138 @@
+/**
+ * @file p2p_send_async_test.cpp
+ *
+ * This program tests ExternalClientCaller::p2p_send_async. The group members
+ * form one subgroup whose P2P handler is deliberately slow, and the external
+ * client sends requests to one member faster than it can reply, so that the
+ * request window fills up, the client-side queue fills up, and p2p_send_async
+ * fails fast with std::nullopt. The client then waits for every request that
+ * was accepted, which only completes if the P2P listener thread drains the
+ * queue as replies free up the window, and checks the replies.
+ */
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/core/derecho.hpp>
+#include <derecho/mutils-serialization/SerializationSupport.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using derecho::ExternalClientCaller;
+using std::cout;
+using std::endl;
+
+class SlowEcho : public mutils::ByteRepresentable {
+    // How long each request takes to handle
+    uint64_t delay_ms;
+
+public:
+    SlowEcho(uint64_t delay_ms = 1) : delay_ms(delay_ms) {}
+
+    uint64_t echo(const uint64_t& value) const {
+        // Slow enough that the external client outpaces the replies
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        return value;
+    }
+
+    REGISTER_RPC_FUNCTIONS(SlowEcho, P2P_TARGETS(echo));
+    DEFAULT_SERIALIZATION_SUPPORT(SlowEcho, delay_ms);
+};
+
+int main(int argc, char** argv) {
+    const int num_args = 2;
+    if(argc < (num_args + 1) || (argc > (num_args + 1) && strcmp("--", argv[argc - (num_args + 1)]) != 0)) {
+        cout << "Invalid command line arguments." << endl;
+        cout << "USAGE:" << argv[0] << "[ derecho-config-list -- ] external_node_id num_nodes" << endl;
+        return -1;
+    }
+    derecho::Conf::initialize(argc, argv);
+    const uint32_t external_node_id = std::stoi(argv[argc - num_args]);
+    const int num_nodes = std::stoi(argv[argc - num_args + 1]);
+    const node_id_t my_id = derecho::getConfUInt64(CONF_DERECHO_LOCAL_ID);
+
+    if(external_node_id != my_id) {
+        derecho::SubgroupInfo subgroup_info{derecho::DefaultSubgroupAllocator(
+                {{std::type_index(typeid(SlowEcho)),
+                  derecho::one_subgroup_policy(derecho::fixed_even_shards(1, num_nodes))}})};
+        auto object_factory = [](persistent::PersistentRegistry*, derecho::subgroup_id_t) { return std::make_unique<SlowEcho>(); };
+
+        derecho::Group<SlowEcho> group({}, subgroup_info, {}, std::vector<derecho::view_upcall_t>{}, object_factory);
+        cout << "Finished constructing/joining Group" << endl;
+        cout << "Press enter when the external client is done." << endl;
+        std::cin.get();
+        group.leave(true);
+        return 0;
+    }
+
+    auto dummy_object_factory = []() { return std::make_unique<SlowEcho>(); };
+    derecho::ExternalGroupClient<SlowEcho> group(dummy_object_factory);
+    cout << "Finished constructing ExternalGroupClient" << endl;
+
+    ExternalClientCaller<SlowEcho, decltype(group)>& caller = group.get_subgroup_caller<SlowEcho>();
+    const node_id_t dest_node = group.get_members()[0];
+    const uint64_t window_size = derecho::getConfUInt32(CONF_DERECHO_P2P_WINDOW_SIZE);
+    const uint64_t queue_size = std::max(derecho::getConfUInt32(CONF_DERECHO_P2P_SEND_QUEUE_SIZE), 1u);
+    // Enough requests to fill both the request window and the queue
+    const uint64_t num_requests = 4 * (window_size + queue_size);
+
+    using results_t = derecho::rpc::QueryResults<uint64_t>;
+    std::vector<std::pair<uint64_t, results_t>> accepted;
+    uint64_t num_rejected = 0;
+    for(uint64_t i = 0; i < num_requests; ++i) {
+        std::optional<results_t> results = caller.p2p_send_async<RPC_NAME(echo)>(dest_node, i);
+        if(results) {
+            accepted.emplace_back(i, std::move(*results));
+        } else {
+            num_rejected++;
+        }
+    }
+    cout << "Accepted " << accepted.size() << " requests, rejected " << num_rejected << endl;
+
+    int errors = 0;
+    if(accepted.size() < window_size + queue_size) {
+        cout << "Expected at least " << window_size + queue_size
+             << " requests to be accepted (the request window plus the queue)" << endl;
+        errors++;
+    }
+    if(num_rejected == 0) {
+        cout << "Expected p2p_send_async to return std::nullopt once the queue was full" << endl;
+        errors++;
+    }
+    // The queued requests only get replies if the listener thread drains the queue
+    for(auto& request : accepted) {
+        for(auto& reply_pair : request.second.get()) {
+            const uint64_t reply = reply_pair.second.get();
+            if(reply != request.first) {
+                cout << "Request " << request.first << " got reply " << reply << endl;
+                errors++;
+            }
+        }
+    }
+    // Once everything is drained, a queue's worth of requests must be accepted again
+    accepted.clear();
+    for(uint64_t i = 0; i < queue_size; ++i) {
+        std::optional<results_t> results = caller.p2p_send_async<RPC_NAME(echo)>(dest_node, i);
+        if(!results) {
+            cout << "Request " << i << " was rejected after the queue was drained" << endl;
+            errors++;
+            break;
+        }
+        accepted.emplace_back(i, std::move(*results));
+    }
+    for(auto& request : accepted) {
+        for(auto& reply_pair : request.second.get()) {
+            reply_pair.second.get();
+        }
+    }
+
+    if(errors > 0) {
+        cout << "FAILED with " << errors << " errors" << endl;
+        return 1;
+    }
+    cout << "PASSED" << endl;
+    return 0;
+}
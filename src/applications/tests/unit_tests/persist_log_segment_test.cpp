@@ -0,0 +1,237 @@
+/**
+ * @file persist_log_segment_test.cpp
+ *
+ * This program tests the segment files and the growing ring buffers of a
+ * FilePersistLog. With tiny segments and a tiny initial capacity, it appends
+ * entries past many segments, so that both rings are grown several times while
+ * another thread reads the entries, and checks every entry. Then it trims the
+ * log, checks that the trimmed segment files are gone, and checks the entries
+ * again after the log is reloaded from disk. Finally it writes a log in the
+ * format before segments, whose ring buffers have wrapped around and whose
+ * HLCs are out of order, and checks that the log is migrated to segments and
+ * its HLCs are put in order when it is loaded.
+ */
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/persistent/detail/FilePersistLog.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace persistent;
+
+//Number of entries to append; entry i has version i, so it is also at log index i
+constexpr int num_entries = 1000;
+//The log is trimmed up to (and including) this version
+constexpr version_t trim_version = 599;
+
+std::string make_entry(version_t ver) {
+    return "entry " + std::to_string(ver) + " " + std::string(100 + (ver * 37) % 900, 'a' + (ver % 26));
+}
+
+bool file_exists(const std::string& path) {
+    struct stat sb;
+    return stat(path.c_str(), &sb) == 0;
+}
+
+/**
+ * Checks that the entries of versions first_ver to last_ver can be
+ * found by index, version and HLC, and that the trimmed ones can't, and
+ * returns the number of errors.
+ */
+int check_entries(PersistLog& log, version_t first_ver, version_t last_ver, const std::string& when) {
+    int errors = 0;
+    if(log.getEarliestIndex() != first_ver || log.getLatestIndex() != last_ver) {
+        std::cout << when << ": the log holds indexes " << log.getEarliestIndex() << " to " << log.getLatestIndex()
+                  << ", expected " << first_ver << " to " << last_ver << std::endl;
+        return 1;
+    }
+    for(version_t ver = first_ver; ver <= last_ver; ver++) {
+        const std::string expected = make_entry(ver);
+        const char* by_index = static_cast<const char*>(log.getEntryByIndex(ver));
+        const char* by_version = static_cast<const char*>(log.getEntry(ver, true));
+        if(by_index == nullptr || expected != by_index || by_version == nullptr || expected != by_version) {
+            std::cout << when << ": the entry at version " << ver << " does not match the one appended" << std::endl;
+            errors++;
+        }
+        if(log.getHLCVersion(HLC(ver + 1, 0)) != ver) {
+            std::cout << when << ": the HLC of version " << ver << " maps to version "
+                      << log.getHLCVersion(HLC(ver + 1, 0)) << std::endl;
+            errors++;
+        }
+    }
+    for(version_t ver = 0; ver < first_ver; ver++) {
+        bool processed = false;
+        log.processEntryAtVersion(ver, [&processed](const void*, std::size_t) { processed = true; });
+        if(log.getEntry(ver, true) != nullptr || processed) {
+            std::cout << when << ": the trimmed entry at version " << ver << " is still in the log" << std::endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/**
+ * Appends the entries while another thread reads back the ones appended so
+ * far, and returns the number of errors.
+ */
+int append_entries(PersistLog& log) {
+    std::atomic<bool> done(false);
+    std::atomic<int> reader_errors(0);
+    std::thread reader([&]() {
+        while(!done) {
+            const int64_t latest = log.getLatestIndex();
+            for(int64_t idx = 0; idx <= latest; idx += 7) {
+                std::string entry;
+                log.processEntryAtVersion(idx, [&entry](const void* data, std::size_t) {
+                    entry.assign(static_cast<const char*>(data));
+                });
+                if(entry != make_entry(idx)) {
+                    std::cout << "Reader: the entry at version " << idx << " changed while the log grew" << std::endl;
+                    reader_errors++;
+                }
+            }
+        }
+    });
+    for(version_t ver = 0; ver < num_entries; ver++) {
+        const std::string entry = make_entry(ver);
+        log.append(entry.c_str(), entry.size() + 1, ver, HLC(ver + 1, 0));
+    }
+    done = true;
+    reader.join();
+    return reader_errors;
+}
+
+/**
+ * Writes a log in the format before segments: one log file and one data file,
+ * which are rings of old_log_entries entries and old_data_size bytes, holding
+ * the entries of versions old_head to old_tail - 1. Like logs written by
+ * older builds, the HLC of one entry is behind the HLC of the entry before it.
+ */
+void write_old_log(const std::string& data_path, const std::string& log_name,
+                   int64_t old_head, int64_t old_tail, uint64_t old_log_entries, uint64_t old_data_size) {
+    const std::string prefix = data_path + "/" + log_name + ".";
+    std::vector<LogEntry> entries(old_log_entries);
+    std::vector<char> data(old_data_size);
+    uint64_t ofst = 0;
+    for(int64_t idx = 0; idx < old_head; idx++) {
+        ofst += make_entry(idx).size() + 1;
+    }
+    for(int64_t idx = old_head; idx < old_tail; idx++) {
+        const std::string entry = make_entry(idx);
+        LogEntry& le = entries[idx % old_log_entries];
+        std::memset(&le, 0, sizeof(le));
+        le.fields.ver = idx;
+        le.fields.sdlen = entry.size() + 1;
+        le.fields.ofst = ofst;
+        le.fields.hlc_r = (idx == old_head + 10) ? 1 : idx + 1;
+        le.fields.hlc_l = 0;
+        le.fields.prev_signed_ver = INVALID_VERSION;
+        for(std::size_t i = 0; i <= entry.size(); i++) {
+            data[(ofst + i) % old_data_size] = entry.c_str()[i];
+        }
+        ofst += entry.size() + 1;
+    }
+    MetaHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.fields.head = old_head;
+    header.fields.tail = old_tail;
+    header.fields.ver = old_tail - 1;
+    auto write_file = [](const std::string& file, const void* buf, std::size_t size) {
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if(fd == -1 || write(fd, buf, size) != static_cast<ssize_t>(size)) {
+            throw PERSIST_EXP_WRITE_FILE(errno);
+        }
+        close(fd);
+    };
+    write_file(prefix + META_FILE_SUFFIX, &header, sizeof(header));
+    write_file(prefix + LOG_FILE_SUFFIX, entries.data(), entries.size() * sizeof(LogEntry));
+    write_file(prefix + DATA_FILE_SUFFIX, data.data(), data.size());
+}
+
+int main(int argc, char** argv) {
+    //Tiny segments and rings, so that a thousand entries span many segments and grow the rings
+    std::vector<std::string> conf_args = {argv[0],
+                                          "--" CONF_PERS_LOG_SEGMENT_ENTRIES "=1",
+                                          "--" CONF_PERS_DATA_SEGMENT_SIZE "=4096",
+                                          "--" CONF_PERS_MAX_LOG_ENTRY "=1",
+                                          "--" CONF_PERS_MAX_DATA_SIZE "=4096"};
+    std::vector<char*> conf_argv;
+    for(auto& arg : conf_args) {
+        conf_argv.push_back(&arg[0]);
+    }
+    derecho::Conf::initialize(conf_argv.size(), conf_argv.data());
+
+    char path_template[] = "/tmp/persist_log_segment_test.XXXXXX";
+    if(mkdtemp(path_template) == nullptr) {
+        std::cout << "Failed to create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string data_path(path_template);
+    const std::string log_name("PersistLogSegmentTest");
+    const std::string old_log_name("PersistLogOldFormatTest");
+    const std::string prefix = data_path + "/" + log_name + ".";
+    int errors = 0;
+
+    try {
+        {
+            FilePersistLog log(log_name, data_path, false);
+            errors += append_entries(log);
+            errors += check_entries(log, 0, num_entries - 1, "After append");
+            log.persist(num_entries - 1);
+        }
+        {
+            FilePersistLog log(log_name, data_path, false);
+            errors += check_entries(log, 0, num_entries - 1, "After reload");
+            log.trim(trim_version);
+            log.persist(num_entries - 1);
+            errors += check_entries(log, trim_version + 1, num_entries - 1, "After trim");
+            for(const std::string& file : {prefix + LOG_FILE_SUFFIX ".0", prefix + DATA_FILE_SUFFIX ".0"}) {
+                if(file_exists(file)) {
+                    std::cout << "After trim: the segment file " << file << " was not removed" << std::endl;
+                    errors++;
+                }
+            }
+        }
+        {
+            FilePersistLog log(log_name, data_path, false);
+            errors += check_entries(log, trim_version + 1, num_entries - 1, "After trim and reload");
+        }
+        //A log whose rings wrapped around: 20 entries at indexes 20 to 39 in a ring of 32
+        write_old_log(data_path, old_log_name, 20, 40, 32, 4096 * 4);
+        {
+            FilePersistLog log(old_log_name, data_path, false);
+            errors += check_entries(log, 20, 39, "After migration");
+            const std::string old_prefix = data_path + "/" + old_log_name + ".";
+            for(const std::string& file : {old_prefix + LOG_FILE_SUFFIX, old_prefix + DATA_FILE_SUFFIX}) {
+                if(file_exists(file)) {
+                    std::cout << "After migration: the old file " << file << " was not removed" << std::endl;
+                    errors++;
+                }
+            }
+        }
+        {
+            FilePersistLog log(old_log_name, data_path, false);
+            errors += check_entries(log, 20, 39, "After migration and reload");
+        }
+    } catch(uint64_t exp) {
+        std::cout << "Persistent log exception: 0x" << std::hex << exp << std::endl;
+        errors++;
+    }
+
+    std::system(("rm -rf " + data_path).c_str());
+    if(errors > 0) {
+        std::cout << "FAILED with " << errors << " errors" << std::endl;
+        return 1;
+    }
+    std::cout << "PASSED" << std::endl;
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file persist_log_snapshot_test.cpp
+ *
+ * This program tests the snapshots stored next to a FilePersistLog. It adds
+ * snapshots to a log and checks that they can be read back before and after
+ * persist() makes them durable, and after the log is reloaded from disk. It
+ * also checks that a snapshot that was never persisted does not survive a
+ * reload, and that trimming the log removes the snapshots of the trimmed
+ * entries.
+ */
+
+#include <derecho/persistent/detail/FilePersistLog.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace persistent;
+
+//Number of entries to append; entry i has version i, so it is also at log index i
+constexpr int num_entries = 100;
+//A snapshot is added at every version v with v % snapshot_interval == snapshot_interval - 1
+constexpr int snapshot_interval = 10;
+
+std::string make_snapshot(version_t ver) {
+    return "snapshot " + std::to_string(ver) + " " + std::string(ver * 13, 'a' + (ver % 26));
+}
+
+/**
+ * Checks that the nearest snapshot at or before a log index is the one at
+ * expected_ver (or that there is none, if expected_ver is INVALID_VERSION)
+ * and that its contents can be read, and returns the number of errors.
+ */
+int check_snapshot(PersistLog& log, int64_t idx, version_t expected_ver, const std::string& when) {
+    const int64_t snapshot_idx = log.getSnapshotIndex(idx);
+    if(expected_ver == INVALID_VERSION) {
+        if(snapshot_idx != INVALID_INDEX) {
+            std::cout << when << ": expected no snapshot at or before index " << idx
+                      << ", found one at index " << snapshot_idx << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if(snapshot_idx != expected_ver) {
+        std::cout << when << ": the snapshot at or before index " << idx << " is at index " << snapshot_idx
+                  << ", expected " << expected_ver << std::endl;
+        return 1;
+    }
+    const std::string expected = make_snapshot(expected_ver);
+    std::string snapshot;
+    const bool found = log.processSnapshotAtIndex(snapshot_idx, [&snapshot](const void* data, std::size_t size) {
+        snapshot.assign(static_cast<const char*>(data), size);
+    });
+    if(!found || snapshot != expected) {
+        std::cout << when << ": the snapshot at version " << expected_ver << " is "
+                  << (found ? snapshot.substr(0, 20) + "..." : std::string("missing")) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Checks every snapshot of a log whose entries from first_ver on are all
+ * present, and returns the number of errors.
+ */
+int check_all_snapshots(PersistLog& log, version_t first_ver, const std::string& when) {
+    int errors = 0;
+    for(version_t ver = first_ver; ver < num_entries; ver++) {
+        version_t expected_ver = ver - (ver + 1) % snapshot_interval;
+        if(expected_ver < first_ver) {
+            expected_ver = INVALID_VERSION;
+        }
+        errors += check_snapshot(log, ver, expected_ver, when);
+    }
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    char path_template[] = "/tmp/persist_log_snapshot_test.XXXXXX";
+    if(mkdtemp(path_template) == nullptr) {
+        std::cout << "Failed to create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string data_path(path_template);
+    const std::string log_name("PersistLogSnapshotTest");
+    int errors = 0;
+
+    try {
+        {
+            FilePersistLog log(log_name, data_path, false);
+            for(version_t ver = 0; ver < num_entries; ver++) {
+                const std::string entry = "entry " + std::to_string(ver);
+                log.append(entry.c_str(), entry.size() + 1, ver, HLC(ver + 1, 0));
+                if(ver % snapshot_interval == snapshot_interval - 1) {
+                    const std::string snapshot = make_snapshot(ver);
+                    log.addSnapshot(ver, snapshot.data(), snapshot.size());
+                }
+            }
+            //The snapshots can be read before they are synced
+            errors += check_all_snapshots(log, 0, "Before persist");
+            log.persist(num_entries - 1);
+            errors += check_all_snapshots(log, 0, "After persist");
+        }
+        {
+            FilePersistLog log(log_name, data_path, false);
+            errors += check_all_snapshots(log, 0, "After reload");
+            //This snapshot is never persisted, so it must not survive a reload
+            const std::string snapshot = make_snapshot(4);
+            log.addSnapshot(4, snapshot.data(), snapshot.size());
+            errors += check_snapshot(log, 5, 4, "Unpersisted snapshot");
+        }
+        {
+            FilePersistLog log(log_name, data_path, false);
+            errors += check_snapshot(log, 5, INVALID_VERSION, "After reload without persist");
+            log.trim(static_cast<version_t>(num_entries / 2 - 1));
+            log.persist(num_entries - 1);
+            errors += check_all_snapshots(log, num_entries / 2, "After trim");
+        }
+        {
+            FilePersistLog log(log_name, data_path, false);
+            errors += check_all_snapshots(log, num_entries / 2, "After trim and reload");
+        }
+    } catch(uint64_t exp) {
+        std::cout << "Persistent log exception: 0x" << std::hex << exp << std::endl;
+        errors++;
+    }
+
+    std::system(("rm -rf " + data_path).c_str());
+    if(errors > 0) {
+        std::cout << "FAILED with " << errors << " errors" << std::endl;
+        return 1;
+    }
+    std::cout << "PASSED" << std::endl;
+    return 0;
+}
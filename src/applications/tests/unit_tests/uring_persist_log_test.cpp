@@ -0,0 +1,112 @@
+/**
+ * @file uring_persist_log_test.cpp
+ *
+ * This program tests the io_uring backend of the persistent log. It appends
+ * entries to a UringPersistLog, persists them with several flushes in flight
+ * at once, and then reloads the log, both through UringPersistLog and through
+ * FilePersistLog (which uses the same on-disk format), checking that every
+ * persisted entry comes back.
+ */
+
+#include <derecho/persistent/detail/UringPersistLog.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace persistent;
+
+//Number of entries to append
+constexpr int num_entries = 10000;
+//Number of versions whose flushes are started before waiting for them
+constexpr int versions_per_persist = 16;
+
+std::string make_entry(version_t ver) {
+    //Vary the entry sizes so the data crosses page boundaries at different offsets
+    return "entry " + std::to_string(ver) + " " + std::string(ver % 300, 'a' + (ver % 26));
+}
+
+/**
+ * Checks that a reloaded log has all the entries, and returns the number of errors.
+ */
+int check_log(PersistLog& log, const std::string& backend) {
+    int errors = 0;
+    if(log.getLastPersistedVersion() != num_entries - 1) {
+        std::cout << backend << ": last persisted version is " << log.getLastPersistedVersion()
+                  << ", expected " << num_entries - 1 << std::endl;
+        errors++;
+    }
+    if(log.getLength() != num_entries) {
+        std::cout << backend << ": log length is " << log.getLength() << ", expected " << num_entries << std::endl;
+        errors++;
+    }
+    for(version_t ver = 0; ver < num_entries && errors < 10; ver++) {
+        const std::string expected = make_entry(ver);
+        const char* entry = static_cast<const char*>(log.getEntry(ver, true));
+        if(entry == nullptr || std::strcmp(entry, expected.c_str()) != 0) {
+            std::cout << backend << ": version " << ver << " is "
+                      << (entry == nullptr ? "missing" : std::string(entry)) << ", expected " << expected << std::endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char** argv) {
+#ifdef HAS_LIBURING
+    char path_template[] = "/tmp/uring_persist_log_test.XXXXXX";
+    if(mkdtemp(path_template) == nullptr) {
+        std::cout << "Failed to create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string data_path(path_template);
+    const std::string log_name("UringPersistLogTest");
+    int errors = 0;
+
+    try {
+        {
+            UringPersistLog log(log_name, data_path, false);
+            for(version_t ver = 0; ver < num_entries; ver++) {
+                const std::string entry = make_entry(ver);
+                log.append(entry.c_str(), entry.size() + 1, ver, HLC(ver + 1, 0));
+                if(ver % versions_per_persist == versions_per_persist - 1) {
+                    //Wait for all the flushes started since the last persist()
+                    log.persist(ver);
+                } else {
+                    log.startPersist(ver);
+                }
+            }
+            log.persist(num_entries - 1);
+            if(log.getLastPersistedVersion() != num_entries - 1) {
+                std::cout << "Last persisted version is " << log.getLastPersistedVersion()
+                          << " after persist(), expected " << num_entries - 1 << std::endl;
+                errors++;
+            }
+        }
+        {
+            UringPersistLog log(log_name, data_path, false);
+            errors += check_log(log, PERS_LOG_BACKEND_IO_URING);
+        }
+        {
+            FilePersistLog log(log_name, data_path, false);
+            errors += check_log(log, PERS_LOG_BACKEND_FILE);
+        }
+    } catch(uint64_t exp) {
+        std::cout << "Persistent log exception: 0x" << std::hex << exp << std::endl;
+        errors++;
+    }
+
+    std::system(("rm -rf " + data_path).c_str());
+    if(errors > 0) {
+        std::cout << "FAILED with " << errors << " errors" << std::endl;
+        return 1;
+    }
+    std::cout << "PASSED" << std::endl;
+    return 0;
+#else
+    std::cout << "Derecho was built without liburing; the io_uring log backend is not available." << std::endl;
+    return 0;
+#endif
+}
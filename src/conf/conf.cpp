@@ -44,15 +44,30 @@ struct option Conf::long_options[] = {
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RDMC_PORT),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_EXTERNAL_PORT),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_LOOP_BUSY_WAIT_BEFORE_SLEEP_MS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_RECEIVE_THREADS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_REQUEST_WORKERS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_PROBE_BATCH_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_HEARTBEAT_MS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PREDICATE_SPIN_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PREDICATE_YIELD_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PREDICATE_BLOCK_US),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RESTART_TIMEOUT_MS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RESTART_INTAKE_THREADS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_ENABLE_BACKUP_RESTART_LEADERS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_DISABLE_PARTITIONING_SAFETY),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_WINDOW_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_SEND_QUEUE_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_NODE_ID),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_NUM_PERSISTENCE_THREADS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_STATE_TRANSFER_CHECKSUMS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_STATE_TRANSFER_SOCKET_BUFFER_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MESSAGE_BUFFER_ARENA_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MESSAGE_BUFFER_HUGE_PAGES),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RPC_DELIVERY_BATCH_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_LAYOUT_JSON_LAYOUT),
         MAKE_LONG_OPT_ENTRY(CONF_LAYOUT_JSON_LAYOUT_FILE),
         // [SUBGROUP/<subgroup name>]
@@ -73,6 +88,10 @@ struct option Conf::long_options[] = {
         MAKE_LONG_OPT_ENTRY(CONF_PERS_RESET),
         MAKE_LONG_OPT_ENTRY(CONF_PERS_MAX_LOG_ENTRY),
         MAKE_LONG_OPT_ENTRY(CONF_PERS_MAX_DATA_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_LOG_SEGMENT_ENTRIES),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_DATA_SEGMENT_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_SNAPSHOT_INTERVAL),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_LOG_BACKEND),
         MAKE_LONG_OPT_ENTRY(CONF_PERS_PRIVATE_KEY_FILE),
         // [LOGGER]
         MAKE_LONG_OPT_ENTRY(CONF_LOGGER_LOG_FILE_DEPTH),
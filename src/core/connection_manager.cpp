@@ -5,6 +5,18 @@
 #include <set>
 
 namespace tcp {
+void set_socket_buffer_sizes(socket& sock, int buffer_size) {
+    if(buffer_size == 0) {
+        return;
+    }
+    try {
+        sock.set_buffer_sizes(buffer_size, buffer_size);
+    } catch(socket_error&) {
+        std::cerr << "WARNING: failed to set the buffer sizes of the socket connected to "
+                  << sock.get_remote_ip() << " to " << buffer_size << " bytes" << std::endl;
+    }
+}
+
 bool tcp_connections::add_connection(const node_id_t other_id,
                                      const std::pair<ip_addr_t, uint16_t>& other_ip_and_port) {
     if(other_id < my_id) {
@@ -35,6 +47,7 @@ bool tcp_connections::add_connection(const node_id_t other_id,
             sockets.erase(other_id);
             return false;
         }
+        set_socket_buffer_sizes(sockets[other_id], socket_buffer_size);
         return true;
     } else if(other_id > my_id) {
         while(true) {
@@ -43,6 +56,7 @@ bool tcp_connections::add_connection(const node_id_t other_id,
 
                 node_id_t remote_id = 0;
                 s.exchange(my_id, remote_id);
+                set_socket_buffer_sizes(s, socket_buffer_size);
 
                 sockets[remote_id] = std::move(s);
                 //If the connection we got wasn't the intended node, keep
@@ -81,8 +95,10 @@ void tcp_connections::establish_node_connections(const std::map<node_id_t, std::
 }
 
 tcp_connections::tcp_connections(node_id_t my_id,
-                                 const std::map<node_id_t, std::pair<ip_addr_t, uint16_t>> ip_addrs_and_ports)
-        : my_id(my_id) {
+                                 const std::map<node_id_t, std::pair<ip_addr_t, uint16_t>> ip_addrs_and_ports,
+                                 int socket_buffer_size)
+        : my_id(my_id),
+          socket_buffer_size(socket_buffer_size) {
     // empty for external clients
     if(!ip_addrs_and_ports.empty()) {
         assert(ip_addrs_and_ports.count(my_id) > 0);
@@ -174,4 +190,8 @@ void tcp_connections::filter_to(const std::vector<node_id_t>& live_nodes_list) {
 derecho::LockedReference<std::unique_lock<std::mutex>, socket> tcp_connections::get_socket(node_id_t node_id) {
     return derecho::LockedReference<std::unique_lock<std::mutex>, socket>(sockets.at(node_id), sockets_mutex);
 }
+
+derecho::LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, socket>> tcp_connections::get_all_sockets() {
+    return derecho::LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, socket>>(sockets, sockets_mutex);
+}
 }  // namespace tcp
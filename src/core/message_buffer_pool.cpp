@@ -0,0 +1,126 @@
+#include "derecho/core/detail/message_buffer_pool.hpp"
+
+#include "derecho/core/derecho_exception.hpp"
+#include "derecho/utils/logger.hpp"
+
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace derecho {
+
+MessageBufferPool::Arena::Arena(uint8_t* base, std::size_t length)
+        : base(base),
+          length(length),
+          mr(std::make_unique<rdma::memory_region>(base, length)) {}
+
+MessageBufferPool::Arena::~Arena() {
+    // Deregister the memory before unmapping it
+    mr.reset();
+    munmap(base, length);
+}
+
+MessageBufferPool::MessageBufferPool(std::size_t arena_size, PageSize page_size)
+        : arena_size(arena_size),
+          page_size(page_size) {}
+
+MessageBufferPool::PageSize MessageBufferPool::parse_page_size(const std::string& value) {
+    if(value == "none") {
+        return PageSize::DEFAULT;
+    } else if(value == "2MB") {
+        return PageSize::HUGE_2MB;
+    } else if(value == "1GB") {
+        return PageSize::HUGE_1GB;
+    }
+    throw derecho_exception("Invalid message_buffer_huge_pages setting: " + value
+                            + ". Expected none, 2MB or 1GB.");
+}
+
+std::size_t MessageBufferPool::size_class_of(std::size_t size) {
+    std::size_t class_size = min_class_size;
+    while(class_size < size) {
+        class_size <<= 1;
+    }
+    return class_size;
+}
+
+std::shared_ptr<MessageBufferPool::Arena> MessageBufferPool::allocate_arena(std::size_t min_length) {
+    const std::size_t system_page_size = sysconf(_SC_PAGESIZE);
+    std::size_t mapping_page_size = system_page_size;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if(page_size == PageSize::HUGE_2MB) {
+        mapping_page_size = std::size_t{1} << 21;
+        flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+    } else if(page_size == PageSize::HUGE_1GB) {
+        mapping_page_size = std::size_t{1} << 30;
+        flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+    }
+    auto round_up = [](std::size_t length, std::size_t granularity) {
+        return (length + granularity - 1) / granularity * granularity;
+    };
+    std::size_t length = round_up(std::max(min_length, arena_size), mapping_page_size);
+    void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if(base == MAP_FAILED && page_size != PageSize::DEFAULT) {
+        // Usually this means too few huge pages are reserved; fall back to normal pages
+        dbg_default_warn("Failed to map a {}-byte message buffer arena with huge pages, falling back to normal pages", length);
+        length = round_up(std::max(min_length, arena_size), system_page_size);
+        base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if(base == MAP_FAILED) {
+        throw derecho_exception("Failed to map a message buffer arena of " + std::to_string(length) + " bytes");
+    }
+    total_arena_bytes += length;
+    dbg_default_debug("Allocated a message buffer arena of {} bytes, {} bytes in total", length, total_arena_bytes);
+    return std::make_shared<Arena>(static_cast<uint8_t*>(base), length);
+}
+
+MessageBuffer MessageBufferPool::carve_buffer(std::size_t class_size) {
+    std::shared_ptr<Arena> arena;
+    std::size_t offset = 0;
+    if(class_size >= arena_size) {
+        // Too big to share an arena with other buffers
+        arena = allocate_arena(class_size);
+    } else {
+        // The rest of the current arena is abandoned if the buffer doesn't fit in it
+        if(!current_arena || current_arena->length - current_arena_used < class_size) {
+            current_arena = allocate_arena(class_size);
+            current_arena_used = 0;
+        }
+        arena = current_arena;
+        offset = current_arena_used;
+        current_arena_used += class_size;
+    }
+    MessageBuffer new_buffer;
+    new_buffer.buffer = arena->base + offset;
+    new_buffer.size = class_size;
+    new_buffer.offset = offset;
+    new_buffer.mr = std::shared_ptr<rdma::memory_region>(arena, arena->mr.get());
+    return new_buffer;
+}
+
+MessageBuffer MessageBufferPool::acquire(std::size_t size) {
+    const std::size_t class_size = size_class_of(size);
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    std::vector<MessageBuffer>& free_list = free_buffers[class_size];
+    if(free_list.empty()) {
+        return carve_buffer(class_size);
+    }
+    MessageBuffer free_buffer = std::move(free_list.back());
+    free_list.pop_back();
+    return free_buffer;
+}
+
+void MessageBufferPool::release(MessageBuffer&& buffer) {
+    if(!buffer.buffer) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    free_buffers[buffer.size].push_back(std::move(buffer));
+}
+
+std::size_t MessageBufferPool::get_total_arena_bytes() {
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    return total_arena_bytes;
+}
+
+}  // namespace derecho
@@ -51,6 +51,7 @@ MulticastGroup::MulticastGroup(
           rdmc_group_num_offset(0),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
+          smc_send_in_progress(total_num_subgroups, false),
           committed_sst_index(total_num_subgroups, -1),
           num_nulls_queued(total_num_subgroups, 0),
           first_null_index(total_num_subgroups, -1),
@@ -62,6 +63,13 @@ MulticastGroup::MulticastGroup(
           minimum_persisted_mtx(total_num_subgroups),
           minimum_verified_version(total_num_subgroups),
           delivered_version(total_num_subgroups),
+          rpc_delivery_batch_size(internal_callbacks.rpc_batch_callback
+                                          ? std::max(getConfUInt32(CONF_DERECHO_RPC_DELIVERY_BATCH_SIZE), 1u)
+                                          : 1),
+          rpc_delivery_batches(total_num_subgroups),
+          rpc_delivery_batch_buffers(total_num_subgroups),
+          msg_state_mtx(total_num_subgroups),
+          unordered_delivery_mtx(total_num_subgroups),
           sender_timeout(sender_timeout),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
@@ -75,14 +83,16 @@ MulticastGroup::MulticastGroup(
     for(uint i = 0; i < num_members; ++i) {
         node_id_to_sst_index[members[i]] = i;
     }
+    initialize_subgroup_state();
 
+    message_buffer_pool = std::make_shared<MessageBufferPool>(
+            getConfUInt64(CONF_DERECHO_MESSAGE_BUFFER_ARENA_SIZE),
+            MessageBufferPool::parse_page_size(getConfString(CONF_DERECHO_MESSAGE_BUFFER_HUGE_PAGES)));
     for(const auto& p : subgroup_settings_by_id) {
         subgroup_id_t id = p.first;
         const SubgroupSettings& settings = p.second;
         auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
+        free_message_buffers[id] = settings.profile.window_size * num_shard_members;
     }
 
     initialize_sst_row();
@@ -99,6 +109,7 @@ MulticastGroup::MulticastGroup(
         // if groups are created successfully, rdmc_sst_groups_created will be set to true
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
+    initialize_sender_states();
     register_predicates();
     sender_thread = std::thread(&MulticastGroup::send_loop, this);
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
@@ -122,6 +133,7 @@ MulticastGroup::MulticastGroup(
           rdmc_group_num_offset(old_group.rdmc_group_num_offset + old_group.num_members),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
+          smc_send_in_progress(total_num_subgroups, false),
           committed_sst_index(total_num_subgroups, -1),
           num_nulls_queued(total_num_subgroups, 0),
           first_null_index(total_num_subgroups, -1),
@@ -133,13 +145,19 @@ MulticastGroup::MulticastGroup(
           minimum_persisted_mtx(total_num_subgroups),
           minimum_verified_version(total_num_subgroups),
           delivered_version(total_num_subgroups),
+          rpc_delivery_batch_size(old_group.rpc_delivery_batch_size),
+          rpc_delivery_batches(total_num_subgroups),
+          rpc_delivery_batch_buffers(total_num_subgroups),
+          msg_state_mtx(total_num_subgroups),
+          unordered_delivery_mtx(total_num_subgroups),
           sender_timeout(old_group.sender_timeout),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
           last_transfer_medium(total_num_subgroups),
           persistence_manager(old_group.persistence_manager) {
-    // Make sure rdmc_group_num_offset didn't overflow.
-    assert(old_group.rdmc_group_num_offset <= std::numeric_limits<uint16_t>::max() - old_group.num_members - num_members);
+    // Make sure rdmc_group_num_offset didn't overflow. create_rdmc_sst_groups
+    // checks each group number it uses from here on.
+    assert(old_group.rdmc_group_num_offset <= std::numeric_limits<uint16_t>::max() - old_group.num_members);
 
     // initialize persisted_version and verified_version
     for (uint i = 0; i< total_num_subgroups; ++i) {
@@ -154,12 +172,19 @@ MulticastGroup::MulticastGroup(
     for(uint i = 0; i < num_members; ++i) {
         node_id_to_sst_index[members[i]] = i;
     }
+    initialize_subgroup_state();
 
     // Convience function that takes a msg from the old group and
     // produces one suitable for this group.
     auto convert_msg = [this](RDMCMessage& msg, subgroup_id_t subgroup_num) {
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num]++;
+        // The message keeps its buffer, which counts against this group's limit
+        // unless it belongs to the application, since return_message_buffer
+        // will give it back to this group
+        if(!msg.message_buffer.release_callback) {
+            free_message_buffers[subgroup_num]--;
+        }
         return std::move(msg);
     };
 
@@ -171,37 +196,41 @@ MulticastGroup::MulticastGroup(
         return std::move(msg);
     };
 
+    // Wait for any UNORDERED delivery the old group's RDMC completion thread is
+    // still making, then lock the old group's subgroups in index order
+    std::vector<std::unique_lock<std::mutex>> old_group_delivery_locks;
+    for(auto& delivery_mtx : old_group.unordered_delivery_mtx) {
+        old_group_delivery_locks.emplace_back(delivery_mtx);
+    }
+    std::vector<std::unique_lock<std::recursive_mutex>> old_group_locks;
+    for(auto& subgroup_mtx : old_group.msg_state_mtx) {
+        old_group_locks.emplace_back(subgroup_mtx);
+    }
+    // Take over the old group's message buffer pool, and give back the buffers
+    // of its incomplete receives. Each subgroup can take as many buffers as
+    // its new window and shard size allow.
+    message_buffer_pool = old_group.message_buffer_pool;
     for(const auto& p : subgroup_settings_by_id) {
         subgroup_id_t id = p.first;
         const SubgroupSettings& settings = p.second;
         auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
+        free_message_buffers[id] = settings.profile.window_size * num_shard_members;
     }
 
-    // Reclaim RDMCMessageBuffers from the old group, and supplement them with
-    // additional if the group has grown.
-    std::lock_guard<std::recursive_mutex> lock(old_group.msg_state_mtx);
-    for(const auto& p : subgroup_settings_by_id) {
-        const subgroup_id_t subgroup_num = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        // for later: don't move extra message buffers
-        free_message_buffers[subgroup_num].swap(old_group.free_message_buffers[subgroup_num]);
-        while(free_message_buffers[subgroup_num].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[subgroup_num].emplace_back(settings.profile.max_msg_size);
+    for(auto& subgroup_receives : old_group.current_receives) {
+        for(auto& msg : subgroup_receives.second) {
+            message_buffer_pool->release(std::move(msg.second.message_buffer));
         }
     }
-
-    for(auto& msg : old_group.current_receives) {
-        free_message_buffers[msg.first.first].push_back(std::move(msg.second.message_buffer));
-    }
     old_group.current_receives.clear();
 
     // Assume that any locally stable messages failed. If we were the sender
     // than re-attempt, otherwise discard. TODO: Presumably the ragged edge
     // cleanup will want the chance to deliver some of these.
+    // Our own messages are re-sent together with the ones that were still being
+    // sent, in their original order, since with more than one RDMC message in
+    // flight a later message can be locally stable before an earlier one.
+    std::map<subgroup_id_t, std::map<message_id_t, RDMCMessage*>> own_unstable_messages;
     for(auto& p : old_group.locally_stable_rdmc_messages) {
         if(p.second.size() == 0) {
             continue;
@@ -209,30 +238,25 @@ MulticastGroup::MulticastGroup(
 
         for(auto& q : p.second) {
             if(q.second.sender_id == members[member_index]) {
-                pending_sends[p.first].push(convert_msg(q.second, p.first));
+                own_unstable_messages[p.first][q.second.index] = &q.second;
             } else {
-                free_message_buffers[p.first].push_back(std::move(q.second.message_buffer));
+                message_buffer_pool->release(std::move(q.second.message_buffer));
             }
         }
     }
-    old_group.locally_stable_rdmc_messages.clear();
-
-    for(const auto& p : subgroup_settings_by_id) {
-        subgroup_id_t id = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
-    }
 
     old_group.locally_stable_sst_messages.clear();
 
     // Any messages that were being sent should be re-attempted.
     for(const auto& p : subgroup_settings_by_id) {
         auto subgroup_num = p.first;
-        if(old_group.current_sends.size() > subgroup_num && old_group.current_sends[subgroup_num]) {
-            pending_sends[subgroup_num].push(convert_msg(*old_group.current_sends[subgroup_num], subgroup_num));
+        if(old_group.current_sends.size() > subgroup_num) {
+            for(auto& send : old_group.current_sends[subgroup_num]) {
+                own_unstable_messages[subgroup_num][send.second.index] = &send.second;
+            }
+        }
+        for(auto& msg : own_unstable_messages[subgroup_num]) {
+            pending_sends[subgroup_num].push(convert_msg(*msg.second, subgroup_num));
         }
 
         if(old_group.pending_sends.size() > subgroup_num) {
@@ -257,6 +281,7 @@ MulticastGroup::MulticastGroup(
         }
         old_group.non_persistent_sst_messages.clear();
     }
+    old_group.locally_stable_rdmc_messages.clear();
 
     initialize_sst_row();
     bool no_member_failed = true;
@@ -272,6 +297,7 @@ MulticastGroup::MulticastGroup(
         // if groups are created successfully, rdmc_sst_groups_created will be set to true
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
+    initialize_sender_states();
     register_predicates();
     sender_thread = std::thread(&MulticastGroup::send_loop, this);
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
@@ -289,7 +315,8 @@ bool MulticastGroup::create_rdmc_sst_groups() {
 
         sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_group<DerechoSST>>(
                 sst, shard_sst_indices, subgroup_settings.profile.window_size, subgroup_settings.profile.sst_max_msg_size, subgroup_settings.senders,
-                subgroup_settings.num_received_offset, subgroup_settings.slot_offset, subgroup_settings.index_offset);
+                subgroup_settings.num_received_offset, subgroup_settings.slot_offset, subgroup_settings.index_offset,
+                subgroup_settings.profile.packed_smc);
 
         if(subgroup_settings.profile.max_msg_size > subgroup_settings.profile.sst_max_msg_size) {
             for(uint shard_rank = 0, sender_rank = -1; shard_rank < num_shard_members; ++shard_rank) {
@@ -301,13 +328,17 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                 node_id_t node_id = shard_members[shard_rank];
                 // When RDMC receives a message, it should store it in
                 // locally_stable_rdmc_messages and update the received count
-                rdmc::completion_callback_t rdmc_receive_handler;
+                std::function<void(uint32_t, uint8_t*, size_t)> rdmc_receive_handler;
                 rdmc_receive_handler = [this, subgroup_num, shard_rank, sender_rank,
                                         subgroup_settings, node_id,
                                         num_shard_senders,
-                                        shard_sst_indices](uint8_t* data, size_t size) {
+                                        shard_sst_indices](uint32_t rdmc_group_num, uint8_t* data, size_t size) {
                     assert(this->sst);
-                    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+                    std::unique_lock<std::mutex> delivery_lock(unordered_delivery_mtx[subgroup_num], std::defer_lock);
+                    if(subgroup_settings.mode == Mode::UNORDERED) {
+                        delivery_lock.lock();
+                    }
+                    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
                     header* h = (header*)data;
                     const int32_t index = h->index;
                     message_id_t sequence_number = index * num_shard_senders + sender_rank;
@@ -316,18 +347,19 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                       subgroup_num, shard_rank, index);
                     // Move message from current_receives to locally_stable_rdmc_messages.
                     if(node_id == members[member_index]) {
-                        assert(current_sends[subgroup_num]);
-                        locally_stable_rdmc_messages[subgroup_num][sequence_number] = std::move(*current_sends[subgroup_num]);
-                        current_sends[subgroup_num] = std::nullopt;
+                        auto it = current_sends[subgroup_num].find(rdmc_group_num);
+                        assert(it != current_sends[subgroup_num].end());
+                        locally_stable_rdmc_messages[subgroup_num][sequence_number] = std::move(it->second);
+                        current_sends[subgroup_num].erase(it);
                     } else {
-                        auto it = current_receives.find({subgroup_num, node_id});
-                        assert(it != current_receives.end());
+                        auto it = current_receives[subgroup_num].find(rdmc_group_num);
+                        assert(it != current_receives[subgroup_num].end());
                         auto& msg = it->second;
                         msg.index = index;
                         // We set the size in this receive handler instead of in the incoming_message_handler
                         msg.size = size;
                         locally_stable_rdmc_messages[subgroup_num].emplace(sequence_number, std::move(msg));
-                        current_receives.erase(it);
+                        current_receives[subgroup_num].erase(it);
                     }
 
                     auto new_num_received = resolve_num_received(index, subgroup_settings.num_received_offset + sender_rank);
@@ -347,47 +379,66 @@ bool MulticastGroup::create_rdmc_sst_groups() {
 
                     // deliver immediately if in UNORDERED mode
                     if(subgroup_settings.mode == Mode::UNORDERED) {
-                        // issue stability upcalls for the recently sequenced messages
+                        // Take the recently sequenced messages out of the maps, then release the
+                        // subgroup's lock for their upcalls, which may send into other subgroups.
+                        // Their SST slots and buffers stay valid until num_received is updated.
+                        struct StableMessage {
+                            node_id_t sender_id;
+                            int32_t index;
+                            uint8_t* payload;
+                            std::size_t payload_size;
+                        };
+                        std::vector<StableMessage> stable_messages;
+                        std::vector<MessageBuffer> stable_message_buffers;
                         for(int i = sst->num_received[member_index][subgroup_settings.num_received_offset + sender_rank] + 1;
                             i <= new_num_received; ++i) {
                             message_id_t seq_num = i * num_shard_senders + sender_rank;
-                            if(!locally_stable_sst_messages[subgroup_num].empty()
-                               && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                                auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                            // Messages of other senders can be waiting in the maps ahead of this one,
+                            // when an earlier message of their sender is still being received
+                            auto sst_it = locally_stable_sst_messages[subgroup_num].find(seq_num);
+                            if(sst_it != locally_stable_sst_messages[subgroup_num].end()) {
+                                auto& msg = sst_it->second;
                                 uint8_t* buf = const_cast<uint8_t*>(msg.buf);
                                 header* h = (header*)(buf);
                                 // no delivery callback for a NULL message
-                                if(msg.size > h->header_size && !(h->cooked_send) && callbacks.global_stability_callback) {
-                                    callbacks.global_stability_callback(subgroup_num, msg.sender_id,
-                                                                        msg.index,
-                                                                        {{buf + h->header_size, msg.size - h->header_size}},
-                                                                        persistent::INVALID_VERSION);
+                                if(msg.size > h->header_size && !(h->cooked_send)) {
+                                    stable_messages.push_back({msg.sender_id, msg.index, buf + h->header_size,
+                                                               msg.size - h->header_size});
                                 }
                                 if(node_id == members[member_index]) {
                                     pending_message_timestamps[subgroup_num].erase(h->timestamp);
                                 }
-                                locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                                locally_stable_sst_messages[subgroup_num].erase(sst_it);
                             } else {
-                                assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                                auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
-                                assert(it2->first == seq_num);
+                                auto it2 = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+                                assert(it2 != locally_stable_rdmc_messages[subgroup_num].end());
                                 auto& msg = it2->second;
-                                uint8_t* buf = msg.message_buffer.buffer.get();
+                                uint8_t* buf = msg.message_buffer.buffer;
                                 header* h = (header*)(buf);
                                 // no delivery for a NULL message
-                                if(msg.size > h->header_size && !(h->cooked_send) && callbacks.global_stability_callback) {
-                                    callbacks.global_stability_callback(subgroup_num, msg.sender_id,
-                                                                        msg.index,
-                                                                        {{buf + h->header_size, msg.size - h->header_size}},
-                                                                        persistent::INVALID_VERSION);
+                                if(msg.size > h->header_size && !(h->cooked_send)) {
+                                    stable_messages.push_back({msg.sender_id, msg.index, buf + h->header_size,
+                                                               msg.size - h->header_size});
                                 }
-                                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
                                 if(node_id == members[member_index]) {
                                     pending_message_timestamps[subgroup_num].erase(h->timestamp);
                                 }
+                                stable_message_buffers.emplace_back(std::move(msg.message_buffer));
                                 locally_stable_rdmc_messages[subgroup_num].erase(it2);
                             }
                         }
+                        if(!stable_messages.empty() && callbacks.global_stability_callback) {
+                            lock.unlock();
+                            for(const StableMessage& msg : stable_messages) {
+                                callbacks.global_stability_callback(subgroup_num, msg.sender_id, msg.index,
+                                                                    {{msg.payload, msg.payload_size}},
+                                                                    persistent::INVALID_VERSION);
+                            }
+                            lock.lock();
+                        }
+                        for(MessageBuffer& buffer : stable_message_buffers) {
+                            return_message_buffer(subgroup_num, std::move(buffer));
+                        }
                     }
                     if(new_num_received > sst->num_received[member_index][subgroup_settings.num_received_offset + sender_rank]) {
                         sst->num_received[member_index][subgroup_settings.num_received_offset + sender_rank] = new_num_received;
@@ -407,14 +458,6 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                  subgroup_settings.num_received_offset + sender_rank);
                     }
                 };
-                // Capture rdmc_receive_handler by copy! The reference to it won't be valid after this constructor ends!
-                auto receive_handler_plus_notify =
-                        [this, rdmc_receive_handler](uint8_t* data, size_t size) {
-                            rdmc_receive_handler(data, size);
-                            // signal background writer thread
-                            sender_cv.notify_all();
-                        };
-
                 // Create a "rotated" vector of members in which the currently selected shard member (shard_rank) is first
                 std::vector<uint32_t> rotated_shard_members(shard_members.size());
                 for(uint k = 0; k < num_shard_members; ++k) {
@@ -423,48 +466,76 @@ bool MulticastGroup::create_rdmc_sst_groups() {
 
                 // don't create rdmc group if there's only one member in the shard
                 if(num_shard_members <= 1) {
-                    singleton_shard_receive_handlers[subgroup_num] = receive_handler_plus_notify;
+                    // Capture rdmc_receive_handler by copy! The reference to it won't be valid after this constructor ends!
+                    singleton_shard_receive_handlers[subgroup_num] =
+                            [this, rdmc_receive_handler](uint8_t* data, size_t size) {
+                                rdmc_receive_handler(0, data, size);
+                                // signal background writer thread
+                                wake_sender();
+                            };
                     continue;
                 }
 
-                if(node_id == members[member_index]) {
-                    //Create a group in which this node is the sender, and only self-receives happen
-                    if(!rdmc::create_group(
-                               rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, subgroup_settings.profile.rdmc_send_algorithm,
-                               [](size_t length) -> rdmc::receive_destination {
-                                   assert_always(false);
-                                   return {nullptr, 0};
-                               },
-                               receive_handler_plus_notify,
-                               [](std::optional<uint32_t>) {})) {
-                        return false;
-                    }
-                    subgroup_to_rdmc_group[subgroup_num] = rdmc_group_num_offset;
-                    rdmc_group_num_offset++;
-                } else {
-                    if(!rdmc::create_group(
-                               rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, subgroup_settings.profile.rdmc_send_algorithm,
-                               [this, subgroup_num, node_id](size_t length) {
-                                   std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
-                                   assert(!free_message_buffers[subgroup_num].empty());
-                                   //Create a Message struct to receive the data into.
-                                   RDMCMessage msg;
-                                   msg.sender_id = node_id;
-                                   // The length variable is not the exact size of the msg,
-                                   // but it is the nearest multiple of the block size greater then the size
-                                   // so we will set the size in the receive handler
-                                   msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-                                   free_message_buffers[subgroup_num].pop_back();
-
-                                   rdmc::receive_destination ret{msg.message_buffer.mr, 0};
-                                   current_receives[{subgroup_num, node_id}] = std::move(msg);
-
-                                   assert(ret.mr->buffer != nullptr);
-                                   return ret;
-                               },
-                               rdmc_receive_handler, [](std::optional<uint32_t>) {})) {
-                        return false;
+                // Create rdmc_pipeline_depth groups per RDMC algorithm the profile uses for some message size,
+                // unless the sender has only one receiver, in which case all algorithms are the same
+                std::vector<rdmc::send_algorithm> rdmc_algorithms;
+                std::set<rdmc::send_algorithm> distinct_algorithms{subgroup_settings.profile.rdmc_send_algorithm};
+                if(num_shard_members > 2) {
+                    distinct_algorithms.insert(subgroup_settings.profile.rdmc_threshold_algorithms.begin(),
+                                               subgroup_settings.profile.rdmc_threshold_algorithms.end());
+                }
+                for(const rdmc::send_algorithm algorithm : distinct_algorithms) {
+                    rdmc_algorithms.insert(rdmc_algorithms.end(), subgroup_settings.profile.rdmc_pipeline_depth, algorithm);
+                }
+                for(const rdmc::send_algorithm algorithm : rdmc_algorithms) {
+                    // Make sure the group number doesn't overflow
+                    assert(rdmc_group_num_offset < std::numeric_limits<uint16_t>::max());
+                    const uint32_t rdmc_group_num = rdmc_group_num_offset;
+                    if(node_id == members[member_index]) {
+                        //Create a group in which this node is the sender, and only self-receives happen
+                        if(!rdmc::create_group(
+                                   rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, algorithm,
+                                   [](size_t length) -> rdmc::receive_destination {
+                                       assert_always(false);
+                                       return {nullptr, 0};
+                                   },
+                                   [this, rdmc_receive_handler, rdmc_group_num](uint8_t* data, size_t size) {
+                                       rdmc_receive_handler(rdmc_group_num, data, size);
+                                       // signal background writer thread
+                                       wake_sender();
+                                   },
+                                   [](std::optional<uint32_t>) {})) {
+                            return false;
+                        }
+                        subgroup_to_rdmc_group[subgroup_num][algorithm].push_back(rdmc_group_num);
+                    } else {
+                        if(!rdmc::create_group(
+                                   rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, algorithm,
+                                   [this, subgroup_num, node_id, rdmc_group_num](size_t length) {
+                                       std::lock_guard<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
+
+                                       //Create a Message struct to receive the data into.
+                                       RDMCMessage msg;
+                                       msg.sender_id = node_id;
+                                       // The length variable is not the exact size of the msg,
+                                       // but it is the nearest multiple of the block size greater then the size
+                                       // so we will set the size in the receive handler
+                                       msg.message_buffer = take_message_buffer(subgroup_num, length);
+
+                                       rdmc::receive_destination ret{msg.message_buffer.mr, msg.message_buffer.offset};
+                                       current_receives[subgroup_num][rdmc_group_num] = std::move(msg);
+
+                                       assert(ret.mr->buffer != nullptr);
+                                       return ret;
+                                   },
+                                   [rdmc_receive_handler, rdmc_group_num](uint8_t* data, size_t size) {
+                                       rdmc_receive_handler(rdmc_group_num, data, size);
+                                   },
+                                   [](std::optional<uint32_t>) {})) {
+                            return false;
+                        }
                     }
+                    rdmc_group_nums.push_back(rdmc_group_num_offset);
                     rdmc_group_num_offset++;
                 }
             }
@@ -473,6 +544,57 @@ bool MulticastGroup::create_rdmc_sst_groups() {
     return true;
 }
 
+void MulticastGroup::initialize_subgroup_state() {
+    // Create every subgroup's entries up front, since threads working on
+    // different subgroups access these maps without a common lock
+    for(const auto& p : subgroup_settings_map) {
+        const subgroup_id_t subgroup_num = p.first;
+        free_message_buffers[subgroup_num];
+        current_receives[subgroup_num];
+        locally_stable_rdmc_messages[subgroup_num];
+        locally_stable_sst_messages[subgroup_num];
+        pending_message_timestamps[subgroup_num];
+        pending_persistence[subgroup_num];
+        non_persistent_messages[subgroup_num];
+        non_persistent_sst_messages[subgroup_num];
+    }
+}
+
+void MulticastGroup::initialize_sender_states() {
+    sender_states.assign(total_num_subgroups, SenderState{});
+    for(const auto& p : subgroup_settings_map) {
+        const subgroup_id_t subgroup_num = p.first;
+        const SubgroupSettings& subgroup_settings = p.second;
+        SenderState& state = sender_states[subgroup_num];
+        state.is_member = true;
+        state.sender_rank = subgroup_settings.sender_rank;
+        state.num_senders = get_num_senders(subgroup_settings.senders);
+        state.num_received_offset = subgroup_settings.num_received_offset;
+        state.ordered = subgroup_settings.mode != Mode::UNORDERED;
+        state.window_size = subgroup_settings.profile.window_size;
+        state.shard_sst_indices = get_shard_sst_indices(subgroup_num);
+        if(subgroup_settings.members.size() > 1) {
+            auto rdmc_groups = subgroup_to_rdmc_group.find(subgroup_num);
+            if(rdmc_groups != subgroup_to_rdmc_group.end()) {
+                const DerechoParams& profile = subgroup_settings.profile;
+                state.rdmc_pipeline_depth = profile.rdmc_pipeline_depth;
+                state.rdmc_groups = rdmc_groups->second.at(profile.rdmc_send_algorithm);
+                for(std::size_t i = 0; i < profile.rdmc_size_thresholds.size(); ++i) {
+                    auto group = rdmc_groups->second.find(profile.rdmc_threshold_algorithms[i]);
+                    if(group != rdmc_groups->second.end()) {
+                        state.rdmc_groups_by_size.emplace_back(profile.rdmc_size_thresholds[i], group->second);
+                    }
+                }
+            }
+        } else {
+            auto handler = singleton_shard_receive_handlers.find(subgroup_num);
+            if(handler != singleton_shard_receive_handlers.end()) {
+                state.singleton_receive_handler = &handler->second;
+            }
+        }
+    }
+}
+
 void MulticastGroup::initialize_sst_row() {
     auto num_received_size = sst->num_received.size();
     auto seq_num_size = sst->seq_num.size();
@@ -500,7 +622,7 @@ void MulticastGroup::deliver_message(RDMCMessage& msg, const subgroup_id_t& subg
         return;
     }
 
-    uint8_t* buf = msg.message_buffer.buffer.get();
+    uint8_t* buf = msg.message_buffer.buffer;
     header* h = (header*)(buf);
     // cooked send
     if(h->cooked_send) {
@@ -552,7 +674,7 @@ void MulticastGroup::deliver_message(SSTMessage& msg, const subgroup_id_t& subgr
 
 bool MulticastGroup::version_message(RDMCMessage& msg, const subgroup_id_t& subgroup_num,
                                      const persistent::version_t& version, const uint64_t& msg_timestamp) {
-    uint8_t* buf = msg.message_buffer.buffer.get();
+    uint8_t* buf = msg.message_buffer.buffer;
     header* h = (header*)(buf);
     // null message filter
     if(msg.size == h->header_size) {
@@ -594,13 +716,59 @@ bool MulticastGroup::version_message(SSTMessage& msg, const subgroup_id_t& subgr
     return true;
 }
 
+bool MulticastGroup::batch_rpc_message(subgroup_id_t subgroup_num, int32_t seq_num, node_id_t sender_id,
+                                       uint8_t* buf, long long unsigned int msg_size,
+                                       persistent::version_t version, uint64_t msg_timestamp) {
+    if(rpc_delivery_batch_size <= 1 || msg_size <= sizeof(header)) {
+        return false;
+    }
+    header* h = (header*)(buf);
+    // null messages and raw sends are delivered one at a time, after the RPC messages before them
+    if(msg_size == h->header_size || !h->cooked_send) {
+        deliver_rpc_batch(subgroup_num);
+        return false;
+    }
+    if(sender_id == members[member_index]) {
+        pending_persistence[subgroup_num][seq_num] = msg_timestamp;
+    }
+    std::vector<DeliveredRPCMessage>& batch = rpc_delivery_batches[subgroup_num];
+    if(batch.size() >= rpc_delivery_batch_size) {
+        deliver_rpc_batch(subgroup_num);
+    }
+    uint64_t msg_ts_us = msg_timestamp / 1e3;
+    if(msg_ts_us == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        msg_ts_us = (uint64_t)now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+    }
+    batch.push_back(DeliveredRPCMessage{sender_id, version, msg_ts_us,
+                                        buf + h->header_size,
+                                        static_cast<uint32_t>(msg_size - h->header_size)});
+    return true;
+}
+
+void MulticastGroup::deliver_rpc_batch(subgroup_id_t subgroup_num) {
+    std::vector<DeliveredRPCMessage>& batch = rpc_delivery_batches[subgroup_num];
+    if(batch.empty()) {
+        return;
+    }
+    // The batch callback makes a version for each message after handling it
+    internal_callbacks.rpc_batch_callback(subgroup_num, batch);
+    delivered_version[subgroup_num]->store(batch.back().version, std::memory_order_release);
+    batch.clear();
+    for(MessageBuffer& buffer : rpc_delivery_batch_buffers[subgroup_num]) {
+        return_message_buffer(subgroup_num, std::move(buffer));
+    }
+    rpc_delivery_batch_buffers[subgroup_num].clear();
+}
+
 void MulticastGroup::deliver_messages_upto(
         const std::vector<int32_t>& max_indices_for_senders,
         subgroup_id_t subgroup_num, uint32_t num_shard_senders) {
     bool non_null_msgs_delivered = false;
     assert(max_indices_for_senders.size() == (size_t)num_shard_senders);
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
         int32_t curr_seq_num = sst->delivered_num[member_index][subgroup_num];
         int32_t max_seq_num = curr_seq_num;
         for(uint sender = 0; sender < num_shard_senders; sender++) {
@@ -619,14 +787,19 @@ void MulticastGroup::deliver_messages_upto(
             assigned_version = persistent::combine_int32s(sst->vid[member_index], seq_num);
             if(rdmc_msg_ptr != locally_stable_rdmc_messages[subgroup_num].end()) {
                 auto& msg = rdmc_msg_ptr->second;
-                uint8_t* buf = msg.message_buffer.buffer.get();
+                uint8_t* buf = msg.message_buffer.buffer;
                 uint64_t msg_ts = ((header*)buf)->timestamp;
-                //Note: deliver_message frees the RDMC buffer in msg, which is why the timestamp must be saved before calling this
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                // free the message buffer only after it version_message has been called
-                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                if(batch_rpc_message(subgroup_num, seq_num, msg.sender_id, buf, msg.size, assigned_version, msg_ts)) {
+                    non_null_msgs_delivered = true;
+                    rpc_delivery_batch_buffers[subgroup_num].emplace_back(std::move(msg.message_buffer));
+                } else {
+                    //Note: deliver_message frees the RDMC buffer in msg, which is why the timestamp must be saved before calling this
+                    deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
+                    delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
+                    non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
+                    // free the message buffer only after it version_message has been called
+                    return_message_buffer(subgroup_num, std::move(msg.message_buffer));
+                }
                 locally_stable_rdmc_messages[subgroup_num].erase(rdmc_msg_ptr);
             } else {
                 dbg_default_trace("Subgroup {}, deliver_messages_upto delivering an SST message with seq_num = {}",
@@ -634,12 +807,17 @@ void MulticastGroup::deliver_messages_upto(
                 auto& msg = locally_stable_sst_messages[subgroup_num].at(seq_num);
                 uint8_t* buf = (uint8_t*)msg.buf;
                 uint64_t msg_ts = ((header*)buf)->timestamp;
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
+                if(batch_rpc_message(subgroup_num, seq_num, msg.sender_id, buf, msg.size, assigned_version, msg_ts)) {
+                    non_null_msgs_delivered = true;
+                } else {
+                    deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
+                    delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
+                    non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
+                }
                 locally_stable_sst_messages[subgroup_num].erase(seq_num);
             }
         }
+        deliver_rpc_batch(subgroup_num);
         gmssst::set(sst->delivered_num[member_index][subgroup_num], max_seq_num);
         if(non_null_msgs_delivered) {
             //Call the persistence_manager_post_persist_func
@@ -734,9 +912,11 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
             // issue stability upcalls for the recently sequenced messages
             for(int i = sst->num_received[member_index][subgroup_settings.num_received_offset + sender_rank] + 1; i <= new_num_received; ++i) {
                 message_id_t seq_num = i * num_shard_senders + sender_rank;
-                if(!locally_stable_sst_messages[subgroup_num].empty()
-                   && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                    auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                // Look the message up by sequence number, since other senders' messages
+                // can be waiting in the maps ahead of it
+                auto sst_it = locally_stable_sst_messages[subgroup_num].find(seq_num);
+                if(sst_it != locally_stable_sst_messages[subgroup_num].end()) {
+                    auto& msg = sst_it->second;
                     uint8_t* buf = const_cast<uint8_t*>(msg.buf);
                     header* h = (header*)(buf);
                     if(msg.size > h->header_size && !(h->cooked_send) && callbacks.global_stability_callback) {
@@ -748,13 +928,12 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
                     if(node_id == members[member_index]) {
                         pending_message_timestamps[subgroup_num].erase(h->timestamp);
                     }
-                    locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                    locally_stable_sst_messages[subgroup_num].erase(sst_it);
                 } else {
-                    assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                    auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
-                    assert(it2->first == seq_num);
+                    auto it2 = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+                    assert(it2 != locally_stable_rdmc_messages[subgroup_num].end());
                     auto& msg = it2->second;
-                    uint8_t* buf = msg.message_buffer.buffer.get();
+                    uint8_t* buf = msg.message_buffer.buffer;
                     header* h = (header*)(buf);
                     if(msg.size > h->header_size && !(h->cooked_send) && callbacks.global_stability_callback) {
                         callbacks.global_stability_callback(subgroup_num, msg.sender_id,
@@ -762,7 +941,7 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
                                                             {{buf + h->header_size, msg.size - h->header_size}},
                                                             persistent::INVALID_VERSION);
                     }
-                    free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                    return_message_buffer(subgroup_num, std::move(msg.message_buffer));
                     if(node_id == members[member_index]) {
                         pending_message_timestamps[subgroup_num].erase(h->timestamp);
                     }
@@ -784,7 +963,13 @@ void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const Subgrou
 
     bool put_new_seq_num = false;
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+        // In UNORDERED mode, sst_receive_handler delivers messages, which must not
+        // overlap with a delivery by the RDMC completion thread
+        std::unique_lock<std::mutex> delivery_lock(unordered_delivery_mtx[subgroup_num], std::defer_lock);
+        if(subgroup_settings.mode == Mode::UNORDERED) {
+            delivery_lock.lock();
+        }
+        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
         for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
             const uint32_t sender_sst_index = node_id_to_sst_index.at(subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)]);
             uint32_t slot;
@@ -792,6 +977,14 @@ void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const Subgrou
             const message_id_t received_index = sst.index[sender_sst_index][subgroup_settings.index_offset];
             while(received_index > old_index) {
                 old_index++;
+                if(profile.packed_smc) {
+                    uint64_t msg_size;
+                    volatile uint8_t* msg = sst_multicast_group_ptrs[subgroup_num]->get_packed_message(
+                            sender_sst_index, sender_count, msg_size);
+                    sst_receive_handler_lambda(sender_count, msg, msg_size);
+                    sst.num_received_sst[member_index][subgroup_settings.num_received_offset + sender_count] = old_index;
+                    continue;
+                }
                 slot = old_index % profile.window_size;
                 dbg_default_trace("receiver_trig calling sst_receive_handler_lambda. next_seq = {}, num_received = {}, sender rank = {}. Reading from SST row {}, slot {}",
                                   received_index, old_index, sender_count, sender_sst_index, subgroup_settings.slot_offset + slot_width * slot);
@@ -834,7 +1027,7 @@ void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const Subgroup
                                       const uint32_t num_shard_members, DerechoSST& sst) {
     bool update_sst = false;
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
         // compute the min of the seq_num
         message_id_t min_stable_num
                 = sst.seq_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
@@ -862,15 +1055,21 @@ void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const Subgroup
                 dbg_default_trace("Subgroup {}, can deliver a locally stable RDMC message: min_stable_num={} and least_undelivered_seq_num={}",
                                   subgroup_num, min_stable_num, least_undelivered_rdmc_seq_num);
                 RDMCMessage& msg = locally_stable_rdmc_messages[subgroup_num].begin()->second;
-                uint8_t* buf = msg.message_buffer.buffer.get();
+                uint8_t* buf = msg.message_buffer.buffer;
                 uint64_t msg_ts = ((header*)buf)->timestamp;
                 //Note: deliver_message frees the RDMC buffer in msg, which is why the timestamp must be saved before calling this
                 assigned_version = persistent::combine_int32s(sst.vid[member_index], least_undelivered_rdmc_seq_num);
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                // free the message buffer only after version_message has been called
-                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                if(batch_rpc_message(subgroup_num, least_undelivered_rdmc_seq_num, msg.sender_id, buf, msg.size,
+                                     assigned_version, msg_ts)) {
+                    non_null_msgs_delivered = true;
+                    rpc_delivery_batch_buffers[subgroup_num].emplace_back(std::move(msg.message_buffer));
+                } else {
+                    deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
+                    delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
+                    non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
+                    // free the message buffer only after version_message has been called
+                    return_message_buffer(subgroup_num, std::move(msg.message_buffer));
+                }
                 sst.delivered_num[member_index][subgroup_num] = least_undelivered_rdmc_seq_num;
                 locally_stable_rdmc_messages[subgroup_num].erase(locally_stable_rdmc_messages[subgroup_num].begin());
             } else if(least_undelivered_sst_seq_num < least_undelivered_rdmc_seq_num && least_undelivered_sst_seq_num <= min_stable_num) {
@@ -881,15 +1080,21 @@ void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const Subgroup
                 uint8_t* buf = (uint8_t*)msg.buf;
                 uint64_t msg_ts = ((header*)buf)->timestamp;
                 assigned_version = persistent::combine_int32s(sst.vid[member_index], least_undelivered_sst_seq_num);
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
+                if(batch_rpc_message(subgroup_num, least_undelivered_sst_seq_num, msg.sender_id, buf, msg.size,
+                                     assigned_version, msg_ts)) {
+                    non_null_msgs_delivered = true;
+                } else {
+                    deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
+                    delivered_version[subgroup_num]->store(assigned_version,std::memory_order_release);
+                    non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
+                }
                 sst.delivered_num[member_index][subgroup_num] = least_undelivered_sst_seq_num;
                 locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
             } else {
                 break;
             }
         }
+        deliver_rpc_batch(subgroup_num);
         if(update_sst) {
             // post persistence request for ordered mode.
             if(non_null_msgs_delivered) {
@@ -910,7 +1115,7 @@ void MulticastGroup::sst_send_trigger(subgroup_id_t subgroup_num, const Subgroup
     int32_t current_first_null_index;
     uint32_t current_num_nulls_queued;
     {
-        std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
+        std::unique_lock<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
         to_be_sent = committed_sst_index[subgroup_num] - sst.index[member_index][subgroup_settings.index_offset];
         if(to_be_sent > 0) {
             current_committed_index = sst_multicast_group_ptrs[subgroup_num]->commit_send(to_be_sent);
@@ -923,7 +1128,8 @@ void MulticastGroup::sst_send_trigger(subgroup_id_t subgroup_num, const Subgroup
     }
     // Here lock is released
     if(to_be_sent > 0) {
-        if(current_num_nulls_queued > 0) {
+        // In the packed layout, each null is a message of its own rather than a count in the first one
+        if(current_num_nulls_queued > 0 && !subgroup_settings.profile.packed_smc) {
             DerechoParams profile = subgroup_settings.profile;
             const uint64_t slot_width = profile.sst_max_msg_size + sizeof(uint64_t);
             auto null_slot = current_first_null_index % profile.window_size;
@@ -938,7 +1144,7 @@ void MulticastGroup::sst_send_trigger(subgroup_id_t subgroup_num, const Subgroup
 
 void MulticastGroup::update_min_persisted_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
                                               uint32_t num_shard_members, DerechoSST& sst) {
-    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
     // compute the min of the persisted_num
     persistent::version_t min_persisted_num
             = sst.persisted_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
@@ -996,7 +1202,16 @@ void MulticastGroup::register_predicates() {
                 l++;
             }
         }
+        const std::vector<uint32_t> shard_sst_indices = get_shard_sst_indices(subgroup_num);
 
+        // The predicates that declare the SST entries they read are evaluated only when those entries change
+        std::vector<sst::PredicateInput> receiver_inputs;
+        for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
+            receiver_inputs.push_back(sst->index.input(shard_sst_indices[shard_ranks_by_sender_rank.at(sender_count)],
+                                                       subgroup_settings.index_offset));
+        }
+        receiver_inputs.push_back(sst->num_received_sst.input(member_index, subgroup_settings.num_received_offset,
+                                                              num_shard_senders));
         auto receiver_pred = [=](const DerechoSST& sst) {
             return receiver_predicate(subgroup_settings,
                                       shard_ranks_by_sender_rank, num_shard_senders, sst);
@@ -1012,7 +1227,8 @@ void MulticastGroup::register_predicates() {
                               sst_receive_handler_lambda);
         };
         receiver_pred_handles.emplace_back(sst->predicates.insert(receiver_pred, receiver_trig,
-                                                                  sst::PredicateType::RECURRENT));
+                                                                  sst::PredicateType::RECURRENT,
+                                                                  std::move(receiver_inputs)));
 
         auto sst_send_pred = [](const DerechoSST& sst) {
             return true;
@@ -1034,53 +1250,81 @@ void MulticastGroup::register_predicates() {
             delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, delivery_trig,
                                                                       sst::PredicateType::RECURRENT));
 
-            //This predicate should be "current min over persisted_num is greater than the last
-            //observed minimum persisted_num," but computing the current min in the predicate is
-            //redundant with computing it in the trigger. To save time, we just make the predicate
-            //do nothing, and make the trigger both compute and update the minimum persisted_num
-            auto persistence_pred = [](const DerechoSST& sst) {
+            std::vector<sst::PredicateInput> persisted_num_inputs;
+            std::vector<sst::PredicateInput> verified_num_inputs;
+            for(uint32_t sst_index : shard_sst_indices) {
+                persisted_num_inputs.push_back(sst->persisted_num.input(sst_index, subgroup_num));
+                verified_num_inputs.push_back(sst->verified_num.input(sst_index, subgroup_num));
+            }
+            //The predicate is "current min over persisted_num is greater than the last observed
+            //minimum persisted_num," and it is only evaluated when the shard's persisted_num changes
+            auto persistence_pred = [=](const DerechoSST& sst) {
+                const persistent::version_t last_min = minimum_persisted_version[subgroup_num]->load(std::memory_order_relaxed);
+                for(uint32_t sst_index : shard_sst_indices) {
+                    if(sst.persisted_num[sst_index][subgroup_num] <= last_min) {
+                        return false;
+                    }
+                }
                 return true;
             };
             auto persistence_trig = [=](DerechoSST& sst) mutable {
                 update_min_persisted_num(subgroup_num, subgroup_settings, num_shard_members, sst);
             };
 
-            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, persistence_trig, sst::PredicateType::RECURRENT));
+            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, persistence_trig, sst::PredicateType::RECURRENT,
+                                                                         std::move(persisted_num_inputs)));
 
             //In case there are persistent objects with signatures, add a similar predicate to check/update the minimum verified_num
-            auto verified_pred = [](const DerechoSST& sst) {
+            auto verified_pred = [=](const DerechoSST& sst) {
+                const persistent::version_t last_min = minimum_verified_version[subgroup_num]->load(std::memory_order_relaxed);
+                for(uint32_t sst_index : shard_sst_indices) {
+                    if(sst.verified_num[sst_index][subgroup_num] <= last_min) {
+                        return false;
+                    }
+                }
                 return true;
             };
             auto verified_trig = [=](DerechoSST& sst) {
                 update_min_verified_num(subgroup_num, subgroup_settings, num_shard_members, sst);
             };
 
-            persistence_pred_handles.emplace_back(sst->predicates.insert(verified_pred, verified_trig, sst::PredicateType::RECURRENT));
+            persistence_pred_handles.emplace_back(sst->predicates.insert(verified_pred, verified_trig, sst::PredicateType::RECURRENT,
+                                                                         std::move(verified_num_inputs)));
 
             if(subgroup_settings.sender_rank >= 0) {
+                std::vector<sst::PredicateInput> sender_inputs;
+                for(uint32_t sst_index : shard_sst_indices) {
+                    sender_inputs.push_back(sst->delivered_num.input(sst_index, subgroup_num));
+                }
                 auto sender_pred = [=](const DerechoSST& sst) {
                     message_id_t seq_num = next_message_to_deliver[subgroup_num] * num_shard_senders + subgroup_settings.sender_rank;
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        if(sst.delivered_num[node_id_to_sst_index.at(subgroup_settings.members[i])][subgroup_num] < seq_num) {
+                    for(uint32_t sst_index : shard_sst_indices) {
+                        if(sst.delivered_num[sst_index][subgroup_num] < seq_num) {
                             return false;
                         }
                     }
                     return true;
                 };
                 auto sender_trig = [=](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    wake_sender();
                     next_message_to_deliver[subgroup_num]++;
                 };
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT,
+                                                                        std::move(sender_inputs)));
             }
         } else {
             //This subgroup is in UNORDERED mode
             if(subgroup_settings.sender_rank >= 0) {
+                // Sending more messages can only make this predicate false, so it declares only the SST entries it reads
+                const uint32_t num_received_index = subgroup_settings.num_received_offset + subgroup_settings.sender_rank;
+                std::vector<sst::PredicateInput> sender_inputs;
+                for(uint32_t sst_index : shard_sst_indices) {
+                    sender_inputs.push_back(sst->num_received.input(sst_index, num_received_index));
+                }
                 auto sender_pred = [=](const DerechoSST& sst) {
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        uint32_t num_received_offset = subgroup_settings.num_received_offset;
-                        if(sst.num_received[node_id_to_sst_index.at(subgroup_settings.members[i])][num_received_offset + subgroup_settings.sender_rank]
+                    for(uint32_t sst_index : shard_sst_indices) {
+                        if(sst.num_received[sst_index][num_received_index]
                            < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - subgroup_settings.profile.window_size)) {
                             return false;
                         }
@@ -1088,10 +1332,11 @@ void MulticastGroup::register_predicates() {
                     return true;
                 };
                 auto sender_trig = [this](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    wake_sender();
                 };
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT,
+                                                                        std::move(sender_inputs)));
             }
         }
     }
@@ -1128,11 +1373,12 @@ void MulticastGroup::wedge() {
         handle_iter = persistence_pred_handles.erase(handle_iter);
     }
 
-    for(uint i = 0; i < num_members; ++i) {
-        rdmc::destroy_group(i + rdmc_group_num_offset);
+    for(const uint16_t rdmc_group_num : rdmc_group_nums) {
+        rdmc::destroy_group(rdmc_group_num);
     }
+    rdmc_group_nums.clear();
 
-    sender_cv.notify_all();
+    wake_sender();
     if(sender_thread.joinable()) {
         sender_thread.join();
     }
@@ -1140,40 +1386,32 @@ void MulticastGroup::wedge() {
 
 void MulticastGroup::send_loop() {
     pthread_setname_np(pthread_self(), "sender_thread");
-    subgroup_id_t subgroup_to_send = 0;
     auto should_send_to_subgroup = [&](subgroup_id_t subgroup_num) {
-        if(!rdmc_sst_groups_created) {
-            return false;
-        }
         if(pending_sends[subgroup_num].empty()) {
             return false;
         }
-        RDMCMessage& msg = pending_sends[subgroup_num].front();
-        const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
-
-        int shard_sender_index = subgroup_settings.sender_rank;
-        std::vector<int> shard_senders = subgroup_settings.senders;
-        uint32_t num_shard_senders = get_num_senders(shard_senders);
-        assert(shard_sender_index >= 0);
+        const SenderState& state = sender_states[subgroup_num];
+        const message_id_t msg_index = pending_sends[subgroup_num].front().index;
+        assert(state.is_member && state.sender_rank >= 0);
 
-        if(sst->num_received[member_index][subgroup_settings.num_received_offset + shard_sender_index] < msg.index - 1) {
+        // Up to rdmc_pipeline_depth messages can be in flight, each on its own RDMC group
+        if(sst->num_received[member_index][state.num_received_offset + state.sender_rank] < msg_index - state.rdmc_pipeline_depth) {
             return false;
         }
 
-        std::vector<node_id_t> shard_members = subgroup_settings.members;
-        auto num_shard_members = shard_members.size();
-        assert(num_shard_members >= 1);
-        if(subgroup_settings.mode != Mode::UNORDERED) {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < static_cast<message_id_t>((msg.index - subgroup_settings.profile.window_size) * num_shard_senders + shard_sender_index)) {
+        assert(!state.shard_sst_indices.empty());
+        if(state.ordered) {
+            const message_id_t min_delivered = (msg_index - state.window_size) * static_cast<int32_t>(state.num_senders)
+                                               + state.sender_rank;
+            for(const uint32_t sst_index : state.shard_sst_indices) {
+                if(sst->delivered_num[sst_index][subgroup_num] < min_delivered) {
                     return false;
                 }
             }
         } else {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                auto num_received_offset = subgroup_settings.num_received_offset;
-                if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-                   < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - subgroup_settings.profile.window_size)) {
+            const int32_t min_received = future_message_indices[subgroup_num] - 1 - state.window_size;
+            for(const uint32_t sst_index : state.shard_sst_indices) {
+                if(sst->num_received[sst_index][state.num_received_offset + state.sender_rank] < min_received) {
                     return false;
                 }
             }
@@ -1181,41 +1419,97 @@ void MulticastGroup::send_loop() {
 
         return true;
     };
-    auto should_send = [&]() {
-        for(uint i = 1; i <= total_num_subgroups; ++i) {
-            auto subgroup_num = (subgroup_to_send + i) % total_num_subgroups;
-            if(should_send_to_subgroup(subgroup_num)) {
-                subgroup_to_send = subgroup_num;
-                return true;
-            }
-        }
-        return false;
-    };
-    auto should_wake = [&]() { return thread_shutdown || should_send(); };
-    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
     while(!thread_shutdown) {
-        sender_cv.wait(lock, should_wake);
-        if(!thread_shutdown) {
-            current_sends[subgroup_to_send] = std::move(pending_sends[subgroup_to_send].front());
-            dbg_default_trace("Calling send in subgroup {} on message {} from sender {}",
-                              subgroup_to_send, current_sends[subgroup_to_send]->index, current_sends[subgroup_to_send]->sender_id);
-            // make sure there are > 1 members before issuing RDMC send
-            if(subgroup_settings_map.at(subgroup_to_send).members.size() > 1) {
-                if(!rdmc::send(subgroup_to_rdmc_group.at(subgroup_to_send),
-                               current_sends[subgroup_to_send]->message_buffer.mr, 0,
-                               current_sends[subgroup_to_send]->size)) {
-                    throw std::runtime_error("rdmc::send returned false");
+        const uint64_t wakeups_seen = sender_wakeups;
+        // Send at most one message per subgroup on each pass, holding only that subgroup's lock
+        bool sent_any = false;
+        for(subgroup_id_t subgroup_num = 0; subgroup_num < total_num_subgroups && rdmc_sst_groups_created && !thread_shutdown;
+            ++subgroup_num) {
+            if(!sender_states[subgroup_num].is_member) {
+                continue;
+            }
+            // A shard with no other members receives its own message on this thread, after the
+            // subgroup's lock is released, since the receive handler can call delivery upcalls
+            const std::function<void(uint8_t*, size_t)>* self_receive_handler = nullptr;
+            uint8_t* self_received_buffer = nullptr;
+            std::size_t self_received_size = 0;
+            {
+                std::lock_guard<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
+                if(!should_send_to_subgroup(subgroup_num)) {
+                    continue;
                 }
-            } else {
-                // receive the message right here
-                singleton_shard_receive_handlers.at(subgroup_to_send)(
-                        current_sends[subgroup_to_send]->message_buffer.buffer.get(), current_sends[subgroup_to_send]->size);
+                sent_any = true;
+                const SenderState& state = sender_states[subgroup_num];
+                // make sure there are > 1 members before issuing RDMC send
+                if(!state.rdmc_groups.empty()) {
+                    // Use the groups of the algorithm chosen for this message's size in turn. The last
+                    // message sent on the chosen group has an index of at most this message's index minus
+                    // rdmc_pipeline_depth, so should_send_to_subgroup has checked that it is no longer being sent.
+                    const std::vector<uint32_t>* rdmc_groups = &state.rdmc_groups;
+                    for(const auto& size_and_groups : state.rdmc_groups_by_size) {
+                        if(pending_sends[subgroup_num].front().size <= size_and_groups.first) {
+                            rdmc_groups = &size_and_groups.second;
+                            break;
+                        }
+                    }
+                    const uint32_t rdmc_group = (*rdmc_groups)[pending_sends[subgroup_num].front().index % rdmc_groups->size()];
+                    assert(current_sends[subgroup_num].count(rdmc_group) == 0);
+                    RDMCMessage& msg = current_sends[subgroup_num][rdmc_group] = std::move(pending_sends[subgroup_num].front());
+                    dbg_default_trace("Calling send in subgroup {} on message {} from sender {}",
+                                      subgroup_num, msg.index, msg.sender_id);
+                    if(!rdmc::send(rdmc_group, msg.message_buffer.mr, msg.message_buffer.offset, msg.size)) {
+                        throw std::runtime_error("rdmc::send returned false");
+                    }
+                } else {
+                    RDMCMessage& msg = current_sends[subgroup_num][0] = std::move(pending_sends[subgroup_num].front());
+                    dbg_default_trace("Calling send in subgroup {} on message {} from sender {}",
+                                      subgroup_num, msg.index, msg.sender_id);
+                    // receive the message right here
+                    assert(state.singleton_receive_handler);
+                    self_receive_handler = state.singleton_receive_handler;
+                    self_received_buffer = msg.message_buffer.buffer;
+                    self_received_size = msg.size;
+                }
+                pending_sends[subgroup_num].pop();
+            }
+            if(self_receive_handler) {
+                (*self_receive_handler)(self_received_buffer, self_received_size);
             }
-            pending_sends[subgroup_to_send].pop();
+        }
+        if(!sent_any) {
+            std::unique_lock<std::mutex> lock(sender_mtx);
+            sender_sleeping = true;
+            sender_cv.wait(lock, [&]() { return thread_shutdown || sender_wakeups != wakeups_seen; });
+            sender_sleeping = false;
         }
     }
 }
 
+void MulticastGroup::wake_sender() {
+    sender_wakeups++;
+    // The sender thread sets sender_sleeping before it checks sender_wakeups, so
+    // either it sees this increment or this thread sees that it is sleeping
+    if(sender_sleeping) {
+        std::lock_guard<std::mutex> lock(sender_mtx);
+        sender_cv.notify_all();
+    }
+}
+
+MessageBuffer MulticastGroup::take_message_buffer(subgroup_id_t subgroup_num, std::size_t size) {
+    free_message_buffers[subgroup_num]--;
+    return message_buffer_pool->acquire(size);
+}
+
+void MulticastGroup::return_message_buffer(subgroup_id_t subgroup_num, MessageBuffer&& buffer) {
+    if(buffer.release_callback) {
+        // The buffer came from send_registered, so it doesn't belong to the pool
+        buffer.release_callback();
+        return;
+    }
+    message_buffer_pool->release(std::move(buffer));
+    free_message_buffers[subgroup_num]++;
+}
+
 const uint64_t MulticastGroup::compute_global_stability_frontier(uint32_t subgroup_num) const {
     uint64_t global_stability_frontier = sst->local_stability_frontier[member_index][subgroup_num];
     auto shard_sst_indices = get_shard_sst_indices(subgroup_num);
@@ -1258,10 +1552,10 @@ void MulticastGroup::check_failures_loop() {
         std::this_thread::sleep_for(std::chrono::milliseconds(sender_timeout));
         if(sst) {
             {
-                std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
                 auto current_time = get_walltime();
                 for(auto p : subgroup_settings_map) {
                     auto subgroup_num = p.first;
+                    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
                     auto members = p.second.members;
                     auto sst_indices = get_shard_sst_indices(subgroup_num);
                     // clean up timestamps of persisted messages
@@ -1289,7 +1583,7 @@ void MulticastGroup::check_failures_loop() {
     }
 }
 
-// we already hold the lock on msg_state_mtx when we call this
+// we already hold the subgroup's msg_state_mtx when we call this
 void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
     // short-circuits most of the normal checks because
     // we know that we received a message and are sending a null
@@ -1303,14 +1597,13 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num];
         msg.size = msg_size;
-        msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-        free_message_buffers[subgroup_num].pop_back();
+        msg.message_buffer = take_message_buffer(subgroup_num, msg_size);
 
         auto current_time = get_walltime();
         pending_message_timestamps[subgroup_num].insert(current_time);
 
         // Fill header
-        uint8_t* buf = msg.message_buffer.buffer.get();
+        uint8_t* buf = msg.message_buffer.buffer;
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->index = msg.index;
         ((header*)buf)->timestamp = current_time;
@@ -1318,7 +1611,7 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
 
         future_message_indices[subgroup_num]++;
         pending_sends[subgroup_num].push(std::move(msg));
-        sender_cv.notify_all();
+        wake_sender();
     } else {
         uint8_t* buf = (uint8_t*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
 
@@ -1345,7 +1638,8 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
 
 uint8_t* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
                                             long long unsigned int payload_size,
-                                            bool cooked_send) {
+                                            bool cooked_send,
+                                            MessageBuffer* caller_buffer) {
     long long unsigned int msg_size = payload_size + sizeof(header);
     const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
     if(msg_size > subgroup_settings.profile.max_msg_size) {
@@ -1385,7 +1679,7 @@ uint8_t* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
             return nullptr;
         }
 
-        if(free_message_buffers[subgroup_num].empty()) {
+        if(!caller_buffer && free_message_buffers[subgroup_num] <= 0) {
             return nullptr;
         }
 
@@ -1398,14 +1692,17 @@ uint8_t* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num];
         msg.size = msg_size;
-        msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-        free_message_buffers[subgroup_num].pop_back();
+        if(caller_buffer) {
+            msg.message_buffer = std::move(*caller_buffer);
+        } else {
+            msg.message_buffer = take_message_buffer(subgroup_num, msg_size);
+        }
 
         auto current_time = get_walltime();
         pending_message_timestamps[subgroup_num].insert(current_time);
 
         // Fill header
-        uint8_t* buf = msg.message_buffer.buffer.get();
+        uint8_t* buf = msg.message_buffer.buffer;
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->index = msg.index;
         ((header*)buf)->timestamp = current_time;
@@ -1453,7 +1750,7 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num, long long unsigned int pay
     if(!rdmc_sst_groups_created) {
         return false;
     }
-    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
+    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
     uint8_t* buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send);
     while(!buf) {
         // Don't want any deadlocks. For example, this thread cannot get a buffer because delivery is lagging
@@ -1474,11 +1771,61 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num, long long unsigned int pay
         assert(next_sends[subgroup_num]);
         pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
         next_sends[subgroup_num] = std::nullopt;
-        sender_cv.notify_all();
+        wake_sender();
+        return true;
+    } else {
+        committed_sst_index[subgroup_num]++;
+        smc_send_in_progress[subgroup_num] = false;
+        return true;
+    }
+}
+
+bool MulticastGroup::send_registered(subgroup_id_t subgroup_num, std::shared_ptr<rdma::memory_region> mr,
+                                     std::size_t offset, long long unsigned int payload_size,
+                                     const std::function<void(uint8_t* buf)>& msg_generator,
+                                     std::function<void()> buffer_released, bool cooked_send) {
+    if(offset + sizeof(header) + payload_size > mr->size) {
+        throw derecho_exception("The message does not fit in the registered memory region it was sent from");
+    }
+    if(!rdmc_sst_groups_created) {
+        return false;
+    }
+    MessageBuffer caller_buffer;
+    caller_buffer.buffer = mr->buffer + offset;
+    caller_buffer.size = mr->size - offset;
+    caller_buffer.offset = offset;
+    caller_buffer.mr = std::move(mr);
+    caller_buffer.release_callback = std::move(buffer_released);
+    uint8_t* caller_payload = caller_buffer.buffer + sizeof(header);
+
+    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx[subgroup_num]);
+    uint8_t* buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send, &caller_buffer);
+    while(!buf) {
+        // Same as in send(): only unlock once we know there is no buffer yet
+        lock.unlock();
+        if(thread_shutdown) {
+            return false;
+        }
+        lock.lock();
+        buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send, &caller_buffer);
+    }
+
+    if(last_transfer_medium[subgroup_num]) {
+        // RDMC will send straight from the caller's memory region, which now
+        // belongs to the message until it is delivered
+        assert(next_sends[subgroup_num]);
+        msg_generator(buf);
+        pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
+        next_sends[subgroup_num] = std::nullopt;
+        wake_sender();
         return true;
     } else {
+        // The message is small enough for SMC, so it must be copied into the SST
+        msg_generator(caller_payload);
+        memcpy(buf, caller_payload, payload_size);
         committed_sst_index[subgroup_num]++;
         smc_send_in_progress[subgroup_num] = false;
+        caller_buffer.release_callback();
         return true;
     }
 }
@@ -1521,9 +1868,10 @@ void MulticastGroup::debug_print() {
         cout << endl;
     }
 
-    std::cout << "Printing memory usage of free_message_buffers" << std::endl;
+    std::cout << "Printing memory usage of message buffers" << std::endl;
+    std::cout << "Total size of message buffer arenas: " << message_buffer_pool->get_total_arena_bytes() << std::endl;
     for(const auto& p : free_message_buffers) {
-        std::cout << "Subgroup " << p.first << ", Number of free buffers " << p.second.size() << std::endl;
+        std::cout << "Subgroup " << p.first << ", Number of free buffers " << p.second << std::endl;
     }
 }
 
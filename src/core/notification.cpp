@@ -161,4 +161,13 @@ mutils::context_ptr<const NotificationMessage> NotificationMessage::from_bytes_n
                                     false)};
 }
 
+void NotificationMessage::for_each_in_batch(const std::function<void(const NotificationMessage&)>& func) const {
+    std::size_t offset = 0;
+    while(offset < size) {
+        auto message = from_bytes_noalloc_const(nullptr, body + offset);
+        func(*message);
+        offset += message->bytes_size();
+    }
+}
+
 }  // namespace derecho
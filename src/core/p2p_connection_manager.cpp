@@ -5,6 +5,7 @@
 #include "derecho/sst/detail/poll_utils.hpp"
 #include "derecho/utils/logger.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <mutex>
@@ -19,6 +20,8 @@ P2PConnectionManager::P2PConnectionManager(const P2PParams params)
         : my_node_id(params.my_node_id),
           p2p_connections(derecho::getConfUInt32(CONF_DERECHO_MAX_NODE_ID)),
           active_p2p_connections(new char[derecho::getConfUInt32(CONF_DERECHO_MAX_NODE_ID)]),
+          probe_cursors(std::max(params.num_probe_shards, 1u)),
+          probe_batch_size(std::max(derecho::getConfUInt32(CONF_DERECHO_P2P_PROBE_BATCH_SIZE), 1u)),
           failure_upcall(params.failure_upcall) {
     // HARD-CODED. Adding another request type will break this
 
@@ -42,6 +45,8 @@ P2PConnectionManager::P2PConnectionManager(const P2PParams params)
 
     p2p_connections[my_node_id].second = std::make_unique<P2PConnection>(my_node_id, my_node_id, p2p_buf_size, request_params);
     active_p2p_connections[my_node_id] = true;
+    active_node_ids.insert(my_node_id);
+    active_node_ids_version++;
 
     // external client doesn't need failure checking
     if(!params.is_external) {
@@ -63,6 +68,15 @@ void P2PConnectionManager::add_connections(const std::vector<node_id_t>& node_id
             active_p2p_connections[remote_id] = true;
         }
     }
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    bool changed = false;
+    for(const node_id_t remote_id : node_ids) {
+        changed |= active_node_ids.insert(remote_id).second;
+    }
+    // Every new view re-adds all of its members, so most calls change nothing
+    if(changed) {
+        active_node_ids_version++;
+    }
 }
 
 void P2PConnectionManager::remove_connections(const std::vector<node_id_t>& node_ids) {
@@ -71,6 +85,19 @@ void P2PConnectionManager::remove_connections(const std::vector<node_id_t>& node
         p2p_connections[remote_id].second = nullptr;
         active_p2p_connections[remote_id] = false;
     }
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    bool changed = false;
+    for(const node_id_t remote_id : node_ids) {
+        changed |= (active_node_ids.erase(remote_id) > 0);
+    }
+    if(changed) {
+        active_node_ids_version++;
+    }
+}
+
+std::vector<node_id_t> P2PConnectionManager::get_active_node_ids() {
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    return std::vector<node_id_t>(active_node_ids.begin(), active_node_ids.end());
 }
 
 bool P2PConnectionManager::contains_node(const node_id_t node_id) {
@@ -103,13 +130,47 @@ void P2PConnectionManager::increment_incoming_seq_num(node_id_t node_id, MESSAGE
 }
 
 // check if there's a new request from any node
-std::optional<MessagePointer> P2PConnectionManager::probe_all() {
-    for(node_id_t node_id = 0; node_id < p2p_connections.size(); ++node_id) {
-        //Check the hint before locking the mutex. If it's false, don't bother.
-        if(!active_p2p_connections[node_id]) continue;
+std::optional<MessagePointer> P2PConnectionManager::probe_all(uint32_t shard) {
+    ProbeCursor& cursor = probe_cursors[shard];
+    const uint64_t version = active_node_ids_version.load(std::memory_order_acquire);
+    if(cursor.version != version) {
+        // Connections were added or removed: refresh this shard's list, and resume the round-robin where it
+        // was, so that frequent membership changes don't keep favoring the lowest node IDs
+        const uint32_t num_shards = probe_cursors.size();
+        const bool had_connections = !cursor.node_ids.empty();
+        const node_id_t resume_id = had_connections ? cursor.node_ids[cursor.position] : 0;
+        cursor.node_ids.clear();
+        for(const node_id_t node_id : get_active_node_ids()) {
+            if(node_id % num_shards == shard) {
+                cursor.node_ids.push_back(node_id);
+            }
+        }
+        cursor.version = version;
+        // node_ids is sorted, since active_node_ids is: find the first node at or after the one to be probed next
+        auto resume_iter = std::lower_bound(cursor.node_ids.begin(), cursor.node_ids.end(), resume_id);
+        if(!had_connections || resume_iter == cursor.node_ids.end() || *resume_iter != resume_id) {
+            // The next node is gone (or there was none), so its batch is over
+            cursor.served = 0;
+        }
+        cursor.position = (resume_iter == cursor.node_ids.end()) ? 0 : resume_iter - cursor.node_ids.begin();
+    }
+    const std::size_t num_connections = cursor.node_ids.size();
+    // Take up to probe_batch_size consecutive messages from a connection, then move on to the next one
+    auto advance_cursor = [&](std::size_t position) {
+        cursor.served = (position == cursor.position) ? cursor.served + 1 : 1;
+        if(cursor.served >= probe_batch_size) {
+            cursor.position = (position + 1) % num_connections;
+            cursor.served = 0;
+        } else {
+            cursor.position = position;
+        }
+    };
+    for(std::size_t i = 0; i < num_connections; ++i) {
+        const std::size_t position = (cursor.position + i) % num_connections;
+        const node_id_t node_id = cursor.node_ids[position];
 
         std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
-        //In case the hint was wrong, check for an empty connection
+        //In case the connection was removed since the list was copied, check for an empty connection
         if(!p2p_connections[node_id].second) continue;
 
         auto buf_type_pair = p2p_connections[node_id].second->probe();
@@ -118,8 +179,10 @@ std::optional<MessagePointer> P2PConnectionManager::probe_all() {
         // If we only test buf[0], it will fall in the wrong path if the least significant byte of the payload size is
         // zero.
         if(buf_type_pair && reinterpret_cast<size_t*>(buf_type_pair->first)[0] != 0) {
+            advance_cursor(position);
             return MessagePointer{node_id, buf_type_pair->first, buf_type_pair->second};
         } else if(buf_type_pair) {
+            advance_cursor(position);
             // this means that we have a null reply
             // we don't need to process it, but we still want to increment the seq num
             dbg_default_trace("Got a null reply from node {} for a void P2P call", node_id);
@@ -153,9 +216,8 @@ void P2PConnectionManager::check_failures_loop() {
 
     // using CONF_DERECHO_HEARTBEAT_MS from derecho.cfg
     uint32_t heartbeat_ms = derecho::getConfUInt32(CONF_DERECHO_HEARTBEAT_MS);
-    const auto tid = std::this_thread::get_id();
     // get id first
-    uint32_t ce_idx = util::polling_data.get_index(tid);
+    uint32_t ce_idx = util::polling_data.get_index();
 
     uint16_t tick_count = 0;
     const uint16_t one_second_count = 1000 / heartbeat_ms;
@@ -164,16 +226,14 @@ void P2PConnectionManager::check_failures_loop() {
         tick_count++;
         std::unordered_set<node_id_t> posted_write_to;
 
-        util::polling_data.set_waiting(tid);
+        util::polling_data.set_waiting(ce_idx);
 #ifdef USE_VERBS_API
         std::map<uint32_t, verbs_sender_ctxt> sctxt;
 #else
         std::map<uint32_t, lf_sender_ctxt> sctxt;
 #endif
 
-        for(node_id_t node_id = 0; node_id < p2p_connections.size(); ++node_id) {
-            if(!active_p2p_connections[node_id]) continue;
-
+        for(const node_id_t node_id : get_active_node_ids()) {
             std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
 
             if(!p2p_connections[node_id].second) continue;
@@ -213,7 +273,7 @@ void P2PConnectionManager::check_failures_loop() {
             std::optional<std::pair<int32_t, int32_t>> ce;
             while(true) {
                 // check if polling result is available
-                ce = util::polling_data.get_completion_entry(tid);
+                ce = util::polling_data.get_completion_entry(ce_idx);
                 if(ce) {
                     break;
                 }
@@ -245,7 +305,7 @@ void P2PConnectionManager::check_failures_loop() {
                 failed_node_indexes.push_back(remote_id);
             }
         }
-        util::polling_data.reset_waiting(tid);
+        util::polling_data.reset_waiting(ce_idx);
 
         for(auto nid : failed_node_indexes) {
             dbg_default_debug("p2p_connection_manager detected failure/timeout on node {}", nid);
@@ -267,17 +327,7 @@ void P2PConnectionManager::check_failures_loop() {
 }
 
 void P2PConnectionManager::filter_to(const std::vector<node_id_t>& live_nodes_list) {
-    std::vector<node_id_t> prev_nodes_list;
-    for(node_id_t node_id = 0; node_id < p2p_connections.size(); ++node_id) {
-        //Check the hint before acquiring the lock
-        if(!active_p2p_connections[node_id]) continue;
-
-        std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
-        //Check again to ensure the connection is non-null
-        if(p2p_connections[node_id].second) {
-            prev_nodes_list.push_back(node_id);
-        }
-    }
+    std::vector<node_id_t> prev_nodes_list = get_active_node_ids();
 
     std::vector<node_id_t> departed;
     std::set_difference(prev_nodes_list.begin(), prev_nodes_list.end(),
@@ -8,6 +8,7 @@
 #include "derecho/core/detail/view_manager.hpp"
 #include "derecho/openssl/signature.hpp"
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <thread>
@@ -22,20 +23,23 @@ PersistenceManager::PersistenceManager(
           signature_size(0),
           persistence_callbacks{user_persistence_callback},
           objects_by_subgroup_id(objects_map) {
-    // initialize semaphore
-    if(sem_init(&persistence_request_sem, 1, 0) != 0) {
-        throw derecho_exception("Cannot initialize persistent_request_sem:errno=" + std::to_string(errno));
+    const uint32_t num_threads = std::max(getConfUInt32(CONF_DERECHO_NUM_PERSISTENCE_THREADS), 1u);
+    for(uint32_t i = 0; i < num_threads; i++) {
+        workers.emplace_back(std::make_unique<PersistenceWorker>());
     }
     if(any_signed_objects) {
         openssl::EnvelopeKey signing_key = openssl::EnvelopeKey::from_pem_private(getConfString(CONF_PERS_PRIVATE_KEY_FILE));
         signature_size = signing_key.get_max_size();
         //The Verifier only needs the public key, but we loaded both public and private components from the private key file
-        signature_verifier = std::make_unique<openssl::Verifier>(signing_key, openssl::DigestAlgorithm::SHA256);
+        for(auto& worker : workers) {
+            worker->signature_verifier = std::make_unique<openssl::Verifier>(signing_key, openssl::DigestAlgorithm::SHA256);
+        }
     }
 }
 
 PersistenceManager::~PersistenceManager() {
-    sem_destroy(&persistence_request_sem);
+    // make sure no thread is left running, in case shutdown() was not called
+    shutdown(true);
 }
 
 void PersistenceManager::set_view_manager(ViewManager& view_manager) {
@@ -53,43 +57,70 @@ void PersistenceManager::add_persistence_callback(const persistence_callback_t&
 void PersistenceManager::start() {
     //Initialize this vector now that ViewManager is set up and we know the number of subgroups
     last_persisted_version.resize(view_manager->get_current_view().get().subgroup_shard_views.size(), -1);
-    //Start the thread
-    this->persist_thread = std::thread{[this]() {
-        pthread_setname_np(pthread_self(), "persist");
-        dbg_default_debug("PersistenceManager thread started");
-        do {
-            // wait for semaphore
-            sem_wait(&persistence_request_sem);
-            while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-                ;                                                    // spin
-            if(this->persistence_request_queue.empty()) {
-                prq_lock.clear(std::memory_order_release);  // release lock
-                if(this->thread_shutdown) {
-                    break;
-                }
-                continue;
-            }
-
-            ThreadRequest request = persistence_request_queue.front();
-            persistence_request_queue.pop();
-            prq_lock.clear(std::memory_order_release);  // release lock
+    //Start the threads
+    for(std::size_t i = 0; i < workers.size(); i++) {
+        PersistenceWorker& worker = *workers[i];
+        worker.thread = std::thread{[this, i, &worker]() {
+            std::string thread_name = "persist_" + std::to_string(i);
+            pthread_setname_np(pthread_self(), thread_name.c_str());
+            dbg_default_debug("PersistenceManager thread {} started", i);
+            worker_loop(worker);
+        }};
+    }
+}
 
+void PersistenceManager::worker_loop(PersistenceWorker& worker) {
+    std::vector<ThreadRequest> requests;
+    while(true) {
+        subgroup_id_t subgroup_id;
+        {
+            std::unique_lock<std::mutex> lock(worker.queue_mutex);
+            worker.queue_cv.wait(lock, [&]() { return !worker.ready_subgroups.empty() || thread_shutdown; });
+            // On shutdown, finish the queued requests before exiting
+            if(worker.ready_subgroups.empty()) {
+                break;
+            }
+            subgroup_id = worker.ready_subgroups.front();
+            worker.ready_subgroups.pop_front();
+            SubgroupQueue& subgroup_queue = worker.subgroup_queues[subgroup_id];
+            requests.swap(subgroup_queue.requests);
+            subgroup_queue.stats.queue_depth = 0;
+        }
+        // Coalesce the queued requests: one persist() for the latest requested version
+        // (hence one persisted_num update), and one verification for the latest version.
+        persistent::version_t persist_version = persistent::INVALID_VERSION;
+        persistent::version_t verify_version = persistent::INVALID_VERSION;
+        uint64_t num_persist_requests = 0;
+        uint64_t num_verify_requests = 0;
+        for(const ThreadRequest& request : requests) {
             if(request.operation == RequestType::PERSIST) {
-                handle_persist_request(request.subgroup_id, request.version);
+                persist_version = std::max(persist_version, request.version);
+                num_persist_requests++;
             } else if(request.operation == RequestType::VERIFY) {
-                handle_verify_request(request.subgroup_id, request.version);
+                verify_version = std::max(verify_version, request.version);
+                num_verify_requests++;
+            }
+        }
+        requests.clear();
+        // Verification relies on the log being persisted, so persist first.
+        if(num_persist_requests > 0) {
+            handle_persist_request(subgroup_id, persist_version);
+        }
+        if(num_verify_requests > 0) {
+            handle_verify_request(subgroup_id, verify_version, *worker.signature_verifier);
+        }
+        {
+            std::lock_guard<std::mutex> lock(worker.queue_mutex);
+            SubgroupQueueStats& stats = worker.subgroup_queues[subgroup_id].stats;
+            if(num_persist_requests > 0) {
+                stats.persist_batches++;
+                stats.max_persist_batch_size = std::max(stats.max_persist_batch_size, num_persist_requests);
             }
-            if(this->thread_shutdown) {
-                while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-                    ;                                                    // spin
-                if(persistence_request_queue.empty()) {
-                    prq_lock.clear(std::memory_order_release);  // release lock
-                    break;                                      // finish
-                }
-                prq_lock.clear(std::memory_order_release);  // release lock
+            if(num_verify_requests > 0) {
+                stats.verify_batches++;
             }
-        } while(true);
-    }};
+        }
+    }
 }
 
 void PersistenceManager::handle_persist_request(subgroup_id_t subgroup_id, persistent::version_t version) {
@@ -143,7 +174,8 @@ void PersistenceManager::handle_persist_request(subgroup_id_t subgroup_id, persi
     }
 }
 
-void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version) {
+void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version,
+                                               openssl::Verifier& signature_verifier) {
     dbg_default_debug("PersistenceManager: handling verify request for subgroup {} version {}", subgroup_id, version);
     auto search = objects_by_subgroup_id.find(subgroup_id);
     if(search != objects_by_subgroup_id.end()) {
@@ -176,7 +208,7 @@ void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persis
             assert(other_signed_version >= version);
             assert(subgroup_object->get_minimum_latest_persisted_version() >= other_signed_version);
             bool verification_success = subgroup_object->verify_log(
-                    other_signed_version, *signature_verifier, other_signature.data());
+                    other_signed_version, signature_verifier, other_signature.data());
             if(verification_success) {
                 minimum_verified_version = std::min(minimum_verified_version, other_signed_version);
             } else {
@@ -191,15 +223,28 @@ void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persis
     }
 }
 
+void PersistenceManager::enqueue_request(const ThreadRequest& request) {
+    PersistenceWorker& worker = *workers[request.subgroup_id % workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.queue_mutex);
+        SubgroupQueue& subgroup_queue = worker.subgroup_queues[request.subgroup_id];
+        if(subgroup_queue.requests.empty()) {
+            worker.ready_subgroups.push_back(request.subgroup_id);
+        }
+        subgroup_queue.requests.push_back(request);
+        subgroup_queue.stats.queue_depth = subgroup_queue.requests.size();
+        if(request.operation == RequestType::PERSIST) {
+            subgroup_queue.stats.persist_requests++;
+        } else {
+            subgroup_queue.stats.verify_requests++;
+        }
+    }
+    worker.queue_cv.notify_one();
+}
+
 /** post a persistence request */
 void PersistenceManager::post_persist_request(const subgroup_id_t& subgroup_id, const persistent::version_t& version) {
-    // request enqueue
-    while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-        ;                                                    // spin
-    persistence_request_queue.push({RequestType::PERSIST, subgroup_id, version});
-    prq_lock.clear(std::memory_order_release);  // release lock
-    // post semaphore
-    sem_post(&persistence_request_sem);
+    enqueue_request({RequestType::PERSIST, subgroup_id, version});
 }
 
 void PersistenceManager::post_verify_request(const subgroup_id_t& subgroup_id, const persistent::version_t& version) {
@@ -207,11 +252,17 @@ void PersistenceManager::post_verify_request(const subgroup_id_t& subgroup_id, c
     if(signature_size == 0) {
         return;
     }
-    while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-        ;                                                    // spin
-    persistence_request_queue.push({RequestType::VERIFY, subgroup_id, version});
-    prq_lock.clear(std::memory_order_release);  // release lock
-    sem_post(&persistence_request_sem);
+    enqueue_request({RequestType::VERIFY, subgroup_id, version});
+}
+
+PersistenceManager::SubgroupQueueStats PersistenceManager::get_queue_stats(subgroup_id_t subgroup_id) {
+    PersistenceWorker& worker = *workers[subgroup_id % workers.size()];
+    std::lock_guard<std::mutex> lock(worker.queue_mutex);
+    auto search = worker.subgroup_queues.find(subgroup_id);
+    if(search == worker.subgroup_queues.end()) {
+        return SubgroupQueueStats{};
+    }
+    return search->second.stats;
 }
 
 /** make a version */
@@ -223,18 +274,26 @@ void PersistenceManager::make_version(const subgroup_id_t& subgroup_id,
     }
 }
 
-/** shutdown the thread
- * @wait - wait till the thread finished or not.
+/** shutdown the threads
+ * @wait - wait till the threads finished or not.
  */
 void PersistenceManager::shutdown(bool wait) {
     // if(replicated_objects == nullptr) return;  //skip for raw subgroups - NO DON'T
 
-    dbg_default_debug("PersistenceManager thread shutting down");
+    dbg_default_debug("PersistenceManager threads shutting down");
     thread_shutdown = true;
-    sem_post(&persistence_request_sem);  // kick the persistence thread in case it is sleeping
+    for(auto& worker : workers) {
+        // take the lock so a thread can't miss the flag between checking it and going to sleep
+        { std::lock_guard<std::mutex> lock(worker->queue_mutex); }
+        worker->queue_cv.notify_all();  // kick the persistence thread in case it is sleeping
+    }
 
     if(wait) {
-        this->persist_thread.join();
+        for(auto& worker : workers) {
+            if(worker->thread.joinable()) {
+                worker->thread.join();
+            }
+        }
     }
 }
 }  // namespace derecho
@@ -7,8 +7,16 @@
 #include "derecho/core/detail/view_manager.hpp"
 #include "derecho/persistent/Persistent.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iterator>
+#include <mutex>
 #include <optional>
+#include <queue>
+#include <thread>
+#include <vector>
 
 namespace derecho {
 
@@ -108,65 +116,131 @@ RestartLeaderState::RestartLeaderState(std::unique_ptr<View> _curr_view, Restart
 }
 
 void RestartLeaderState::await_quorum(tcp::connection_listener& server_socket) {
-    bool ready_to_restart = false;
-    int time_remaining_ms = getConfUInt32(CONF_DERECHO_RESTART_TIMEOUT_MS);
-    while(time_remaining_ms > 0) {
-        using namespace std::chrono;
+    using namespace std::chrono;
+    const int restart_timeout_ms = getConfUInt32(CONF_DERECHO_RESTART_TIMEOUT_MS);
+    const uint32_t num_intake_threads = std::max(getConfUInt32(CONF_DERECHO_RESTART_INTAKE_THREADS), 1u);
+    //How long the accept loop waits before checking whether the intake threads have found every member
+    const int accept_poll_interval_ms = 10;
+
+    //Accepted sockets waiting for an intake thread, and the number of handshakes under way
+    std::queue<tcp::socket> accepted_sockets;
+    uint32_t num_intakes_in_progress = 0;
+    bool stop_intake = false;
+    std::mutex accepted_sockets_mutex;
+    std::condition_variable accepted_sockets_cv;
+    std::vector<std::thread> intake_threads;
+    for(uint32_t i = 0; i < num_intake_threads; ++i) {
+        intake_threads.emplace_back([&]() {
+            pthread_setname_np(pthread_self(), "restart_intake");
+            std::unique_lock<std::mutex> lock(accepted_sockets_mutex);
+            while(true) {
+                accepted_sockets_cv.wait(lock, [&]() { return stop_intake || !accepted_sockets.empty(); });
+                if(accepted_sockets.empty()) {
+                    return;
+                }
+                tcp::socket client_socket = std::move(accepted_sockets.front());
+                accepted_sockets.pop();
+                num_intakes_in_progress++;
+                lock.unlock();
+                intake_joiner(std::move(client_socket));
+                lock.lock();
+                num_intakes_in_progress--;
+                accepted_sockets_cv.notify_all();
+            }
+        });
+    }
+
+    int time_remaining_ms = restart_timeout_ms;
+    while(true) {
         auto start_time = high_resolution_clock::now();
-        std::optional<tcp::socket> client_socket = server_socket.try_accept(time_remaining_ms);
+        std::optional<tcp::socket> client_socket = server_socket.try_accept(std::min(time_remaining_ms, accept_poll_interval_ms));
         auto end_time = high_resolution_clock::now();
-        milliseconds time_waited = duration_cast<milliseconds>(end_time - start_time);
-        time_remaining_ms -= time_waited.count();
+        time_remaining_ms -= duration_cast<milliseconds>(end_time - start_time).count();
         if(client_socket) {
-            uint64_t joiner_version_code;
-            client_socket->exchange(my_version_hashcode, joiner_version_code);
-            if(joiner_version_code != my_version_hashcode) {
-                rls_default_warn("Rejected a connection from client at {}. Client was running on an incompatible platform or used an incompatible compiler.", client_socket->get_remote_ip());
-                continue;
-            }
-            JoinRequest join_request;
-            client_socket->read(join_request);
-            client_socket->write(JoinResponse{JoinResponseCode::TOTAL_RESTART, my_id});
-            dbg_default_debug("Node {} rejoined", join_request.joiner_id);
-            if(join_request.is_external) {
-                dbg_default_debug("Rejected request from external client {} during total restart", join_request.joiner_id);
-                continue;
-            }
-            rejoined_node_ids.emplace(join_request.joiner_id);
-            //Receive and process the joining node's logs of the last known View and RaggedTrim
-            receive_joiner_logs(join_request.joiner_id, *client_socket);
-
-            //Receive the joining node's ports - this is part of the standard join logic
-            uint16_t joiner_gms_port = 0;
-            client_socket->read(joiner_gms_port);
-            uint16_t joiner_state_transfer_port = 0;
-            client_socket->read(joiner_state_transfer_port);
-            uint16_t joiner_sst_port = 0;
-            client_socket->read(joiner_sst_port);
-            uint16_t joiner_rdmc_port = 0;
-            client_socket->read(joiner_rdmc_port);
-            uint16_t joiner_external_port = 0;
-            client_socket->read(joiner_external_port);
-            const ip_addr_t& joiner_ip = client_socket->get_remote_ip();
-            rejoined_node_ips_and_ports[join_request.joiner_id] = {joiner_ip, joiner_gms_port,
-                                                                   joiner_state_transfer_port, joiner_sst_port,
-                                                                   joiner_rdmc_port, joiner_external_port};
-            //Done receiving from this socket (for now), so store it in waiting_join_sockets for later
-            waiting_join_sockets.emplace(join_request.joiner_id, std::move(*client_socket));
-            //Check for quorum
-            ready_to_restart = has_restart_quorum();
-            //If all the members have rejoined, no need to keep waiting
-            if(std::includes(rejoined_node_ids.begin(), rejoined_node_ids.end(),
-                             last_known_view_members.begin(), last_known_view_members.end())) {
-                return;
-            }
-        } else if(!ready_to_restart) {
-            //Accept timed out, but we haven't heard from enough nodes yet, so reset the timer
-            time_remaining_ms = getConfUInt32(CONF_DERECHO_RESTART_TIMEOUT_MS);
+            std::lock_guard<std::mutex> lock(accepted_sockets_mutex);
+            accepted_sockets.emplace(std::move(*client_socket));
+            accepted_sockets_cv.notify_one();
+        }
+        bool all_members_rejoined;
+        {
+            std::lock_guard<std::mutex> lock(intake_mutex);
+            all_members_rejoined = std::includes(rejoined_node_ids.begin(), rejoined_node_ids.end(),
+                                                 last_known_view_members.begin(), last_known_view_members.end());
+        }
+        if(!all_members_rejoined && time_remaining_ms > 0) {
+            continue;
         }
+        //Let the nodes that were already accepted finish their handshakes before deciding
+        {
+            std::unique_lock<std::mutex> lock(accepted_sockets_mutex);
+            accepted_sockets_cv.wait(lock, [&]() { return accepted_sockets.empty() && num_intakes_in_progress == 0; });
+        }
+        std::lock_guard<std::mutex> lock(intake_mutex);
+        //If all the members have rejoined, no need to keep waiting
+        if(std::includes(rejoined_node_ids.begin(), rejoined_node_ids.end(),
+                         last_known_view_members.begin(), last_known_view_members.end())
+           || ready_to_restart) {
+            break;
+        }
+        //Timed out, but we haven't heard from enough nodes yet, so reset the timer
+        time_remaining_ms = restart_timeout_ms;
+    }
+    {
+        std::lock_guard<std::mutex> lock(accepted_sockets_mutex);
+        stop_intake = true;
+    }
+    accepted_sockets_cv.notify_all();
+    for(auto& intake_thread : intake_threads) {
+        intake_thread.join();
     }
 }
 
+void RestartLeaderState::intake_joiner(tcp::socket client_socket) {
+    JoinRequest join_request;
+    JoinerLogs joiner_logs;
+    IpAndPorts joiner_ips_and_ports;
+    //This socket carries the joiner's logs, so size its buffers like the state transfer sockets
+    tcp::set_socket_buffer_sizes(client_socket, getConfInt32(CONF_DERECHO_STATE_TRANSFER_SOCKET_BUFFER_SIZE));
+    try {
+        uint64_t joiner_version_code;
+        client_socket.exchange(my_version_hashcode, joiner_version_code);
+        if(joiner_version_code != my_version_hashcode) {
+            rls_default_warn("Rejected a connection from client at {}. Client was running on an incompatible platform or used an incompatible compiler.", client_socket.get_remote_ip());
+            return;
+        }
+        client_socket.read(join_request);
+        client_socket.write(JoinResponse{JoinResponseCode::TOTAL_RESTART, my_id});
+        dbg_default_debug("Node {} rejoined", join_request.joiner_id);
+        if(join_request.is_external) {
+            dbg_default_debug("Rejected request from external client {} during total restart", join_request.joiner_id);
+            return;
+        }
+        //Receive the joining node's logs of the last known View and RaggedTrim
+        joiner_logs = receive_joiner_logs(client_socket);
+
+        //Receive the joining node's ports - this is part of the standard join logic
+        joiner_ips_and_ports.ip_address = client_socket.get_remote_ip();
+        struct iovec port_iovecs[] = {{&joiner_ips_and_ports.gms_port, sizeof(uint16_t)},
+                                      {&joiner_ips_and_ports.state_transfer_port, sizeof(uint16_t)},
+                                      {&joiner_ips_and_ports.sst_port, sizeof(uint16_t)},
+                                      {&joiner_ips_and_ports.rdmc_port, sizeof(uint16_t)},
+                                      {&joiner_ips_and_ports.external_port, sizeof(uint16_t)}};
+        client_socket.readv(port_iovecs, std::size(port_iovecs));
+    } catch(tcp::socket_error&) {
+        rls_default_warn("Node at {} failed during its restart handshake; ignoring it", client_socket.get_remote_ip());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(intake_mutex);
+    rejoined_node_ids.emplace(join_request.joiner_id);
+    merge_joiner_logs(join_request.joiner_id, std::move(joiner_logs));
+    rejoined_node_ips_and_ports[join_request.joiner_id] = joiner_ips_and_ports;
+    //Done receiving from this socket (for now), so store it in waiting_join_sockets for later
+    waiting_join_sockets.emplace(join_request.joiner_id, std::move(client_socket));
+    //Check for quorum
+    ready_to_restart = has_restart_quorum();
+}
+
 bool RestartLeaderState::has_restart_quorum() {
     //Compute rejoined_node_ids.intersect(last_known_view_members)
     //but with a lot of unnecessary repetitive boilerplate because it's the STL
@@ -183,13 +257,42 @@ bool RestartLeaderState::has_restart_quorum() {
     return compute_restart_view();
 }
 
-void RestartLeaderState::receive_joiner_logs(const node_id_t& joiner_id, tcp::socket& client_socket) {
+RestartLeaderState::JoinerLogs RestartLeaderState::receive_joiner_logs(tcp::socket& client_socket) {
+    JoinerLogs joiner_logs;
     //Receive the joining node's saved View
     std::size_t size_of_view;
     client_socket.read(size_of_view);
-    uint8_t view_buffer[size_of_view];
-    client_socket.read(view_buffer, size_of_view);
-    std::unique_ptr<View> client_view = mutils::from_bytes<View>(nullptr, view_buffer);
+    std::vector<uint8_t> buffer(size_of_view);
+    client_socket.read(buffer.data(), size_of_view);
+    joiner_logs.view = mutils::from_bytes<View>(nullptr, buffer.data());
+    //Receive the number of RaggedTrims and the total size of their records, then all the records at once
+    std::size_t num_of_ragged_trims;
+    std::size_t ragged_trims_size;
+    struct iovec size_iovecs[] = {{&num_of_ragged_trims, sizeof(num_of_ragged_trims)},
+                                  {&ragged_trims_size, sizeof(ragged_trims_size)}};
+    client_socket.readv(size_iovecs, std::size(size_iovecs));
+    buffer.resize(ragged_trims_size);
+    client_socket.read(buffer.data(), ragged_trims_size);
+    //Each record is the size of a RaggedTrim followed by the serialized RaggedTrim
+    std::size_t offset = 0;
+    for(std::size_t i = 0; i < num_of_ragged_trims; ++i) {
+        std::size_t size_of_ragged_trim;
+        if(ragged_trims_size - offset < sizeof(size_of_ragged_trim)) {
+            throw tcp::socket_error("Ragged trim records from joiner are truncated");
+        }
+        std::memcpy(&size_of_ragged_trim, buffer.data() + offset, sizeof(size_of_ragged_trim));
+        offset += sizeof(size_of_ragged_trim);
+        if(ragged_trims_size - offset < size_of_ragged_trim) {
+            throw tcp::socket_error("Ragged trim records from joiner are truncated");
+        }
+        joiner_logs.ragged_trims.emplace_back(mutils::from_bytes<RaggedTrim>(nullptr, buffer.data() + offset));
+        offset += size_of_ragged_trim;
+    }
+    return joiner_logs;
+}
+
+void RestartLeaderState::merge_joiner_logs(const node_id_t& joiner_id, JoinerLogs joiner_logs) {
+    std::unique_ptr<View>& client_view = joiner_logs.view;
 
     if(client_view->vid > curr_view->vid) {
         dbg_default_trace("Node {} had newer view {}, replacing view {} and discarding ragged trim",
@@ -206,15 +309,7 @@ void RestartLeaderState::receive_joiner_logs(const node_id_t& joiner_id, tcp::so
             }
         }
     }
-    //Receive the joining node's RaggedTrims
-    std::size_t num_of_ragged_trims;
-    client_socket.read(num_of_ragged_trims);
-    for(std::size_t i = 0; i < num_of_ragged_trims; ++i) {
-        std::size_t size_of_ragged_trim;
-        client_socket.read(size_of_ragged_trim);
-        uint8_t buffer[size_of_ragged_trim];
-        client_socket.read(buffer, size_of_ragged_trim);
-        std::unique_ptr<RaggedTrim> ragged_trim = mutils::from_bytes<RaggedTrim>(nullptr, buffer);
+    for(std::unique_ptr<RaggedTrim>& ragged_trim : joiner_logs.ragged_trims) {
         dbg_default_trace("Received ragged trim for subgroup {}, shard {} from node {}",
                           ragged_trim->subgroup_id, ragged_trim->shard_num, joiner_id);
         /* If the joining node has an obsolete View, we only care about the
@@ -269,34 +364,42 @@ bool RestartLeaderState::compute_restart_view() {
 
 int64_t RestartLeaderState::send_restart_view() {
     members_sent_restart_view.clear();
+    //Serialize everything once, then send it to each member with a single writev
+    std::size_t view_buffer_size = mutils::bytes_size(*restart_view);
+    std::vector<uint8_t> view_buffer(view_buffer_size);
+    mutils::to_bytes(*restart_view, view_buffer.data());
+    std::size_t num_ragged_trims = multimap_size(restart_state.logged_ragged_trim);
+    //Unroll the maps and send each RaggedTrim individually, since it contains its subgroup_id and shard_num
+    std::vector<std::size_t> trim_buffer_sizes;
+    std::vector<std::vector<uint8_t>> trim_buffers;
+    for(const auto& subgroup_to_shard_map : restart_state.logged_ragged_trim) {
+        for(const auto& shard_trim_pair : subgroup_to_shard_map.second) {
+            trim_buffer_sizes.emplace_back(mutils::bytes_size(*shard_trim_pair.second));
+            trim_buffers.emplace_back(trim_buffer_sizes.back());
+            mutils::to_bytes(*shard_trim_pair.second, trim_buffers.back().data());
+        }
+    }
+    std::size_t leaders_buffer_size = mutils::bytes_size(nodes_with_longest_log);
+    std::vector<uint8_t> leaders_buffer(leaders_buffer_size);
+    mutils::to_bytes(nodes_with_longest_log, leaders_buffer.data());
+
+    std::vector<struct iovec> message_iovecs;
+    message_iovecs.push_back({&view_buffer_size, sizeof(view_buffer_size)});
+    message_iovecs.push_back({view_buffer.data(), view_buffer_size});
+    message_iovecs.push_back({&num_ragged_trims, sizeof(num_ragged_trims)});
+    for(std::size_t i = 0; i < trim_buffers.size(); ++i) {
+        message_iovecs.push_back({&trim_buffer_sizes[i], sizeof(std::size_t)});
+        message_iovecs.push_back({trim_buffers[i].data(), trim_buffer_sizes[i]});
+    }
+    message_iovecs.push_back({&leaders_buffer_size, sizeof(leaders_buffer_size)});
+    message_iovecs.push_back({leaders_buffer.data(), leaders_buffer_size});
+
     for(auto waiting_sockets_iter = waiting_join_sockets.begin();
         waiting_sockets_iter != waiting_join_sockets.end();) {
-        std::size_t view_buffer_size = mutils::bytes_size(*restart_view);
-        std::size_t leaders_buffer_size = mutils::bytes_size(nodes_with_longest_log);
-        uint8_t view_buffer[view_buffer_size];
-        uint8_t leaders_buffer[leaders_buffer_size];
         try {
-            dbg_default_debug("Sending post-recovery view {} to node {}", restart_view->vid, waiting_sockets_iter->first);
-            waiting_sockets_iter->second.write(view_buffer_size);
-            mutils::to_bytes(*restart_view, view_buffer);
-            waiting_sockets_iter->second.write(view_buffer, view_buffer_size);
-            dbg_default_debug("Sending ragged-trim information to node {}", waiting_sockets_iter->first);
-            std::size_t num_ragged_trims = multimap_size(restart_state.logged_ragged_trim);
-            waiting_sockets_iter->second.write(num_ragged_trims);
-            //Unroll the maps and send each RaggedTrim individually, since it contains its subgroup_id and shard_num
-            for(const auto& subgroup_to_shard_map : restart_state.logged_ragged_trim) {
-                for(const auto& shard_trim_pair : subgroup_to_shard_map.second) {
-                    std::size_t trim_buffer_size = mutils::bytes_size(*shard_trim_pair.second);
-                    uint8_t trim_buffer[trim_buffer_size];
-                    waiting_sockets_iter->second.write(trim_buffer_size);
-                    mutils::to_bytes(*shard_trim_pair.second, trim_buffer);
-                    waiting_sockets_iter->second.write(trim_buffer, trim_buffer_size);
-                }
-            }
-            dbg_default_debug("Sending longest-log locations to node {}", waiting_sockets_iter->first);
-            waiting_sockets_iter->second.write(leaders_buffer_size);
-            mutils::to_bytes(nodes_with_longest_log, leaders_buffer);
-            waiting_sockets_iter->second.write(leaders_buffer, leaders_buffer_size);
+            dbg_default_debug("Sending post-recovery view {}, ragged-trim information, and longest-log locations to node {}",
+                              restart_view->vid, waiting_sockets_iter->first);
+            waiting_sockets_iter->second.writev(message_iovecs.data(), message_iovecs.size());
             members_sent_restart_view.emplace(waiting_sockets_iter->first);
             waiting_sockets_iter++;
         } catch(tcp::socket_error& e) {
@@ -5,6 +5,7 @@
  */
 
 #include "derecho/core/detail/rpc_manager.hpp"
+#include "derecho/core/detail/replicated_interface.hpp"
 #include "derecho/core/detail/view_manager.hpp"
 
 #include <cassert>
@@ -13,7 +14,9 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 namespace derecho {
 
@@ -25,8 +28,10 @@ thread_local node_id_t RPCManager::rpc_caller_id;
 
 RPCManager::~RPCManager() {
     thread_shutdown = true;
-    if(rpc_listener_thread.joinable()) {
-        rpc_listener_thread.join();
+    for(std::thread& listener_thread : rpc_listener_threads) {
+        if(listener_thread.joinable()) {
+            listener_thread.join();
+        }
     }
 }
 
@@ -52,7 +57,8 @@ void RPCManager::create_connections() {
             getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE) + sizeof(header),
             view_manager.view_max_rpc_reply_payload_size + sizeof(header),
             false,
-            [this](const uint32_t node_id) { report_failure(node_id); }});
+            [this](const uint32_t node_id) { report_failure(node_id); },
+            num_receive_threads});
 }
 
 void RPCManager::destroy_remote_invocable_class(uint32_t instance_id) {
@@ -138,11 +144,29 @@ std::exception_ptr RPCManager::parse_and_receive(uint8_t* buf, std::size_t size,
 void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender_id,
                                      persistent::version_t version, uint64_t timestamp,
                                      uint8_t* msg_buf, uint32_t buffer_size) {
-    // WARNING: This assumes the current view doesn't change during execution!
-    // (It accesses curr_view without a lock).
-
     // set the thread local rpc_handler context
     _in_rpc_handler = true;
+    receive_rpc_message(subgroup_id, sender_id, version, timestamp, msg_buf, buffer_size);
+    // clear the thread local rpc_handler context
+    _in_rpc_handler = false;
+}
+
+void RPCManager::rpc_batch_handler(subgroup_id_t subgroup_id,
+                                   const std::vector<DeliveredRPCMessage>& messages,
+                                   ReplicatedObject* object) {
+    _in_rpc_handler = true;
+    object->deliver_versions(messages, [this, subgroup_id](const DeliveredRPCMessage& message) {
+        receive_rpc_message(subgroup_id, message.sender_id, message.version, message.timestamp_us,
+                            message.buf, message.size);
+    });
+    _in_rpc_handler = false;
+}
+
+void RPCManager::receive_rpc_message(subgroup_id_t subgroup_id, node_id_t sender_id,
+                                     persistent::version_t version, uint64_t timestamp,
+                                     uint8_t* msg_buf, uint32_t buffer_size) {
+    // WARNING: This assumes the current view doesn't change during execution!
+    // (It accesses curr_view without a lock).
 
     // Use the reply-buffer allocation lambda to detect whether parse_and_receive generated a reply
     size_t reply_size = 0;
@@ -207,9 +231,6 @@ void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender
         // Otherwise, the only thing to do is send the reply (if there was one)
         connections->send(sender_id, sst::MESSAGE_TYPE::RPC_REPLY, reply_buffer->seq_num);
     }
-
-    // clear the thread local rpc_handler context
-    _in_rpc_handler = false;
 }
 
 void RPCManager::p2p_message_handler(node_id_t sender_id, uint8_t* msg_buf) {
@@ -234,13 +255,22 @@ void RPCManager::p2p_message_handler(node_id_t sender_id, uint8_t* msg_buf) {
         // for cascading messages, we create a new thread.
         throw derecho::derecho_exception("Cascading P2P Send/Queries to be implemented!");
     } else {
-        // send to fifo queue.
-        std::unique_lock<std::mutex> lock(request_queue_mutex);
-        p2p_request_queue.emplace(sender_id, msg_buf);
-        request_queue_cv.notify_one();
+        // send to the fifo queue of the sender
+        p2p_request_queue& request_queue = get_request_queue(sender_id);
+        std::unique_lock<std::mutex> lock(request_queue.mutex);
+        request_queue.requests.emplace(sender_id, msg_buf);
+        request_queue.cv.notify_one();
     }
 }
 
+RPCManager::p2p_request_queue& RPCManager::get_request_queue(node_id_t sender_id) {
+    // The sender's connection is probed by receive thread (sender_id % num_receive_threads),
+    // and the senders of that thread are spread over its workers.
+    const uint32_t receive_thread = sender_id % num_receive_threads;
+    const uint32_t worker = (sender_id / num_receive_threads) % num_request_workers;
+    return *p2p_request_queues[receive_thread * num_request_workers + worker];
+}
+
 //This is always called while holding a write lock on view_manager.view_mutex
 void RPCManager::new_view_callback(const View& new_view) {
     connections->remove_connections(new_view.departed);
@@ -431,6 +461,15 @@ sst::P2PBufferHandle RPCManager::get_sendbuffer_ptr(uint32_t dest_id, sst::MESSA
     return *buffer;
 }
 
+std::optional<sst::P2PBufferHandle> RPCManager::try_get_sendbuffer_ptr(uint32_t dest_id, sst::MESSAGE_TYPE type) {
+    SharedLockedReference<View> view_and_lock = view_manager.get_current_view();
+    try {
+        return connections->get_sendbuffer_ptr(dest_id, type);
+    } catch(std::out_of_range& map_error) {
+        throw node_removed_from_group_exception(dest_id);
+    }
+}
+
 void RPCManager::send_p2p_message(node_id_t dest_id, subgroup_id_t dest_subgroup_id, uint64_t sequence_num,
                                   std::weak_ptr<AbstractPendingResults> pending_results_handle) {
     try {
@@ -452,7 +491,7 @@ void RPCManager::send_p2p_message(node_id_t dest_id, subgroup_id_t dest_subgroup
     }
 }
 
-void RPCManager::p2p_request_worker() {
+void RPCManager::p2p_request_worker(p2p_request_queue& request_queue) {
     pthread_setname_np(pthread_self(), "p2p_req_wkr");
     using namespace remote_invocation_utilities;
     const std::size_t header_size = header_space();
@@ -465,13 +504,13 @@ void RPCManager::p2p_request_worker() {
 
     while(!thread_shutdown) {
         {
-            std::unique_lock<std::mutex> lock(request_queue_mutex);
-            request_queue_cv.wait(lock, [&]() { return !p2p_request_queue.empty() || thread_shutdown; });
+            std::unique_lock<std::mutex> lock(request_queue.mutex);
+            request_queue.cv.wait(lock, [&]() { return !request_queue.requests.empty() || thread_shutdown; });
             if(thread_shutdown) {
                 break;
             }
-            request = p2p_request_queue.front();
-            p2p_request_queue.pop();
+            request = request_queue.requests.front();
+            request_queue.requests.pop();
         }
         retrieve_header(nullptr, request.msg_buf, payload_size, indx, received_from, flags);
         if(indx.is_reply || RPC_HEADER_FLAG_TST(flags, CASCADE)) {
@@ -512,8 +551,9 @@ void RPCManager::p2p_request_worker() {
     }
 }
 
-void RPCManager::p2p_receive_loop() {
-    pthread_setname_np(pthread_self(), "rpc_lsnr");
+void RPCManager::p2p_receive_loop(uint32_t thread_index) {
+    std::string thread_name = "rpc_lsnr_" + std::to_string(thread_index);
+    pthread_setname_np(pthread_self(), thread_name.c_str());
 
     // set the thread local rpc_handler context
     _in_rpc_handler = true;
@@ -522,9 +562,13 @@ void RPCManager::p2p_receive_loop() {
         std::unique_lock<std::mutex> lock(thread_start_mutex);
         thread_start_cv.wait(lock, [this]() { return thread_start; });
     }
-    dbg_default_debug("P2P listening thread started");
-    // start the fifo worker thread
-    request_worker_thread = std::thread(&RPCManager::p2p_request_worker, this);
+    dbg_default_debug("P2P listening thread {} started", thread_index);
+    // start the fifo worker threads for the senders of this thread's connections
+    std::vector<std::thread> request_worker_threads;
+    for(uint32_t worker = 0; worker < num_request_workers; ++worker) {
+        request_worker_threads.emplace_back(&RPCManager::p2p_request_worker, this,
+                                            std::ref(*p2p_request_queues[thread_index * num_request_workers + worker]));
+    }
 
     struct timespec last_time, cur_time;
     clock_gettime(CLOCK_REALTIME, &last_time);
@@ -537,7 +581,7 @@ void RPCManager::p2p_receive_loop() {
         // successful probe_all() and the call to p2p_message_handler)
         {
             SharedLockedReference<View> locked_view = view_manager.get_current_view();
-            auto optional_message = connections->probe_all();
+            auto optional_message = connections->probe_all(thread_index);
             if(optional_message) {
                 message_received = true;
                 auto message_handle = optional_message.value();
@@ -563,9 +607,15 @@ void RPCManager::p2p_receive_loop() {
             }
         }
     }
-    // stop fifo worker.
-    request_queue_cv.notify_one();
-    request_worker_thread.join();
+    // stop the fifo workers.
+    for(uint32_t worker = 0; worker < num_request_workers; ++worker) {
+        p2p_request_queue& request_queue = *p2p_request_queues[thread_index * num_request_workers + worker];
+        {
+            std::lock_guard<std::mutex> lock(request_queue.mutex);
+        }
+        request_queue.cv.notify_one();
+        request_worker_threads[worker].join();
+    }
 }
 
 node_id_t RPCManager::get_rpc_caller_id() {
@@ -0,0 +1,193 @@
+#include "derecho/core/detail/state_transfer.hpp"
+
+#include "derecho/conf/conf.hpp"
+#include "derecho/core/derecho_exception.hpp"
+#include "derecho/utils/logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+namespace derecho {
+
+#ifndef __SSE4_2__
+/** The lookup table of the byte-at-a-time CRC-32C, using the reflected polynomial */
+static const std::array<uint32_t, 256> crc32c_table = [] {
+    std::array<uint32_t, 256> table{};
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for(int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0);
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+#endif
+
+uint32_t crc32c(const uint8_t* buffer, std::size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+#ifdef __SSE4_2__
+    uint64_t crc64 = crc;
+    for(; size >= sizeof(uint64_t); size -= sizeof(uint64_t), buffer += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, buffer, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for(; size > 0; size--, buffer++) {
+        crc = _mm_crc32_u8(crc, *buffer);
+    }
+#else
+    for(; size > 0; size--, buffer++) {
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ *buffer) & 0xFF];
+    }
+#endif
+    return ~crc;
+}
+
+StateTransferWriter::StateTransferWriter(tcp::socket& socket)
+        : socket(socket),
+          chunk_size(std::clamp<uint64_t>(getConfUInt64(CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE), 4096, UINT32_MAX)),
+          use_checksums(getConfBoolean(CONF_DERECHO_STATE_TRANSFER_CHECKSUMS)),
+          chunk(std::make_unique<uint8_t[]>(chunk_size)),
+          chunk_used(0),
+          offset(0) {}
+
+void StateTransferWriter::send_chunk(const uint8_t* buffer, std::size_t size) {
+    StateTransferChunkHeader header{};
+    header.offset = offset;
+    header.size = static_cast<uint32_t>(size);
+    header.has_checksum = use_checksums ? 1 : 0;
+    if(use_checksums) {
+        header.checksum = crc32c(buffer, size);
+    }
+    struct iovec chunk_iovecs[] = {{&header, sizeof(header)},
+                                   {const_cast<uint8_t*>(buffer), size}};
+    socket.writev(chunk_iovecs, 2);
+    offset += size;
+}
+
+void StateTransferWriter::write(const uint8_t* bytes, std::size_t size) {
+    while(size > 0) {
+        if(chunk_used == 0 && size >= chunk_size) {
+            // A whole chunk is available in the caller's buffer, so send it without copying it.
+            send_chunk(bytes, chunk_size);
+            bytes += chunk_size;
+            size -= chunk_size;
+            continue;
+        }
+        const std::size_t copy_size = std::min(size, chunk_size - chunk_used);
+        std::memcpy(chunk.get() + chunk_used, bytes, copy_size);
+        chunk_used += copy_size;
+        bytes += copy_size;
+        size -= copy_size;
+        if(chunk_used == chunk_size) {
+            send_chunk(chunk.get(), chunk_used);
+            chunk_used = 0;
+        }
+    }
+}
+
+void StateTransferWriter::write_file(int fd, off_t file_offset, std::size_t size) {
+    assert(!use_checksums);
+    // The bytes already written come first in the object
+    if(chunk_used > 0) {
+        send_chunk(chunk.get(), chunk_used);
+        chunk_used = 0;
+    }
+    while(size > 0) {
+        const std::size_t piece_size = std::min(size, chunk_size);
+        StateTransferChunkHeader header{};
+        header.offset = offset;
+        header.size = static_cast<uint32_t>(piece_size);
+        socket.write(header);
+        socket.sendfile(fd, file_offset, piece_size);
+        offset += piece_size;
+        file_offset += piece_size;
+        size -= piece_size;
+    }
+}
+
+std::size_t StateTransferWriter::finish() {
+    if(chunk_used > 0) {
+        send_chunk(chunk.get(), chunk_used);
+        chunk_used = 0;
+    }
+    StateTransferChunkHeader end_marker{};
+    end_marker.offset = offset;
+    socket.write(end_marker);
+    return offset;
+}
+
+StateTransferBuffer::StateTransferBuffer()
+        : buffer(nullptr), capacity(0), received_size(0), object_size(0) {}
+
+StateTransferBuffer::~StateTransferBuffer() {
+    if(buffer != nullptr) {
+        munmap(buffer, capacity);
+    }
+}
+
+void StateTransferBuffer::reserve(std::size_t new_capacity) {
+    if(new_capacity <= capacity) {
+        return;
+    }
+    // Double the capacity to keep the number of remappings logarithmic in the object size.
+    new_capacity = std::max(new_capacity, capacity * 2);
+    void* new_buffer;
+    if(buffer == nullptr) {
+        new_buffer = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        new_buffer = mremap(buffer, capacity, new_capacity, MREMAP_MAYMOVE);
+    }
+    if(new_buffer == MAP_FAILED) {
+        throw derecho_exception("Failed to allocate a state transfer buffer of " + std::to_string(new_capacity)
+                                + " bytes: " + std::strerror(errno));
+    }
+    buffer = static_cast<uint8_t*>(new_buffer);
+    capacity = new_capacity;
+}
+
+bool StateTransferBuffer::receive_chunk(tcp::socket& socket) {
+    StateTransferChunkHeader header;
+    socket.read(header);
+    // The sender sends the chunks in order, so any other offset means the stream is corrupt,
+    // and trusting it could make the receiver write (or allocate) far outside the object.
+    if(header.offset != received_size || header.has_checksum > 1) {
+        throw derecho_exception("Invalid state transfer chunk header (offset " + std::to_string(header.offset)
+                                + ", size " + std::to_string(header.size) + ") after "
+                                + std::to_string(received_size) + " bytes from " + socket.get_remote_ip());
+    }
+    if(header.size == 0) {
+        object_size = received_size;
+        // An empty object still needs a valid buffer.
+        reserve(std::max<std::size_t>(object_size, 1));
+        return false;
+    }
+    reserve(received_size + header.size);
+    uint8_t* chunk = buffer + received_size;
+    socket.read(chunk, header.size);
+    if(header.has_checksum && crc32c(chunk, header.size) != header.checksum) {
+        throw derecho_exception("Checksum mismatch in the state transfer chunk at offset "
+                                + std::to_string(header.offset) + " from " + socket.get_remote_ip());
+    }
+    received_size += header.size;
+    return true;
+}
+
+void StateTransferBuffer::receive(tcp::socket& socket) {
+    while(receive_chunk(socket)) {
+    }
+    dbg_default_trace("Received an object of {} bytes from {}", object_size, socket.get_remote_ip());
+}
+
+}  // namespace derecho
@@ -18,6 +18,10 @@
 #include <mutils/macro_utils.hpp>
 
 #include <arpa/inet.h>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <set>
 #include <tuple>
 
 namespace derecho {
@@ -41,7 +45,8 @@ ViewManager::ViewManager(
           subgroup_type_order(subgroup_type_order),
           tcp_sockets(getConfUInt32(CONF_DERECHO_LOCAL_ID),
                       {{getConfUInt32(CONF_DERECHO_LOCAL_ID),
-                        {getConfString(CONF_DERECHO_LOCAL_IP), getConfUInt16(CONF_DERECHO_STATE_TRANSFER_PORT)}}}),
+                        {getConfString(CONF_DERECHO_LOCAL_IP), getConfUInt16(CONF_DERECHO_STATE_TRANSFER_PORT)}}},
+                      getConfInt32(CONF_DERECHO_STATE_TRANSFER_SOCKET_BUFFER_SIZE)),
           subgroup_objects(object_pointer_map),
           any_persistent_objects(any_persistent_objects),
           persistence_manager(persistence_manager) {
@@ -239,6 +244,8 @@ bool ViewManager::receive_initial_view() {
     in_total_restart = (leader_response.code == JoinResponseCode::TOTAL_RESTART);
     if(in_total_restart) {
         dbg_default_info("Logged state found on disk. Restarting in recovery mode.");
+        //This socket carries the logs exchanged during the restart, so size its buffers like the state transfer sockets
+        tcp::set_socket_buffer_sizes(*leader_connection, getConfInt32(CONF_DERECHO_STATE_TRANSFER_SOCKET_BUFFER_SIZE));
         dbg_default_debug("Sending view {} to leader", curr_view->vid);
         auto leader_socket_write = [this](const uint8_t* bytes, std::size_t size) {
             leader_connection->write(bytes, size);
@@ -251,16 +258,27 @@ bool ViewManager::receive_initial_view() {
             //Now that we know we need them, load ragged trims from disk
             restart_state->load_ragged_trim(*curr_view);
             dbg_default_debug("In restart mode, sending {} ragged trims to leader", restart_state->logged_ragged_trim.size());
-            /* Protocol: Send the number of RaggedTrim objects, then serialize each RaggedTrim */
+            /* Protocol: Send the number of RaggedTrim objects and the total size of their records,
+             * then a record for each RaggedTrim: its size, followed by the serialized RaggedTrim */
             /* Since we know this node is only a member of one shard per subgroup,
              * the size of the outer map (subgroup IDs) is the number of RaggedTrims. */
-            leader_connection->write(restart_state->logged_ragged_trim.size());
+            //Serialize them all, each preceded by its size, so they can be sent with one system call
+            std::size_t num_ragged_trims = restart_state->logged_ragged_trim.size();
+            std::vector<uint8_t> ragged_trims_buffer;
             for(const auto& id_to_shard_map : restart_state->logged_ragged_trim) {
                 assert(id_to_shard_map.second.size() == 1);  //The inner map has one entry
                 const std::unique_ptr<RaggedTrim>& ragged_trim = id_to_shard_map.second.begin()->second;
-                leader_connection->write(mutils::bytes_size(*ragged_trim));
-                mutils::post_object(leader_socket_write, *ragged_trim);
+                std::size_t trim_size = mutils::bytes_size(*ragged_trim);
+                std::size_t offset = ragged_trims_buffer.size();
+                ragged_trims_buffer.resize(offset + sizeof(trim_size) + trim_size);
+                std::memcpy(ragged_trims_buffer.data() + offset, &trim_size, sizeof(trim_size));
+                mutils::to_bytes(*ragged_trim, ragged_trims_buffer.data() + offset + sizeof(trim_size));
             }
+            std::size_t ragged_trims_size = ragged_trims_buffer.size();
+            struct iovec ragged_trim_iovecs[] = {{&num_ragged_trims, sizeof(num_ragged_trims)},
+                                                 {&ragged_trims_size, sizeof(ragged_trims_size)},
+                                                 {ragged_trims_buffer.data(), ragged_trims_size}};
+            leader_connection->writev(ragged_trim_iovecs, std::size(ragged_trim_iovecs));
         } catch(tcp::socket_error& e) {
             //If any of the leader socket operations throws an error, stop and return false
             return false;
@@ -270,11 +288,12 @@ bool ViewManager::receive_initial_view() {
         restart_state.reset();
     }
     try {
-        leader_connection->write(getConfUInt16(CONF_DERECHO_GMS_PORT));
-        leader_connection->write(getConfUInt16(CONF_DERECHO_STATE_TRANSFER_PORT));
-        leader_connection->write(getConfUInt16(CONF_DERECHO_SST_PORT));
-        leader_connection->write(getConfUInt16(CONF_DERECHO_RDMC_PORT));
-        leader_connection->write(getConfUInt16(CONF_DERECHO_EXTERNAL_PORT));
+        uint16_t my_ports[] = {getConfUInt16(CONF_DERECHO_GMS_PORT),
+                               getConfUInt16(CONF_DERECHO_STATE_TRANSFER_PORT),
+                               getConfUInt16(CONF_DERECHO_SST_PORT),
+                               getConfUInt16(CONF_DERECHO_RDMC_PORT),
+                               getConfUInt16(CONF_DERECHO_EXTERNAL_PORT)};
+        leader_connection->write(reinterpret_cast<const uint8_t*>(my_ports), sizeof(my_ports));
     } catch(tcp::socket_error& e) {
         return false;
     }
@@ -489,7 +508,9 @@ void ViewManager::send_logs() {
                 //Send object data to all shard members, since they will all be in receive_objects()
                 for(node_id_t shard_member : restart_view.subgroup_shard_views[subgroup_id][shard].members) {
                     if(shard_member != my_id) {
-                        send_subgroup_object(subgroup_id, shard_member);
+                        LockedReference<std::unique_lock<std::mutex>, tcp::socket> member_socket
+                                = tcp_sockets.get_socket(shard_member);
+                        send_subgroup_object(subgroup_id, member_socket.get());
                     }
                 }
             }
@@ -574,11 +595,12 @@ void ViewManager::await_first_view() {
                     continue;
                 }
                 client_socket.write(JoinResponse{JoinResponseCode::OK, my_id});
-                client_socket.read(joiner_gms_port);
-                client_socket.read(joiner_state_transfer_port);
-                client_socket.read(joiner_sst_port);
-                client_socket.read(joiner_rdmc_port);
-                client_socket.read(joiner_external_port);
+                struct iovec port_iovecs[] = {{&joiner_gms_port, sizeof(joiner_gms_port)},
+                                              {&joiner_state_transfer_port, sizeof(joiner_state_transfer_port)},
+                                              {&joiner_sst_port, sizeof(joiner_sst_port)},
+                                              {&joiner_rdmc_port, sizeof(joiner_rdmc_port)},
+                                              {&joiner_external_port, sizeof(joiner_external_port)}};
+                client_socket.readv(port_iovecs, std::size(port_iovecs));
             } catch(tcp::socket_error& ex) {
                 dbg_default_info("TCP connection to {} failed during join-request handshake. Ignoring request.", client_socket.get_remote_ip());
                 dbg_default_debug("Error description: {}", ex.what());
@@ -1464,6 +1486,8 @@ void ViewManager::finish_view_change(DerechoSST& gmsSST) {
     // Determine the shard leaders in the old view and re-index them by new subgroup IDs
     vector_int64_2d old_shard_leaders_by_id = old_shard_leaders_by_new_ids(
             *curr_view, *next_view);
+    // Spread the state transfers of this view change over the shard members
+    vector_int64_2d state_transfer_senders = choose_state_transfer_senders(*next_view, old_shard_leaders_by_id);
 
     std::list<tcp::socket> joiner_sockets;
     if(active_leader && next_view->joined.size() > 0) {
@@ -1473,13 +1497,13 @@ void ViewManager::finish_view_change(DerechoSST& gmsSST) {
         for(std::size_t c = 0; c < next_view->joined.size(); ++c) {
             dbg_default_debug("Sending joining node {} the new view over the joiner socket", proposed_join_sockets.front().first);
             send_view(*next_view, proposed_join_sockets.front().second);
-            std::size_t size_of_vector = mutils::bytes_size(old_shard_leaders_by_id);
-            dbg_default_debug("Sending node {} the old shard leaders vector on the joiner socket. size_of_vector is {}", proposed_join_sockets.front().first, size_of_vector);
+            std::size_t size_of_vector = mutils::bytes_size(state_transfer_senders);
+            dbg_default_debug("Sending node {} the state transfer senders vector on the joiner socket. size_of_vector is {}", proposed_join_sockets.front().first, size_of_vector);
             proposed_join_sockets.front().second.write(size_of_vector);
             mutils::post_object([this](const uint8_t* bytes, std::size_t size) {
                 proposed_join_sockets.front().second.write(bytes, size);
             },
-                                old_shard_leaders_by_id);
+                                state_transfer_senders);
             // save the socket for the commit step
             joiner_sockets.emplace_back(std::move(proposed_join_sockets.front().second));
             proposed_join_sockets.pop_front();
@@ -1488,13 +1512,13 @@ void ViewManager::finish_view_change(DerechoSST& gmsSST) {
 
     // Set up TCP connections to the joined nodes
     update_tcp_connections();
-    // After doing that, shard leaders can send them RPC objects over state_transfer_port
-    send_objects_to_new_members(old_shard_leaders_by_id);
+    // After doing that, the chosen shard members can send them RPC objects over state_transfer_port
+    send_objects_to_new_members(state_transfer_senders);
 
     // Re-initialize this node's RPC objects, which includes receiving them
-    // from shard leaders if it is newly a member of a subgroup
+    // from shard members if it is newly a member of a subgroup
     dbg_default_debug("Receiving state for local Replicated Objects");
-    initialize_subgroup_objects(my_id, *next_view, old_shard_leaders_by_id);
+    initialize_subgroup_objects(my_id, *next_view, state_transfer_senders);
 
     // Once state transfer completes, we can tell joining clients to commit the view
     if(active_leader) {
@@ -1667,11 +1691,12 @@ bool ViewManager::receive_join(DerechoSST& gmsSST, const node_id_t joiner_id, tc
         }
         client_socket.write(JoinResponse{JoinResponseCode::OK, my_id});
 
-        client_socket.read(joiner_gms_port);
-        client_socket.read(joiner_state_transfer_port);
-        client_socket.read(joiner_sst_port);
-        client_socket.read(joiner_rdmc_port);
-        client_socket.read(joiner_external_port);
+        struct iovec port_iovecs[] = {{&joiner_gms_port, sizeof(joiner_gms_port)},
+                                      {&joiner_state_transfer_port, sizeof(joiner_state_transfer_port)},
+                                      {&joiner_sst_port, sizeof(joiner_sst_port)},
+                                      {&joiner_rdmc_port, sizeof(joiner_rdmc_port)},
+                                      {&joiner_external_port, sizeof(joiner_external_port)}};
+        client_socket.readv(port_iovecs, std::size(port_iovecs));
     } catch(tcp::socket_error& ex) {
         dbg_default_warn("TCP connection to node {} at IP {} failed during join-request handshake. Ignoring request.", joiner_id, client_socket.get_remote_ip());
         dbg_default_debug("Socket error description: {}", ex.what());
@@ -1784,42 +1809,80 @@ void ViewManager::send_view(const View& new_view, tcp::socket& client_socket) {
     mutils::post_object(bind_socket_write, new_view);
 }
 
-void ViewManager::send_objects_to_new_members(const vector_int64_2d& old_shard_leaders) {
+void ViewManager::send_objects_to_new_members(const vector_int64_2d& state_transfer_senders) {
     node_id_t my_id = next_view->members[next_view->my_rank];
-    for(subgroup_id_t subgroup_id = 0; subgroup_id < old_shard_leaders.size(); ++subgroup_id) {
-        for(uint32_t shard = 0; shard < old_shard_leaders[subgroup_id].size(); ++shard) {
-            //if I was the leader of the shard in the old view...
-            if(my_id == old_shard_leaders[subgroup_id][shard]) {
+    // The subgroups whose state this node sends to each new member, in ascending order of subgroup ID
+    std::map<node_id_t, std::vector<subgroup_id_t>> subgroups_by_joiner;
+    for(subgroup_id_t subgroup_id = 0; subgroup_id < state_transfer_senders.size(); ++subgroup_id) {
+        for(uint32_t shard = 0; shard < state_transfer_senders[subgroup_id].size(); ++shard) {
+            //if I was chosen to send the shard's state...
+            if(my_id == state_transfer_senders[subgroup_id][shard]) {
                 //send its object state to the new members
                 for(node_id_t shard_joiner : next_view->subgroup_shard_views[subgroup_id][shard].joined) {
                     if(shard_joiner != my_id) {
-                        send_subgroup_object(subgroup_id, shard_joiner);
+                        subgroups_by_joiner[shard_joiner].push_back(subgroup_id);
                     }
                 }
             }
         }
     }
+    if(subgroups_by_joiner.empty()) {
+        return;
+    }
+    LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, tcp::socket>> sockets
+            = tcp_sockets.get_all_sockets();
+    auto send_to_joiner = [this, &sockets](node_id_t joiner, const std::vector<subgroup_id_t>& subgroup_ids) {
+        tcp::socket& joiner_socket = sockets.get().at(joiner);
+        for(subgroup_id_t subgroup_id : subgroup_ids) {
+            send_subgroup_object(subgroup_id, joiner_socket);
+        }
+    };
+    if(subgroups_by_joiner.size() == 1) {
+        send_to_joiner(subgroups_by_joiner.begin()->first, subgroups_by_joiner.begin()->second);
+        return;
+    }
+    // Each joiner has its own socket, so the joiners can be served concurrently
+    std::vector<std::thread> sender_threads;
+    std::vector<std::exception_ptr> errors(subgroups_by_joiner.size());
+    for(const auto& joiner_and_subgroups : subgroups_by_joiner) {
+        std::size_t thread_index = sender_threads.size();
+        sender_threads.emplace_back([&, thread_index]() {
+            pthread_setname_np(pthread_self(), "state_xfer");
+            try {
+                send_to_joiner(joiner_and_subgroups.first, joiner_and_subgroups.second);
+            } catch(...) {
+                errors[thread_index] = std::current_exception();
+            }
+        });
+    }
+    for(auto& thread : sender_threads) {
+        thread.join();
+    }
+    for(const auto& error : errors) {
+        if(error) {
+            std::rethrow_exception(error);
+        }
+    }
 }
 
-/* Note for the future: Since this "send" requires first receiving the log tail length,
- * it's really a blocking receive-then-send. Since all nodes call send_subgroup_object
- * before initialize_subgroup_objects, there's a small chance of a deadlock: node A could
- * be attempting to send an object to node B at the same time as B is attempting to send a
- * different object to A, and neither node will be able to send the log tail length that
- * the other one is waiting on. */
-void ViewManager::send_subgroup_object(subgroup_id_t subgroup_id, node_id_t new_node_id) {
-    LockedReference<std::unique_lock<std::mutex>, tcp::socket> joiner_socket = tcp_sockets.get_socket(new_node_id);
+/* Since this "send" requires first receiving the log tail length, it's really a blocking
+ * receive-then-send. If node A attempted to send an object to node B at the same time as B
+ * attempted to send a different object to A, neither node would be able to send the log tail
+ * length that the other one is waiting on; choose_state_transfer_senders never makes a node
+ * that receives state in a view change send state in the same view change, unless the old
+ * shard leader is the only choice. */
+void ViewManager::send_subgroup_object(subgroup_id_t subgroup_id, tcp::socket& joiner_socket) {
     assert(subgroup_objects.find(subgroup_id) != subgroup_objects.end());
     ReplicatedObject* subgroup_object = subgroup_objects.at(subgroup_id);
     if(subgroup_object->is_persistent()) {
         //First, read the log tail length sent by the joining node
         persistent::version_t persistent_log_length = 0;
-        joiner_socket.get().read(persistent_log_length);
+        joiner_socket.read(persistent_log_length);
         persistent::PersistentRegistry::setEarliestVersionToSerialize(persistent_log_length);
-        dbg_default_debug("Got log tail length {} from {}", persistent_log_length, joiner_socket.get().get_remote_ip());
+        dbg_default_debug("Got log tail length {} from {}", persistent_log_length, joiner_socket.get_remote_ip());
     }
-    dbg_default_debug("Sending Replicated Object state for subgroup {} to node {} over the state-transfer socket", subgroup_id, new_node_id);
-    subgroup_object->send_object(joiner_socket.get());
+    dbg_default_debug("Sending Replicated Object state for subgroup {} to {} over the state-transfer socket", subgroup_id, joiner_socket.get_remote_ip());
+    subgroup_object->send_object(joiner_socket);
 }
 
 void ViewManager::update_tcp_connections() {
@@ -1926,7 +1989,9 @@ std::tuple<uint32_t, uint32_t, uint32_t> ViewManager::derive_subgroup_settings(V
             max_shard_senders = std::max(shard_view.num_senders(), max_shard_senders);
 
             const DerechoParams& profile = DerechoParams::from_profile(shard_view.profile);
-            uint32_t slot_size_for_shard = profile.window_size * (profile.sst_max_msg_size + sizeof(uint64_t));
+            uint32_t slot_size_for_shard = profile.packed_smc
+                                                   ? sst::multicast_group<DerechoSST>::packed_ring_size(profile.window_size, profile.sst_max_msg_size)
+                                                   : profile.window_size * (profile.sst_max_msg_size + sizeof(uint64_t));
             uint64_t payload_size = profile.max_msg_size - sizeof(header);
             max_payload_size = std::max(payload_size, max_payload_size);
             view_max_rpc_reply_payload_size = std::max(
@@ -2136,6 +2201,42 @@ vector_int64_2d ViewManager::old_shard_leaders_by_new_ids(const View& curr_view,
     return old_shard_leaders_by_new_id;
 }
 
+vector_int64_2d ViewManager::choose_state_transfer_senders(const View& next_view,
+                                                           const vector_int64_2d& old_shard_leaders) {
+    // The nodes that receive some shard's state in this view change
+    std::set<node_id_t> receivers;
+    for(subgroup_id_t subgroup_id = 0; subgroup_id < old_shard_leaders.size(); ++subgroup_id) {
+        for(uint32_t shard_num = 0; shard_num < old_shard_leaders[subgroup_id].size(); ++shard_num) {
+            if(old_shard_leaders[subgroup_id][shard_num] > -1) {
+                const std::vector<node_id_t>& joined = next_view.subgroup_shard_views[subgroup_id][shard_num].joined;
+                receivers.insert(joined.begin(), joined.end());
+            }
+        }
+    }
+    vector_int64_2d senders = old_shard_leaders;
+    for(subgroup_id_t subgroup_id = 0; subgroup_id < senders.size(); ++subgroup_id) {
+        for(uint32_t shard_num = 0; shard_num < senders[subgroup_id].size(); ++shard_num) {
+            const SubView& shard_view = next_view.subgroup_shard_views[subgroup_id][shard_num];
+            if(senders[subgroup_id][shard_num] == -1 || shard_view.joined.empty()) {
+                continue;
+            }
+            // Members that are not in joined were in this shard in the old view, so they have its state
+            std::vector<node_id_t> candidates;
+            for(node_id_t member : shard_view.members) {
+                if(std::find(shard_view.joined.begin(), shard_view.joined.end(), member) == shard_view.joined.end()
+                   && receivers.count(member) == 0) {
+                    candidates.push_back(member);
+                }
+            }
+            if(!candidates.empty()) {
+                senders[subgroup_id][shard_num]
+                        = candidates[(next_view.vid + subgroup_id + shard_num) % candidates.size()];
+            }
+        }
+    }
+    return senders;
+}
+
 bool ViewManager::suspected_not_equal(const DerechoSST& gmsSST, const std::vector<bool>& old) {
     for(unsigned int r = 0; r < gmsSST.get_num_rows(); r++) {
         for(size_t who = 0; who < gmsSST.suspected.size(); who++) {
@@ -2596,6 +2697,10 @@ LockedReference<std::unique_lock<std::mutex>, tcp::socket> ViewManager::get_tran
     return tcp_sockets.get_socket(member_id);
 }
 
+LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, tcp::socket>> ViewManager::get_transfer_sockets() {
+    return tcp_sockets.get_all_sockets();
+}
+
 void ViewManager::debug_print_status() const {
     std::cout << "curr_view = " << curr_view->debug_string() << std::endl;
 }
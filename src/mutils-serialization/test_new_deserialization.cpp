@@ -28,4 +28,11 @@ int main() {
 			assert(v3 == v.at(3));
             return;
 		});
+
+	deserialize_and_run(nullptr,c,[&](const vector_view<int>& view){
+			assert(view.size() == v.size());
+			assert(view.data() == (int*)(c + sizeof(int)));
+			assert(view.to_vector() == v);
+            return;
+		});
 }
@@ -6,12 +6,14 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <functional>
 #include <iostream>
 #include <string.h>
 #include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <vector>
 
 #if __GNUC__ > 7
 #include <filesystem>
@@ -29,6 +31,56 @@ namespace persistent {
 // internal structures //
 /////////////////////////
 
+// write the whole buffer to a file descriptor, retrying partial writes.
+static bool writeFully(int fd, const void* buf, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(buf);
+    while(len > 0) {
+        ssize_t nWrite = write(fd, p, len);
+        if(nWrite < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += nWrite;
+        len -= nWrite;
+    }
+    return true;
+}
+
+// round x up to a multiple of unit
+static uint64_t roundUp(uint64_t x, uint64_t unit) {
+    return ((x + unit - 1) / unit) * unit;
+}
+
+// the number of log entries in a log segment, rounded up to whole pages.
+static uint64_t getLogSegmentEntries() {
+    const uint64_t entries_per_page = getpagesize() / sizeof(LogEntry);
+    return roundUp(MAX(derecho::getConfUInt64(CONF_PERS_LOG_SEGMENT_ENTRIES), (uint64_t)1), entries_per_page);
+}
+
+// the size of a data segment, rounded up to whole pages.
+static uint64_t getDataSegmentSize() {
+    return roundUp(MAX(derecho::getConfUInt64(CONF_PERS_DATA_SEGMENT_SIZE), (uint64_t)1), getpagesize());
+}
+
+// call func on each segment file in dataPath, whose name is '<prefix>.<segment number>'.
+static void forEachSegmentFile(const std::string& dataPath, const std::string& prefix,
+                               const std::function<void(int64_t, const fs::path&)>& func) {
+    const std::string seg_prefix = prefix + ".";
+    for(const auto& dent : fs::directory_iterator(dataPath)) {
+        const std::string fname = dent.path().filename().string();
+        if(fname.size() <= seg_prefix.size() || fname.compare(0, seg_prefix.size(), seg_prefix) != 0) {
+            continue;
+        }
+        const std::string seg_str = fname.substr(seg_prefix.size());
+        if(seg_str.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        func(std::stoll(seg_str), dent.path());
+    }
+}
+
 ////////////////////////
 // visible to outside //
 ////////////////////////
@@ -39,10 +91,12 @@ FilePersistLog::FilePersistLog(const string& name, const string& dataPath, bool
           m_sMetaFile(dataPath + "/" + name + "." + META_FILE_SUFFIX),
           m_sLogFile(dataPath + "/" + name + "." + LOG_FILE_SUFFIX),
           m_sDataFile(dataPath + "/" + name + "." + DATA_FILE_SUFFIX),
-          m_iMaxLogEntry(derecho::getConfUInt64(CONF_PERS_MAX_LOG_ENTRY)),
-          m_iMaxDataSize(derecho::getConfUInt64(CONF_PERS_MAX_DATA_SIZE)),
-          m_iLogFileDesc(-1),
-          m_iDataFileDesc(-1),
+          m_iLogSegmentEntries(getLogSegmentEntries()),
+          m_iDataSegmentSize(getDataSegmentSize()),
+          // one more segment than the capacity, see the comment on MAX_LOG_ENTRY
+          m_iMaxLogEntry(roundUp(derecho::getConfUInt64(CONF_PERS_MAX_LOG_ENTRY), m_iLogSegmentEntries) + m_iLogSegmentEntries),
+          m_iMaxDataSize(roundUp(derecho::getConfUInt64(CONF_PERS_MAX_DATA_SIZE), m_iDataSegmentSize) + m_iDataSegmentSize),
+          m_iSnapshotInterval(derecho::getConfUInt64(CONF_PERS_SNAPSHOT_INTERVAL)),
           m_pLog(MAP_FAILED),
           m_pData(MAP_FAILED) {
     if(pthread_rwlock_init(&this->m_rwlock, NULL) != 0) {
@@ -66,13 +120,34 @@ void FilePersistLog::reset() {
             dbg_default_error("{0} reset failed to remove the file:{1}", this->m_sName, this->m_sMetaFile);
             throw PERSIST_EXP_REMOVE_FILE(errno);
         }
-        if(!fs::remove(this->m_sLogFile)) {
-            dbg_default_error("{0} reset failed to remove the file:{1}", this->m_sName, this->m_sLogFile);
-            throw PERSIST_EXP_REMOVE_FILE(errno);
+    }
+    // remove the segments and the snapshots, including the unfinished ones.
+    if(fs::exists(this->m_sDataPath)) {
+        auto remove_segment = [this](int64_t, const fs::path& path) {
+            if(!fs::remove(path)) {
+                dbg_default_error("{0} reset failed to remove the file:{1}", this->m_sName, path.string());
+                throw PERSIST_EXP_REMOVE_FILE(errno);
+            }
+        };
+        forEachSegmentFile(this->m_sDataPath, this->m_sName + "." + LOG_FILE_SUFFIX, remove_segment);
+        forEachSegmentFile(this->m_sDataPath, this->m_sName + "." + DATA_FILE_SUFFIX, remove_segment);
+        // the log and data files of the format before segments
+        for(const std::string& file : {this->m_sLogFile, this->m_sDataFile}) {
+            if(fs::exists(file) && !fs::remove(file)) {
+                dbg_default_error("{0} reset failed to remove the file:{1}", this->m_sName, file);
+                throw PERSIST_EXP_REMOVE_FILE(errno);
+            }
         }
-        if(!fs::remove(this->m_sDataFile)) {
-            dbg_default_error("{0} reset failed to remove the file:{1}", this->m_sName, this->m_sDataFile);
-            throw PERSIST_EXP_REMOVE_FILE(errno);
+        const std::string prefix = this->m_sName + ".";
+        for(const auto& dent : fs::directory_iterator(this->m_sDataPath)) {
+            const std::string fname = dent.path().filename().string();
+            if(fname.compare(0, prefix.size(), prefix) == 0
+               && (fname.find("." SNAPSHOT_FILE_SUFFIX, prefix.size()) != std::string::npos)) {
+                if(!fs::remove(dent.path())) {
+                    dbg_default_error("{0} reset failed to remove the file:{1}", this->m_sName, fname);
+                    throw PERSIST_EXP_REMOVE_FILE(errno);
+                }
+            }
         }
     }
     dbg_default_trace("{0} reset state...done", this->m_sName);
@@ -83,54 +158,26 @@ void FilePersistLog::load() {
     // STEP 0: check if data path exists
     checkOrCreateDir(this->m_sDataPath);
     dbg_default_trace("{0}:checkOrCreateDir passed.", this->m_sName);
-    // STEP 1: check and create files.
+    // STEP 1: check and create the meta file.
     bool bCreate = checkOrCreateMetaFile();
-    checkOrCreateLogFile();
-    checkOrCreateDataFile();
-    dbg_default_trace("{0}:checkOrCreateDataFile passed.", this->m_sName);
-    // STEP 2: open files
-    this->m_iLogFileDesc = open(this->m_sLogFile.c_str(), O_RDWR);
-    if(this->m_iLogFileDesc == -1) {
-        throw PERSIST_EXP_OPEN_FILE(errno);
-    }
-    this->m_iDataFileDesc = open(this->m_sDataFile.c_str(), O_RDWR);
-    if(this->m_iDataFileDesc == -1) {
-        throw PERSIST_EXP_OPEN_FILE(errno);
-    }
-    // STEP 3: mmap to memory
+    dbg_default_trace("{0}:checkOrCreateMetaFile passed.", this->m_sName);
+    // STEP 2: reserve the virtual memory for the ring buffers, the segments are mapped on top of it.
     //// we map the log entry and data twice to faciliate the search and data
     //// retrieving then the data is rewinding across the buffer end as follow:
     //// [1][2][3][4][5][6][1][2][3][4][5][6]
-    this->m_pLog = mmap(NULL, MAX_LOG_SIZE << 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if(this->m_pLog == MAP_FAILED) {
-        dbg_default_error("{0}:reserve map space for log failed.", this->m_sName);
-        throw PERSIST_EXP_MMAP_FILE(errno);
-    }
-    if(mmap(this->m_pLog, MAX_LOG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, this->m_iLogFileDesc, 0) == MAP_FAILED) {
-        dbg_default_error("{0}:map ringbuffer space for the first half of log failed. Is the size of log ringbuffer aligned to page?", this->m_sName);
-        throw PERSIST_EXP_MMAP_FILE(errno);
-    }
-    if(mmap((void*)((uint64_t)this->m_pLog + MAX_LOG_SIZE), MAX_LOG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, this->m_iLogFileDesc, 0) == MAP_FAILED) {
-        dbg_default_error("{0}:map ringbuffer space for the second half of log failed. Is the size of log ringbuffer aligned to page?", this->m_sName);
-        throw PERSIST_EXP_MMAP_FILE(errno);
-    }
+    this->m_pLog = reserveRing(MAX_LOG_SIZE);
     //// data ringbuffer
-    this->m_pData = mmap(NULL, (size_t)(MAX_DATA_SIZE << 1), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if(this->m_pData == MAP_FAILED) {
-        dbg_default_error("{0}:reserve map space for data failed.", this->m_sName);
-        throw PERSIST_EXP_MMAP_FILE(errno);
-    }
-    if(mmap(this->m_pData, (size_t)(MAX_DATA_SIZE), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, this->m_iDataFileDesc, 0) == MAP_FAILED) {
-        dbg_default_error("{0}:map ringbuffer space for the first half of data failed. Is the size of data ringbuffer aligned to page?", this->m_sName);
-        throw PERSIST_EXP_MMAP_FILE(errno);
-    }
-    if(mmap((void*)((uint64_t)this->m_pData + MAX_DATA_SIZE), (size_t)MAX_DATA_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, this->m_iDataFileDesc, 0) == MAP_FAILED) {
-        dbg_default_error("{0}:map ringbuffer space for the second half of data failed. Is the size of data ringbuffer aligned to page?", this->m_sName);
-        throw PERSIST_EXP_MMAP_FILE(errno);
-    }
-    dbg_default_trace("{0}:data/meta file mapped to memory", this->m_sName);
-    // STEP 4: initialize the header for new created Metafile
+    this->m_pData = reserveRing(MAX_DATA_SIZE);
+    // STEP 3: initialize the header for new created Metafile
     if(bCreate) {
+        // Without a meta file, the files of the format before segments are garbage. They must not be taken for
+        // this log's files after the new meta file is created.
+        if(hasOldLogFormat()) {
+            dbg_default_warn("{0}:removing the log and data files without a meta file.", this->m_sName);
+            std::error_code ec;
+            fs::remove(this->m_sLogFile, ec);
+            fs::remove(this->m_sDataFile, ec);
+        }
         m_currMetaHeader.fields.head = 0ll;
         m_currMetaHeader.fields.tail = 0ll;
         m_currMetaHeader.fields.ver = INVALID_VERSION;
@@ -166,14 +213,34 @@ void FilePersistLog::load() {
             }
             close(fd);
             m_currMetaHeader = m_persMetaHeader;
-            // update mhlc index
-            for(int64_t idx = m_currMetaHeader.fields.head; idx < m_currMetaHeader.fields.tail; idx++) {
-                struct hlc_index_entry _ent;
-                _ent.hlc.m_rtc_us = LOG_ENTRY_AT(idx)->fields.hlc_r;
-                _ent.hlc.m_logic = LOG_ENTRY_AT(idx)->fields.hlc_l;
-                _ent.log_idx = idx;
-                this->hidx.insert(_ent);
+            // STEP 4: map the segments of the log. The log segments go first because the log entries tell where the
+            // data is. The log may have been written with a larger capacity than configured now, so the rings grow to
+            // fit it.
+            int64_t log_first, log_last, data_first, data_last;
+            m_iMaxLogEntry = growRing(m_logSegments, m_pLog, MAX_LOG_SIZE, LOG_SEGMENT_SIZE,
+                                      (NUM_USED_SLOTS + LOG_SEGMENT_ENTRIES) * sizeof(LogEntry), m_retiredLogRings)
+                             / sizeof(LogEntry);
+            if(hasOldLogFormat()) {
+                migrateOldLogFormat();
+            }
+            if(m_currMetaHeader.fields.tail > m_currMetaHeader.fields.head) {
+                log_first = m_currMetaHeader.fields.head / (int64_t)LOG_SEGMENT_ENTRIES;
+                log_last = (m_currMetaHeader.fields.tail - 1) / (int64_t)LOG_SEGMENT_ENTRIES;
+                for(int64_t seg = log_first; seg <= log_last; seg++) {
+                    mapSegment(m_sLogFile, m_logSegments, m_pLog, MAX_LOG_SIZE, LOG_SEGMENT_SIZE, seg, false);
+                }
             }
+            m_iMaxDataSize = growRing(m_dataSegments, m_pData, MAX_DATA_SIZE, DATA_SEGMENT_SIZE,
+                                      NUM_USED_BYTES + DATA_SEGMENT_SIZE, m_retiredDataRings);
+            getSegmentRange(m_currMetaHeader.fields.head, m_currMetaHeader.fields.tail,
+                            log_first, log_last, data_first, data_last);
+            for(int64_t seg = data_first; seg <= data_last; seg++) {
+                mapSegment(m_sDataFile, m_dataSegments, m_pData, MAX_DATA_SIZE, DATA_SEGMENT_SIZE, seg, false);
+            }
+            dbg_default_trace("{0}:{1} log segments and {2} data segments mapped to memory",
+                              this->m_sName, m_logSegments.size(), m_dataSegments.size());
+            // STEP 4.1: logs written by older builds, including migrated ones, may have HLCs out of order.
+            repairLogEntryHLCs();
         } catch(uint64_t e) {
             FPL_PERS_UNLOCK;
             FPL_UNLOCK;
@@ -183,7 +250,17 @@ void FilePersistLog::load() {
         FPL_PERS_UNLOCK;
         FPL_UNLOCK;
     }
-    // STEP 5: update m_hlcLE with the latest event: we don't need this anymore
+    // STEP 5: clean up the segments left behind and index the snapshots
+    FPL_WRLOCK;
+    try {
+        removeStaleSegmentFiles();
+        loadSnapshots();
+    } catch(uint64_t e) {
+        FPL_UNLOCK;
+        throw e;
+    }
+    FPL_UNLOCK;
+    // STEP 6: update m_hlcLE with the latest event: we don't need this anymore
     //if (m_currMetaHeader.fields.eno >0) {
     //  if (this->m_hlcLE.m_rtc_us < CURR_LOG_ENTRY->fields.hlc_r &&
     //    this->m_hlcLE.m_logic < CURR_LOG_ENTRY->fields.hlc_l){
@@ -202,35 +279,24 @@ FilePersistLog::~FilePersistLog() noexcept(true) {
     }
     this->m_pData = nullptr;  // prevent ~MemLog() destructor to release it again.
     if(this->m_pLog != MAP_FAILED) {
-        munmap(m_pLog, MAX_LOG_SIZE);
+        munmap(m_pLog, MAX_LOG_SIZE << 1);
     }
     this->m_pLog = nullptr;  // prevent ~MemLog() destructor to release it again.
-    if(this->m_iLogFileDesc != -1) {
-        close(this->m_iLogFileDesc);
+    for(const auto& retired : this->m_retiredLogRings) {
+        munmap(retired.ring, retired.ring_size << 1);
+    }
+    for(const auto& retired : this->m_retiredDataRings) {
+        munmap(retired.ring, retired.ring_size << 1);
+    }
+    for(const auto& seg : this->m_logSegments) {
+        close(seg.second);
     }
-    if(this->m_iDataFileDesc != -1) {
-        close(this->m_iDataFileDesc);
+    for(const auto& seg : this->m_dataSegments) {
+        close(seg.second);
     }
 }
 
 inline void FilePersistLog::do_append_validation(const uint64_t size, const int64_t ver) {
-    if(NUM_FREE_SLOTS < 1) {
-        dbg_default_error("{0}-append exception no free slots in log! NUM_FREE_SLOTS={1}",
-                          this->m_sName, NUM_FREE_SLOTS);
-        dbg_default_flush();
-        FPL_UNLOCK;
-        std::cerr << "PERSIST_EXP_NOSPACE_LOG: FREESLOT=" << NUM_FREE_SLOTS << ",version=" << ver << std::endl;
-        throw PERSIST_EXP_NOSPACE_LOG;
-    }
-    if(NUM_FREE_BYTES < (signature_size + size)) {
-        dbg_default_error("{0}-append exception no space for data: NUM_FREE_BYTES={1}, size={2}, signature_size={3}",
-                          this->m_sName, NUM_FREE_BYTES, size, signature_size);
-        dbg_default_flush();
-        FPL_UNLOCK;
-        std::cerr << "PERSIST_EXP_NOSPACE_DATA: FREE:" << NUM_FREE_BYTES << ",size=" << size
-                  << ",signature_size=" << signature_size << std::endl;
-        throw PERSIST_EXP_NOSPACE_DATA;
-    }
     if((CURR_LOG_IDX != INVALID_INDEX) && (m_currMetaHeader.fields.ver >= ver)) {
         int64_t cver = m_currMetaHeader.fields.ver;
         dbg_default_error("{0}-append version already exists! cur_ver:{1} new_ver:{2}", this->m_sName,
@@ -255,6 +321,14 @@ void FilePersistLog::append(const void* pdat, uint64_t size, version_t ver, cons
     do_append_validation(size, ver);
     dbg_default_trace("{0} append:validate check2 Finished.", this->m_sName);
 
+    try {
+        ensureCapacity(signature_size + size);
+        ensureSegments(NEXT_DATA_OFST, signature_size + size);
+    } catch(uint64_t e) {
+        FPL_UNLOCK;
+        throw e;
+    }
+
     // copy data
     // we reserve the first 'signature_size' bytes at the beginning of NEXT_DATA.
     memcpy(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(NEXT_DATA) + signature_size), pdat, size);
@@ -264,8 +338,7 @@ void FilePersistLog::append(const void* pdat, uint64_t size, version_t ver, cons
     NEXT_LOG_ENTRY->fields.ver = ver;
     NEXT_LOG_ENTRY->fields.sdlen = signature_size + size;
     NEXT_LOG_ENTRY->fields.ofst = NEXT_DATA_OFST;
-    NEXT_LOG_ENTRY->fields.hlc_r = mhlc.m_rtc_us;
-    NEXT_LOG_ENTRY->fields.hlc_l = mhlc.m_logic;
+    setLogEntryHLC(NEXT_LOG_ENTRY, mhlc.m_rtc_us, mhlc.m_logic);
     /* No Sync required here.
     if (msync(ALIGN_TO_PAGE(NEXT_LOG_ENTRY),
         sizeof(LogEntry) + (((uint64_t)NEXT_LOG_ENTRY) % PAGE_SIZE),MS_SYNC) != 0) {
@@ -275,7 +348,6 @@ void FilePersistLog::append(const void* pdat, uint64_t size, version_t ver, cons
     */
 
     // update meta header
-    this->hidx.insert(hlc_index_entry{mhlc, m_currMetaHeader.fields.tail});
     m_currMetaHeader.fields.tail++;
     m_currMetaHeader.fields.ver = ver;
     dbg_default_trace("{0} append:log entry and meta data are updated.", this->m_sName);
@@ -316,6 +388,7 @@ version_t FilePersistLog::persist(version_t ver, bool preLocked) {
         if(!preLocked) {
             FPL_UNLOCK;
             FPL_PERS_UNLOCK;
+            syncSnapshots();
         }
         return ver_ret;
     }
@@ -366,6 +439,7 @@ version_t FilePersistLog::persist(version_t ver, bool preLocked) {
 
     if(!preLocked) {
         FPL_PERS_UNLOCK;
+        syncSnapshots();
     }
     return ver_ret;
 }
@@ -389,13 +463,14 @@ void FilePersistLog::addSignature(version_t version,
             m_currMetaHeader.fields.head,
             m_currMetaHeader.fields.tail);
     ple = (l_idx == -1) ? nullptr : LOG_ENTRY_AT(l_idx);
-    FPL_UNLOCK;
 
+    // the ring may be grown or the entry trimmed as soon as the lock is released.
     if(ple != nullptr && ple->fields.ver == version) {
         memcpy(LOG_ENTRY_SIGNATURE(ple), signature, signature_size);
 
         ple->fields.prev_signed_ver = prev_signed_ver;
     }
+    FPL_UNLOCK;
 }
 
 bool FilePersistLog::getSignature(version_t version, uint8_t* signature, version_t& previous_signed_version) {
@@ -415,14 +490,14 @@ bool FilePersistLog::getSignature(version_t version, uint8_t* signature, version
             m_currMetaHeader.fields.tail);
     ple = (l_idx == -1) ? nullptr : LOG_ENTRY_AT(l_idx);
 
-    FPL_UNLOCK;
-
+    bool found = false;
     if(ple != nullptr && ple->fields.ver == version) {
         memcpy(signature, LOG_ENTRY_SIGNATURE(ple), signature_size);
         previous_signed_version = ple->fields.prev_signed_ver;
-        return true;
+        found = true;
     }
-    return false;
+    FPL_UNLOCK;
+    return found;
 }
 
 bool FilePersistLog::getSignatureByIndex(int64_t index, uint8_t* signature, version_t& previous_signed_version) {
@@ -442,14 +517,249 @@ bool FilePersistLog::getSignatureByIndex(int64_t index, uint8_t* signature, vers
         return false;
         // throw PERSIST_EXP_INV_ENTRY_IDX(index);
     }
-    FPL_UNLOCK;
 
     entry_ptr = LOG_ENTRY_AT(ridx);
     memcpy(signature, LOG_ENTRY_SIGNATURE(entry_ptr), signature_size);
     previous_signed_version = entry_ptr->fields.prev_signed_ver;
+    FPL_UNLOCK;
     return true;
 }
 
+std::string FilePersistLog::getSnapshotFileName(version_t ver) const {
+    return this->m_sDataPath + "/" + this->m_sName + "." + std::to_string(ver) + "." + SNAPSHOT_FILE_SUFFIX;
+}
+
+std::string FilePersistLog::getSnapshotPath(version_t ver) const {
+    if(m_unsyncedSnapshots.find(ver) != m_unsyncedSnapshots.end()) {
+        return getSnapshotFileName(ver) + "." + SWAP_FILE_SUFFIX;
+    }
+    return getSnapshotFileName(ver);
+}
+
+void FilePersistLog::addSnapshot(version_t ver, const void* pdata, uint64_t size) {
+    FPL_RDLOCK;
+    int64_t l_idx = binarySearch<int64_t>(
+            [&](const LogEntry* ple) {
+                return ple->fields.ver;
+            },
+            ver,
+            m_currMetaHeader.fields.head,
+            m_currMetaHeader.fields.tail);
+    const bool found = (l_idx != INVALID_INDEX) && (LOG_ENTRY_AT(l_idx)->fields.ver == ver);
+    FPL_UNLOCK;
+
+    if(!found) {
+        dbg_default_warn("{0} skip snapshot at version {1}: no log entry for that version.", this->m_sName, ver);
+        return;
+    }
+
+    // write the snapshot to a swap file, which syncSnapshots() fsyncs and renames on the next persist(), so that a
+    // crash never leaves a partial snapshot behind and this thread does not wait for the disk.
+    const std::string swpFile = getSnapshotFileName(ver) + "." + SWAP_FILE_SUFFIX;
+    int fd = open(swpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    if(fd == -1) {
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    SnapshotHeader header;
+    header.ver = ver;
+    header.size = size;
+    if(!writeFully(fd, &header, sizeof(header)) || !writeFully(fd, pdata, size)) {
+        close(fd);
+        throw PERSIST_EXP_WRITE_FILE(errno);
+    }
+    close(fd);
+
+    FPL_WRLOCK;
+    // the entry might be trimmed or truncated while we were writing the file.
+    if(l_idx >= m_currMetaHeader.fields.head && l_idx < m_currMetaHeader.fields.tail
+       && LOG_ENTRY_AT(l_idx)->fields.ver == ver) {
+        m_snapshots[ver] = l_idx;
+        m_unsyncedSnapshots.insert(ver);
+    } else {
+        std::error_code ec;
+        fs::remove(swpFile, ec);
+    }
+    FPL_UNLOCK;
+    dbg_default_debug("{0} add snapshot at version {1} ({2} bytes)", this->m_sName, ver, size);
+}
+
+bool FilePersistLog::isSnapshotDue() {
+    if(m_iSnapshotInterval == 0) {
+        return false;
+    }
+    bool due = false;
+    FPL_RDLOCK;
+    if(NUM_USED_SLOTS > 0) {
+        int64_t base_idx = m_snapshots.empty() ? (m_currMetaHeader.fields.head - 1) : m_snapshots.rbegin()->second;
+        due = (static_cast<uint64_t>(CURR_LOG_IDX - base_idx) >= m_iSnapshotInterval);
+    }
+    FPL_UNLOCK;
+    return due;
+}
+
+int64_t FilePersistLog::getSnapshotIndex(int64_t idx) {
+    int64_t snapshot_idx = INVALID_INDEX;
+    FPL_RDLOCK;
+    if(idx >= m_currMetaHeader.fields.head && idx < m_currMetaHeader.fields.tail) {
+        auto itr = m_snapshots.upper_bound(LOG_ENTRY_AT(idx)->fields.ver);
+        if(itr != m_snapshots.begin()) {
+            itr--;
+            snapshot_idx = itr->second;
+        }
+    }
+    FPL_UNLOCK;
+    dbg_default_trace("{0} getSnapshotIndex({1}) returns {2}", this->m_sName, idx, snapshot_idx);
+    return snapshot_idx;
+}
+
+bool FilePersistLog::processSnapshotAtIndex(int64_t idx, const std::function<void(const void*, std::size_t)>& func) {
+    version_t ver = INVALID_VERSION;
+    std::string snapshotFile;
+    FPL_RDLOCK;
+    if(idx >= m_currMetaHeader.fields.head && idx < m_currMetaHeader.fields.tail) {
+        auto itr = m_snapshots.find(LOG_ENTRY_AT(idx)->fields.ver);
+        if(itr != m_snapshots.end() && itr->second == idx) {
+            ver = itr->first;
+            snapshotFile = getSnapshotPath(ver);
+        }
+    }
+    FPL_UNLOCK;
+    if(ver == INVALID_VERSION) {
+        return false;
+    }
+
+    // The snapshot file may be removed by a concurrent trim, or renamed by a concurrent persist. In that case, the
+    // caller falls back to the log.
+    int fd = open(snapshotFile.c_str(), O_RDONLY);
+    if(fd == -1) {
+        dbg_default_warn("{0} cannot open snapshot file:{1}, errno={2}", this->m_sName, snapshotFile, errno);
+        return false;
+    }
+    struct stat sb;
+    if(fstat(fd, &sb) != 0 || static_cast<size_t>(sb.st_size) < sizeof(SnapshotHeader)) {
+        dbg_default_warn("{0} invalid snapshot file:{1}", this->m_sName, snapshotFile);
+        close(fd);
+        return false;
+    }
+    void* pSnapshot = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(pSnapshot == MAP_FAILED) {
+        throw PERSIST_EXP_MMAP_FILE(errno);
+    }
+    const SnapshotHeader* pHeader = reinterpret_cast<const SnapshotHeader*>(pSnapshot);
+    if(pHeader->ver != ver || pHeader->size + sizeof(SnapshotHeader) != static_cast<uint64_t>(sb.st_size)) {
+        dbg_default_warn("{0} corrupted snapshot file:{1}", this->m_sName, snapshotFile);
+        munmap(pSnapshot, sb.st_size);
+        return false;
+    }
+    try {
+        func(reinterpret_cast<const uint8_t*>(pSnapshot) + sizeof(SnapshotHeader), pHeader->size);
+    } catch(...) {
+        munmap(pSnapshot, sb.st_size);
+        throw;
+    }
+    munmap(pSnapshot, sb.st_size);
+    return true;
+}
+
+void FilePersistLog::loadSnapshots() {
+    m_snapshots.clear();
+    m_unsyncedSnapshots.clear();
+    const std::string prefix = this->m_sName + ".";
+    const std::string suffix = "." SNAPSHOT_FILE_SUFFIX;
+    const std::string swap_suffix = suffix + "." SWAP_FILE_SUFFIX;
+    for(const auto& dent : fs::directory_iterator(this->m_sDataPath)) {
+        const std::string fname = dent.path().filename().string();
+        if(fname.size() > prefix.size() + swap_suffix.size()
+           && fname.compare(0, prefix.size(), prefix) == 0
+           && fname.compare(fname.size() - swap_suffix.size(), swap_suffix.size(), swap_suffix) == 0) {
+            // a snapshot that was never synced before a crash
+            dbg_default_info("{0} remove unsynced snapshot:{1}", this->m_sName, fname);
+            std::error_code ec;
+            fs::remove(dent.path(), ec);
+            continue;
+        }
+        if(fname.size() <= prefix.size() + suffix.size()
+           || fname.compare(0, prefix.size(), prefix) != 0
+           || fname.compare(fname.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        const std::string ver_str = fname.substr(prefix.size(), fname.size() - prefix.size() - suffix.size());
+        if(ver_str.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        version_t ver = std::stoll(ver_str);
+        int64_t l_idx = binarySearch<int64_t>(
+                [&](const LogEntry* ple) {
+                    return ple->fields.ver;
+                },
+                ver,
+                m_currMetaHeader.fields.head,
+                m_currMetaHeader.fields.tail);
+        if(l_idx == INVALID_INDEX || LOG_ENTRY_AT(l_idx)->fields.ver != ver) {
+            dbg_default_info("{0} remove stale snapshot:{1}", this->m_sName, fname);
+            std::error_code ec;
+            fs::remove(dent.path(), ec);
+            continue;
+        }
+        m_snapshots.emplace(ver, l_idx);
+    }
+    dbg_default_trace("{0} {1} snapshots loaded.", this->m_sName, m_snapshots.size());
+}
+
+void FilePersistLog::removeTrimmedSnapshots() {
+    auto itr = m_snapshots.begin();
+    while(itr != m_snapshots.end() && itr->second < m_currMetaHeader.fields.head) {
+        std::error_code ec;
+        fs::remove(getSnapshotPath(itr->first), ec);
+        m_unsyncedSnapshots.erase(itr->first);
+        itr = m_snapshots.erase(itr);
+    }
+}
+
+void FilePersistLog::removeSnapshotsAfter(version_t ver) {
+    auto itr = m_snapshots.upper_bound(ver);
+    while(itr != m_snapshots.end()) {
+        std::error_code ec;
+        fs::remove(getSnapshotPath(itr->first), ec);
+        m_unsyncedSnapshots.erase(itr->first);
+        itr = m_snapshots.erase(itr);
+    }
+}
+
+void FilePersistLog::syncSnapshots() {
+    FPL_RDLOCK;
+    const std::vector<version_t> unsynced(m_unsyncedSnapshots.begin(), m_unsyncedSnapshots.end());
+    FPL_UNLOCK;
+
+    for(const version_t ver : unsynced) {
+        const std::string snapshotFile = getSnapshotFileName(ver);
+        const std::string swpFile = snapshotFile + "." + SWAP_FILE_SUFFIX;
+        // the snapshot might be removed by a trim or truncate in the meantime.
+        int fd = open(swpFile.c_str(), O_RDONLY);
+        if(fd == -1) {
+            continue;
+        }
+        if(fsync(fd) != 0) {
+            const int error = errno;
+            close(fd);
+            throw PERSIST_EXP_MSYNC(error);
+        }
+        close(fd);
+        // rename under the lock, so that a concurrent removal finds the snapshot under the name it expects.
+        FPL_WRLOCK;
+        if(m_unsyncedSnapshots.erase(ver) > 0 && rename(swpFile.c_str(), snapshotFile.c_str()) != 0) {
+            const int error = errno;
+            m_snapshots.erase(ver);
+            std::error_code ec;
+            fs::remove(swpFile, ec);
+            FPL_UNLOCK;
+            throw PERSIST_EXP_RENAME_FILE(error);
+        }
+        FPL_UNLOCK;
+    }
+}
+
 int64_t FilePersistLog::getLength() {
     FPL_RDLOCK;
     int64_t len = NUM_USED_SLOTS;
@@ -513,12 +823,12 @@ int64_t FilePersistLog::getVersionIndex(version_t ver, bool exact) {
             m_currMetaHeader.fields.tail);
     dbg_default_trace("{0} - end binary search.", this->m_sName);
 
-    FPL_UNLOCK;
-
     if((l_idx != INVALID_INDEX) && (LOG_ENTRY_AT(l_idx)->fields.ver != ver) && exact) {
         l_idx = INVALID_INDEX;
     }
 
+    FPL_UNLOCK;
+
     dbg_default_trace("{0} getVersionIndex({1}) at index {2}", this->m_sName, ver, l_idx);
 
     return l_idx;
@@ -535,7 +845,6 @@ const void* FilePersistLog::getEntryByIndex(int64_t eidx) {
         FPL_UNLOCK;
         throw PERSIST_EXP_INV_ENTRY_IDX(eidx);
     }
-    FPL_UNLOCK;
 
     dbg_default_trace("{0} getEntryByIndex at idx:{1} ver:{2} time:({3},{4})",
                       this->m_sName,
@@ -544,7 +853,10 @@ const void* FilePersistLog::getEntryByIndex(int64_t eidx) {
                       (LOG_ENTRY_AT(ridx))->fields.hlc_r,
                       (LOG_ENTRY_AT(ridx))->fields.hlc_l);
 
-    return LOG_ENTRY_DATA(LOG_ENTRY_AT(ridx));
+    // resolve the data pointer against the ring and its size together: growing the ring swaps both.
+    const void* pdata = LOG_ENTRY_DATA(LOG_ENTRY_AT(ridx));
+    FPL_UNLOCK;
+    return pdata;
 }
 
 const void* FilePersistLog::getEntry(version_t ver, bool exact) {
@@ -564,30 +876,39 @@ const void* FilePersistLog::getEntry(version_t ver, bool exact) {
     ple = (l_idx == INVALID_INDEX) ? nullptr : LOG_ENTRY_AT(l_idx);
     dbg_default_trace("{0} - end binary search.", this->m_sName);
 
-    FPL_UNLOCK;
-
     // no object exists before the requested timestamp.
     if(ple == nullptr || (exact && (ple->fields.ver != ver))) {
+        FPL_UNLOCK;
         return nullptr;
     }
 
     dbg_default_trace("{0} getEntry at ({1},{2})", this->m_sName, ple->fields.hlc_r, ple->fields.hlc_l);
 
-    return LOG_ENTRY_DATA(ple);
+    const void* pdata = LOG_ENTRY_DATA(ple);
+    FPL_UNLOCK;
+    return pdata;
 }
 
 int64_t FilePersistLog::getHLCIndex(const HLC& rhlc) {
     FPL_RDLOCK;
     dbg_default_trace("getHLCIndex for hlc({0},{1})", rhlc.m_rtc_us, rhlc.m_logic);
-    struct hlc_index_entry skey(rhlc, 0);
-    auto key = this->hidx.upper_bound(skey);
-    FPL_UNLOCK;
+    // The HLCs grow with the log index, so we search the HLCs in the log entries directly instead of keeping an
+    // index in memory.
+    int64_t l_idx = binarySearch<HLCKey>(
+            [](const LogEntry* ple) {
+                return HLCKey{ple->fields.hlc_r, ple->fields.hlc_l};
+            },
+            HLCKey{rhlc.m_rtc_us, rhlc.m_logic},
+            m_currMetaHeader.fields.head,
+            m_currMetaHeader.fields.tail);
 
-    if(key != this->hidx.begin() && this->hidx.size() > 0) {
-        key--;
-        dbg_default_trace("getHLCIndex returns: hlc:({0},{1}),idx:{2}", key->hlc.m_rtc_us, key->hlc.m_logic, key->log_idx);
-        return key->log_idx;
+    if(l_idx != INVALID_INDEX) {
+        dbg_default_trace("getHLCIndex returns: hlc:({0},{1}),idx:{2}",
+                          LOG_ENTRY_AT(l_idx)->fields.hlc_r, LOG_ENTRY_AT(l_idx)->fields.hlc_l, l_idx);
+        FPL_UNLOCK;
+        return l_idx;
     }
+    FPL_UNLOCK;
 
     // no object exists before the requested timestamp.
 
@@ -598,27 +919,34 @@ int64_t FilePersistLog::getHLCIndex(const HLC& rhlc) {
 
 version_t FilePersistLog::getHLCVersion(const HLC& rhlc) {
     int64_t idx = getHLCIndex(rhlc);
+    version_t ver = INVALID_VERSION;
 
     if (idx != INVALID_INDEX) {
-        return LOG_ENTRY_AT(idx)->fields.ver;
+        FPL_RDLOCK;
+        // the entry might be trimmed since getHLCIndex() released the lock.
+        if (idx >= m_currMetaHeader.fields.head && idx < m_currMetaHeader.fields.tail) {
+            ver = LOG_ENTRY_AT(idx)->fields.ver;
+        }
+        FPL_UNLOCK;
     }
 
-    return INVALID_VERSION;
+    return ver;
 }
 
 version_t FilePersistLog::getPreviousVersionOf(version_t ver) {
     int64_t idx = getVersionIndex(ver,false);
     version_t prev_ver = INVALID_VERSION;
     if (idx != INVALID_INDEX) {
-        if(LOG_ENTRY_AT(idx)->fields.ver < ver) {
-            prev_ver = LOG_ENTRY_AT(idx)->fields.ver;
-        } else {
-            FPL_RDLOCK;
-            if (idx > m_currMetaHeader.fields.head) {
+        FPL_RDLOCK;
+        // the entry might be trimmed since getVersionIndex() released the lock.
+        if (idx >= m_currMetaHeader.fields.head && idx < m_currMetaHeader.fields.tail) {
+            if(LOG_ENTRY_AT(idx)->fields.ver < ver) {
+                prev_ver = LOG_ENTRY_AT(idx)->fields.ver;
+            } else if (idx > m_currMetaHeader.fields.head) {
                 prev_ver = LOG_ENTRY_AT(idx - 1)->fields.ver;
             }
-            FPL_UNLOCK;
         }
+        FPL_UNLOCK;
     }
 
     return prev_ver;
@@ -629,8 +957,10 @@ version_t FilePersistLog::getNextVersionOf(version_t ver) {
     version_t next_ver = INVALID_VERSION;
     if (idx != INVALID_INDEX) {
         FPL_RDLOCK;
-        if (idx < (m_currMetaHeader.fields.tail - 1)) {
-            next_ver = LOG_ENTRY_AT(idx+1)->fields.ver;
+        // the entries after idx might be trimmed since getVersionIndex() released the lock.
+        const int64_t next_idx = MAX(idx + 1, m_currMetaHeader.fields.head);
+        if (next_idx < m_currMetaHeader.fields.tail) {
+            next_ver = LOG_ENTRY_AT(next_idx)->fields.ver;
         }
         FPL_UNLOCK;
     } else {
@@ -649,18 +979,24 @@ const void* FilePersistLog::getEntry(const HLC& rhlc) {
 
     int64_t idx = getHLCIndex(rhlc);
 
-    if(idx != INVALID_INDEX) {
-        ple = LOG_ENTRY_AT(idx);
+    // no object exists before the requested timestamp.
+    if(idx == INVALID_INDEX) {
+        return nullptr;
     }
 
-    // no object exists before the requested timestamp.
-    if(ple == nullptr) {
+    FPL_RDLOCK;
+    // the entry might be trimmed since getHLCIndex() released the lock.
+    if(idx < m_currMetaHeader.fields.head || idx >= m_currMetaHeader.fields.tail) {
+        FPL_UNLOCK;
         return nullptr;
     }
+    ple = LOG_ENTRY_AT(idx);
 
     dbg_default_trace("{0} getEntry at ({1},{2})", this->m_sName, ple->fields.hlc_r, ple->fields.hlc_l);
 
-    return LOG_ENTRY_DATA(ple);
+    const void* pdata = LOG_ENTRY_DATA(ple);
+    FPL_UNLOCK;
+    return pdata;
 }
 
 void FilePersistLog::processEntryAtVersion(version_t ver,
@@ -679,11 +1015,16 @@ void FilePersistLog::processEntryAtVersion(version_t ver,
             m_currMetaHeader.fields.tail);
     ple = (l_idx == -1) ? nullptr : LOG_ENTRY_AT(l_idx);
 
-    FPL_UNLOCK;
-
+    // keep the lock while func reads the data, so that a concurrent trim can't swap the entry for zeros under it.
     if(ple != nullptr && ple->fields.ver == ver) {
-        func(LOG_ENTRY_DATA(ple), static_cast<size_t>(ple->fields.sdlen - this->signature_size));
+        try {
+            func(LOG_ENTRY_DATA(ple), static_cast<size_t>(ple->fields.sdlen - this->signature_size));
+        } catch(...) {
+            FPL_UNLOCK;
+            throw;
+        }
     }
+    FPL_UNLOCK;
 }
 
 // trim by index
@@ -706,6 +1047,7 @@ void FilePersistLog::trimByIndex(int64_t idx) {
         return;
     }
     m_currMetaHeader.fields.head = idx + 1;
+    removeTrimmedSnapshots();
     try {
         //What version number should be supplied to persist in this case?
         // CAUTION:
@@ -713,13 +1055,12 @@ void FilePersistLog::trimByIndex(int64_t idx) {
         // This has a widespreading on the design and needs extensive test before replying on
         // it.
         persist(LOG_ENTRY_AT(CURR_LOG_IDX)->fields.ver, true);
+        releaseSegments();
     } catch(uint64_t e) {
         FPL_UNLOCK;
         FPL_PERS_UNLOCK;
         throw e;
     }
-    //TODO: remove entry from index...this is tricky because HLC
-    // order does not agree with index order.
     FPL_UNLOCK;
     FPL_PERS_UNLOCK;
     // throw PERSIST_EXP_UNIMPLEMENTED;
@@ -735,14 +1076,9 @@ void FilePersistLog::trim(version_t ver) {
 
 void FilePersistLog::trim(const HLC& hlc) {
     dbg_default_trace("{0} trim at time: {1}.{2}", this->m_sName, hlc.m_rtc_us, hlc.m_logic);
-    //    this->trim<unsigned __int128>(
-    //      ((((const unsigned __int128)hlc.m_rtc_us)<<64) | hlc.m_logic),
-    //      [&](int64_t idx) {
-    //        return ((((const unsigned __int128)LOG_ENTRY_AT(idx)->fields.hlc_r)<<64) |
-    //          LOG_ENTRY_AT(idx)->fields.hlc_l);
-    //      });
-    //TODO: This is hard because HLC order does not agree with index order.
-    throw PERSIST_EXP_UNIMPLEMENTED;
+    // the HLCs grow with the log index, see setLogEntryHLC().
+    this->trim<HLCKey>(HLCKey{hlc.m_rtc_us, hlc.m_logic},
+                       [](const LogEntry* ple) { return HLCKey{ple->fields.hlc_r, ple->fields.hlc_l}; });
     dbg_default_trace("{0} trim at time: {1}.{2}...done", this->m_sName, hlc.m_rtc_us, hlc.m_logic);
 }
 
@@ -909,12 +1245,45 @@ size_t FilePersistLog::postLogEntry(const std::function<void(uint8_t const* cons
     f((const uint8_t*)ple, sizeof(LogEntry));
     nr_written += sizeof(LogEntry);
     if(ple->fields.sdlen > 0) {
-        f((const uint8_t*)LOG_ENTRY_SIGNATURE(ple), ple->fields.sdlen);
+        if(file_range_poster && ple->fields.sdlen >= file_range_min_size) {
+            postDataFromSegments(ple->fields.ofst, ple->fields.sdlen);
+        } else {
+            f((const uint8_t*)LOG_ENTRY_SIGNATURE(ple), ple->fields.sdlen);
+        }
         nr_written += ple->fields.sdlen;
     }
     return nr_written;
 }
 
+void FilePersistLog::postDataFromSegments(uint64_t ofst, uint64_t len) {
+    const uint64_t end = ofst + len;
+    while(ofst < end) {
+        const int64_t seg = ofst / DATA_SEGMENT_SIZE;
+        const uint64_t piece_len = MIN(end, (seg + 1) * DATA_SEGMENT_SIZE) - ofst;
+        FPL_RDLOCK;
+        auto seg_it = m_dataSegments.find(seg);
+        int fd = -1;
+        int dup_errno = ENOENT;
+        if(seg_it != m_dataSegments.end()) {
+            fd = dup(seg_it->second);
+            dup_errno = errno;
+        }
+        FPL_UNLOCK;
+        if(fd == -1) {
+            dbg_default_error("{0} failed to open data segment {1} of log {2}.", __func__, seg, this->m_sName);
+            throw PERSIST_EXP_OPEN_FILE(dup_errno);
+        }
+        try {
+            file_range_poster(fd, ofst % DATA_SEGMENT_SIZE, piece_len);
+        } catch(...) {
+            close(fd);
+            throw;
+        }
+        close(fd);
+        ofst += piece_len;
+    }
+}
+
 size_t FilePersistLog::mergeLogEntryFromByteArray(const uint8_t* ba) {
     const LogEntry* cple = (const LogEntry*)ba;
     // valid check
@@ -923,20 +1292,14 @@ size_t FilePersistLog::mergeLogEntryFromByteArray(const uint8_t* ba) {
         dbg_default_trace("{0} skip log entry version {1}, we are at {2}.", __func__, cple->fields.ver, m_currMetaHeader.fields.ver);
         return cple->fields.sdlen + sizeof(LogEntry);
     }
-    // 1) do we have space to merge it?
-    if(NUM_FREE_SLOTS == 0) {
-        dbg_default_trace("{0} failed to merge log entry, we don't empty log entry.", __func__);
-        throw PERSIST_EXP_NOSPACE_LOG;
-    }
-    if(NUM_FREE_BYTES < cple->fields.sdlen) {
-        dbg_default_trace("{0} failed to merge log entry, we need {1} bytes data space, but we have only {2} bytes.", __func__, cple->fields.sdlen, NUM_FREE_BYTES);
-        throw PERSIST_EXP_NOSPACE_DATA;
-    }
+    // 1) make space to merge it
+    ensureCapacity(cple->fields.sdlen);
     // 2) merge it!
+    ensureSegments(NEXT_DATA_OFST, cple->fields.sdlen);
     memcpy(NEXT_DATA, (const void*)(ba + sizeof(LogEntry)), cple->fields.sdlen);
     memcpy(NEXT_LOG_ENTRY, cple, sizeof(LogEntry));
     NEXT_LOG_ENTRY->fields.ofst = NEXT_DATA_OFST;
-    this->hidx.insert(hlc_index_entry{HLC{cple->fields.hlc_r, cple->fields.hlc_l}, m_currMetaHeader.fields.tail});
+    setLogEntryHLC(NEXT_LOG_ENTRY, cple->fields.hlc_r, cple->fields.hlc_l);
     m_currMetaHeader.fields.tail++;
     m_currMetaHeader.fields.ver = cple->fields.ver;
     dbg_default_trace("{0} merge log:log entry and meta data are updated.", __func__);
@@ -992,12 +1355,323 @@ bool FilePersistLog::checkOrCreateMetaFile() {
     return checkOrCreateFileWithSize(this->m_sMetaFile, META_SIZE);
 }
 
-bool FilePersistLog::checkOrCreateLogFile() {
-    return checkOrCreateFileWithSize(this->m_sLogFile, MAX_LOG_SIZE);
+void FilePersistLog::setLogEntryHLC(LogEntry* ple, uint64_t hlc_r, uint64_t hlc_l) {
+    if(CURR_LOG_IDX != INVALID_INDEX) {
+        const LogEntry* prev = LOG_ENTRY_AT(CURR_LOG_IDX);
+        if(HLCKey{hlc_r, hlc_l} <= HLCKey{prev->fields.hlc_r, prev->fields.hlc_l}) {
+            // Like receiving an HLC behind the local one: advance the logical component instead. This is routine when
+            // the senders' clocks disagree, so it is only traced.
+            dbg_default_trace("{0} the HLC ({1},{2}) of version {3} is not later than the HLC ({4},{5}) of version {6}, "
+                              "storing ({4},{7}) instead.",
+                              this->m_sName, hlc_r, hlc_l, ple->fields.ver, prev->fields.hlc_r, prev->fields.hlc_l,
+                              prev->fields.ver, prev->fields.hlc_l + 1);
+            hlc_r = prev->fields.hlc_r;
+            hlc_l = prev->fields.hlc_l + 1;
+        }
+    }
+    ple->fields.hlc_r = hlc_r;
+    ple->fields.hlc_l = hlc_l;
 }
 
-bool FilePersistLog::checkOrCreateDataFile() {
-    return checkOrCreateFileWithSize(this->m_sDataFile, MAX_DATA_SIZE);
+void FilePersistLog::repairLogEntryHLCs() {
+    int64_t repaired = 0;
+    for(int64_t idx = m_currMetaHeader.fields.head + 1; idx < m_currMetaHeader.fields.tail; idx++) {
+        const LogEntry* prev = LOG_ENTRY_AT(idx - 1);
+        LogEntry* ple = LOG_ENTRY_AT(idx);
+        // the same rule as setLogEntryHLC()
+        if(HLCKey{ple->fields.hlc_r, ple->fields.hlc_l} <= HLCKey{prev->fields.hlc_r, prev->fields.hlc_l}) {
+            ple->fields.hlc_r = prev->fields.hlc_r;
+            ple->fields.hlc_l = prev->fields.hlc_l + 1;
+            repaired++;
+        }
+    }
+    if(repaired > 0) {
+        dbg_default_warn("{0}:{1} log entries had an HLC not later than the previous entry's, advanced them.",
+                         this->m_sName, repaired);
+    }
+}
+
+std::string FilePersistLog::getSegmentFileName(const std::string& prefix, int64_t seg) const {
+    return prefix + "." + std::to_string(seg);
+}
+
+void FilePersistLog::getSegmentRange(int64_t head, int64_t tail,
+                                     int64_t& log_first, int64_t& log_last,
+                                     int64_t& data_first, int64_t& data_last) {
+    log_first = data_first = 0;
+    log_last = data_last = -1;
+    if(tail <= head) {
+        return;
+    }
+    log_first = head / (int64_t)LOG_SEGMENT_ENTRIES;
+    log_last = (tail - 1) / (int64_t)LOG_SEGMENT_ENTRIES;
+    const uint64_t data_start = LOG_ENTRY_AT(head)->fields.ofst;
+    const uint64_t data_end = LOG_ENTRY_AT(tail - 1)->fields.ofst + LOG_ENTRY_AT(tail - 1)->fields.sdlen;
+    if(data_end > data_start) {
+        data_first = data_start / DATA_SEGMENT_SIZE;
+        data_last = (data_end - 1) / DATA_SEGMENT_SIZE;
+    }
+}
+
+void FilePersistLog::mapSegment(const std::string& prefix, std::map<int64_t, int>& segments,
+                                void* ring, uint64_t ring_size, uint64_t seg_size, int64_t seg, bool create) {
+    if(segments.find(seg) != segments.end()) {
+        return;
+    }
+    const std::string file = getSegmentFileName(prefix, seg);
+    if(create) {
+        checkOrCreateFileWithSize(file, seg_size);
+    } else if(!checkRegularFile(file)) {
+        dbg_default_error("{0}:segment file {1} is missing.", this->m_sName, file);
+        throw PERSIST_EXP_OPEN_FILE(ENOENT);
+    }
+    int fd = open(file.c_str(), O_RDWR);
+    if(fd == -1) {
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    // map the segment to its slot in both halves of the ring
+    void* slot = (void*)((uint64_t)ring + ((uint64_t)seg * seg_size) % ring_size);
+    if(mmap(slot, seg_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+       || mmap((void*)((uint64_t)slot + ring_size), seg_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        dbg_default_error("{0}:map segment file {1} failed.", this->m_sName, file);
+        throw PERSIST_EXP_MMAP_FILE(err);
+    }
+    segments.emplace(seg, fd);
+    dbg_default_trace("{0}:segment file {1} mapped to memory", this->m_sName, file);
+}
+
+void FilePersistLog::unmapSegment(const std::string& prefix, std::map<int64_t, int>& segments,
+                                  void* ring, uint64_t ring_size, uint64_t seg_size, int64_t seg,
+                                  const std::vector<RetiredRing>& retired) {
+    auto itr = segments.find(seg);
+    if(itr == segments.end()) {
+        return;
+    }
+    // Put anonymous memory back in the slot instead of leaving a hole, so that a reader still holding a pointer
+    // to a trimmed entry does not crash.
+    auto clear_slot = [seg, seg_size](void* ring, uint64_t ring_size) {
+        void* slot = (void*)((uint64_t)ring + ((uint64_t)seg * seg_size) % ring_size);
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED;
+        if(mmap(slot, seg_size, PROT_READ, flags, -1, 0) == MAP_FAILED
+           || mmap((void*)((uint64_t)slot + ring_size), seg_size, PROT_READ, flags, -1, 0) == MAP_FAILED) {
+            throw PERSIST_EXP_MMAP_FILE(errno);
+        }
+    };
+    clear_slot(ring, ring_size);
+    for(const auto& retired_ring : retired) {
+        clear_slot(retired_ring.ring, retired_ring.ring_size);
+    }
+    close(itr->second);
+    segments.erase(itr);
+    const std::string file = getSegmentFileName(prefix, seg);
+    std::error_code ec;
+    if(!fs::remove(file, ec)) {
+        dbg_default_warn("{0}:failed to remove segment file {1}: {2}", this->m_sName, file, ec.message());
+    }
+    dbg_default_trace("{0}:segment file {1} released", this->m_sName, file);
+}
+
+void* FilePersistLog::reserveRing(uint64_t ring_size) {
+    // Only address space is reserved: the segments are mapped on top of it, and the rest is never touched.
+    void* ring = mmap(NULL, ring_size << 1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(ring == MAP_FAILED) {
+        dbg_default_error("{0}:reserve map space of {1} bytes failed.", this->m_sName, ring_size << 1);
+        throw PERSIST_EXP_MMAP_FILE(errno);
+    }
+    return ring;
+}
+
+uint64_t FilePersistLog::growRing(std::map<int64_t, int>& segments, void*& ring, uint64_t ring_size,
+                                  uint64_t seg_size, uint64_t min_size, std::vector<RetiredRing>& retired) {
+    if(ring_size >= min_size) {
+        return ring_size;
+    }
+    uint64_t new_size = ring_size;
+    while(new_size < min_size) {
+        new_size <<= 1;
+    }
+    void* new_ring = reserveRing(new_size);
+    for(const auto& seg : segments) {
+        void* slot = (void*)((uint64_t)new_ring + ((uint64_t)seg.first * seg_size) % new_size);
+        if(mmap(slot, seg_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, seg.second, 0) == MAP_FAILED
+           || mmap((void*)((uint64_t)slot + new_size), seg_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, seg.second, 0) == MAP_FAILED) {
+            int err = errno;
+            munmap(new_ring, new_size << 1);
+            throw PERSIST_EXP_MMAP_FILE(err);
+        }
+    }
+    if(segments.empty()) {
+        munmap(ring, ring_size << 1);
+    } else {
+        retired.push_back(RetiredRing{ring, ring_size});
+    }
+    ring = new_ring;
+    dbg_default_info("{0}:ring buffer grown from {1} to {2} bytes.", this->m_sName, ring_size, new_size);
+    return new_size;
+}
+
+void FilePersistLog::ensureCapacity(uint64_t size) {
+    if(NUM_FREE_SLOTS < 1) {
+        m_iMaxLogEntry = growRing(m_logSegments, m_pLog, MAX_LOG_SIZE, LOG_SEGMENT_SIZE,
+                                  (NUM_USED_SLOTS + 1 + LOG_SEGMENT_ENTRIES) * sizeof(LogEntry), m_retiredLogRings)
+                         / sizeof(LogEntry);
+    }
+    if(NUM_FREE_BYTES < size) {
+        m_iMaxDataSize = growRing(m_dataSegments, m_pData, MAX_DATA_SIZE, DATA_SEGMENT_SIZE,
+                                  NUM_USED_BYTES + size + DATA_SEGMENT_SIZE, m_retiredDataRings);
+    }
+}
+
+bool FilePersistLog::hasOldLogFormat() const {
+    return checkRegularFile(this->m_sLogFile) || checkRegularFile(this->m_sDataFile);
+}
+
+void FilePersistLog::migrateOldLogFormat() {
+    dbg_default_info("{0}:migrating the log from the format before segments.", this->m_sName);
+    struct stat log_sb, data_sb;
+    if(stat(this->m_sLogFile.c_str(), &log_sb) != 0) {
+        // The old files are removed log first, so a previous migration was done with the data file.
+        if(errno == ENOENT) {
+            std::error_code ec;
+            fs::remove(this->m_sDataFile, ec);
+            return;
+        }
+        throw PERSIST_EXP_OLD_LOG_FORMAT(errno);
+    }
+    if(stat(this->m_sDataFile.c_str(), &data_sb) != 0) {
+        dbg_default_error("{0}:old log format, but {1} is missing.", this->m_sName, this->m_sDataFile);
+        throw PERSIST_EXP_OLD_LOG_FORMAT(errno);
+    }
+    const int64_t head = m_currMetaHeader.fields.head;
+    const int64_t tail = m_currMetaHeader.fields.tail;
+    const uint64_t old_max_log_entry = log_sb.st_size / sizeof(LogEntry);
+    const uint64_t old_max_data_size = data_sb.st_size;
+    if(tail > head) {
+        if(old_max_log_entry < (uint64_t)(tail - head)) {
+            dbg_default_error("{0}:old log format, but {1} entries don't fit in {2} ({3} bytes).",
+                              this->m_sName, tail - head, this->m_sLogFile, log_sb.st_size);
+            throw PERSIST_EXP_OLD_LOG_FORMAT(EINVAL);
+        }
+        int log_fd = open(this->m_sLogFile.c_str(), O_RDONLY);
+        int data_fd = open(this->m_sDataFile.c_str(), O_RDONLY);
+        void* old_log = (log_fd == -1) ? MAP_FAILED : mmap(NULL, log_sb.st_size, PROT_READ, MAP_SHARED, log_fd, 0);
+        void* old_data = (data_fd == -1) ? MAP_FAILED
+                         : (old_max_data_size == 0) ? nullptr
+                                                    : mmap(NULL, data_sb.st_size, PROT_READ, MAP_SHARED, data_fd, 0);
+        const int err = errno;
+        auto release_old_files = [&]() {
+            if(old_log != MAP_FAILED) munmap(old_log, log_sb.st_size);
+            if(old_data != MAP_FAILED && old_data != nullptr) munmap(old_data, data_sb.st_size);
+            if(log_fd != -1) close(log_fd);
+            if(data_fd != -1) close(data_fd);
+        };
+        if(old_log == MAP_FAILED || old_data == MAP_FAILED) {
+            release_old_files();
+            throw PERSIST_EXP_MMAP_FILE(err);
+        }
+        try {
+            // STEP 1: copy the log entries, which keep their indexes.
+            for(int64_t seg = head / (int64_t)LOG_SEGMENT_ENTRIES; seg <= (tail - 1) / (int64_t)LOG_SEGMENT_ENTRIES; seg++) {
+                mapSegment(m_sLogFile, m_logSegments, m_pLog, MAX_LOG_SIZE, LOG_SEGMENT_SIZE, seg, true);
+            }
+            for(int64_t idx = head; idx < tail; idx++) {
+                memcpy(LOG_ENTRY_AT(idx), (const LogEntry*)old_log + idx % old_max_log_entry, sizeof(LogEntry));
+            }
+            // STEP 2: copy the data, which keeps its offsets.
+            const uint64_t data_start = LOG_ENTRY_AT(head)->fields.ofst;
+            const uint64_t data_end = LOG_ENTRY_AT(tail - 1)->fields.ofst + LOG_ENTRY_AT(tail - 1)->fields.sdlen;
+            if(data_end - data_start > old_max_data_size) {
+                dbg_default_error("{0}:old log format, but the data ({1} bytes) doesn't fit in {2} ({3} bytes).",
+                                  this->m_sName, data_end - data_start, this->m_sDataFile, data_sb.st_size);
+                throw PERSIST_EXP_OLD_LOG_FORMAT(EINVAL);
+            }
+            m_iMaxDataSize = growRing(m_dataSegments, m_pData, MAX_DATA_SIZE, DATA_SEGMENT_SIZE,
+                                      (data_end - data_start) + DATA_SEGMENT_SIZE, m_retiredDataRings);
+            if(data_end > data_start) {
+                for(int64_t seg = data_start / DATA_SEGMENT_SIZE; seg <= (int64_t)((data_end - 1) / DATA_SEGMENT_SIZE); seg++) {
+                    mapSegment(m_sDataFile, m_dataSegments, m_pData, MAX_DATA_SIZE, DATA_SEGMENT_SIZE, seg, true);
+                }
+            }
+            for(uint64_t ofst = data_start; ofst < data_end;) {
+                const uint64_t old_ofst = ofst % old_max_data_size;
+                const uint64_t len = MIN(data_end - ofst, old_max_data_size - old_ofst);
+                memcpy((uint8_t*)m_pData + ofst % MAX_DATA_SIZE, (const uint8_t*)old_data + old_ofst, len);
+                ofst += len;
+            }
+            // STEP 3: the segments must be durable before the old files are gone.
+            for(const auto& segments : {std::cref(m_logSegments), std::cref(m_dataSegments)}) {
+                for(const auto& seg : segments.get()) {
+                    if(fsync(seg.second) != 0) {
+                        throw PERSIST_EXP_MSYNC(errno);
+                    }
+                }
+            }
+        } catch(uint64_t e) {
+            release_old_files();
+            throw e;
+        }
+        release_old_files();
+    }
+    for(const std::string& file : {this->m_sLogFile, this->m_sDataFile}) {
+        std::error_code ec;
+        fs::remove(file, ec);
+        if(ec) {
+            dbg_default_error("{0}:failed to remove the old file {1}: {2}", this->m_sName, file, ec.message());
+            throw PERSIST_EXP_REMOVE_FILE(ec.value());
+        }
+    }
+    dbg_default_info("{0}:migrated {1} log entries from the format before segments.", this->m_sName, tail - head);
+}
+
+void FilePersistLog::ensureSegments(uint64_t ofst, uint64_t len) {
+    mapSegment(m_sLogFile, m_logSegments, m_pLog, MAX_LOG_SIZE, LOG_SEGMENT_SIZE,
+               m_currMetaHeader.fields.tail / (int64_t)LOG_SEGMENT_ENTRIES, true);
+    if(len == 0) {
+        return;
+    }
+    for(int64_t seg = ofst / DATA_SEGMENT_SIZE; seg <= (int64_t)((ofst + len - 1) / DATA_SEGMENT_SIZE); seg++) {
+        mapSegment(m_sDataFile, m_dataSegments, m_pData, MAX_DATA_SIZE, DATA_SEGMENT_SIZE, seg, true);
+    }
+}
+
+void FilePersistLog::releaseSegments() {
+    int64_t log_first, log_last, data_first, data_last;
+    getSegmentRange(m_currMetaHeader.fields.head, m_currMetaHeader.fields.tail,
+                    log_first, log_last, data_first, data_last);
+    std::vector<int64_t> released;
+    for(const auto& seg : m_logSegments) {
+        if(seg.first < log_first || seg.first > log_last) {
+            released.push_back(seg.first);
+        }
+    }
+    for(const int64_t seg : released) {
+        unmapSegment(m_sLogFile, m_logSegments, m_pLog, MAX_LOG_SIZE, LOG_SEGMENT_SIZE, seg, m_retiredLogRings);
+    }
+    released.clear();
+    for(const auto& seg : m_dataSegments) {
+        if(seg.first < data_first || seg.first > data_last) {
+            released.push_back(seg.first);
+        }
+    }
+    for(const int64_t seg : released) {
+        unmapSegment(m_sDataFile, m_dataSegments, m_pData, MAX_DATA_SIZE, DATA_SEGMENT_SIZE, seg, m_retiredDataRings);
+    }
+}
+
+void FilePersistLog::removeStaleSegmentFiles() {
+    auto remove_stale = [this](const std::map<int64_t, int>& segments) {
+        return [this, &segments](int64_t seg, const fs::path& path) {
+            if(segments.find(seg) == segments.end()) {
+                dbg_default_info("{0} remove stale segment:{1}", this->m_sName, path.string());
+                std::error_code ec;
+                fs::remove(path, ec);
+            }
+        };
+    };
+    forEachSegmentFile(this->m_sDataPath, this->m_sName + "." + LOG_FILE_SUFFIX, remove_stale(m_logSegments));
+    forEachSegmentFile(this->m_sDataPath, this->m_sName + "." + DATA_FILE_SUFFIX, remove_stale(m_dataSegments));
 }
 
 void FilePersistLog::truncate(version_t ver) {
@@ -1026,10 +1700,12 @@ void FilePersistLog::truncate(version_t ver) {
     }
     if(m_currMetaHeader.fields.ver > ver)
         m_currMetaHeader.fields.ver = ver;
+    removeSnapshotsAfter(ver);
     // STEP 3: update PERSISTENT STATE
     FPL_PERS_LOCK;
     try {
         persistMetaHeaderAtomically(&m_currMetaHeader);
+        releaseSegments();
     } catch(uint64_t e) {
         FPL_PERS_UNLOCK;
         FPL_UNLOCK;
@@ -6,6 +6,9 @@
 
 namespace persistent {
 
+thread_local FileRangePoster PersistLog::file_range_poster;
+thread_local std::size_t PersistLog::file_range_min_size = 0;
+
 PersistLog::PersistLog(const std::string& name, bool enable_signatures) noexcept(true)
         : m_sName(name),
           signature_size(enable_signatures
@@ -16,12 +19,13 @@ PersistLog::PersistLog(const std::string& name, bool enable_signatures) noexcept
 PersistLog::~PersistLog() noexcept(true) {
 }
 
-#ifndef NDEBUG
-void PersistLog::dump_hidx() {
-    dbg_default_trace("number of entry in hidx:{}.log_len={}.", hidx.size(), getLength());
-    for(auto itr = hidx.cbegin(); itr != hidx.cend(); itr++) {
-        dbg_default_trace("hlc({0},{1})->idx({2})", itr->hlc.m_rtc_us, itr->hlc.m_logic, itr->log_idx);
-    }
+void PersistLog::setFileRangePoster(const FileRangePoster& poster, std::size_t min_size) {
+    PersistLog::file_range_poster = poster;
+    PersistLog::file_range_min_size = min_size;
+}
+
+void PersistLog::resetFileRangePoster() noexcept(true) {
+    PersistLog::file_range_poster = nullptr;
+    PersistLog::file_range_min_size = 0;
 }
-#endif  //DERECHO_DEBUG
 }  // namespace persistent
@@ -30,6 +30,22 @@ void PersistentRegistry::makeVersion(version_t ver, const HLC& mhlc) {
     }
 };
 
+void PersistentRegistry::makeVersions(std::size_t num_updates,
+                                      const std::function<std::pair<version_t, uint64_t>(std::size_t)>& apply_update) {
+    std::vector<PersistentObject*> fields;
+    fields.reserve(m_registry.size());
+    for(auto& entry : m_registry) {
+        fields.push_back(entry.second);
+    }
+    for(std::size_t i = 0; i < num_updates; i++) {
+        const std::pair<version_t, uint64_t> update = apply_update(i);
+        const HLC mhlc{update.second, 0};
+        for(PersistentObject* field : fields) {
+            field->version(update.first, mhlc);
+        }
+    }
+};
+
 version_t PersistentRegistry::getMinimumLatestVersion() {
     version_t min = -1;
     for(auto itr = m_registry.begin();
@@ -146,6 +162,10 @@ bool PersistentRegistry::verify(version_t version, openssl::Verifier& verifier,
 
 version_t PersistentRegistry::persist(version_t latest_version) {
     version_t min = INVALID_VERSION;
+    // Let the fields flush concurrently before waiting for each of them.
+    for(auto& entry : m_registry) {
+        entry.second->startPersist(latest_version);
+    }
     for(auto& entry : m_registry) {
         version_t ver = entry.second->persist(latest_version);
         if (min == INVALID_VERSION || 
@@ -0,0 +1,354 @@
+#include "derecho/persistent/detail/UringPersistLog.hpp"
+
+#include "derecho/conf/conf.hpp"
+#include "derecho/persistent/detail/util.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+namespace persistent {
+
+std::unique_ptr<PersistLog> createFilePersistLog(const std::string& name,
+                                                 const std::string& dataPath,
+                                                 bool enableSignatures) {
+    const std::string backend = derecho::getConfString(CONF_PERS_LOG_BACKEND);
+    if(backend == PERS_LOG_BACKEND_IO_URING) {
+#ifdef HAS_LIBURING
+        return std::make_unique<UringPersistLog>(name, dataPath, enableSignatures);
+#else
+        dbg_default_warn("{0}: log backend '{1}' is not available in this build, using '{2}' instead.",
+                         name, backend, PERS_LOG_BACKEND_FILE);
+#endif
+    } else if(backend != PERS_LOG_BACKEND_FILE) {
+        dbg_default_warn("{0}: unknown log backend '{1}', using '{2}' instead.",
+                         name, backend, PERS_LOG_BACKEND_FILE);
+    }
+    return std::make_unique<FilePersistLog>(name, dataPath, enableSignatures);
+}
+
+#ifdef HAS_LIBURING
+
+////////////////////////
+// visible to outside //
+////////////////////////
+
+UringPersistLog::UringPersistLog(const string& name, const string& dataPath, bool enableSignatures)
+        : FilePersistLog(name, dataPath, enableSignatures),
+          m_nextTicket(0),
+          m_retiredTicket(0),
+          m_bReaping(false) {
+    int ret = io_uring_queue_init(URING_MAX_INFLIGHT_FLUSHES * URING_SQES_PER_FLUSH, &m_ring, 0);
+    if(ret < 0) {
+        throw PERSIST_EXP_IO_URING(-ret);
+    }
+    // FilePersistLog::load() has created or loaded the meta file.
+    m_submittedMetaHeader = m_persMetaHeader;
+}
+
+UringPersistLog::~UringPersistLog() noexcept(true) {
+    try {
+        std::unique_lock<std::mutex> lck(m_uringMutex);
+        if(m_nextTicket > 0) {
+            waitForFlushes(lck, m_nextTicket - 1);
+        }
+    } catch(uint64_t e) {
+        dbg_default_error("{0}: failed to wait for in-flight flushes, error:0x{1:x}", this->m_sName, e);
+    }
+    io_uring_queue_exit(&m_ring);
+}
+
+version_t UringPersistLog::getLastPersistedVersion() {
+    std::lock_guard<std::mutex> lck(m_uringMutex);
+    return m_persMetaHeader.fields.ver;
+}
+
+void UringPersistLog::startPersist(version_t ver) {
+    FPL_PERS_LOCK;
+    FPL_RDLOCK;
+    std::unique_lock<std::mutex> lck(m_uringMutex);
+    try {
+        submitFlush(lck);
+    } catch(uint64_t e) {
+        FPL_PERS_UNLOCK;
+        throw e;
+    }
+    FPL_PERS_UNLOCK;
+}
+
+version_t UringPersistLog::persist(version_t ver, bool preLocked) {
+    if(preLocked) {
+        // trim() holds the locks and expects the flush to be done on return: retire the in-flight flushes so that
+        // m_persMetaHeader is stable, then flush synchronously.
+        {
+            std::unique_lock<std::mutex> lck(m_uringMutex);
+            if(m_nextTicket > 0) {
+                waitForFlushes(lck, m_nextTicket - 1);
+            }
+        }
+        return FilePersistLog::persist(ver, true);
+    }
+
+    version_t ver_ret = INVALID_VERSION;
+
+    FPL_PERS_LOCK;
+    FPL_RDLOCK;
+    std::unique_lock<std::mutex> lck(m_uringMutex);
+    if(NUM_USED_SLOTS > 0) {
+        ver_ret = m_currMetaHeader.fields.ver;
+    }
+    try {
+        // Flushes started by startPersist() are still in flight, so the latest ticket covers them all.
+        submitFlush(lck);
+    } catch(uint64_t e) {
+        FPL_PERS_UNLOCK;
+        throw e;
+    }
+    FPL_PERS_UNLOCK;
+    if(m_nextTicket == 0) {
+        lck.unlock();
+        syncSnapshots();
+        return ver_ret;
+    }
+    const uint64_t ticket = m_nextTicket - 1;
+
+    waitForFlushes(lck, ticket);
+    // A failed flush fails every flush that was submitted before the failure was noticed, so the latest ticket
+    // reports the errors of the earlier ones.
+    int error = 0;
+    while(!m_flushErrors.empty() && m_flushErrors.begin()->first <= ticket) {
+        if(m_flushErrors.begin()->first == ticket) {
+            error = m_flushErrors.begin()->second;
+        }
+        m_flushErrors.erase(m_flushErrors.begin());
+    }
+    if(error != 0) {
+        throw PERSIST_EXP_MSYNC(error);
+    }
+    lck.unlock();
+    syncSnapshots();
+    dbg_default_trace("{0} flush data,log,and meta...done.", this->m_sName);
+    return ver_ret;
+}
+
+//////////////////////////
+// invisible to outside //
+//////////////////////////
+
+void UringPersistLog::persistMetaHeaderAtomically(MetaHeader* pShadowHeader) {
+    std::unique_lock<std::mutex> lck(m_uringMutex);
+    // an older header must not overwrite this one.
+    if(m_nextTicket > 0) {
+        waitForFlushes(lck, m_nextTicket - 1);
+    }
+    int error = writeMetaHeader(*pShadowHeader);
+    if(error != 0) {
+        throw PERSIST_EXP_WRITE_FILE(error);
+    }
+    m_submittedMetaHeader = *pShadowHeader;
+}
+
+int UringPersistLog::writeMetaHeader(const MetaHeader& header) {
+    const string swpFile = this->m_sMetaFile + "." + SWAP_FILE_SUFFIX;
+    int fd = open(swpFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    if(fd == -1) {
+        return errno;
+    }
+    // the swap file must be durable before it replaces the meta file
+    if(write(fd, &header, sizeof(MetaHeader)) != sizeof(MetaHeader) || fdatasync(fd) != 0) {
+        int error = (errno != 0) ? errno : EIO;
+        close(fd);
+        return error;
+    }
+    close(fd);
+    if(rename(swpFile.c_str(), this->m_sMetaFile.c_str()) != 0) {
+        return errno;
+    }
+    m_persMetaHeader = header;
+    return 0;
+}
+
+void UringPersistLog::submitFlush(std::unique_lock<std::mutex>& lck) {
+    MetaHeader shadow_header = m_currMetaHeader;
+    if(shadow_header == m_submittedMetaHeader) {
+        // nothing new to flush
+        FPL_UNLOCK;
+        return;
+    }
+    // the entries appended since the last submitted flush
+    std::vector<SegmentRange> ranges;
+    const int64_t first_idx = MAX(m_submittedMetaHeader.fields.tail, m_currMetaHeader.fields.head);
+    if((NUM_USED_SLOTS > 0) && (first_idx < m_currMetaHeader.fields.tail)) {
+        const LogEntry* first_entry = LOG_ENTRY_AT(first_idx);
+        const LogEntry* last_entry = LOG_ENTRY_AT(CURR_LOG_IDX);
+        try {
+            getSegmentRanges(m_dataSegments, DATA_SEGMENT_SIZE, first_entry->fields.ofst,
+                             last_entry->fields.ofst + last_entry->fields.sdlen, ranges);
+            getSegmentRanges(m_logSegments, LOG_SEGMENT_SIZE, first_idx * sizeof(LogEntry),
+                             m_currMetaHeader.fields.tail * sizeof(LogEntry), ranges);
+        } catch(uint64_t e) {
+            FPL_UNLOCK;
+            throw e;
+        }
+    }
+    FPL_UNLOCK;
+
+    dbg_default_trace("{0} submit flush of data and log.", this->m_sName);
+    // make room in the ring
+    while(m_inflight.size() >= URING_MAX_INFLIGHT_FLUSHES) {
+        waitForFlushes(lck, m_retiredTicket);
+    }
+    const uint64_t ticket = m_nextTicket++;
+    InflightFlush& flush = m_inflight[ticket];
+    flush.header = shadow_header;
+    flush.error = 0;
+    // Everything is counted as pending before it is queued: a batch may be submitted, and even completed, before
+    // the whole flush is queued. A flush that only moves the head of the log still needs a completion to be
+    // retired by, so it submits a no-op.
+    flush.pending = ranges.empty() ? 1 : ranges.size();
+    struct io_uring_sqe* sqe;
+    if(ranges.empty()) {
+        sqe = getSqe();
+        io_uring_prep_nop(sqe);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(ticket));
+    }
+    for(const auto& range : ranges) {
+        sqe = getSqe();
+        io_uring_prep_fsync(sqe, range.fd, IORING_FSYNC_DATASYNC);
+        sqe->off = range.offset;
+        sqe->len = static_cast<uint32_t>(range.length);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(ticket));
+    }
+    m_submittedMetaHeader = shadow_header;
+    int ret = io_uring_submit(&m_ring);
+    if(ret < 0) {
+        throw PERSIST_EXP_IO_URING(-ret);
+    }
+}
+
+struct io_uring_sqe* UringPersistLog::getSqe() {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+    if(sqe == nullptr) {
+        int ret = io_uring_submit(&m_ring);
+        if(ret < 0) {
+            throw PERSIST_EXP_IO_URING(-ret);
+        }
+        sqe = io_uring_get_sqe(&m_ring);
+        if(sqe == nullptr) {
+            throw PERSIST_EXP_IO_URING(EBUSY);
+        }
+    }
+    return sqe;
+}
+
+void UringPersistLog::getSegmentRanges(const std::map<int64_t, int>& segments, uint64_t seg_size,
+                                       uint64_t start, uint64_t end, std::vector<SegmentRange>& ranges) {
+    if(end <= start) {
+        return;
+    }
+    for(int64_t seg = start / seg_size; seg <= (int64_t)((end - 1) / seg_size); seg++) {
+        auto itr = segments.find(seg);
+        if(itr == segments.end()) {
+            // all segments of the log are mapped; this never happens.
+            throw PERSIST_EXP_INV_ENTRY_IDX(seg);
+        }
+        const uint64_t seg_start = seg * seg_size;
+        uint64_t offset = MAX(start, seg_start) - seg_start;
+        uint64_t length = MIN(end, seg_start + seg_size) - seg_start - offset;
+        // The range of IORING_OP_FSYNC is limited to 32 bits, so a larger range is split.
+        while(length > 0) {
+            const uint64_t piece = MIN(length, (uint64_t)UINT32_MAX);
+            ranges.push_back(SegmentRange{itr->second, offset, piece});
+            offset += piece;
+            length -= piece;
+        }
+    }
+}
+
+void UringPersistLog::processCompletions() {
+    unsigned head;
+    unsigned count = 0;
+    struct io_uring_cqe* cqe;
+    io_uring_for_each_cqe(&m_ring, head, cqe) {
+        uint64_t ticket = reinterpret_cast<uint64_t>(io_uring_cqe_get_data(cqe));
+        auto it = m_inflight.find(ticket);
+        if(it != m_inflight.end()) {
+            if(cqe->res < 0 && it->second.error == 0) {
+                it->second.error = -cqe->res;
+            }
+            it->second.pending--;
+        }
+        count++;
+    }
+    io_uring_cq_advance(&m_ring, count);
+
+    // Retire the finished flushes in submission order. The meta header is written once, for the latest of them.
+    std::vector<uint64_t> retired_tickets;
+    MetaHeader retired_header = m_persMetaHeader;
+    while(!m_inflight.empty() && m_inflight.begin()->second.pending == 0) {
+        auto it = m_inflight.begin();
+        if(it->second.error == 0) {
+            retired_header = it->second.header;
+            retired_tickets.push_back(it->first);
+        } else {
+            dbg_default_error("{0}: flush of version {1} failed with error {2}.",
+                              this->m_sName, it->second.header.fields.ver, it->second.error);
+            failFlushes(it->second.error);
+            m_flushErrors[it->first] = it->second.error;
+        }
+        m_retiredTicket = it->first + 1;
+        m_inflight.erase(it);
+    }
+    if(!retired_tickets.empty() && !(retired_header == m_persMetaHeader)) {
+        int error = writeMetaHeader(retired_header);
+        if(error != 0) {
+            dbg_default_error("{0}: failed to write the meta header of version {1}, error {2}.",
+                              this->m_sName, retired_header.fields.ver, error);
+            failFlushes(error);
+            for(const uint64_t ticket : retired_tickets) {
+                m_flushErrors[ticket] = error;
+            }
+        }
+    }
+}
+
+void UringPersistLog::failFlushes(int error) {
+    // The flushes still in flight only cover the entries after the failed one, so their meta headers can't be
+    // written either. The next flush starts again from the persisted meta header.
+    for(auto& inflight : m_inflight) {
+        if(inflight.second.error == 0) {
+            inflight.second.error = error;
+        }
+    }
+    m_submittedMetaHeader = m_persMetaHeader;
+}
+
+void UringPersistLog::waitForFlushes(std::unique_lock<std::mutex>& lck, uint64_t ticket) {
+    while(m_retiredTicket <= ticket) {
+        if(m_bReaping) {
+            // another thread is waiting on the completion queue.
+            m_uringCv.wait(lck);
+            continue;
+        }
+        m_bReaping = true;
+        lck.unlock();
+        struct io_uring_cqe* cqe = nullptr;
+        int ret = io_uring_wait_cqe(&m_ring, &cqe);
+        lck.lock();
+        m_bReaping = false;
+        if(ret == 0) {
+            processCompletions();
+        }
+        m_uringCv.notify_all();
+        if(ret < 0 && ret != -EINTR) {
+            throw PERSIST_EXP_IO_URING(-ret);
+        }
+    }
+}
+
+#endif  // HAS_LIBURING
+
+}  // namespace persistent
@@ -14,7 +14,9 @@
 #include "derecho/utils/logger.hpp"
 #include "derecho/core/derecho_exception.hpp"
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <array>
 #include <byteswap.h>
 #include <errno.h>
 #include <iostream>
@@ -574,9 +576,8 @@ void _resources::oob_remote_op(uint32_t op, const struct iovec* iov, int iovcnt,
     msg.data = 0l; // not used
     
     // set up completion entry.
-    const auto tid = std::this_thread::get_id();
-    uint32_t ce_idx = util::polling_data.get_index(tid);
-    util::polling_data.set_waiting(tid);
+    uint32_t ce_idx = util::polling_data.get_index();
+    util::polling_data.set_waiting(ce_idx);
     lf_sender_ctxt sctxt;
     sctxt.set_remote_id(remote_id);
     sctxt.set_ce_idx(ce_idx);
@@ -655,7 +656,7 @@ void _resources::oob_remote_op(uint32_t op, const struct iovec* iov, int iovcnt,
     uint64_t        poll_cq_timeout_ms = derecho::getConfUInt64(CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS);
 
     while (true) {
-        ce = util::polling_data.get_completion_entry(tid);
+        ce = util::polling_data.get_completion_entry(ce_idx);
         if (ce) {
             break;
         }
@@ -666,6 +667,7 @@ void _resources::oob_remote_op(uint32_t op, const struct iovec* iov, int iovcnt,
             break;
         }
     }
+    util::polling_data.reset_waiting(ce_idx);
 
     if (!ce) {
         // timeout or failed.
@@ -856,14 +858,20 @@ void polling_loop() {
     struct timespec last_time, cur_time;
     clock_gettime(CLOCK_REALTIME, &last_time);
 
+    std::array<std::pair<uint32_t, std::pair<int32_t, int32_t>>, max_completions_per_poll> completions;
     while(!shutdown) {
-        auto ce = lf_poll_completion();
+        std::size_t num_completions = lf_poll_completions(completions.data(), completions.size());
         if(shutdown) {
             break;
         }
-        if(ce.first != 0xFFFFFFFF) {
-            util::polling_data.insert_completion_entry(ce.first, ce.second);
-
+        bool any_valid = false;
+        for(std::size_t i = 0; i < num_completions; ++i) {
+            if(completions[i].first != 0xFFFFFFFF) {
+                util::polling_data.insert_completion_entry(completions[i].first, completions[i].second);
+                any_valid = true;
+            }
+        }
+        if(any_valid) {
             // update last time
             clock_gettime(CLOCK_REALTIME, &last_time);
         } else {
@@ -882,16 +890,20 @@ void polling_loop() {
 
 /**
  * @details
- * This blocks until a single entry in the completion queue has
- * completed
+ * This blocks until at least one entry in the completion queue has
+ * completed, and reads as many completed entries as fit in completions
  * It is exclusively used by the polling thread
  * the thread can sleep while in this function, when it calls util::polling_data.wait_for_requests
- * @return pair(remote_id,result) The queue pair number associated with the
- * completed request and the result (1 for successful, -1 for unsuccessful)
+ * @return The number of entries written to completions, each a
+ * pair(ce_idx,pair(remote_id,result)) with the completion entry index and
+ * remote node associated with the completed request and the result (1 for
+ * successful, -1 for unsuccessful)
  */
-std::pair<uint32_t, std::pair<int32_t, int32_t>> lf_poll_completion() {
-    struct fi_cq_entry entry;
-    int poll_result = 0;
+std::size_t lf_poll_completions(std::pair<uint32_t, std::pair<int32_t, int32_t>>* completions,
+                                std::size_t max_completions) {
+    struct fi_cq_entry entries[max_completions_per_poll];
+    max_completions = std::min(max_completions, max_completions_per_poll);
+    ssize_t poll_result = 0;
 
     struct timespec last_time, cur_time;
     clock_gettime(CLOCK_REALTIME, &last_time);
@@ -908,7 +920,7 @@ std::pair<uint32_t, std::pair<int32_t, int32_t>> lf_poll_completion() {
 
         poll_result = 0;
         for(int i = 0; i < 50; ++i) {
-            poll_result = fi_cq_read(g_ctxt.cq, &entry, 1);
+            poll_result = fi_cq_read(g_ctxt.cq, entries, max_completions);
             if(poll_result && (poll_result != -FI_EAGAIN)) {
                 break;
             }
@@ -974,20 +986,23 @@ std::pair<uint32_t, std::pair<int32_t, int32_t>> lf_poll_completion() {
             return {(uint32_t)0xFFFFFFFF, {0, -1}};  // we don't know who sent the message.
         }*/
         dbg_default_error("\tFailed polling the completion queue");
-        return {(uint32_t)0xFFFFFFFF, {0, -1}};  // we don't know who sent the message.
+        completions[0] = {(uint32_t)0xFFFFFFFF, {0, -1}};  // we don't know who sent the message.
+        return 1;
+    }
+    if(shutdown) {
+        return 0;
     }
-    if(!shutdown) {
-        lf_sender_ctxt* sctxt = (lf_sender_ctxt*)entry.op_context;
+    for(ssize_t i = 0; i < poll_result; ++i) {
+        lf_sender_ctxt* sctxt = (lf_sender_ctxt*)entries[i].op_context;
         if(sctxt == NULL) {
             dbg_default_debug("WEIRD: we get an entry with op_context = NULL.");
-            return {0xFFFFFFFFu, {0, 0}};  // return a bad entry: weird!!!!
+            completions[i] = {0xFFFFFFFFu, {0, 0}};  // return a bad entry: weird!!!!
         } else {
             //dbg_default_trace("Normal: we get an entry with op_context = {}.",(long long unsigned)sctxt);
-            return {sctxt->ce_idx(), {sctxt->remote_id(), 1}};
+            completions[i] = {sctxt->ce_idx(), {sctxt->remote_id(), 1}};
         }
-    } else {  // shutdown return a bad entry
-        return {0, {0, 0}};
     }
+    return poll_result;
 }
 
 void lf_initialize(const std::map<node_id_t, std::pair<ip_addr_t, uint16_t>>& internal_ip_addrs_and_ports,
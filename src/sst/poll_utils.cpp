@@ -1,68 +1,105 @@
 #include "derecho/sst/detail/poll_utils.hpp"
 
-#include <functional>
-#include <iostream>
-#include <numeric>
+#include "derecho/utils/logger.hpp"
+
+#include <stdexcept>
 
 namespace sst {
 namespace util {
 
-//std::vector<std::list<std::pair<int32_t, int32_t>>> PollingData::completion_entries;
-//std::map<std::thread::id, uint32_t> PollingData::tid_to_index;
-//std::vector<bool> PollingData::if_waiting;
-//std::condition_variable PollingData::poll_cv;
-//std::mutex PollingData::poll_mutex;
-
 //Single global instance, defined here
 PollingData polling_data;
 
-bool PollingData::check_waiting() {
-    return std::accumulate(if_waiting.begin(), if_waiting.end(), false, [](bool a, bool b) { return a || b; });
+/**
+ * Gives a thread's completion slot back to polling_data when the thread exits.
+ */
+struct SlotOwner {
+    uint32_t index;
+    SlotOwner() : index(polling_data.allocate_index()) {}
+    ~SlotOwner() { polling_data.release_index(index); }
+};
+
+PollingData::~PollingData() {
+    for(auto& slot : slots) {
+        delete slot.load();
+    }
+}
+
+uint32_t PollingData::allocate_index() {
+    std::lock_guard<std::mutex> lk(slot_allocation_mutex);
+    if(!free_indices.empty()) {
+        uint32_t index = free_indices.back();
+        free_indices.pop_back();
+        // Drop any completions that arrived after the previous owner stopped waiting
+        CompletionSlot* slot = slots[index].load(std::memory_order_relaxed);
+        slot->head.store(slot->tail.load(std::memory_order_acquire), std::memory_order_release);
+        return index;
+    }
+    if(num_slots == max_waiting_threads) {
+        throw std::runtime_error("Too many threads are waiting for SST completions");
+    }
+    slots[num_slots].store(new CompletionSlot, std::memory_order_release);
+    return num_slots++;
+}
+
+void PollingData::release_index(uint32_t index) {
+    reset_waiting(index);
+    std::lock_guard<std::mutex> lk(slot_allocation_mutex);
+    free_indices.push_back(index);
 }
 
 void PollingData::insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    completion_entries[index].push_back(ce);
+    CompletionSlot* slot = index < max_waiting_threads ? slots[index].load(std::memory_order_acquire) : nullptr;
+    if(!slot) {
+        dbg_default_warn("Dropping a completion entry for unknown completion slot {}", index);
+        return;
+    }
+    const uint64_t tail = slot->tail.load(std::memory_order_relaxed);
+    if(tail - slot->head.load(std::memory_order_acquire) == slot_capacity) {
+        dbg_default_warn("Dropping a completion entry because completion slot {} is full", index);
+        return;
+    }
+    slot->entries[tail % slot_capacity] = ce;
+    slot->tail.store(tail + 1, std::memory_order_release);
 }
 
-std::optional<std::pair<int32_t, int32_t>> PollingData::get_completion_entry(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if(completion_entries[index].empty()) {
+std::optional<std::pair<int32_t, int32_t>> PollingData::get_completion_entry(uint32_t index) {
+    CompletionSlot* slot = slots[index].load(std::memory_order_relaxed);
+    const uint64_t head = slot->head.load(std::memory_order_relaxed);
+    if(head == slot->tail.load(std::memory_order_acquire)) {
         return {};
     }
-    auto ce = completion_entries[index].front();
-    completion_entries[index].pop_front();
+    auto ce = slot->entries[head % slot_capacity];
+    slot->head.store(head + 1, std::memory_order_release);
     return ce;
 }
 
-uint32_t PollingData::get_index(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    if(tid_to_index.find(id) == tid_to_index.end()) {
-        completion_entries.push_back(std::list<std::pair<int32_t, int32_t>>());
-        tid_to_index[id] = completion_entries.size() - 1;
-        if_waiting.push_back(false);
-    }
-    return tid_to_index[id];
+uint32_t PollingData::get_index() {
+    static thread_local SlotOwner owner;
+    return owner.index;
 }
 
-void PollingData::set_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = true;
-    poll_cv.notify_all();
+void PollingData::set_waiting(uint32_t index) {
+    if(!slots[index].load(std::memory_order_relaxed)->waiting.exchange(true)) {
+        num_waiting++;
+        if(poller_sleeping) {
+            std::lock_guard<std::mutex> lk(poll_mutex);
+            poll_cv.notify_all();
+        }
+    }
 }
 
-void PollingData::reset_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = false;
+void PollingData::reset_waiting(uint32_t index) {
+    if(slots[index].load(std::memory_order_relaxed)->waiting.exchange(false)) {
+        num_waiting--;
+    }
 }
 
 void PollingData::wait_for_requests() {
     std::unique_lock<std::mutex> lk(poll_mutex);
-    // poll_cv.wait(lk, check_waiting);
-    poll_cv.wait(lk, std::bind(&PollingData::check_waiting, this));
+    poller_sleeping = true;
+    poll_cv.wait(lk, [this]() { return num_waiting > 0; });
+    poller_sleeping = false;
 }
 }  // namespace util
 }  // namespace sst
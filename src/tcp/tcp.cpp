@@ -4,18 +4,68 @@
 #include <arpa/inet.h>
 #include <cassert>
 #include <cerrno>
+#include <climits>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <linux/tcp.h>
 #include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <vector>
 
 namespace tcp {
 
+/**
+ * Advances past the first num_bytes bytes of a list of iovecs, by moving the
+ * index of the first unfinished iovec and trimming the start of that iovec.
+ */
+static void advance_iovecs(std::vector<struct iovec>& iovecs, std::size_t& first, std::size_t num_bytes) {
+    while(first < iovecs.size() && num_bytes >= iovecs[first].iov_len) {
+        num_bytes -= iovecs[first].iov_len;
+        ++first;
+    }
+    if(num_bytes > 0) {
+        iovecs[first].iov_base = static_cast<uint8_t*>(iovecs[first].iov_base) + num_bytes;
+        iovecs[first].iov_len -= num_bytes;
+    }
+}
+
+/**
+ * Blocks SIGPIPE in the calling thread for the lifetime of the object, for
+ * system calls like sendfile that can't be passed MSG_NOSIGNAL. A SIGPIPE
+ * raised in the meantime is consumed before the old mask is restored, unless
+ * one was already pending before, so it never reaches the process.
+ */
+class sigpipe_blocker {
+    sigset_t sigpipe_set;
+    sigset_t old_set;
+    bool was_pending;
+
+public:
+    sigpipe_blocker() {
+        sigemptyset(&sigpipe_set);
+        sigaddset(&sigpipe_set, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &sigpipe_set, &old_set);
+        sigset_t pending;
+        sigpending(&pending);
+        was_pending = sigismember(&pending, SIGPIPE);
+    }
+    ~sigpipe_blocker() {
+        if(!was_pending) {
+            const struct timespec no_wait = {0, 0};
+            while(sigtimedwait(&sigpipe_set, nullptr, &no_wait) == -1 && errno == EINTR) {
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+    }
+};
+
 socket::socket(std::string server_ip, uint16_t server_port, bool retry)
         : remote_port(server_port) {
     sock = ::socket(AF_INET, SOCK_STREAM, 0);
@@ -199,6 +249,88 @@ void socket::write(const uint8_t* buffer, size_t size) {
     }
 }
 
+void socket::readv(const struct iovec* iov, int iovcnt) {
+    if(sock < 0) {
+        throw socket_closed_error("Attempted to read from closed socket");
+    }
+
+    std::vector<struct iovec> remaining(iov, iov + iovcnt);
+    std::size_t first = 0;
+    advance_iovecs(remaining, first, 0);
+    while(first < remaining.size()) {
+        ssize_t new_bytes = ::readv(sock, remaining.data() + first,
+                                    std::min<std::size_t>(remaining.size() - first, IOV_MAX));
+        if(new_bytes > 0) {
+            advance_iovecs(remaining, first, new_bytes);
+        } else if(new_bytes == 0) {
+            throw incomplete_read_error("Read EOF prematurely");
+        } else if(new_bytes == -1 && errno != EINTR) {
+            throw socket_io_error(errno, "Read failed due to an error in socket connected to " + remote_ip);
+        }
+    }
+}
+
+void socket::writev(const struct iovec* iov, int iovcnt) {
+    if(sock < 0) {
+        throw socket_closed_error("Attempted to write to closed socket");
+    }
+
+    std::vector<struct iovec> remaining(iov, iov + iovcnt);
+    std::size_t first = 0;
+    advance_iovecs(remaining, first, 0);
+    while(first < remaining.size()) {
+        //Use sendmsg rather than ::writev so that MSG_NOSIGNAL can be passed, as in write()
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = remaining.data() + first;
+        message.msg_iovlen = std::min<std::size_t>(remaining.size() - first, IOV_MAX);
+        ssize_t bytes_written = sendmsg(sock, &message, MSG_NOSIGNAL);
+        if(bytes_written >= 0) {
+            advance_iovecs(remaining, first, bytes_written);
+        } else if(bytes_written == -1 && errno == ECONNRESET) {
+            throw connection_reset_error("socket::writev: Connection reset on socket to " + remote_ip);
+        } else if(bytes_written == -1 && errno == EPIPE) {
+            throw remote_closed_connection_error("socket::writev: Socket closed by remote at " + remote_ip);
+        } else if(bytes_written == -1 && errno != EINTR) {
+            throw socket_io_error(errno, "socket::writev: Unexpected error in socket connected to " + remote_ip);
+        }
+    }
+}
+
+void socket::sendfile(int file_fd, off_t offset, size_t size) {
+    if(sock < 0) {
+        throw socket_closed_error("Attempted to write to closed socket");
+    }
+
+    //::sendfile can't take MSG_NOSIGNAL, so block SIGPIPE instead
+    sigpipe_blocker blocker;
+    size_t total_bytes = 0;
+    while(total_bytes < size) {
+        //sendfile advances offset by the number of bytes it sent
+        ssize_t bytes_written = ::sendfile(sock, file_fd, &offset, size - total_bytes);
+        if(bytes_written > 0) {
+            total_bytes += bytes_written;
+        } else if(bytes_written == 0) {
+            throw socket_error("socket::sendfile: File ended before all bytes were sent to " + remote_ip);
+        } else if(errno == ECONNRESET) {
+            throw connection_reset_error("socket::sendfile: Connection reset on socket to " + remote_ip);
+        } else if(errno == EPIPE) {
+            throw remote_closed_connection_error("socket::sendfile: Socket closed by remote at " + remote_ip);
+        } else if(errno != EINTR) {
+            throw socket_io_error(errno, "socket::sendfile: Unexpected error in socket connected to " + remote_ip);
+        }
+    }
+}
+
+void socket::set_buffer_sizes(int send_buffer_size, int receive_buffer_size) {
+    if(setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &send_buffer_size, sizeof(send_buffer_size))) {
+        throw socket_io_error(errno, "socket::set_buffer_sizes: Failed to set the send buffer size");
+    }
+    if(setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size))) {
+        throw socket_io_error(errno, "socket::set_buffer_sizes: Failed to set the receive buffer size");
+    }
+}
+
 std::string socket::get_self_ip() {
     struct sockaddr_storage my_addr_info;
     socklen_t len = sizeof my_addr_info;